@@ -0,0 +1,669 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file diet-bench.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Main program file with main() entry point.
+*
+* The calory-counter load generator. Every connection has its own thread, which sends one request at a
+* time, either as soon as the previous one was answered (closed loop) or at fixed times (open loop). In
+* open loop, the latency is measured from the time the request should have been sent, so a server which
+* falls behind is not hidden by requests which are sent late.
+*
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "../lib/food.h"
+#include "../lib/foodlist.h"
+#include "../lib/sock.h"
+#include "../lib/histogram.h"
+
+#define BENCH_TIMEOUT_S 5 /**< Seconds after which a request without answer counts as error */
+#define BENCH_RETRY_MS 100 /**< Delay before reconnecting after a failed connection */
+
+/**
+* @brief Bench config structure
+*
+*
+*/
+struct bench_config {
+    char *host; /**< Hostname or path of the Unix domain socket to connect to */
+    unsigned int port; /**< Port to connect to */
+    char *csv; /**< csv-file the search terms are taken from */
+    unsigned int conns; /**< Number of concurrent connections */
+    unsigned int duration; /**< Duration of the measurement in seconds */
+    double rate; /**< Requests per second over all connections, 0 for closed loop */
+    unsigned int food_pct; /**< Percentage of FOOD requests */
+    double zipf; /**< Exponent of the Zipf distribution of the terms, 0 to use their frequency in the csv-file */
+    bool legacy; /**< True, if the connections stay in the acknowledged legacy mode */
+};
+
+/**
+* @brief Forward declaration of bench_config
+*
+*
+*/
+typedef struct bench_config bench_config;
+
+/**
+* @brief Search terms with their cumulative probabilities
+*
+*/
+struct bench_terms {
+    char **terms; /**< Distinct terms, most frequent first */
+    double *cdf; /**< Probability of drawing one of the terms up to this index */
+    size_t num; /**< Number of terms */
+};
+
+/**
+* @brief State of one connection thread
+*
+*/
+struct bench_worker {
+    bench_config *config; /**< Shared configuration */
+    struct bench_terms *terms; /**< Shared search terms */
+    unsigned int index; /**< Number of this connection */
+    pthread_t thread; /**< Thread sending the requests */
+    uint64_t rng; /**< State of the random number generator */
+    int sock; /**< Connected socket, -1 while disconnected */
+    unsigned long next_id; /**< Id of the next pipelined request */
+    histogram *search; /**< Latencies of SEARCH requests in ns */
+    histogram *food; /**< Latencies of FOOD requests in ns, only acknowledged in legacy mode */
+    uint64_t searches; /**< Number of answered SEARCH requests */
+    uint64_t foods; /**< Number of sent FOOD requests */
+    uint64_t found; /**< Number of received foods */
+    uint64_t errors; /**< Number of failed requests and connections */
+    uint64_t rejected; /**< Number of connections the server rejected as busy */
+    char frame[SOCK_FRAME_MAX + 1]; /**< Buffer for received frames */
+};
+
+/**
+* @brief This is set to exit when the application should exit gracefully.
+*
+* */
+volatile sig_atomic_t bench_exit = 0;
+
+/**
+* @brief Start of the measurement, the same for all connections
+*
+* */
+struct timespec bench_start;
+
+/**
+* @brief Prints the help for diet-bench to the console.
+* @param char* Program name
+*
+* */
+void usage(char *pname) {
+    fprintf(stderr, "usage: %s [-c conns] [-d seconds] [-r rate] [-f food%%] [-z exponent] [-i csv] [-L] <host> <port>\n", pname);
+    fprintf(stderr, "       %s [options] <socket path>\n", pname);
+}
+
+/**
+* @brief Signal handler stopping the measurement early
+* @param int The signal
+*
+* */
+void bench_signal_handler(int sig) {
+    (void) sig;
+    bench_exit = 1;
+}
+
+/**
+* @brief Helper function to get the nanoseconds between two points in time
+* @param struct timespec* The earlier point in time
+* @param struct timespec* The later point in time
+* @return The nanoseconds, 0 if the later point is before the earlier one
+*
+* */
+static uint64_t bench_elapsed(const struct timespec *from, const struct timespec *to) {
+    int64_t ns = (int64_t) (to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+    return ns > 0 ? (uint64_t) ns : 0;
+}
+
+/**
+* @brief Helper function to add nanoseconds to a point in time
+* @param struct timespec* The point in time, it is modified
+* @param uint64_t The nanoseconds
+*
+* */
+static void bench_advance(struct timespec *ts, uint64_t ns) {
+    ts->tv_sec += ns / 1000000000ULL;
+    ts->tv_nsec += ns % 1000000000ULL;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+* @brief Helper function to sleep
+* @param unsigned int The delay in ms
+*
+* */
+static void bench_sleep(unsigned int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+/**
+* @brief Helper function to draw a random number, xorshift64*
+* @param struct bench_worker* The worker owning the generator
+* @return A random number
+*
+* */
+static uint64_t bench_random(struct bench_worker *w) {
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return w->rng * 2685821657736338717ULL;
+}
+
+/**
+* @brief Helper function to draw a search term
+* @param struct bench_worker* The worker drawing the term
+* @return The term, owned by the terms structure
+*
+* */
+static const char *bench_term(struct bench_worker *w) {
+    double p = (bench_random(w) >> 11) * (1.0 / 9007199254740992.0);
+    size_t lo = 0, hi = w->terms->num - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (w->terms->cdf[mid] < p) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return w->terms->terms[lo];
+}
+
+/**
+* @brief Compare function for using qsort() with strings, ignoring the case
+* @param void* Pointer to first string
+* @param void* Pointer to second string
+* @return An integer less than, equal to, or greater than zero
+*
+* */
+static int bench_cmp_name(const void *a, const void *b) {
+    return strcasecmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+* @brief A distinct term and the number of names starting with it
+*
+*/
+struct bench_count {
+    char *term; /**< The term */
+    size_t count; /**< Number of names starting with the term */
+};
+
+/**
+* @brief Compare function for using qsort() with term counts, most frequent first
+* @param void* Pointer to first count
+* @param void* Pointer to second count
+* @return An integer less than, equal to, or greater than zero
+*
+* */
+static int bench_cmp_count(const void *a, const void *b) {
+    const struct bench_count *x = a, *y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return strcasecmp(x->term, y->term);
+}
+
+/**
+* @brief Method for loading the search terms from a csv-file
+* @param char* Name of the csv-file
+* @param double Exponent of the Zipf distribution, 0 to draw terms as often as names start with them
+* @param struct bench_terms* Structure to fill
+* @return False, if the file contains no foods, true otherwise
+*
+* Searches only match whole comma separated parts of a name, so every name yields its first part, its
+* first two parts and so on, e.g. "Milk" and "Milk, whole".
+*
+* */
+bool bench_load_terms(char *csv, double zipf, struct bench_terms *t) {
+    foodlist *fl = foodlist_init_csv(csv);
+    size_t n = 0;
+    food **foods = foodlist_get_range(fl, 0, (size_t) foodlist_count(fl), &n);
+    char **prefixes = NULL;
+    size_t num_prefixes = 0, cap = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const char *name = food_get_name(foods[i]);
+        const char *p = name;
+        do {
+            p = strchr(p, ',');
+            size_t len = p ? (size_t) (p - name) : strlen(name);
+            if (num_prefixes == cap) {
+                cap = cap ? cap * 2 : 1024;
+                prefixes = realloc(prefixes, cap * sizeof(char *));
+            }
+            prefixes[num_prefixes++] = strndup(name, len);
+        } while (p && *++p);
+    }
+    free(foods);
+    foodlist_destroy(fl);
+    if (num_prefixes == 0) {
+        free(prefixes);
+        return false;
+    }
+
+    qsort(prefixes, num_prefixes, sizeof(char *), bench_cmp_name);
+    struct bench_count *counts = malloc(num_prefixes * sizeof(struct bench_count));
+    size_t num = 0;
+    for (size_t i = 0; i < num_prefixes; ++i) {
+        if (num > 0 && !strcasecmp(counts[num - 1].term, prefixes[i])) {
+            counts[num - 1].count++;
+            free(prefixes[i]);
+        } else {
+            counts[num].term = prefixes[i];
+            counts[num].count = 1;
+            num++;
+        }
+    }
+    free(prefixes);
+    qsort(counts, num, sizeof(struct bench_count), bench_cmp_count);
+
+    t->terms = malloc(num * sizeof(char *));
+    t->cdf = malloc(num * sizeof(double));
+    t->num = num;
+    double sum = 0;
+    for (size_t i = 0; i < num; ++i) {
+        t->terms[i] = counts[i].term;
+        sum += zipf > 0 ? 1.0 / pow((double) (i + 1), zipf) : (double) counts[i].count;
+        t->cdf[i] = sum;
+    }
+    for (size_t i = 0; i < num; ++i) {
+        t->cdf[i] /= sum;
+    }
+    /* rounding must not leave the last term out of reach */
+    t->cdf[num - 1] = 1.0;
+    free(counts);
+    return true;
+}
+
+/**
+* @brief Helper function to connect to the server and switch the connection to pipelined mode if requested
+* @param struct bench_worker* The worker to connect
+* @return SOCK_OK if the connection is ready for requests, SOCK_BUSY if the server rejected it, SOCK_ERROR otherwise
+*
+* */
+static sock_status bench_connect(struct bench_worker *w) {
+    bench_config *c = w->config;
+    struct sockaddr_storage server;
+    socklen_t len;
+    bool local = strchr(c->host, '/') != NULL;
+    memset(&server, 0, sizeof(server));
+    if (local) {
+        struct sockaddr_un *un = (struct sockaddr_un *) &server;
+        if (strlen(c->host) >= sizeof(un->sun_path)) {
+            return SOCK_ERROR;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, c->host);
+        len = sizeof(struct sockaddr_un);
+    } else {
+        struct sockaddr_in *in = (struct sockaddr_in *) &server;
+        in->sin_addr.s_addr = inet_addr(c->host);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(c->port);
+        len = sizeof(struct sockaddr_in);
+    }
+    w->sock = socket(server.ss_family, SOCK_STREAM, 0);
+    if (w->sock == -1) {
+        return SOCK_ERROR;
+    }
+    /* a lost answer must not stall the connection until the end of the measurement */
+    struct timeval tv = {BENCH_TIMEOUT_S, 0};
+    setsockopt(w->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (!local) {
+        /* a request written right after an unanswered FOOD must not wait for the delayed ACK of the server */
+        int one = 1;
+        setsockopt(w->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (connect(w->sock, (struct sockaddr *) &server, len) < 0) {
+        close(w->sock);
+        w->sock = -1;
+        return SOCK_ERROR;
+    }
+    if (c->legacy) {
+        return SOCK_OK;
+    }
+    unsigned int retry_ms = 0;
+    char buf[BUF_LEN] = {0};
+    sock_status st = sock_send_status(w->sock, "HELLO:", local ? SOCK_PIPELINE : SOCK_FEATURES, &retry_ms);
+    if (st == SOCK_BUSY) {
+        close(w->sock);
+        w->sock = -1;
+        bench_sleep(retry_ms);
+        return SOCK_BUSY;
+    }
+    if (st != SOCK_OK || !sock_read(w->sock, buf) || strncmp("HELLO:", buf, 6)
+        || !sock_has_feature(buf + 6, SOCK_PIPELINE)) {
+        close(w->sock);
+        w->sock = -1;
+        return SOCK_ERROR;
+    }
+    w->next_id = 1;
+    return SOCK_OK;
+}
+
+/**
+* @brief Helper function to read the answer of a pipelined search
+* @param struct bench_worker* The worker which sent the search
+* @param unsigned long Id of the search
+* @return Number of found foods, or -1 on errors
+*
+* */
+static long bench_read_pipelined(struct bench_worker *w, unsigned long id) {
+    long expected = -1, received = 0;
+    while (expected < 0 || received < expected) {
+        if (sock_read_frame(w->sock, w->frame) <= 0) {
+            return -1;
+        }
+        char *save = NULL;
+        for (char *msg = strtok_r(w->frame, "\n", &save); msg; msg = strtok_r(NULL, "\n", &save)) {
+            unsigned long msg_id = 0;
+            char *body = sock_parse_tag(msg, &msg_id);
+            if (!body || msg_id != id) {
+                return -1;
+            }
+            if (expected < 0 && !strncmp("COUNT:", body, 6)) {
+                expected = strtol(body + 6, NULL, 10);
+            } else if (expected >= 0 && !strncmp("FOOD:", body, 5)) {
+                received++;
+            } else {
+                return -1;
+            }
+        }
+    }
+    return received;
+}
+
+/**
+* @brief Helper function to send a search and wait for its answer
+* @param struct bench_worker* The worker sending the search
+* @param char* The search term
+* @return Number of found foods, or -1 on errors
+*
+* */
+static long bench_search(struct bench_worker *w, const char *term) {
+    if (!w->config->legacy) {
+        char msg[MAX_NAME_LEN + 64];
+        int len = snprintf(msg, sizeof(msg), "#%lu SEARCH:%s\n", w->next_id, term);
+        if (!sock_write_frame(w->sock, msg, len, false)) {
+            return -1;
+        }
+        return bench_read_pipelined(w, w->next_id++);
+    }
+    char buf[BUF_LEN] = {0};
+    strncpy(buf, term, BUF_LEN - 1);
+    if (!sock_send_search(w->sock, buf) || !sock_read(w->sock, buf) || strncmp("COUNT:", buf, 6)) {
+        return -1;
+    }
+    long count = strtol(buf + 6, NULL, 10);
+    for (long i = 0; i < count; ++i) {
+        if (!sock_read(w->sock, buf) || strncmp("FOOD:", buf, 5)) {
+            return -1;
+        }
+    }
+    return count;
+}
+
+/**
+* @brief Helper function to send a new food
+* @param struct bench_worker* The worker sending the food
+* @return True, if the food was sent, and acknowledged in legacy mode, false otherwise
+*
+* */
+static bool bench_add(struct bench_worker *w) {
+    food *f = food_init();
+    char name[64];
+    snprintf(name, sizeof(name), "calory-bench, %u, %llu", w->index, (unsigned long long) w->foods);
+    food_set_name(f, name);
+    food_set_measure(f, "1 serving");
+    food_set_weight(f, 100);
+    food_set_kcal(f, (int) (bench_random(w) % 900));
+    char *s = food_serialize(f);
+    food_destroy(f);
+    bool ok;
+    if (!w->config->legacy) {
+        char msg[BUF_LEN + 64];
+        int len = snprintf(msg, sizeof(msg), "#%lu FOOD:%s\n", w->next_id++, s);
+        ok = sock_write_frame(w->sock, msg, len, false);
+    } else {
+        ok = sock_send_food(w->sock, s);
+    }
+    free(s);
+    return ok;
+}
+
+/**
+* @brief Main function of a connection thread
+* @param void* The worker
+* @return Always NULL
+*
+* */
+static void *bench_thread_func(void *arg) {
+    struct bench_worker *w = arg;
+    bench_config *c = w->config;
+    struct timespec end = bench_start;
+    bench_advance(&end, (uint64_t) c->duration * 1000000000ULL);
+    /* in open loop, every connection sends its share of the rate, the connections are staggered */
+    uint64_t interval = c->rate > 0 ? (uint64_t) (1e9 * c->conns / c->rate) : 0;
+    struct timespec next = bench_start;
+    bench_advance(&next, interval * w->index / c->conns);
+
+    struct timespec now;
+    while (!bench_exit) {
+        if (interval) {
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (bench_elapsed(&now, &end) == 0 || bench_exit) {
+            break;
+        }
+        sock_status st = w->sock < 0 ? bench_connect(w) : SOCK_OK;
+        if (st != SOCK_OK) {
+            /* the request which should have been sent is lost */
+            if (st == SOCK_BUSY) {
+                w->rejected++;
+            } else {
+                w->errors++;
+                bench_sleep(BENCH_RETRY_MS);
+            }
+            if (interval) {
+                bench_advance(&next, interval);
+            }
+            continue;
+        }
+        struct timespec sent = interval ? next : now;
+        bool is_food = bench_random(w) % 100 < c->food_pct;
+        long found = is_food ? (bench_add(w) ? 0 : -1) : bench_search(w, bench_term(w));
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (found < 0) {
+            w->errors++;
+            close(w->sock);
+            w->sock = -1;
+        } else if (is_food) {
+            w->foods++;
+            /* a pipelined food is not answered, only the acknowledgement of the legacy mode is timed */
+            if (c->legacy) {
+                histogram_record(w->food, bench_elapsed(&sent, &now));
+            }
+        } else {
+            w->searches++;
+            w->found += found;
+            histogram_record(w->search, bench_elapsed(&sent, &now));
+        }
+        if (interval) {
+            bench_advance(&next, interval);
+        }
+    }
+    if (w->sock >= 0) {
+        close(w->sock);
+    }
+    return NULL;
+}
+
+/**
+* @brief Main entry point of diet-bench
+* @param int Number of arguments
+* @param char** Pointer to array of arguments
+* @return Exit code of diet-bench
+*
+* */
+int main(int argc, char **argv) {
+
+    bench_config bc;
+    bc.host = "127.0.0.1";
+    bc.port = 12345;
+    bc.csv = "calories.csv";
+    bc.conns = 16;
+    bc.duration = 10;
+    bc.rate = 0;
+    bc.food_pct = 0;
+    bc.zipf = 0;
+    bc.legacy = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:d:r:f:z:i:Lh")) != -1) {
+        switch (opt) {
+            case 'c':
+                bc.conns = atoi(optarg);
+                break;
+            case 'd':
+                bc.duration = atoi(optarg);
+                break;
+            case 'r':
+                bc.rate = atof(optarg);
+                break;
+            case 'f':
+                bc.food_pct = atoi(optarg);
+                break;
+            case 'z':
+                bc.zipf = atof(optarg);
+                break;
+            case 'i':
+                bc.csv = optarg;
+                break;
+            case 'L':
+                bc.legacy = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) {
+        /* a path selects the Unix domain socket of a local server */
+        if (strchr(argv[optind], '/')) {
+            bc.host = argv[optind];
+        } else if (optind + 1 < argc) {
+            bc.host = argv[optind];
+            bc.port = atoi(argv[optind + 1]);
+        } else {
+            bc.port = atoi(argv[optind]);
+        }
+    }
+    if (bc.conns == 0 || bc.duration == 0 || bc.food_pct > 100 || bc.rate < 0 || bc.zipf < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct bench_terms terms;
+    if (!bench_load_terms(bc.csv, bc.zipf, &terms)) {
+        fprintf(stderr, "No search terms in %s\n", bc.csv);
+        return 1;
+    }
+    printf("%zu search terms from %s, %s\n", terms.num, bc.csv, bc.zipf > 0 ? "Zipf distribution" : "csv distribution");
+    if (bc.rate > 0) {
+        printf("Open loop, %.0f requests/s over %u connections for %u s\n", bc.rate, bc.conns, bc.duration);
+    } else {
+        printf("Closed loop, %u connections for %u s\n", bc.conns, bc.duration);
+    }
+    fflush(stdout);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, bench_signal_handler);
+    signal(SIGTERM, bench_signal_handler);
+
+    struct bench_worker *workers = calloc(bc.conns, sizeof(struct bench_worker));
+    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+    for (unsigned int i = 0; i < bc.conns; ++i) {
+        struct bench_worker *w = &workers[i];
+        w->config = &bc;
+        w->terms = &terms;
+        w->index = i;
+        w->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        w->sock = -1;
+        w->search = histogram_init(11);
+        w->food = histogram_init(11);
+        pthread_create(&w->thread, NULL, bench_thread_func, w);
+    }
+
+    histogram *search = histogram_init(11);
+    histogram *fh = histogram_init(11);
+    uint64_t searches = 0, foods = 0, found = 0, errors = 0, rejected = 0;
+    for (unsigned int i = 0; i < bc.conns; ++i) {
+        struct bench_worker *w = &workers[i];
+        pthread_join(w->thread, NULL);
+        histogram_merge(search, w->search);
+        histogram_merge(fh, w->food);
+        searches += w->searches;
+        foods += w->foods;
+        found += w->found;
+        errors += w->errors;
+        rejected += w->rejected;
+        histogram_destroy(w->search);
+        histogram_destroy(w->food);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double secs = bench_elapsed(&bench_start, &now) / 1e9;
+
+    printf("requests=%llu searches=%llu foods=%llu found=%llu errors=%llu rejected=%llu\n",
+           (unsigned long long) (searches + foods), (unsigned long long) searches, (unsigned long long) foods,
+           (unsigned long long) found, (unsigned long long) errors, (unsigned long long) rejected);
+    printf("throughput=%.1f requests/s in %.2f s\n", (searches + foods) / secs, secs);
+    histogram_print(search, stdout, "SEARCH latency (us):", 1000.0);
+    if (histogram_count(fh) > 0) {
+        histogram_print(fh, stdout, "FOOD latency (us):", 1000.0);
+    }
+
+    histogram_destroy(search);
+    histogram_destroy(fh);
+    free(workers);
+    for (size_t i = 0; i < terms.num; ++i) {
+        free(terms.terms[i]);
+    }
+    free(terms.terms);
+    free(terms.cdf);
+    return errors > 0 ? 2 : 0;
+}
@@ -0,0 +1,584 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file diet-gen.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Main program file with main() entry point.
+*
+* Generator of synthetic calories.csv files of any size, learned from a real one. A name is a chain of
+* comma separated parts. The first part is drawn like in a Chinese restaurant process: it is a new one
+* with a probability falling with the number of rows, otherwise the first part of an earlier row, so
+* a few first parts are shared by many names, like "Beef" or "Milk". The concentration of the process is
+* fitted to the number of distinct first parts of the real file. Every further part follows the previous
+* one as in the real file, or, now and then, is any part seen at its depth. New words are made up by a
+* letter model of the real parts. Measure and nutrition values are taken from a real row with the same
+* first part, if there is one, and scaled.
+*
+* The same seed, input file and number of rows always generate the same file.
+*
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include "../lib/food.h"
+
+#define GEN_LINE_LEN 4096 /**< Maximum length of a line of the input file */
+#define GEN_MAX_DEPTH 16 /**< Maximum number of parts of a name */
+#define GEN_MIX 0.1 /**< Probability of following any part of the depth instead of the learned successors */
+#define GEN_END ((size_t) -1) /**< Marks the end of a name in the successors of a part */
+#define GEN_LETTERS 257 /**< Letters of the letter model, the last one marks the start and the end of a word */
+
+/**
+* @brief A multiset of indices, drawing from it is drawing with the frequency of the indices
+*
+*/
+struct gen_bag {
+    size_t *items; /**< The indices */
+    size_t num; /**< Number of indices */
+    size_t cap; /**< Allocated entries of items */
+};
+
+/**
+* @brief A row of the input file, the template of nutrition values
+*
+*/
+struct gen_row {
+    char *measure; /**< Measure, e.g. "1 Cup" */
+    double values[5]; /**< Weight, kCal, fat, carbo and protein */
+    bool decimals; /**< True, if the weight has decimals, e.g. "28.35" */
+};
+
+/**
+* @brief A part of the names
+*
+*/
+struct gen_word {
+    char *text; /**< The part, e.g. "Raw" */
+    struct gen_bag next; /**< Parts following this one in the input file, GEN_END for the end of a name */
+    struct gen_bag rows; /**< Rows of the input file whose name starts with this part */
+};
+
+/**
+* @brief The learned model
+*
+*/
+struct gen_model {
+    struct gen_word *words; /**< All parts, the ones made up included */
+    size_t num_words; /**< Number of parts */
+    size_t *table; /**< Hash table of the parts, index + 1 or 0 for free slots */
+    size_t table_cap; /**< Number of slots of the hash table, a power of two */
+    struct gen_bag depth[GEN_MAX_DEPTH]; /**< Parts seen at every depth after the first, GEN_END for ends */
+    struct gen_bag heads; /**< First part of every row so far, the input rows included */
+    struct gen_bag head_words; /**< Numbers of words of the distinct first parts of the input file */
+    struct gen_row *rows; /**< Rows of the input file */
+    size_t num_rows; /**< Number of rows of the input file */
+    double alpha; /**< Concentration of the first parts */
+    size_t num_heads; /**< Number of distinct first parts so far */
+    uint32_t letters[GEN_LETTERS][GEN_LETTERS]; /**< Number of times a letter follows another one */
+    uint64_t letter_totals[GEN_LETTERS]; /**< Number of times any letter follows a letter */
+    uint64_t rng; /**< State of the random number generator */
+};
+
+/**
+* @brief Set of the hashes of the generated names, for keeping the names unique
+*
+*/
+struct gen_names {
+    uint64_t *slots; /**< Hashes, 0 for free slots */
+    size_t num; /**< Number of hashes */
+    size_t cap; /**< Number of slots, a power of two */
+};
+
+/**
+* @brief Prints the help for diet-gen to the console.
+* @param char* Program name
+*
+* */
+void usage(char *pname) {
+    fprintf(stderr, "usage: %s [-n rows] [-s seed] [-i csv] [-o file] [-a alpha]\n", pname);
+}
+
+/**
+* @brief Helper function to add an index to a bag
+* @param struct gen_bag* The bag
+* @param size_t The index
+*
+* */
+static void gen_bag_add(struct gen_bag *b, size_t item) {
+    if (b->num == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 4;
+        b->items = realloc(b->items, b->cap * sizeof(size_t));
+    }
+    b->items[b->num++] = item;
+}
+
+/**
+* @brief Helper function to draw a random number, xorshift64*
+* @param struct gen_model* The model owning the generator
+* @return A random number
+*
+* */
+static uint64_t gen_random(struct gen_model *m) {
+    m->rng ^= m->rng >> 12;
+    m->rng ^= m->rng << 25;
+    m->rng ^= m->rng >> 27;
+    return m->rng * 2685821657736338717ULL;
+}
+
+/**
+* @brief Helper function to draw a random number between 0 and 1
+* @param struct gen_model* The model owning the generator
+* @return A random number, at least 0 and less than 1
+*
+* */
+static double gen_uniform(struct gen_model *m) {
+    return (gen_random(m) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+* @brief Helper function to draw an index from a bag
+* @param struct gen_model* The model owning the generator
+* @param struct gen_bag* The bag, it must not be empty
+* @return The index
+*
+* */
+static size_t gen_bag_draw(struct gen_model *m, struct gen_bag *b) {
+    return b->items[gen_random(m) % b->num];
+}
+
+/**
+* @brief Helper function to hash a string, ignoring the case like the search does
+* @param char* The string
+* @return The hash, never 0
+*
+* */
+static uint64_t gen_hash(const char *s) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *s; ++s) {
+        h ^= (unsigned char) tolower((unsigned char) *s);
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+/**
+* @brief Helper function to find a part, adding it if it is new
+* @param struct gen_model* The model
+* @param char* The part
+* @return Index of the part
+*
+* */
+static size_t gen_word(struct gen_model *m, const char *text) {
+    if (2 * (m->num_words + 1) > m->table_cap) {
+        size_t cap = m->table_cap ? m->table_cap * 2 : 1024;
+        size_t *table = calloc(cap, sizeof(size_t));
+        for (size_t i = 0; i < m->num_words; ++i) {
+            size_t slot = gen_hash(m->words[i].text) & (cap - 1);
+            while (table[slot]) {
+                slot = (slot + 1) & (cap - 1);
+            }
+            table[slot] = i + 1;
+        }
+        free(m->table);
+        m->table = table;
+        m->table_cap = cap;
+    }
+    size_t slot = gen_hash(text) & (m->table_cap - 1);
+    while (m->table[slot]) {
+        if (!strcmp(m->words[m->table[slot] - 1].text, text)) {
+            return m->table[slot] - 1;
+        }
+        slot = (slot + 1) & (m->table_cap - 1);
+    }
+    m->words = realloc(m->words, (m->num_words + 1) * sizeof(struct gen_word));
+    struct gen_word *w = &m->words[m->num_words];
+    memset(w, 0, sizeof(struct gen_word));
+    w->text = strdup(text);
+    m->table[slot] = ++m->num_words;
+    return m->num_words - 1;
+}
+
+/**
+* @brief Helper function to learn the letters of a part
+* @param struct gen_model* The model
+* @param char* The part
+*
+* */
+static void gen_learn_letters(struct gen_model *m, const char *text) {
+    unsigned int prev = GEN_LETTERS - 1;
+    for (const unsigned char *p = (const unsigned char *) text; *p; ++p) {
+        unsigned int c = tolower(*p);
+        m->letters[prev][c]++;
+        m->letter_totals[prev]++;
+        prev = c;
+    }
+    m->letters[prev][GEN_LETTERS - 1]++;
+    m->letter_totals[prev]++;
+}
+
+/**
+* @brief Helper function to make up a word with the letter model, capitalized like the input file
+* @param struct gen_model* The model
+* @param char* Buffer for the word
+* @param size_t Length of the buffer
+*
+* */
+static void gen_make_word(struct gen_model *m, char *buf, size_t len) {
+    for (;;) {
+        size_t n = 0;
+        unsigned int prev = GEN_LETTERS - 1;
+        while (n + 1 < len) {
+            uint64_t r = gen_random(m) % m->letter_totals[prev];
+            unsigned int c = 0;
+            while (r >= m->letters[prev][c]) {
+                r -= m->letters[prev][c++];
+            }
+            /* a space or comma would split the word */
+            if (c == GEN_LETTERS - 1 || c == ' ' || c == ',') {
+                break;
+            }
+            buf[n] = (char) (n == 0 ? toupper(c) : c);
+            n++;
+            prev = c;
+        }
+        buf[n] = 0;
+        if (n >= 3 && n <= 12) {
+            return;
+        }
+    }
+}
+
+/**
+* @brief Helper function to learn a row of the input file
+* @param struct gen_model* The model
+* @param char* The line, it is modified
+*
+* */
+static void gen_learn(struct gen_model *m, char *line) {
+    line[strcspn(line, "\r\n")] = 0;
+    char *fields[GEN_MAX_DEPTH + 6];
+    size_t n = 0;
+    char *save = NULL;
+    for (char *p = strtok_r(line, ",", &save); p && n < GEN_MAX_DEPTH + 6; p = strtok_r(NULL, ",", &save)) {
+        fields[n++] = p;
+    }
+    if (n < 7) {
+        return;
+    }
+    size_t parts = n - 6;
+    struct gen_row *row = &m->rows[m->num_rows];
+    row->measure = strdup(fields[parts]);
+    for (int i = 0; i < 5; ++i) {
+        row->values[i] = atof(fields[parts + 1 + i]);
+    }
+    row->decimals = strchr(fields[parts + 1], '.') != NULL;
+
+    size_t prev = GEN_END;
+    for (size_t i = 0; i < parts; ++i) {
+        gen_learn_letters(m, fields[i]);
+        size_t w = gen_word(m, fields[i]);
+        if (i == 0) {
+            gen_bag_add(&m->heads, w);
+            gen_bag_add(&m->words[w].rows, m->num_rows);
+        } else {
+            gen_bag_add(&m->words[prev].next, w);
+            gen_bag_add(&m->depth[i], w);
+        }
+        prev = w;
+    }
+    gen_bag_add(&m->words[prev].next, GEN_END);
+    if (parts < GEN_MAX_DEPTH) {
+        gen_bag_add(&m->depth[parts], GEN_END);
+    }
+    m->num_rows++;
+}
+
+/**
+* @brief Helper function to fit the concentration of the first parts to the input file
+* @param size_t Number of rows
+* @param size_t Number of distinct first parts
+* @return The concentration, for which the expected number of distinct first parts matches
+*
+* */
+static double gen_fit_alpha(size_t rows, size_t distinct) {
+    double lo = 1e-3, hi = 1e7;
+    for (int iter = 0; iter < 100; ++iter) {
+        double alpha = sqrt(lo * hi);
+        double expected = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            expected += alpha / (alpha + i);
+        }
+        if (expected < distinct) {
+            lo = alpha;
+        } else {
+            hi = alpha;
+        }
+    }
+    return sqrt(lo * hi);
+}
+
+/**
+* @brief Method for learning the model from a csv-file
+* @param struct gen_model* The model to fill
+* @param char* Name of the csv-file
+* @return False, if the file could not be read or has no rows, true otherwise
+*
+* */
+bool gen_load(struct gen_model *m, char *file) {
+    FILE *fptr = fopen(file, "r");
+    if (!fptr) {
+        fprintf(stderr, "cannot read file %s\n", file);
+        return false;
+    }
+    size_t cap = 1024;
+    m->rows = malloc(cap * sizeof(struct gen_row));
+    char line[GEN_LINE_LEN];
+    while (fgets(line, sizeof(line), fptr)) {
+        if (*line == '#') {
+            continue;
+        }
+        if (m->num_rows == cap) {
+            cap *= 2;
+            m->rows = realloc(m->rows, cap * sizeof(struct gen_row));
+        }
+        gen_learn(m, line);
+    }
+    fclose(fptr);
+    if (m->num_rows == 0) {
+        fprintf(stderr, "No foods in %s\n", file);
+        return false;
+    }
+    size_t distinct = 0;
+    for (size_t i = 0; i < m->num_words; ++i) {
+        if (m->words[i].rows.num > 0) {
+            distinct++;
+            size_t words = 1;
+            for (const char *p = m->words[i].text; *p; ++p) {
+                words += *p == ' ';
+            }
+            gen_bag_add(&m->head_words, words);
+        }
+    }
+    m->num_heads = distinct;
+    if (m->alpha <= 0) {
+        m->alpha = gen_fit_alpha(m->num_rows, distinct);
+    }
+    return true;
+}
+
+/**
+* @brief Helper function to draw the first part of the next name
+* @param struct gen_model* The model
+* @return Index of the part
+*
+* */
+static size_t gen_head(struct gen_model *m) {
+    size_t w;
+    if (gen_uniform(m) * (m->heads.num + m->alpha) < m->alpha) {
+        /* a new first part of as many words as the first parts of the input file */
+        char text[MAX_NAME_LEN / 2];
+        size_t words = gen_bag_draw(m, &m->head_words);
+        size_t len = 0;
+        for (size_t i = 0; i < words && len + 16 < sizeof(text); ++i) {
+            if (i > 0) {
+                text[len++] = ' ';
+            }
+            gen_make_word(m, text + len, 14);
+            len += strlen(text + len);
+        }
+        w = gen_word(m, text);
+        m->num_heads++;
+    } else {
+        w = gen_bag_draw(m, &m->heads);
+    }
+    gen_bag_add(&m->heads, w);
+    return w;
+}
+
+/**
+* @brief Helper function to add a hash to the set of generated names
+* @param struct gen_names* The set
+* @param uint64_t The hash
+* @return False, if the hash was in the set already, true otherwise
+*
+* */
+static bool gen_names_add(struct gen_names *s, uint64_t h) {
+    if (2 * (s->num + 1) > s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint64_t *slots = calloc(cap, sizeof(uint64_t));
+        for (size_t i = 0; i < s->cap; ++i) {
+            if (s->slots[i]) {
+                size_t slot = s->slots[i] & (cap - 1);
+                while (slots[slot]) {
+                    slot = (slot + 1) & (cap - 1);
+                }
+                slots[slot] = s->slots[i];
+            }
+        }
+        free(s->slots);
+        s->slots = slots;
+        s->cap = cap;
+    }
+    size_t slot = h & (s->cap - 1);
+    while (s->slots[slot]) {
+        if (s->slots[slot] == h) {
+            return false;
+        }
+        slot = (slot + 1) & (s->cap - 1);
+    }
+    s->slots[slot] = h;
+    s->num++;
+    return true;
+}
+
+/**
+* @brief Method for generating one row
+* @param struct gen_model* The model
+* @param struct gen_names* The names generated so far
+* @param FILE* Stream to write the row to
+*
+* */
+void gen_row(struct gen_model *m, struct gen_names *names, FILE *out) {
+    char name[MAX_NAME_LEN];
+    size_t head = gen_head(m);
+    size_t len = snprintf(name, sizeof(name), "%s", m->words[head].text);
+    size_t prev = head;
+    for (size_t depth = 1; depth < GEN_MAX_DEPTH; ++depth) {
+        struct gen_bag *next = &m->words[prev].next;
+        size_t w = GEN_END;
+        if (next->num > 0 && gen_uniform(m) >= GEN_MIX) {
+            w = gen_bag_draw(m, next);
+        } else if (m->depth[depth].num > 0) {
+            w = gen_bag_draw(m, &m->depth[depth]);
+        }
+        if (w == GEN_END || len + strlen(m->words[w].text) + 2 >= sizeof(name) / 2) {
+            break;
+        }
+        len += snprintf(name + len, sizeof(name) - len, ",%s", m->words[w].text);
+        prev = w;
+    }
+    /* the learned chains repeat in large files, a made up part keeps a search from finding thousands of equal names */
+    for (int i = 0; !gen_names_add(names, gen_hash(name)); ++i) {
+        if (i < 8) {
+            name[len] = ',';
+            gen_make_word(m, name + len + 1, 14);
+        } else {
+            snprintf(name + len, sizeof(name) - len, ",%d", i);
+        }
+    }
+
+    struct gen_bag *rows = &m->words[head].rows;
+    struct gen_row *row = &m->rows[rows->num > 0 ? gen_bag_draw(m, rows) : gen_random(m) % m->num_rows];
+    /* about half to twice the amount of the template, the proportions stay realistic */
+    double scale = exp((gen_uniform(m) - 0.5) * 1.4);
+    double v[5];
+    for (int i = 0; i < 5; ++i) {
+        v[i] = row->values[i] * scale;
+    }
+    if (row->decimals) {
+        fprintf(out, "%s,%s,%.2f,%.0f,%.0f,%.0f,%.0f\n", name, row->measure, v[0], v[1], v[2], v[3], v[4]);
+    } else {
+        fprintf(out, "%s,%s,%.0f,%.0f,%.0f,%.0f,%.0f\n", name, row->measure, v[0], v[1], v[2], v[3], v[4]);
+    }
+}
+
+/**
+* @brief Main entry point of diet-gen
+* @param int Number of arguments
+* @param char** Pointer to array of arguments
+* @return Exit code of diet-gen
+*
+* */
+int main(int argc, char **argv) {
+
+    size_t num = 100000;
+    unsigned long seed = 1;
+    char *input = "calories.csv";
+    char *output = NULL;
+    double alpha = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:i:o:a:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                num = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = strcmp(optarg, "-") ? optarg : NULL;
+                break;
+            case 'a':
+                alpha = atof(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    struct gen_model *m = calloc(1, sizeof(struct gen_model));
+    m->alpha = alpha;
+    /* splitmix64 of the seed, similar seeds must not start similar sequences */
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    m->rng = (z ^ (z >> 31)) | 1;
+    if (!gen_load(m, input)) {
+        return 1;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "cannot write file %s\n", output);
+        return 1;
+    }
+    fprintf(out, "# Generated by calory-gen from %s, seed %lu, %zu rows\n", input, seed, num);
+    fprintf(out, "#\n# The names of the fields are\n");
+    fprintf(out, "# Food, Measure, Weight (g), kCal, Fat (g), Carbo(g), Protein (g)\n#\n");
+    struct gen_names names = {NULL, 0, 0};
+    for (size_t i = 0; i < num; ++i) {
+        gen_row(m, &names, out);
+    }
+    if (output) {
+        fclose(out);
+    }
+    fprintf(stderr, "%zu rows from %zu input rows, %zu distinct first parts, alpha %.1f\n", num, m->num_rows,
+            m->num_heads, m->alpha);
+
+    free(names.slots);
+    for (size_t i = 0; i < m->num_words; ++i) {
+        free(m->words[i].text);
+        free(m->words[i].next.items);
+        free(m->words[i].rows.items);
+    }
+    for (size_t i = 0; i < m->num_rows; ++i) {
+        free(m->rows[i].measure);
+    }
+    for (size_t i = 0; i < GEN_MAX_DEPTH; ++i) {
+        free(m->depth[i].items);
+    }
+    free(m->heads.items);
+    free(m->head_words.items);
+    free(m->words);
+    free(m->table);
+    free(m->rows);
+    free(m);
+    return 0;
+}
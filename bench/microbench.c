@@ -0,0 +1,418 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file microbench.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Main program file with main() entry point.
+*
+* Microbenchmarks of the foodlist and food methods of calory-lib on synthetic food lists. Every size is
+* measured in a child process of its own, so its peak RSS is not inflated by the larger sizes measured
+* before. The allocations of calory-lib are counted by wrapping malloc(), calloc() and realloc() at link
+* time, allocations inside the C library, e.g. by fopen(), are not counted.
+*
+* Every measurement prints one line of key=value pairs, e.g.
+*
+*     op=foodlist_find_hit rows=100000 ops=412 ns_per_op=485113.2 allocs_per_op=1.00 peak_rss_kb=231604
+*
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "../lib/food.h"
+#include "../lib/foodlist.h"
+
+#define MICROBENCH_MAX_SIZES 16 /**< Maximum number of sizes measured in one run */
+#define MICROBENCH_CODEC_ROWS 10000 /**< Maximum number of distinct foods serialized and deserialized */
+
+/**
+* @brief Microbench config structure
+*
+*
+*/
+struct microbench_config {
+    size_t sizes[MICROBENCH_MAX_SIZES]; /**< Numbers of rows of the synthetic food lists */
+    size_t num_sizes; /**< Number of sizes */
+    unsigned int budget_ms; /**< Time spent on repeating one operation */
+    unsigned int seed; /**< Seed of the synthetic food lists and search terms */
+    char *dir; /**< Directory for the csv-files */
+};
+
+/**
+* @brief Forward declaration of microbench_config
+*
+*
+*/
+typedef struct microbench_config microbench_config;
+
+/**
+* @brief Number of allocations of calory-lib so far
+*
+* */
+static uint64_t microbench_allocs = 0;
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+
+/**
+* @brief Replacement of malloc() counting the allocations, linked with -Wl,--wrap=malloc
+* @param size_t Number of bytes
+* @return The allocated memory
+*
+* */
+void *__wrap_malloc(size_t size) {
+    microbench_allocs++;
+    return __real_malloc(size);
+}
+
+/**
+* @brief Replacement of calloc() counting the allocations, linked with -Wl,--wrap=calloc
+* @param size_t Number of elements
+* @param size_t Size of an element
+* @return The allocated memory
+*
+* */
+void *__wrap_calloc(size_t num, size_t size) {
+    microbench_allocs++;
+    return __real_calloc(num, size);
+}
+
+/**
+* @brief Replacement of realloc() counting the allocations, linked with -Wl,--wrap=realloc
+* @param void* The memory to resize
+* @param size_t Number of bytes
+* @return The resized memory
+*
+* */
+void *__wrap_realloc(void *ptr, size_t size) {
+    microbench_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+/**
+* @brief First parts of the synthetic names
+*
+* */
+static const char *microbench_heads[] = {
+    "Apples", "Bagels", "Beans", "Beef", "Bread", "Butter", "Cake", "Cheese", "Chicken", "Cookies",
+    "Corn", "Crackers", "Eggs", "Fish", "Ham", "Ice cream", "Juice", "Lamb", "Milk", "Muffins",
+    "Noodles", "Oil", "Pasta", "Peas", "Pie", "Pork", "Potatoes", "Rice", "Soup", "Yogurt"
+};
+
+/**
+* @brief Further parts of the synthetic names
+*
+* */
+static const char *microbench_parts[] = {
+    "raw", "cooked", "canned", "frozen", "dried", "fresh", "baked", "fried", "boiled", "roasted",
+    "whole", "sliced", "chopped", "low fat", "salted", "unsalted", "sweetened", "plain", "enriched", "smoked"
+};
+
+/**
+* @brief Measures of the synthetic foods
+*
+* */
+static const char *microbench_measures[] = {
+    "1 cup", "1 tbsp", "1 oz", "1 slice", "1 piece", "1 medium", "3 oz", "1/2 cup"
+};
+
+#define MICROBENCH_LEN(a) (sizeof(a) / sizeof((a)[0])) /**< Number of elements of a static array */
+
+/**
+* @brief Helper function to draw a random number, xorshift64*
+* @param uint64_t* State of the generator
+* @return A random number
+*
+* */
+static uint64_t microbench_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/**
+* @brief Helper function to get the current time
+* @return Monotonic time in ns
+*
+* */
+static uint64_t microbench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+* @brief Helper function to get the peak RSS of the process
+* @return Peak RSS in KiB
+*
+* */
+static long microbench_peak_rss() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/**
+* @brief Helper function to fill a synthetic food
+* @param food* The food to fill
+* @param size_t Row of the food, makes the name unique
+* @param uint64_t* State of the random number generator
+*
+* Names share their first parts like the real ones, e.g. "Milk, low fat, canned, 1234".
+*
+* */
+static void microbench_food(food *f, size_t row, uint64_t *rng) {
+    char name[MAX_NAME_LEN];
+    int len = snprintf(name, sizeof(name), "%s", microbench_heads[microbench_random(rng) % MICROBENCH_LEN(microbench_heads)]);
+    unsigned int parts = microbench_random(rng) % 3;
+    for (unsigned int i = 0; i < parts; ++i) {
+        len += snprintf(name + len, sizeof(name) - len, ", %s",
+                        microbench_parts[microbench_random(rng) % MICROBENCH_LEN(microbench_parts)]);
+    }
+    snprintf(name + len, sizeof(name) - len, ", %zu", row);
+    food_set_name(f, name);
+    food_set_measure(f, microbench_measures[microbench_random(rng) % MICROBENCH_LEN(microbench_measures)]);
+    food_set_weight(f, 10 + microbench_random(rng) % 300);
+    food_set_kcal(f, microbench_random(rng) % 900);
+    food_set_fat(f, microbench_random(rng) % 60);
+    food_set_carbo(f, microbench_random(rng) % 100);
+    food_set_protein(f, microbench_random(rng) % 50);
+}
+
+/**
+* @brief Helper function to print the result of a measurement
+* @param char* Name of the operation
+* @param size_t Number of rows of the food list
+* @param uint64_t Number of operations
+* @param uint64_t Elapsed time in ns
+* @param uint64_t Number of allocations
+*
+* */
+static void microbench_report(const char *op, size_t rows, uint64_t ops, uint64_t ns, uint64_t allocs) {
+    printf("op=%s rows=%zu ops=%llu ns_per_op=%.1f allocs_per_op=%.2f peak_rss_kb=%ld\n", op, rows,
+           (unsigned long long) ops, ops ? (double) ns / ops : 0, ops ? (double) allocs / ops : 0,
+           microbench_peak_rss());
+    fflush(stdout);
+}
+
+/**
+* @brief Helper function to repeat searches until the time budget is spent
+* @param microbench_config* The configuration
+* @param foodlist* The food list to search
+* @param food** The foods of the list, the search terms are taken from their names
+* @param size_t Number of rows
+* @param bool True, to search for names of the list, false to search for names which are not in it
+* @param uint64_t* State of the random number generator
+*
+* */
+static void microbench_find(microbench_config *c, foodlist *fl, food **foods, size_t rows, bool hit, uint64_t *rng) {
+    uint64_t ops = 0, elapsed = 0, allocs = 0;
+    char term[MAX_NAME_LEN];
+    while (ops == 0 || elapsed < c->budget_ms * 1000000ULL) {
+        if (hit) {
+            /* the first part of a name, e.g. "Milk" */
+            const char *name = food_get_name(foods[microbench_random(rng) % rows]);
+            snprintf(term, sizeof(term), "%.*s", (int) strcspn(name, ","), name);
+        } else {
+            snprintf(term, sizeof(term), "Zz%llu", (unsigned long long) (microbench_random(rng) % 1000000));
+        }
+        uint64_t a = microbench_allocs, t = microbench_now();
+        size_t num = 0;
+        food **found = foodlist_find(fl, term, &num);
+        free(found);
+        elapsed += microbench_now() - t;
+        allocs += microbench_allocs - a;
+        ops++;
+    }
+    microbench_report(hit ? "foodlist_find_hit" : "foodlist_find_miss", rows, ops, elapsed, allocs);
+}
+
+/**
+* @brief Helper function to measure all operations on a food list of one size
+* @param microbench_config* The configuration
+* @param size_t Number of rows
+* @return Exit code of the child process
+*
+* */
+static int microbench_size(microbench_config *c, size_t rows) {
+    uint64_t rng = 0x9E3779B97F4A7C15ULL ^ ((uint64_t) c->seed << 32) ^ rows;
+    char file[4096];
+    snprintf(file, sizeof(file), "%s/microbench-%zu.csv", c->dir, rows);
+
+    /* the csv-file is not measured */
+    FILE *fptr = fopen(file, "w");
+    if (!fptr) {
+        fprintf(stderr, "cannot write file %s\n", file);
+        return 1;
+    }
+    food *f = food_init();
+    for (size_t i = 0; i < rows; ++i) {
+        microbench_food(f, i, &rng);
+        char *s = food_serialize(f);
+        fprintf(fptr, "%s\n", s);
+        free(s);
+    }
+    food_destroy(f);
+    fclose(fptr);
+
+    uint64_t a = microbench_allocs, t = microbench_now();
+    foodlist *fl = foodlist_init_csv(file);
+    microbench_report("foodlist_init_csv", rows, rows, microbench_now() - t, microbench_allocs - a);
+
+    size_t n = 0;
+    food **foods = foodlist_get_range(fl, 0, rows, &n);
+    microbench_find(c, fl, foods, n, true, &rng);
+    microbench_find(c, fl, foods, n, false, &rng);
+
+    a = microbench_allocs;
+    t = microbench_now();
+    foodlist_save(fl);
+    microbench_report("foodlist_save", rows, rows, microbench_now() - t, microbench_allocs - a);
+
+    /* serialize distinct foods, a single food would stay in the cache */
+    size_t codec_rows = n < MICROBENCH_CODEC_ROWS ? n : MICROBENCH_CODEC_ROWS;
+    char **lines = malloc(codec_rows * sizeof(char *));
+    uint64_t ops = 0, elapsed = 0, allocs = 0;
+    while (ops < codec_rows || elapsed < c->budget_ms * 1000000ULL) {
+        size_t i = ops % codec_rows;
+        a = microbench_allocs;
+        t = microbench_now();
+        char *s = food_serialize(foods[i]);
+        elapsed += microbench_now() - t;
+        allocs += microbench_allocs - a;
+        if (ops < codec_rows) {
+            lines[i] = s;
+        } else {
+            free(s);
+        }
+        ops++;
+    }
+    microbench_report("food_serialize", rows, ops, elapsed, allocs);
+
+    /* food_deserialize() modifies its argument, copying it is measured as well */
+    char line[4096];
+    ops = elapsed = allocs = 0;
+    while (ops < codec_rows || elapsed < c->budget_ms * 1000000ULL) {
+        a = microbench_allocs;
+        t = microbench_now();
+        strcpy(line, lines[ops % codec_rows]);
+        food *d = food_deserialize(line);
+        elapsed += microbench_now() - t;
+        allocs += microbench_allocs - a;
+        food_destroy(d);
+        ops++;
+    }
+    microbench_report("food_deserialize", rows, ops, elapsed, allocs);
+    for (size_t i = 0; i < codec_rows; ++i) {
+        free(lines[i]);
+    }
+    free(lines);
+    free(foods);
+    foodlist_destroy(fl);
+
+    /* the foods are created up front, only appending them is measured */
+    foods = malloc(rows * sizeof(food *));
+    for (size_t i = 0; i < rows; ++i) {
+        foods[i] = food_init();
+        microbench_food(foods[i], i, &rng);
+    }
+    fl = foodlist_init();
+    a = microbench_allocs;
+    t = microbench_now();
+    for (size_t i = 0; i < rows; ++i) {
+        foodlist_append(fl, &foods[i]);
+    }
+    microbench_report("foodlist_append", rows, rows, microbench_now() - t, microbench_allocs - a);
+    foodlist_destroy(fl);
+    free(foods);
+
+    unlink(file);
+    return 0;
+}
+
+/**
+* @brief Prints the help for microbench to the console.
+* @param char* Program name
+*
+* */
+void usage(char *pname) {
+    fprintf(stderr, "usage: %s [-n rows[,rows...]] [-t ms] [-s seed] [-d dir]\n", pname);
+}
+
+/**
+* @brief Main entry point of microbench
+* @param int Number of arguments
+* @param char** Pointer to array of arguments
+* @return Exit code of microbench
+*
+* */
+int main(int argc, char **argv) {
+
+    microbench_config mc;
+    size_t defaults[] = {1000, 10000, 100000, 1000000};
+    memcpy(mc.sizes, defaults, sizeof(defaults));
+    mc.num_sizes = MICROBENCH_LEN(defaults);
+    mc.budget_ms = 200;
+    mc.seed = 1;
+    mc.dir = "/tmp";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:s:d:h")) != -1) {
+        switch (opt) {
+            case 'n': {
+                mc.num_sizes = 0;
+                char *save = NULL;
+                for (char *p = strtok_r(optarg, ",", &save); p && mc.num_sizes < MICROBENCH_MAX_SIZES;
+                     p = strtok_r(NULL, ",", &save)) {
+                    mc.sizes[mc.num_sizes++] = strtoul(p, NULL, 10);
+                }
+                break;
+            }
+            case 't':
+                mc.budget_ms = atoi(optarg);
+                break;
+            case 's':
+                mc.seed = atoi(optarg);
+                break;
+            case 'd':
+                mc.dir = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < mc.num_sizes; ++i) {
+        if (mc.sizes[i] == 0) {
+            continue;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            exit(microbench_size(&mc, mc.sizes[i]));
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Measuring %zu rows failed\n", mc.sizes[i]);
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -21,13 +21,10 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
 #include <ctype.h>
-#include <unistd.h>
-#include <errno.h>
-#include "../lib/sock.h"
+#include <signal.h>
 #include "../lib/food.h"
+#include "../lib/dietclient.h"
 
 /**
 * @brief Client config structure
@@ -46,6 +43,12 @@ struct client_config {
 */
 typedef struct client_config client_config;
 
+/**
+* @brief Number of items shown at once
+*
+* */
+#define PAGE_SIZE 25
+
 /**
 * @brief This is set to exit when the application should exit gracefully.
 *
@@ -59,6 +62,7 @@ bool client_exit = false;
 * */
 void usage(char *pname) {
     fprintf(stderr, "usage: %s <host> <port>\n", pname);
+    fprintf(stderr, "       %s <socket path>\n", pname);
 }
 
 /**
@@ -198,108 +202,105 @@ food *get_food_from_user() {
 }
 
 /**
-* @brief Loop function with handles the client connection and user input stuff.
-* @param client_config* A pointer to the client configuration
+* @brief Method for searching and printing the results page by page.
+* @param dietclient* The client to search with
+* @param char* The search term as entered by the user
 *
 * */
-void client_loop(client_config *c) {
-    while (!client_exit) {
-        int sock;
-        struct sockaddr_in server;
-
-        sock = socket(AF_INET, SOCK_STREAM, 0);
-        if (sock == -1) {
-            printf("Could not create socket %d\n", errno);
+void show_results(dietclient *dc, char *input) {
+    char *cursor = NULL;
+    size_t shown = 0;
+    do {
+        food **foods = NULL;
+        size_t count = 0;
+        dietclient_future *fu = dietclient_search_page_async(dc, input, PAGE_SIZE, cursor);
+        dietclient_status st = dietclient_future_wait(fu, &foods, &count);
+        free(cursor);
+        cursor = NULL;
+        if (st != DIETCLIENT_OK) {
+            printf("Error in protocol, search failed\n");
+        } else {
+            if (dietclient_future_cursor(fu)) {
+                cursor = strdup(dietclient_future_cursor(fu));
+            }
+            if (shown + count == 0) {
+                printf("\nNo items found matching %sPlease check your spelling and try again!\n\n", input);
+            } else if (cursor || shown > 0) {
+                printf("\nShowing items %zu to %zu\n\n", shown + 1, shown + count);
+            } else if (count == 1) {
+                printf("\nFound %zu item\n\n", count);
+            } else {
+                printf("\nFound %zu items\n\n", count);
+            }
         }
+        for (size_t i = 0; i < count; ++i) {
+            char *c = food_to_string(foods[i]);
+            printf("%s\n", c);
+            free(c);
+            food_destroy(foods[i]);
+        }
+        free(foods);
+        dietclient_future_destroy(fu);
+        shown += count;
 
-        server.sin_addr.s_addr = inet_addr(c->host);
-        server.sin_family = AF_INET;
-        server.sin_port = htons(c->port);
-
-        /* Connect to remote server, retry every 5 seconds if failing */
-        if (connect(sock, (struct sockaddr *) &server, sizeof(server)) < 0) {
-            printf("connect failed. Error %d\n", errno);
-            sleep(5);
-            continue;
+        /* the next page is only requested if the user wants to see it */
+        if (cursor) {
+            printf("Press enter to show more items or ‘q’ to stop:\n> ");
+            fflush(stdout);
+            char *more = NULL;
+            size_t morelen = 0;
+            if (getline(&more, &morelen, stdin) == -1 || *more == 'q') {
+                free(cursor);
+                cursor = NULL;
+            }
+            free(more);
         }
+    } while (cursor);
+}
 
-        while (!client_exit) {
-            printf("Enter the food name to search, ‘a’ to add a new food item, or ‘q’ to quit:\n> ");
+/**
+* @brief Loop function with handles the user input stuff, the connection is handled by the dietclient.
+* @param client_config* A pointer to the client configuration
+*
+* */
+void client_loop(client_config *c) {
+    dietclient *dc = dietclient_init(c->host, c->port, 1);
+    while (!client_exit) {
+        printf("Enter the food name to search, ‘a’ to add a new food item, or ‘q’ to quit:\n> ");
+        fflush(stdout);
 
-            char *input = NULL;
-            size_t inputlen = 0;
-            int read = 0;
-            read = getline(&input, &inputlen, stdin);
+        char *input = NULL;
+        size_t inputlen = 0;
+        int read = 0;
+        read = getline(&input, &inputlen, stdin);
 
+        /* end of input */
+        if (read == -1) {
+            client_exit = true;
             /* add some food */
-            if (read == 2 && *input == 'a') {
-                food *f = get_food_from_user();
-                if (f) {
-                    char *sf = food_serialize(f);
-                    if (sock_send_food(sock, sf)) {
-                        printf("Sent food to server\n");
-                    } else {
-                        printf("Error sending food to server\n");
-                    }
-                    free(sf);
-                    food_destroy(f);
-                }
-                /* quit application */
-            } else if (read == 2 && *input == 'q') {
-                client_exit = true;
-                printf("quit application\n");
-                /* everything else is a search request */
-            } else if (read >= 2) {
-                if (sock_send_search(sock, input)) {
-                    /* server must reply with number of items */
-                    char buf[BUF_LEN] = {0};
-                    size_t count = 0;
-                    if (sock_read(sock, buf)) {
-                        if (!strncmp("COUNT:", buf, 6)) {
-                            count = atoi(buf + 6);
-                        } else {
-                            printf("Error in protocol, expected COUNT");
-                        }
-                    } else {
-                        printf("Read failed, %d\n", errno);
-                        continue;
-                    }
-                    if (count == 0) {
-                        printf("\nNo items found matching %sPlease check your spelling and try again!\n\n", input);
-                    } else if (count == 1) {
-                        printf("\nFound %zu item\n\n", count);
-                    } else {
-                        printf("\nFound %zu items\n\n", count);
-                    }
-                    /* now, server must send 'count' foods */
-                    for (int i = 0; i < count; ++i) {
-                        char buf[BUF_LEN] = {0};
-                        if (sock_read(sock, buf)) {
-                            if (!strncmp("FOOD:", buf, 5)) {
-                                food *f = food_deserialize(buf + 5);
-                                char *c = food_to_string(f);
-                                printf("%s\n", c);
-                                free(c);
-                                free(f);
-                            } else {
-                                printf("Error in protocol, expected FOOD");
-                            }
-                        } else {
-                            printf("Read failed, %d\n", errno);
-                            continue;
-                        }
-                    }
+        } else if (read == 2 && *input == 'a') {
+            food *f = get_food_from_user();
+            if (f) {
+                dietclient_future *fu = dietclient_add_async(dc, f);
+                if (dietclient_future_wait(fu, NULL, NULL) == DIETCLIENT_OK) {
+                    printf("Sent food to server\n");
                 } else {
-                    printf("Send failed, %d\n", errno);
-                    continue;
+                    printf("Error sending food to server\n");
                 }
-            } else {
-                continue;
+                dietclient_future_destroy(fu);
+                food_destroy(f);
             }
-            free(input);
+            /* quit application */
+        } else if (read == 2 && *input == 'q') {
+            client_exit = true;
+            printf("quit application\n");
+            /* everything else is a search request */
+        } else if (read >= 2) {
+            show_results(dc, input);
         }
-        close(sock);
+        free(input);
     }
+    dietclient_destroy(dc);
 }
 
 /**
@@ -312,6 +313,9 @@ void client_loop(client_config *c) {
 int main(int argc, char **argv) {
 
     client_config cc;
+    /* a server rejecting us may close the connection before our HELLO arrived */
+    signal(SIGPIPE, SIG_IGN);
+
     /* set default values */
     cc.port = 12345;
     cc.host = "127.0.0.1";
@@ -323,7 +327,12 @@ int main(int argc, char **argv) {
             usage(argv[0]);
             return 0;
         }
-        cc.port = atoi(argv[1]);
+        /* a path selects the Unix domain socket of a local server */
+        if (strchr(argv[1], '/')) {
+            cc.host = argv[1];
+        } else {
+            cc.port = atoi(argv[1]);
+        }
     }
 
     /* program started with one argument */
@@ -0,0 +1,106 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file bloom.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief File containing the bloom structure and its member methods.
+*
+* The filter uses 10 bits per string and 7 probes, which gives a false positive rate below 1%. The
+* probes are derived from one 64 bit hash by double hashing.
+*
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "bloom.h"
+
+#define BLOOM_BITS_PER_KEY 10 /**< Bits of the filter per string it is sized for */
+#define BLOOM_PROBES 7 /**< Number of bits set for every string */
+
+/**
+* @brief bloom structure for representing a bloom filter
+*
+*/
+struct bloom {
+    uint64_t *bits; /**< The bit array */
+    size_t num_bits; /**< Number of bits in the bit array */
+    size_t capacity; /**< Number of strings the filter is sized for */
+    size_t count; /**< Number of added strings */
+};
+
+/**
+* @brief Helper function to hash a string case insensitively
+* @param char* The string
+* @param size_t Length of the string
+* @return The 64 bit hash value
+*
+* */
+static uint64_t bloom_hash(const char *key, size_t len) {
+    /* FNV-1a with a final mix, so both halves of the value are usable as independent hashes */
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char) tolower((unsigned char) key[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bloom *bloom_init(size_t capacity) {
+    bloom *b = (bloom *) malloc(sizeof(bloom));
+    b->capacity = capacity > 0 ? capacity : 1;
+    b->num_bits = ((b->capacity * BLOOM_BITS_PER_KEY + 63) / 64) * 64;
+    b->bits = calloc(b->num_bits / 64, sizeof(uint64_t));
+    b->count = 0;
+    return b;
+}
+
+void bloom_add(bloom *b, const char *key, size_t len) {
+    uint64_t h = bloom_hash(key, len);
+    uint64_t h1 = h & 0xffffffffULL;
+    uint64_t h2 = (h >> 32) | 1;
+    for (int i = 0; i < BLOOM_PROBES; ++i) {
+        size_t bit = (h1 + i * h2) % b->num_bits;
+        __atomic_fetch_or(&b->bits[bit / 64], 1ULL << (bit % 64), __ATOMIC_RELAXED);
+    }
+    b->count++;
+}
+
+bool bloom_may_contain(bloom *b, const char *key, size_t len) {
+    uint64_t h = bloom_hash(key, len);
+    uint64_t h1 = h & 0xffffffffULL;
+    uint64_t h2 = (h >> 32) | 1;
+    for (int i = 0; i < BLOOM_PROBES; ++i) {
+        size_t bit = (h1 + i * h2) % b->num_bits;
+        if (!(__atomic_load_n(&b->bits[bit / 64], __ATOMIC_RELAXED) & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t bloom_count(bloom *b) {
+    return b->count;
+}
+
+size_t bloom_capacity(bloom *b) {
+    return b->capacity;
+}
+
+size_t bloom_memory(bloom *b) {
+    return sizeof(bloom) + b->num_bits / 8;
+}
+
+void bloom_destroy(bloom *b) {
+    free(b->bits);
+    free(b);
+}
@@ -0,0 +1,95 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file bloom.h
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Header containing the public accessible bloom methods.
+*
+* A bloom filter is a compact set of strings which answers membership queries with false positives, but
+* without false negatives. Strings are compared case insensitively, like the search of the foodlist.
+*
+*/
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+*
+* @brief Forward declaration for bloom
+*
+* */
+typedef struct bloom bloom;
+
+/**
+* @brief Constructor for bloom
+* @param size_t Number of strings the filter is sized for
+* @return A pointer to the bloom structure, representing the created object
+*
+* Adding more strings than the filter is sized for increases the false positive rate.
+* After using this structure, it must be freed with bloom_destroy(bloom *)
+*
+* */
+bloom *bloom_init(size_t);
+
+/**
+* @brief Method for adding a string to the filter
+* @param bloom* Pointer to structure to work on
+* @param char* The string, it does not need to be zero terminated
+* @param size_t Length of the string
+*
+* Adds are not serialized among each other, but bloom_may_contain() may run concurrently with one.
+*
+* */
+void bloom_add(bloom *, const char *, size_t);
+
+/**
+* @brief Method for checking if a string may have been added to the filter
+* @param bloom* Pointer to structure to work on
+* @param char* The string, it does not need to be zero terminated
+* @param size_t Length of the string
+* @return False, if the string was never added, true if it probably was
+*
+* */
+bool bloom_may_contain(bloom *, const char *, size_t);
+
+/**
+* @brief Method for getting the number of added strings
+* @param bloom* Pointer to structure to work on
+* @return Number of bloom_add() calls
+*
+* */
+size_t bloom_count(bloom *);
+
+/**
+* @brief Method for getting the number of strings the filter is sized for
+* @param bloom* Pointer to structure to work on
+* @return The capacity passed to bloom_init()
+*
+* */
+size_t bloom_capacity(bloom *);
+
+/**
+* @brief Method for getting the memory used by the filter
+* @param bloom* Pointer to structure to work on
+* @return Size of the structure and its bit array in bytes
+*
+* */
+size_t bloom_memory(bloom *);
+
+/**
+* @brief Destructor for bloom
+* @param bloom* Pointer to structure to be freed
+*
+* */
+void bloom_destroy(bloom *);
+
+#endif /* BLOOM_H */
@@ -0,0 +1,800 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file dietclient.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief File containing the dietclient structure and its member methods.
+*
+* Every pooled connection has its own I/O thread. Callers only queue encoded requests and wake the
+* thread up, the thread sends them, collects the tagged answers and completes the requests. Requests
+* which are not completed when a connection drops are sent again on the next connection. A FOOD
+* request is completed as soon as it is written completely, because the server does not answer it.
+*
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include "sock.h"
+#include "dietclient.h"
+
+#define DIETCLIENT_RECONNECT_MIN 100 /**< First delay in ms before reconnecting a failed connection */
+#define DIETCLIENT_RECONNECT_MAX 5000 /**< Maximum delay in ms before reconnecting a failed connection */
+#define DIETCLIENT_POLL_MS 1000 /**< Interval in which the I/O threads check for shutdown */
+
+/**
+* @brief Types of requests
+*
+*/
+enum dietclient_type {
+    DIETCLIENT_SEARCH, /**< Search request, answered with COUNT and FOOD messages */
+    DIETCLIENT_FOOD /**< Add request, not answered */
+};
+
+/**
+* @brief A request queued on or sent over a connection
+*
+*/
+struct dietclient_request {
+    unsigned long id; /**< Id the request is tagged with */
+    enum dietclient_type type; /**< Type of the request */
+    char *msg; /**< Untagged message, e.g. "SEARCH:Milk" */
+    dietclient_search_cb search_cb; /**< Callback of a search request */
+    dietclient_page_cb page_cb; /**< Callback of a paginated search request */
+    dietclient_done_cb done_cb; /**< Callback of an add request */
+    void *userdata; /**< User data passed to the callback */
+    bool queued; /**< True, if the request is encoded into the output buffer of the current connection */
+    size_t end; /**< Offset in the output buffer after which the request is written completely */
+    long expected; /**< Number of foods announced by COUNT, -1 until COUNT arrived */
+    food **foods; /**< Foods received so far */
+    size_t num_foods; /**< Number of foods received so far */
+    char *cursor; /**< Cursor of the next page announced by COUNT, NULL if there is none */
+    dietclient_status status; /**< Status the request is completed with */
+    struct dietclient_request *next; /**< Next request of the same connection */
+};
+
+/**
+* @brief One pooled connection
+*
+*/
+struct dietclient_conn {
+    dietclient *client; /**< Client owning this connection */
+    pthread_t thread; /**< I/O thread of the connection */
+    pthread_mutex_t mutex; /**< Mutex protecting the requests and the output buffer */
+    int sock; /**< Connected socket, -1 while disconnected */
+    int wake[2]; /**< Pipe for waking up the I/O thread */
+    struct dietclient_request *head; /**< First not completed request */
+    struct dietclient_request *tail; /**< Last not completed request */
+    size_t num_requests; /**< Number of not completed requests */
+    char *out; /**< Encoded frames waiting to be sent */
+    size_t out_len; /**< Number of bytes in out */
+    size_t out_cap; /**< Allocated bytes of out */
+    size_t out_pos; /**< Number of bytes of out already sent */
+    char *frame; /**< Buffer for received frames */
+};
+
+/**
+* @brief dietclient structure for representing a connection pool to one server
+*
+*/
+struct dietclient {
+    char *host; /**< IPv4 address of the server */
+    unsigned int port; /**< Port of the server */
+    struct dietclient_conn *conns; /**< Pooled connections */
+    size_t num_conns; /**< Number of pooled connections */
+    unsigned long next_id; /**< Last used request id */
+    volatile bool shutdown; /**< Set to stop the I/O threads */
+};
+
+/**
+* @brief dietclient_future structure for waiting for the result of a request
+*
+*/
+struct dietclient_future {
+    pthread_mutex_t mutex; /**< Mutex protecting the result */
+    pthread_cond_t cond; /**< Signalled when the result is available */
+    bool done; /**< True, if the result is available */
+    dietclient_status status; /**< Status of the request */
+    food **foods; /**< Found foods, until taken by the caller */
+    size_t num_foods; /**< Number of found foods */
+    char *cursor; /**< Cursor of the next page, NULL if there is none */
+};
+
+/**
+* @brief Helper function to wake up the I/O thread of a connection
+* @param struct dietclient_conn* The connection to wake up
+*
+* */
+static void dietclient_wake(struct dietclient_conn *conn) {
+    char c = 0;
+    /* the pipe is non-blocking, if it is full the thread is woken up anyway */
+    if (write(conn->wake[1], &c, 1) < 0) {
+        return;
+    }
+}
+
+/**
+* @brief Helper function to empty the wakeup pipe of a connection
+* @param struct dietclient_conn* The connection to work on
+*
+* */
+static void dietclient_drain(struct dietclient_conn *conn) {
+    char buf[64];
+    while (read(conn->wake[0], buf, sizeof(buf)) > 0) {
+    }
+}
+
+/**
+* @brief Helper function to sleep until a delay expired or the client is shut down
+* @param struct dietclient_conn* The connection whose thread is sleeping
+* @param unsigned int The delay in ms
+*
+* */
+static void dietclient_sleep(struct dietclient_conn *conn, unsigned int ms) {
+    struct timespec now, end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += ms / 1000;
+    end.tv_nsec += (ms % 1000) * 1000000L;
+    if (end.tv_nsec >= 1000000000L) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000L;
+    }
+    while (!conn->client->shutdown) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long left = (end.tv_sec - now.tv_sec) * 1000 + (end.tv_nsec - now.tv_nsec) / 1000000L;
+        if (left <= 0) {
+            return;
+        }
+        /* submitted requests wake us up as well, they have to wait for the connection */
+        struct pollfd pfd = {conn->wake[0], POLLIN, 0};
+        if (poll(&pfd, 1, (int) left) > 0) {
+            dietclient_drain(conn);
+        }
+    }
+}
+
+/**
+* @brief Helper function to connect to the server and switch the connection to pipelined mode
+* @param dietclient* The client to connect
+* @param unsigned int* Set to the retry time if the server is busy, 0 otherwise
+* @return The connected socket, or -1 on errors
+*
+* */
+static int dietclient_connect(dietclient *c, unsigned int *retry_ms) {
+    struct sockaddr_storage server;
+    socklen_t len;
+    /* a host containing a slash is the path of a Unix domain socket */
+    bool local = strchr(c->host, '/') != NULL;
+    *retry_ms = 0;
+    memset(&server, 0, sizeof(server));
+    if (local) {
+        struct sockaddr_un *un = (struct sockaddr_un *) &server;
+        if (strlen(c->host) >= sizeof(un->sun_path)) {
+            printf("Socket path %s is too long\n", c->host);
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, c->host);
+        len = sizeof(struct sockaddr_un);
+    } else {
+        struct sockaddr_in *in = (struct sockaddr_in *) &server;
+        in->sin_addr.s_addr = inet_addr(c->host);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(c->port);
+        len = sizeof(struct sockaddr_in);
+    }
+    int sock = socket(server.ss_family, SOCK_STREAM, 0);
+    if (sock == -1) {
+        printf("Could not create socket %d\n", errno);
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &server, len) < 0) {
+        printf("connect failed. Error %d\n", errno);
+        close(sock);
+        return -1;
+    }
+    /* offer compression as well, large answers are sent compressed then, a local socket does not gain from it */
+    sock_status st = sock_send_status(sock, "HELLO:", local ? SOCK_PIPELINE : SOCK_FEATURES, retry_ms);
+    if (st == SOCK_BUSY) {
+        printf("Server is busy, reconnecting in %u ms\n", *retry_ms);
+        close(sock);
+        return -1;
+    }
+    char buf[BUF_LEN] = {0};
+    if (st != SOCK_OK || !sock_read(sock, buf)) {
+        printf("Handshake failed, %d\n", errno);
+        close(sock);
+        return -1;
+    }
+    if (strncmp("HELLO:", buf, 6) || !sock_has_feature(buf + 6, SOCK_PIPELINE)) {
+        printf("Server does not support pipelined mode\n");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+* @brief Helper function to encode a request into the output buffer of its connection
+* @param struct dietclient_conn* The connection, its mutex must be held
+* @param struct dietclient_request* The request to encode
+*
+* */
+static void dietclient_queue(struct dietclient_conn *conn, struct dietclient_request *req) {
+    char tag[32];
+    int tag_len = snprintf(tag, sizeof(tag), "#%lu ", req->id);
+    size_t len = tag_len + strlen(req->msg) + 1;
+    if (conn->out_pos > 0 && conn->out_pos >= conn->out_len / 2) {
+        /* drop the already sent bytes before the buffer grows */
+        memmove(conn->out, conn->out + conn->out_pos, conn->out_len - conn->out_pos);
+        for (struct dietclient_request *r = conn->head; r; r = r->next) {
+            if (r->queued) {
+                r->end = r->end > conn->out_pos ? r->end - conn->out_pos : 0;
+            }
+        }
+        conn->out_len -= conn->out_pos;
+        conn->out_pos = 0;
+    }
+    while (conn->out_len + SOCK_FRAME_HEADER + len > conn->out_cap) {
+        conn->out_cap = conn->out_cap ? conn->out_cap * 2 : SOCK_FRAME_HEADER + SOCK_FRAME_MAX;
+        conn->out = realloc(conn->out, conn->out_cap);
+    }
+    char *p = conn->out + conn->out_len;
+    sock_frame_encode(p, len);
+    memcpy(p + SOCK_FRAME_HEADER, tag, tag_len);
+    memcpy(p + SOCK_FRAME_HEADER + tag_len, req->msg, len - tag_len - 1);
+    p[SOCK_FRAME_HEADER + len - 1] = '\n';
+    conn->out_len += SOCK_FRAME_HEADER + len;
+    req->end = conn->out_len;
+    req->queued = true;
+}
+
+/**
+* @brief Helper function to remove a request from the list of its connection
+* @param struct dietclient_conn* The connection, its mutex must be held
+* @param struct dietclient_request* The request to remove
+* @param struct dietclient_request** List the removed request is prepended to
+*
+* */
+static void dietclient_unlink(struct dietclient_conn *conn, struct dietclient_request *req,
+                              struct dietclient_request **done) {
+    struct dietclient_request **pp = &conn->head;
+    struct dietclient_request *prev = NULL;
+    while (*pp != req) {
+        prev = *pp;
+        pp = &(*pp)->next;
+    }
+    *pp = req->next;
+    if (conn->tail == req) {
+        conn->tail = prev;
+    }
+    conn->num_requests--;
+    req->next = *done;
+    *done = req;
+}
+
+/**
+* @brief Helper function to free the received foods of a request
+* @param struct dietclient_request* The request to work on
+*
+* */
+static void dietclient_free_foods(struct dietclient_request *req) {
+    for (size_t i = 0; i < req->num_foods; ++i) {
+        food_destroy(req->foods[i]);
+    }
+    free(req->foods);
+    req->foods = NULL;
+    req->num_foods = 0;
+    free(req->cursor);
+    req->cursor = NULL;
+}
+
+/**
+* @brief Helper function to call the callbacks of completed requests and free them
+* @param struct dietclient_request* List of completed requests, in reverse order of completion
+*
+* */
+static void dietclient_complete(struct dietclient_request *done) {
+    /* restore the order of completion */
+    struct dietclient_request *list = NULL;
+    while (done) {
+        struct dietclient_request *next = done->next;
+        done->next = list;
+        list = done;
+        done = next;
+    }
+    while (list) {
+        struct dietclient_request *req = list;
+        list = req->next;
+        if (req->type == DIETCLIENT_SEARCH) {
+            if (req->status != DIETCLIENT_OK) {
+                dietclient_free_foods(req);
+            }
+            if (req->page_cb) {
+                req->page_cb(req->userdata, req->status, req->foods, req->num_foods, req->cursor);
+            } else {
+                req->search_cb(req->userdata, req->status, req->foods, req->num_foods);
+            }
+            free(req->cursor);
+        } else if (req->done_cb) {
+            req->done_cb(req->userdata, req->status);
+        }
+        free(req->msg);
+        free(req);
+    }
+}
+
+/**
+* @brief Helper function to handle the answers of a received frame
+* @param struct dietclient_conn* The connection, its mutex must be held, the payload is in its frame buffer
+* @param struct dietclient_request** List completed requests are prepended to
+*
+* */
+static void dietclient_handle_payload(struct dietclient_conn *conn, struct dietclient_request **done) {
+    char *save = NULL;
+    for (char *msg = strtok_r(conn->frame, "\n", &save); msg; msg = strtok_r(NULL, "\n", &save)) {
+        unsigned long id = 0;
+        char *body = sock_parse_tag(msg, &id);
+        if (!body) {
+            printf("Error in protocol, expected tagged message\n");
+            continue;
+        }
+        struct dietclient_request *req = conn->head;
+        while (req && req->id != id) {
+            req = req->next;
+        }
+        if (!req || req->type != DIETCLIENT_SEARCH) {
+            printf("Error in protocol, answer to unknown request %lu\n", id);
+            continue;
+        }
+        if (req->expected < 0 && !strncmp("COUNT:", body, 6)) {
+            char *end = NULL;
+            req->expected = strtol(body + 6, &end, 10);
+            if (!strncmp(";next=", end, 6)) {
+                req->cursor = strdup(end + 6);
+            }
+            if (req->expected > 0) {
+                req->foods = calloc(req->expected, sizeof(food *));
+            }
+        } else if (req->expected >= 0 && !strncmp("FOOD:", body, 5)) {
+            req->foods[req->num_foods++] = food_deserialize(body + 5);
+        } else {
+            printf("Error in protocol, expected COUNT|FOOD\n");
+            req->status = DIETCLIENT_ERROR;
+            dietclient_unlink(conn, req, done);
+            continue;
+        }
+        if (req->expected >= 0 && req->num_foods == (size_t) req->expected) {
+            req->status = DIETCLIENT_OK;
+            dietclient_unlink(conn, req, done);
+        }
+    }
+}
+
+/**
+* @brief Helper function to send queued frames without blocking
+* @param struct dietclient_conn* The connection, its mutex must be held
+* @param struct dietclient_request** List completed requests are prepended to
+* @return False, if the connection failed, true otherwise
+*
+* */
+static bool dietclient_send(struct dietclient_conn *conn, struct dietclient_request **done) {
+    while (conn->out_pos < conn->out_len) {
+        ssize_t w = send(conn->sock, conn->out + conn->out_pos, conn->out_len - conn->out_pos,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (w <= 0) {
+            return false;
+        }
+        conn->out_pos += w;
+    }
+    struct dietclient_request *req = conn->head;
+    while (req) {
+        struct dietclient_request *next = req->next;
+        if (req->type == DIETCLIENT_FOOD && req->queued && req->end <= conn->out_pos) {
+            req->status = DIETCLIENT_OK;
+            dietclient_unlink(conn, req, done);
+        }
+        req = next;
+    }
+    if (conn->out_pos == conn->out_len) {
+        conn->out_pos = 0;
+        conn->out_len = 0;
+    }
+    return true;
+}
+
+/**
+* @brief Helper function to close a failed connection and prepare its requests for sending them again
+* @param struct dietclient_conn* The connection, its mutex must be held
+*
+* */
+static void dietclient_disconnect(struct dietclient_conn *conn) {
+    close(conn->sock);
+    conn->sock = -1;
+    conn->out_len = 0;
+    conn->out_pos = 0;
+    for (struct dietclient_request *req = conn->head; req; req = req->next) {
+        req->queued = false;
+        req->expected = -1;
+        dietclient_free_foods(req);
+    }
+}
+
+/**
+* @brief Main function of the I/O thread of a connection
+* @param void* The connection to serve
+* @return Always NULL
+*
+* */
+static void *dietclient_thread_func(void *arg) {
+    struct dietclient_conn *conn = arg;
+    dietclient *c = conn->client;
+    unsigned int backoff = DIETCLIENT_RECONNECT_MIN;
+    while (!c->shutdown) {
+        if (conn->sock < 0) {
+            unsigned int retry_ms = 0;
+            int sock = dietclient_connect(c, &retry_ms);
+            if (sock < 0) {
+                dietclient_sleep(conn, retry_ms ? retry_ms : backoff);
+                if (!retry_ms && backoff < DIETCLIENT_RECONNECT_MAX) {
+                    backoff = backoff * 2 < DIETCLIENT_RECONNECT_MAX ? backoff * 2 : DIETCLIENT_RECONNECT_MAX;
+                }
+                continue;
+            }
+            backoff = DIETCLIENT_RECONNECT_MIN;
+            pthread_mutex_lock(&conn->mutex);
+            conn->sock = sock;
+            for (struct dietclient_request *req = conn->head; req; req = req->next) {
+                dietclient_queue(conn, req);
+            }
+            pthread_mutex_unlock(&conn->mutex);
+        }
+
+        pthread_mutex_lock(&conn->mutex);
+        bool sending = conn->out_pos < conn->out_len;
+        pthread_mutex_unlock(&conn->mutex);
+        struct pollfd pfd[2] = {{conn->sock, POLLIN | (sending ? POLLOUT : 0), 0},
+                                {conn->wake[0], POLLIN, 0}};
+        if (poll(pfd, 2, DIETCLIENT_POLL_MS) < 0) {
+            continue;
+        }
+        if (pfd[1].revents) {
+            dietclient_drain(conn);
+        }
+
+        struct dietclient_request *done = NULL;
+        bool failed = false;
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            /* the server sends whole frames, reading the rest of a started one does not block for long */
+            ssize_t len = sock_read_frame(conn->sock, conn->frame);
+            pthread_mutex_lock(&conn->mutex);
+            if (len > 0) {
+                dietclient_handle_payload(conn, &done);
+            } else {
+                failed = true;
+            }
+            pthread_mutex_unlock(&conn->mutex);
+        }
+        pthread_mutex_lock(&conn->mutex);
+        if (!failed && conn->out_pos < conn->out_len) {
+            failed = !dietclient_send(conn, &done);
+        }
+        if (failed) {
+            printf("Connection to server lost, reconnecting\n");
+            dietclient_disconnect(conn);
+        }
+        pthread_mutex_unlock(&conn->mutex);
+        dietclient_complete(done);
+    }
+    return NULL;
+}
+
+/**
+* @brief Helper function to queue a request on the least loaded connection
+* @param dietclient* The client to work on
+* @param struct dietclient_request* The request to queue
+*
+* */
+static void dietclient_submit(dietclient *c, struct dietclient_request *req) {
+    req->id = __atomic_add_fetch(&c->next_id, 1, __ATOMIC_RELAXED);
+    req->queued = false;
+    req->end = 0;
+    req->expected = -1;
+    req->foods = NULL;
+    req->num_foods = 0;
+    req->cursor = NULL;
+    req->status = DIETCLIENT_OK;
+    req->next = NULL;
+
+    /* prefer connected connections, then the one with the fewest requests in flight */
+    struct dietclient_conn *best = NULL;
+    size_t best_load = 0;
+    for (size_t i = 0; i < c->num_conns; ++i) {
+        struct dietclient_conn *conn = &c->conns[i];
+        pthread_mutex_lock(&conn->mutex);
+        size_t load = conn->num_requests + (conn->sock < 0 ? c->num_conns * 1024 : 0);
+        pthread_mutex_unlock(&conn->mutex);
+        if (!best || load < best_load) {
+            best = conn;
+            best_load = load;
+        }
+    }
+
+    pthread_mutex_lock(&best->mutex);
+    if (best->tail) {
+        best->tail->next = req;
+    } else {
+        best->head = req;
+    }
+    best->tail = req;
+    best->num_requests++;
+    if (best->sock >= 0) {
+        dietclient_queue(best, req);
+    }
+    pthread_mutex_unlock(&best->mutex);
+    dietclient_wake(best);
+}
+
+dietclient *dietclient_init(const char *host, unsigned int port, size_t num_conns) {
+    dietclient *c = (dietclient *) malloc(sizeof(dietclient));
+    c->host = strdup(host);
+    c->port = port;
+    c->num_conns = num_conns > 0 ? num_conns : 1;
+    c->next_id = 0;
+    c->shutdown = false;
+    c->conns = calloc(c->num_conns, sizeof(struct dietclient_conn));
+    for (size_t i = 0; i < c->num_conns; ++i) {
+        struct dietclient_conn *conn = &c->conns[i];
+        conn->client = c;
+        pthread_mutex_init(&conn->mutex, NULL);
+        conn->sock = -1;
+        if (pipe(conn->wake) < 0) {
+            printf("Could not create pipe %d\n", errno);
+        }
+        fcntl(conn->wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(conn->wake[1], F_SETFL, O_NONBLOCK);
+        conn->frame = malloc(SOCK_FRAME_MAX + 1);
+        pthread_create(&conn->thread, NULL, dietclient_thread_func, conn);
+    }
+    return c;
+}
+
+void dietclient_search(dietclient *c, const char *term, dietclient_search_cb cb, void *userdata) {
+    struct dietclient_request *req = malloc(sizeof(struct dietclient_request));
+    req->type = DIETCLIENT_SEARCH;
+    req->msg = malloc(BUF_LEN);
+    snprintf(req->msg, BUF_LEN, "SEARCH:%s", term);
+    /* newlines separate messages in pipelined frames */
+    req->msg[strcspn(req->msg, "\r\n")] = 0;
+    req->search_cb = cb;
+    req->page_cb = NULL;
+    req->done_cb = NULL;
+    req->userdata = userdata;
+    dietclient_submit(c, req);
+}
+
+void dietclient_search_page(dietclient *c, const char *term, size_t limit, const char *cursor,
+                            dietclient_page_cb cb, void *userdata) {
+    struct dietclient_request *req = malloc(sizeof(struct dietclient_request));
+    req->type = DIETCLIENT_SEARCH;
+    req->msg = malloc(BUF_LEN);
+    if (cursor) {
+        snprintf(req->msg, BUF_LEN, "SEARCH?limit=%zu&cursor=%s:%s", limit, cursor, term);
+    } else {
+        snprintf(req->msg, BUF_LEN, "SEARCH?limit=%zu:%s", limit, term);
+    }
+    req->msg[strcspn(req->msg, "\r\n")] = 0;
+    req->search_cb = NULL;
+    req->page_cb = cb;
+    req->done_cb = NULL;
+    req->userdata = userdata;
+    dietclient_submit(c, req);
+}
+
+void dietclient_subscribe(dietclient *c, const char *cursor, dietclient_page_cb cb, void *userdata) {
+    struct dietclient_request *req = malloc(sizeof(struct dietclient_request));
+    req->type = DIETCLIENT_SEARCH;
+    req->msg = malloc(BUF_LEN);
+    snprintf(req->msg, BUF_LEN, "SUBSCRIBE:%s", cursor ? cursor : "");
+    req->msg[strcspn(req->msg, "\r\n")] = 0;
+    req->search_cb = NULL;
+    req->page_cb = cb;
+    req->done_cb = NULL;
+    req->userdata = userdata;
+    dietclient_submit(c, req);
+}
+
+void dietclient_add(dietclient *c, food *f, dietclient_done_cb cb, void *userdata) {
+    struct dietclient_request *req = malloc(sizeof(struct dietclient_request));
+    char *sf = food_serialize(f);
+    req->type = DIETCLIENT_FOOD;
+    req->msg = malloc(BUF_LEN);
+    snprintf(req->msg, BUF_LEN, "FOOD:%s", sf);
+    req->msg[strcspn(req->msg, "\r\n")] = 0;
+    free(sf);
+    req->search_cb = NULL;
+    req->page_cb = NULL;
+    req->done_cb = cb;
+    req->userdata = userdata;
+    dietclient_submit(c, req);
+}
+
+/**
+* @brief Helper function to create a future
+* @return The created future
+*
+* */
+static dietclient_future *dietclient_future_init() {
+    dietclient_future *fu = (dietclient_future *) malloc(sizeof(dietclient_future));
+    pthread_mutex_init(&fu->mutex, NULL);
+    pthread_cond_init(&fu->cond, NULL);
+    fu->done = false;
+    fu->status = DIETCLIENT_OK;
+    fu->foods = NULL;
+    fu->num_foods = 0;
+    fu->cursor = NULL;
+    return fu;
+}
+
+/**
+* @brief Callback completing a future with a search result
+* @param void* The future
+* @param dietclient_status Status of the request
+* @param food** Found foods
+* @param size_t Number of found foods
+*
+* */
+static void dietclient_future_search_cb(void *arg, dietclient_status status, food **foods, size_t num_foods) {
+    dietclient_future *fu = arg;
+    pthread_mutex_lock(&fu->mutex);
+    fu->status = status;
+    fu->foods = foods;
+    fu->num_foods = num_foods;
+    fu->done = true;
+    pthread_cond_broadcast(&fu->cond);
+    pthread_mutex_unlock(&fu->mutex);
+}
+
+/**
+* @brief Callback completing a future with a page of search results
+* @param void* The future
+* @param dietclient_status Status of the request
+* @param food** Found foods
+* @param size_t Number of found foods
+* @param char* Cursor of the next page, or NULL
+*
+* */
+static void dietclient_future_page_cb(void *arg, dietclient_status status, food **foods, size_t num_foods,
+                                      const char *cursor) {
+    dietclient_future *fu = arg;
+    pthread_mutex_lock(&fu->mutex);
+    fu->cursor = cursor ? strdup(cursor) : NULL;
+    pthread_mutex_unlock(&fu->mutex);
+    dietclient_future_search_cb(arg, status, foods, num_foods);
+}
+
+/**
+* @brief Callback completing a future of a request without result
+* @param void* The future
+* @param dietclient_status Status of the request
+*
+* */
+static void dietclient_future_done_cb(void *arg, dietclient_status status) {
+    dietclient_future_search_cb(arg, status, NULL, 0);
+}
+
+dietclient_future *dietclient_search_async(dietclient *c, const char *term) {
+    dietclient_future *fu = dietclient_future_init();
+    dietclient_search(c, term, dietclient_future_search_cb, fu);
+    return fu;
+}
+
+dietclient_future *dietclient_search_page_async(dietclient *c, const char *term, size_t limit, const char *cursor) {
+    dietclient_future *fu = dietclient_future_init();
+    dietclient_search_page(c, term, limit, cursor, dietclient_future_page_cb, fu);
+    return fu;
+}
+
+dietclient_future *dietclient_subscribe_async(dietclient *c, const char *cursor) {
+    dietclient_future *fu = dietclient_future_init();
+    dietclient_subscribe(c, cursor, dietclient_future_page_cb, fu);
+    return fu;
+}
+
+dietclient_future *dietclient_add_async(dietclient *c, food *f) {
+    dietclient_future *fu = dietclient_future_init();
+    dietclient_add(c, f, dietclient_future_done_cb, fu);
+    return fu;
+}
+
+bool dietclient_future_ready(dietclient_future *fu) {
+    pthread_mutex_lock(&fu->mutex);
+    bool done = fu->done;
+    pthread_mutex_unlock(&fu->mutex);
+    return done;
+}
+
+dietclient_status dietclient_future_wait(dietclient_future *fu, food ***foods, size_t *num_foods) {
+    pthread_mutex_lock(&fu->mutex);
+    while (!fu->done) {
+        pthread_cond_wait(&fu->cond, &fu->mutex);
+    }
+    if (foods) {
+        *foods = fu->foods;
+        fu->foods = NULL;
+    }
+    if (num_foods) {
+        *num_foods = fu->num_foods;
+    }
+    dietclient_status status = fu->status;
+    pthread_mutex_unlock(&fu->mutex);
+    return status;
+}
+
+const char *dietclient_future_cursor(dietclient_future *fu) {
+    dietclient_future_wait(fu, NULL, NULL);
+    return fu->cursor;
+}
+
+void dietclient_future_destroy(dietclient_future *fu) {
+    dietclient_future_wait(fu, NULL, NULL);
+    if (fu->foods) {
+        for (size_t i = 0; i < fu->num_foods; ++i) {
+            food_destroy(fu->foods[i]);
+        }
+        free(fu->foods);
+    }
+    free(fu->cursor);
+    pthread_cond_destroy(&fu->cond);
+    pthread_mutex_destroy(&fu->mutex);
+    free(fu);
+}
+
+void dietclient_destroy(dietclient *c) {
+    c->shutdown = true;
+    for (size_t i = 0; i < c->num_conns; ++i) {
+        dietclient_wake(&c->conns[i]);
+    }
+    for (size_t i = 0; i < c->num_conns; ++i) {
+        struct dietclient_conn *conn = &c->conns[i];
+        pthread_join(conn->thread, NULL);
+        struct dietclient_request *done = NULL;
+        while (conn->head) {
+            conn->head->status = DIETCLIENT_CLOSED;
+            dietclient_unlink(conn, conn->head, &done);
+        }
+        dietclient_complete(done);
+        if (conn->sock >= 0) {
+            close(conn->sock);
+        }
+        close(conn->wake[0]);
+        close(conn->wake[1]);
+        pthread_mutex_destroy(&conn->mutex);
+        free(conn->out);
+        free(conn->frame);
+    }
+    free(c->conns);
+    free(c->host);
+    free(c);
+}
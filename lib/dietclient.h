@@ -0,0 +1,228 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file dietclient.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible dietclient methods.
+ *
+ * The dietclient is a reusable client for the calory socket protocol. It keeps a pool of pipelined
+ * connections to one server, reconnects them automatically and never blocks the caller while a request
+ * is in flight. Results are delivered either to a callback, which runs on the I/O thread of the
+ * connection, or through a future the caller can wait for.
+ *
+ */
+
+#ifndef DIETCLIENT_H
+#define DIETCLIENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "food.h"
+
+/**
+ *
+ * @brief Forward declaration for dietclient
+ *
+ * */
+typedef struct dietclient dietclient;
+
+/**
+ *
+ * @brief Forward declaration for dietclient_future
+ *
+ * */
+typedef struct dietclient_future dietclient_future;
+
+/**
+ *
+ * @brief Result status of a request
+ *
+ * */
+typedef enum dietclient_status {
+    DIETCLIENT_OK, /**< The request was answered */
+    DIETCLIENT_ERROR, /**< The answer of the server could not be understood */
+    DIETCLIENT_CLOSED /**< The client was destroyed before the request was answered */
+} dietclient_status;
+
+/**
+ * @brief Callback for search results
+ * @param void* The user data passed with the request
+ * @param dietclient_status Status of the request
+ * @param food** Array of found foods, owned by the callback. Free every food with food_destroy() and the array with free().
+ * @param size_t Number of found foods
+ *
+ * */
+typedef void (*dietclient_search_cb)(void *, dietclient_status, food **, size_t);
+
+/**
+ * @brief Callback for one page of search results
+ * @param void* The user data passed with the request
+ * @param dietclient_status Status of the request
+ * @param food** Array of found foods, owned by the callback. Free every food with food_destroy() and the array with free().
+ * @param size_t Number of found foods
+ * @param char* Cursor of the next page, or NULL if this is the last page. Only valid during the callback.
+ *
+ * */
+typedef void (*dietclient_page_cb)(void *, dietclient_status, food **, size_t, const char *);
+
+/**
+ * @brief Callback for requests without result, called when the request was handed to the server
+ * @param void* The user data passed with the request
+ * @param dietclient_status Status of the request
+ *
+ * */
+typedef void (*dietclient_done_cb)(void *, dietclient_status);
+
+/**
+ * @brief Constructor for dietclient
+ * @param char* IPv4 address of the server, or path of its Unix domain socket if it contains a slash
+ * @param unsigned int Port of the server, ignored for Unix domain sockets
+ * @param size_t Number of pooled connections, at least one
+ * @return A pointer to the dietclient structure, representing the created object
+ *
+ * The connections are established in the background. Requests submitted before a connection is up are
+ * queued and sent as soon as it is. After using this structure, it must be freed with
+ * dietclient_destroy(dietclient *)
+ *
+ * */
+dietclient *dietclient_init(const char *, unsigned int, size_t);
+
+/**
+* @brief Method for searching foods without blocking
+* @param dietclient* Pointer to structure to work on
+* @param char* The search term
+* @param dietclient_search_cb Callback receiving the result
+* @param void* User data passed to the callback
+*
+* Searches are repeated transparently if their connection drops before the answer arrived.
+*
+* */
+void dietclient_search(dietclient *, const char *, dietclient_search_cb, void *);
+
+/**
+* @brief Method for searching one page of foods without blocking
+* @param dietclient* Pointer to structure to work on
+* @param char* The search term
+* @param size_t Maximum number of foods of the page, the server may return less
+* @param char* Cursor returned with the previous page, or NULL for the first page
+* @param dietclient_page_cb Callback receiving the page
+* @param void* User data passed to the callback
+*
+* If the server replaced its food list since the cursor was returned, the page is the first one again.
+*
+* */
+void dietclient_search_page(dietclient *, const char *, size_t, const char *, dietclient_page_cb, void *);
+
+/**
+* @brief Method for adding a food without blocking
+* @param dietclient* Pointer to structure to work on
+* @param food* The food to add, it is serialized immediately and not referenced afterwards
+* @param dietclient_done_cb Callback called when the food was sent, may be NULL
+* @param void* User data passed to the callback
+*
+* */
+void dietclient_add(dietclient *, food *, dietclient_done_cb, void *);
+
+/**
+* @brief Method for fetching the foods the server added since a position of its replication log
+* @param dietclient* Pointer to structure to work on
+* @param char* Cursor returned with the previous batch, or NULL to start with all foods of the server
+* @param dietclient_page_cb Callback receiving the batch and the cursor of the next one
+* @param void* User data passed to the callback
+*
+* If the server replaced its food list since the cursor was returned, the batch starts with its first food
+* again, i.e. the cursor of the batch belongs to another generation. A batch without foods means the
+* caller is up to date.
+*
+* */
+void dietclient_subscribe(dietclient *, const char *, dietclient_page_cb, void *);
+
+/**
+* @brief Method for searching foods, returning a future for the result
+* @param dietclient* Pointer to structure to work on
+* @param char* The search term
+* @return A future, must be freed with dietclient_future_destroy(dietclient_future *)
+*
+* */
+dietclient_future *dietclient_search_async(dietclient *, const char *);
+
+/**
+* @brief Method for searching one page of foods, returning a future for the result
+* @param dietclient* Pointer to structure to work on
+* @param char* The search term
+* @param size_t Maximum number of foods of the page, the server may return less
+* @param char* Cursor returned with the previous page, or NULL for the first page
+* @return A future, must be freed with dietclient_future_destroy(dietclient_future *)
+*
+* */
+dietclient_future *dietclient_search_page_async(dietclient *, const char *, size_t, const char *);
+
+/**
+* @brief Method for fetching a batch of the replication log, returning a future for the result
+* @param dietclient* Pointer to structure to work on
+* @param char* Cursor returned with the previous batch, or NULL to start with all foods of the server
+* @return A future, must be freed with dietclient_future_destroy(dietclient_future *)
+*
+* */
+dietclient_future *dietclient_subscribe_async(dietclient *, const char *);
+
+/**
+* @brief Method for adding a food, returning a future for the completion
+* @param dietclient* Pointer to structure to work on
+* @param food* The food to add, it is serialized immediately and not referenced afterwards
+* @return A future, must be freed with dietclient_future_destroy(dietclient_future *)
+*
+* */
+dietclient_future *dietclient_add_async(dietclient *, food *);
+
+/**
+* @brief Method for checking if a future is completed
+* @param dietclient_future* Pointer to structure to work on
+* @return True, if the result is available, false otherwise
+*
+* */
+bool dietclient_future_ready(dietclient_future *);
+
+/**
+* @brief Method for waiting for the result of a future
+* @param dietclient_future* Pointer to structure to work on
+* @param food*** If not NULL, set to the array of found foods. The caller takes ownership.
+* @param size_t* If not NULL, set to the number of found foods
+* @return Status of the request
+*
+* */
+dietclient_status dietclient_future_wait(dietclient_future *, food ***, size_t *);
+
+/**
+* @brief Method for getting the cursor of the next page after waiting for a page
+* @param dietclient_future* Pointer to structure to work on
+* @return The cursor, valid until the future is destroyed, or NULL if there are no more pages
+*
+* */
+const char *dietclient_future_cursor(dietclient_future *);
+
+/**
+ * @brief Destructor for dietclient_future
+ * @param dietclient_future* Pointer to structure to be freed
+ *
+ * Waits for the request to complete. Foods not taken with dietclient_future_wait() are freed.
+ *
+ * */
+void dietclient_future_destroy(dietclient_future *);
+
+/**
+ * @brief Destructor for dietclient
+ * @param dietclient* Pointer to structure to be freed
+ *
+ * Closes all connections, requests still in flight complete with DIETCLIENT_CLOSED.
+ *
+ * */
+void dietclient_destroy(dietclient *);
+
+#endif /* DIETCLIENT_H */
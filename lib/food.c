@@ -146,13 +146,14 @@ food *food_deserialize(char *c)
     if(*p == ',') count++;
   char **res = calloc(count, sizeof(char *));
 
-  /* tokenize string */
+  /* tokenize string, reentrant because foods are deserialized on several threads */
   int i = 0;
-  p = strtok (c, ",");
+  char *save = NULL;
+  p = strtok_r (c, ",", &save);
   while (p != NULL) {
     *(res + i) = p;
     ++i;
-    p = strtok (NULL, ",");
+    p = strtok_r (NULL, ",", &save);
   }
 
   food *f = food_init();
@@ -11,6 +11,11 @@
 * @date 25-09-2014
 * @brief File containing the foodlist structure and its member methods.
 *
+* Besides the readers taking the lock, searches may scan the list without any lock. The writer fills
+* a new entry of the index and the bloom filter before it publishes the new length, and a grown index
+* or a rebuilt filter is published as a whole. The replaced ones are kept until the list is destroyed,
+* since a lock-free reader may still scan them.
+*
 */
 
 #include <stdlib.h>
@@ -19,10 +24,15 @@
 #include <string.h>
 #include <strings.h>
 #include <pthread.h>
+#include <time.h>
+#include <math.h>
 #include "food.h"
 #include "foodlistnode.h"
+#include "bloom.h"
 #include "foodlist.h"
 
+#define FOODLIST_FILTER_MIN 4096 /**< Minimum number of name prefixes the bloom filter is sized for */
+
 /**
 * @brief foodlist structure for representing a food item
 *
@@ -35,27 +45,158 @@ struct foodlist {
     /**< Integer for thread safe read access */
     foodlistnode *data;
     /**< First node of this list */
+    foodlistnode *tail;
+    /**< Last node of this list */
+    food **index;
+    /**< Array of all foods in list order, for random access to index ranges */
+    size_t index_len;
+    /**< Number of foods in index */
+    size_t index_cap;
+    /**< Allocated entries of index */
+    bloom *filter;
+    /**< All search terms which match at least one food, for answering misses without scanning */
     char *file;/**< Filename for loading/saving data from/to file */
+    foodlist_lockprofile profile;
+    /**< Waits for and holds of the lock, updated atomically */
+    int writers_waiting;
+    /**< Number of writers waiting for the lock, updated atomically */
+    float *columns[FOODLIST_NUTRIENTS];
+    /**< Nutrients per 100 g of the foods in index, one column per nutrient, NAN for foods without weight */
+    double column_sum[FOODLIST_NUTRIENTS];
+    /**< Sum of every column over the foods with weight */
+    double column_sq[FOODLIST_NUTRIENTS];
+    /**< Sum of the squares of every column over the foods with weight */
+    size_t column_len;
+    /**< Number of foods with weight */
+    struct foodlist_retired *retired;
+    /**< Index arrays and filters replaced while lock-free readers may have used them */
+};
+
+/**
+* @brief An index array or a bloom filter which was replaced, freed when the list is destroyed
+*
+*/
+struct foodlist_retired {
+    food **index;
+    /**< Replaced index, or NULL */
+    bloom *filter;
+    /**< Replaced filter, or NULL */
+    size_t size;
+    /**< Memory of the replaced index or filter in bytes */
+    struct foodlist_retired *next;
+    /**< Next retired entry */
+};
+
+/**
+* @brief Names of the call sites, in the order of foodlist_site
+*
+*/
+static const char *foodlist_site_names[] = {
+    "foodlist_append", "foodlist_init_csv", "foodlist_count", "foodlist_memory", "foodlist_is_empty",
+    "foodlist_get_data", "foodlist_may_match", "foodlist_find_range", "foodlist_get_range", "foodlist_find_page",
+    "foodlist_similar"
 };
 
+/**
+* @brief Function called after a lock was taken, NULL if there is none
+*
+*/
+static foodlist_lock_hook foodlist_hook = NULL;
+
+/**
+* @brief Helper function to get the monotonic time in nanoseconds
+* @return Nanoseconds since an arbitrary point in time
+*
+* */
+static uint64_t foodlist_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+* @brief Helper function to count a duration in a log2 histogram, its sum and its maximum
+* @param uint64_t* Buckets of the histogram
+* @param uint64_t* Sum of the durations
+* @param uint64_t* Longest duration
+* @param uint64_t The duration in nanoseconds
+*
+* */
+static void foodlist_profile_add(uint64_t *buckets, uint64_t *sum, uint64_t *max, uint64_t ns) {
+    int i = ns ? 64 - __builtin_clzll(ns) : 0;
+    if (i >= FOODLIST_PROFILE_BUCKETS) {
+        i = FOODLIST_PROFILE_BUCKETS - 1;
+    }
+    __atomic_add_fetch(&buckets[i], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(sum, ns, __ATOMIC_RELAXED);
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (ns > old && !__atomic_compare_exchange_n(max, &old, ns, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+* @brief Helper function to count a lock acquisition and the time spent waiting for it
+* @param foodlist* The foodlist structure
+* @param foodlist_site Call site taking the lock
+* @param bool True for the write lock
+* @param uint64_t Time the wait started, from foodlist_now()
+* @return Time the lock was taken
+*
+* */
+static uint64_t foodlist_lock_waited(foodlist *fl, foodlist_site site, bool write, uint64_t start) {
+    uint64_t now = foodlist_now();
+    foodlist_lock_hook hook = foodlist_hook;
+    if (hook) {
+        hook(write, start, now);
+    }
+    foodlist_siteprofile *sp = &fl->profile.sites[site];
+    __atomic_add_fetch(&sp->locks, 1, __ATOMIC_RELAXED);
+    foodlist_profile_add(sp->wait, &sp->wait_ns, &sp->wait_max_ns, now - start);
+    return now;
+}
+
+/**
+* @brief Helper function to count the time a lock was held, when it is released
+* @param foodlist* The foodlist structure
+* @param foodlist_site Call site which took the lock
+* @param uint64_t Time the lock was taken
+*
+* */
+static void foodlist_lock_held(foodlist *fl, foodlist_site site, uint64_t taken) {
+    foodlist_siteprofile *sp = &fl->profile.sites[site];
+    foodlist_profile_add(sp->hold, &sp->hold_ns, &sp->hold_max_ns, foodlist_now() - taken);
+}
+
 /**
 * @brief Helper function to enter a critical section for reading
 * @param foodlist* The foodlist structure to lock
+* @param foodlist_site Call site taking the lock
+* @return Time the lock was taken, to be passed to end_read()
 *
 * */
-void start_read(foodlist *fl) {
+uint64_t start_read(foodlist *fl, foodlist_site site) {
+    uint64_t start = foodlist_now();
     pthread_mutex_lock(&(fl->r_mutex));
     if (++fl->read_count == 1)
         pthread_mutex_lock(&(fl->rw_mutex));
+    if (fl->read_count > fl->profile.readers_high_water)
+        __atomic_store_n(&fl->profile.readers_high_water, fl->read_count, __ATOMIC_RELAXED);
     pthread_mutex_unlock(&(fl->r_mutex));
+    if (__atomic_load_n(&fl->writers_waiting, __ATOMIC_RELAXED) > 0) {
+        /* a writer waits and this reader went first */
+        __atomic_add_fetch(&fl->profile.overtaking_reads, 1, __ATOMIC_RELAXED);
+    }
+    return foodlist_lock_waited(fl, site, false, start);
 }
 
 /**
 * @brief Helper function to exit a critical section for reading
 * @param foodlist* The foodlist structure to unlock
+* @param foodlist_site Call site which took the lock
+* @param uint64_t Time the lock was taken, from start_read()
 *
 * */
-void end_read(foodlist *fl) {
+void end_read(foodlist *fl, foodlist_site site, uint64_t taken) {
+    foodlist_lock_held(fl, site, taken);
     pthread_mutex_lock(&(fl->r_mutex));
     if (--fl->read_count == 0)
         pthread_mutex_unlock(&(fl->rw_mutex));
@@ -65,18 +206,34 @@ void end_read(foodlist *fl) {
 /**
 * @brief Helper function to enter a critical section for writing
 * @param foodlist* The foodlist structure to lock
+* @param foodlist_site Call site taking the lock
+* @return Time the lock was taken, to be passed to end_write()
 *
 * */
-void start_write(foodlist *fl) {
+uint64_t start_write(foodlist *fl, foodlist_site site) {
+    uint64_t start = foodlist_now();
+    __atomic_add_fetch(&fl->writers_waiting, 1, __ATOMIC_RELAXED);
+    uint64_t overtaken = __atomic_load_n(&fl->profile.overtaking_reads, __ATOMIC_RELAXED);
     pthread_mutex_lock(&(fl->rw_mutex));
+    __atomic_sub_fetch(&fl->writers_waiting, 1, __ATOMIC_RELAXED);
+    uint64_t taken = foodlist_lock_waited(fl, site, true, start);
+    if (__atomic_load_n(&fl->profile.overtaking_reads, __ATOMIC_RELAXED) != overtaken) {
+        __atomic_add_fetch(&fl->profile.starved_writes, 1, __ATOMIC_RELAXED);
+        foodlist_profile_add(fl->profile.starved, &fl->profile.starved_ns, &fl->profile.starved_max_ns,
+                             taken - start);
+    }
+    return taken;
 }
 
 /**
 * @brief Helper function to exit a critical section for writing
 * @param foodlist* The foodlist structure to unlock
+* @param foodlist_site Call site which took the lock
+* @param uint64_t Time the lock was taken, from start_write()
 *
 * */
-void end_write(foodlist *fl) {
+void end_write(foodlist *fl, foodlist_site site, uint64_t taken) {
+    foodlist_lock_held(fl, site, taken);
     pthread_mutex_unlock(&(fl->rw_mutex));
 }
 
@@ -97,12 +254,199 @@ int cmpfunc(const void *a, const void *b) {
     return strcasecmp(c1, c2);
 }
 
+/**
+* @brief Helper function to add all search terms matching a food name to the bloom filter
+* @param bloom* The filter
+* @param char* Name of the food
+*
+* These are the prefixes ending right before or at a comma, and the complete name. See foodlist_matches().
+*
+* */
+static void foodlist_filter_add(bloom *filter, const char *name) {
+    size_t len = strlen(name);
+    for (size_t i = 0; i < len; ++i) {
+        if (name[i] == ',') {
+            bloom_add(filter, name, i);
+            bloom_add(filter, name, i + 1);
+        }
+    }
+    bloom_add(filter, name, len);
+}
+
+/**
+* @brief Helper function to keep a replaced index or filter until the list is destroyed
+* @param foodlist* The foodlist structure, must be locked for writing
+* @param food** The replaced index, or NULL
+* @param bloom* The replaced filter, or NULL
+* @param size_t Memory of the replaced index or filter in bytes
+*
+* */
+static void foodlist_retire(foodlist *fl, food **index, bloom *filter, size_t size) {
+    struct foodlist_retired *r = (struct foodlist_retired *) malloc(sizeof(struct foodlist_retired));
+    r->index = index;
+    r->filter = filter;
+    r->size = size;
+    r->next = fl->retired;
+    fl->retired = r;
+}
+
+/**
+* @brief Helper function to add the nutrients per 100 g of a food to the columns
+* @param foodlist* The foodlist structure, must be locked for writing
+* @param size_t Position of the food in index, the columns have room for it
+*
+* */
+static void foodlist_columns_add(foodlist *fl, size_t pos) {
+    food *f = fl->index[pos];
+    int weight = food_get_weight(f);
+    int values[FOODLIST_NUTRIENTS] = {
+        food_get_kcal(f), food_get_fat(f), food_get_carbo(f), food_get_protein(f)
+    };
+    bool known = weight > 0;
+    for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+        known &= values[d] >= 0;
+    }
+    for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+        float v = known ? values[d] * 100.0f / weight : NAN;
+        fl->columns[d][pos] = v;
+        if (known) {
+            fl->column_sum[d] += v;
+            fl->column_sq[d] += (double) v * v;
+        }
+    }
+    if (known) {
+        fl->column_len++;
+    }
+}
+
+/**
+* @brief Helper function to rebuild the bloom filter from all foods, sized for twice the current prefixes
+* @param foodlist* The foodlist structure, must be locked for writing
+*
+* */
+static void foodlist_filter_rebuild(foodlist *fl) {
+    size_t prefixes = 0;
+    for (size_t i = 0; i < fl->index_len; ++i) {
+        const char *name = food_get_name(fl->index[i]);
+        prefixes++;
+        for (const char *p = name; *p; ++p) {
+            if (*p == ',') {
+                prefixes += 2;
+            }
+        }
+    }
+    bloom *filter = bloom_init(prefixes * 2 > FOODLIST_FILTER_MIN ? prefixes * 2 : FOODLIST_FILTER_MIN);
+    for (size_t i = 0; i < fl->index_len; ++i) {
+        foodlist_filter_add(filter, food_get_name(fl->index[i]));
+    }
+    foodlist_retire(fl, NULL, fl->filter, bloom_memory(fl->filter));
+    __atomic_store_n(&fl->filter, filter, __ATOMIC_RELEASE);
+}
+
+/**
+* @brief Helper function to search a range of the list, reading only what the writer has published
+* @param foodlist* The foodlist structure, locked for reading or not locked at all
+* @param char* A pointer to the string which should be found
+* @param size_t Position of the first food to check
+* @param size_t Position after the last food to check, clamped to the length of the list
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order. Must be freed by caller.
+*
+* */
+static food **foodlist_scan_range(foodlist *fl, char *str, size_t from, size_t to, size_t *num) {
+    size_t max_items = 25;
+    food **ret = calloc(max_items, sizeof(food *));
+    *num = 0;
+    /* the length is read first, the index and the filter are at least as new as it */
+    size_t len = __atomic_load_n(&fl->index_len, __ATOMIC_ACQUIRE);
+    food **index = __atomic_load_n(&fl->index, __ATOMIC_ACQUIRE);
+    if (!bloom_may_contain(__atomic_load_n(&fl->filter, __ATOMIC_ACQUIRE), str, strlen(str))) {
+        /* no food matches, skip the scan */
+        return ret;
+    }
+    if (to > len) {
+        to = len;
+    }
+    for (size_t i = from; i < to; ++i) {
+        food *f = index[i];
+        if (foodlist_matches(food_get_name(f), str)) {
+            if (*num == max_items) {
+                max_items *= 2;
+                ret = realloc(ret, max_items * sizeof(food *));
+            }
+            ret[*num] = f;
+            *num += 1;
+        }
+    }
+    return ret;
+}
+
+/**
+* @brief Helper function to find one page of food, reading only what the writer has published
+* @param foodlist* The foodlist structure, locked for reading or not locked at all
+* @param char* A pointer to the string which should be found
+* @param size_t* Position of the first food to check, updated like by foodlist_find_page()
+* @param size_t Number of matches to skip before the page starts
+* @param size_t Maximum number of foods to return
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order. Must be freed by caller.
+*
+* */
+static food **foodlist_scan_page(foodlist *fl, char *str, size_t *pos, size_t skip, size_t limit, size_t *num) {
+    size_t max_items = limit > 0 && limit < 25 ? limit : 25;
+    food **ret = calloc(max_items, sizeof(food *));
+    size_t i = *pos;
+    *num = 0;
+    *pos = (size_t) -1;
+    size_t len = __atomic_load_n(&fl->index_len, __ATOMIC_ACQUIRE);
+    food **index = __atomic_load_n(&fl->index, __ATOMIC_ACQUIRE);
+    if (!bloom_may_contain(__atomic_load_n(&fl->filter, __ATOMIC_ACQUIRE), str, strlen(str))) {
+        return ret;
+    }
+    for (; i < len; ++i) {
+        food *f = index[i];
+        if (!foodlist_matches(food_get_name(f), str)) {
+            continue;
+        }
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+        if (*num == limit) {
+            /* the page is full, remember where the next one starts */
+            *pos = i;
+            break;
+        }
+        if (*num == max_items) {
+            max_items *= 2;
+            ret = realloc(ret, max_items * sizeof(food *));
+        }
+        ret[*num] = f;
+        *num += 1;
+    }
+    return ret;
+}
+
 foodlist *foodlist_init() {
     foodlist *f = (foodlist *) malloc(sizeof(foodlist));
     pthread_mutex_init(&(f->rw_mutex), NULL);
     pthread_mutex_init(&(f->r_mutex), NULL);
     f->read_count = 0;
     f->data = NULL;
+    f->tail = NULL;
+    f->index_cap = 64;
+    f->index = calloc(f->index_cap, sizeof(food *));
+    f->index_len = 0;
+    f->filter = bloom_init(FOODLIST_FILTER_MIN);
+    memset(&f->profile, 0, sizeof(foodlist_lockprofile));
+    f->writers_waiting = 0;
+    for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+        f->columns[d] = calloc(f->index_cap, sizeof(float));
+        f->column_sum[d] = 0;
+        f->column_sq[d] = 0;
+    }
+    f->column_len = 0;
+    f->retired = NULL;
     char *fname = "calories.csv";
     f->file = malloc(strlen(fname) + 1);
     sprintf(f->file, "%s", fname);
@@ -127,85 +471,343 @@ foodlist *foodlist_init_csv(char *file) {
             foodlist_append(fl, &f);
         }
         fclose(fptr);
+        /* size the filter for the loaded list */
+        uint64_t taken = start_write(fl, FOODLIST_SITE_REBUILD);
+        foodlist_filter_rebuild(fl);
+        end_write(fl, FOODLIST_SITE_REBUILD, taken);
     }
     return fl;
 }
 
 int foodlist_count(foodlist *fl) {
     int count = 0;
-    start_read(fl);
-    if (!foodlist_is_empty(fl)) {
-        count = foodlistnode_count(fl->data);
-    }
-    end_read(fl);
+    uint64_t taken = start_read(fl, FOODLIST_SITE_COUNT);
+    count = fl->index_len;
+    end_read(fl, FOODLIST_SITE_COUNT, taken);
     return count;
 }
 
+size_t foodlist_count_lockfree(foodlist *fl) {
+    return __atomic_load_n(&fl->index_len, __ATOMIC_ACQUIRE);
+}
+
+size_t foodlist_memory(foodlist *fl) {
+    size_t size = sizeof(foodlist) + strlen(fl->file) + 1;
+    uint64_t taken = start_read(fl, FOODLIST_SITE_MEMORY);
+    /* every food has its node with an item and a next pointer */
+    size += fl->index_len * (food_get_size() + 2 * sizeof(void *));
+    size += fl->index_cap * (sizeof(food *) + FOODLIST_NUTRIENTS * sizeof(float));
+    size += bloom_memory(fl->filter);
+    for (struct foodlist_retired *r = fl->retired; r; r = r->next) {
+        size += r->size;
+    }
+    end_read(fl, FOODLIST_SITE_MEMORY, taken);
+    return size;
+}
+
+void foodlist_set_lock_hook(foodlist_lock_hook hook) {
+    foodlist_hook = hook;
+}
+
+void foodlist_get_lockstats(foodlist *fl, foodlist_lockstats *out) {
+    memset(out, 0, sizeof(foodlist_lockstats));
+    for (int i = 0; i < FOODLIST_SITES; ++i) {
+        foodlist_siteprofile *sp = &fl->profile.sites[i];
+        bool write = i == FOODLIST_SITE_APPEND || i == FOODLIST_SITE_REBUILD;
+        uint64_t max = __atomic_load_n(&sp->wait_max_ns, __ATOMIC_RELAXED);
+        *(write ? &out->write_locks : &out->read_locks) += __atomic_load_n(&sp->locks, __ATOMIC_RELAXED);
+        *(write ? &out->write_wait_ns : &out->read_wait_ns) += __atomic_load_n(&sp->wait_ns, __ATOMIC_RELAXED);
+        uint64_t *out_max = write ? &out->write_wait_max_ns : &out->read_wait_max_ns;
+        if (max > *out_max) {
+            *out_max = max;
+        }
+    }
+}
+
+/**
+* @brief Helper function to copy counters which are updated atomically
+* @param uint64_t* Destination
+* @param uint64_t* Source
+* @param size_t Number of counters
+*
+* */
+static void foodlist_profile_copy(uint64_t *dst, uint64_t *src, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+void foodlist_get_lockprofile(foodlist *fl, foodlist_lockprofile *out) {
+    for (int i = 0; i < FOODLIST_SITES; ++i) {
+        foodlist_profile_copy((uint64_t *) &out->sites[i], (uint64_t *) &fl->profile.sites[i],
+                              sizeof(foodlist_siteprofile) / sizeof(uint64_t));
+    }
+    out->readers_high_water = __atomic_load_n(&fl->profile.readers_high_water, __ATOMIC_RELAXED);
+    out->overtaking_reads = __atomic_load_n(&fl->profile.overtaking_reads, __ATOMIC_RELAXED);
+    out->starved_writes = __atomic_load_n(&fl->profile.starved_writes, __ATOMIC_RELAXED);
+    out->starved_ns = __atomic_load_n(&fl->profile.starved_ns, __ATOMIC_RELAXED);
+    out->starved_max_ns = __atomic_load_n(&fl->profile.starved_max_ns, __ATOMIC_RELAXED);
+    foodlist_profile_copy(out->starved, fl->profile.starved, FOODLIST_PROFILE_BUCKETS);
+}
+
+/**
+* @brief Helper function to get a percentile of a log2 histogram
+* @param uint64_t* Buckets of the histogram
+* @param double The percentile, e.g. 99
+* @return Upper bound of the bucket containing the percentile in nanoseconds, 0 if it is empty
+*
+* */
+static uint64_t foodlist_profile_percentile(const uint64_t *buckets, double p) {
+    uint64_t count = 0;
+    for (int i = 0; i < FOODLIST_PROFILE_BUCKETS; ++i) {
+        count += buckets[i];
+    }
+    uint64_t rank = (uint64_t) (count * p / 100.0 + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < FOODLIST_PROFILE_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen > 0 && seen >= rank) {
+            return i ? 1ULL << i : 0;
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Helper function to print the non-empty buckets of a log2 histogram as "<bound:count"
+* @param FILE* Stream to print to
+* @param char* Label printed before the buckets
+* @param uint64_t* Buckets of the histogram
+*
+* */
+static void foodlist_profile_print(FILE *out, const char *label, const uint64_t *buckets) {
+    fprintf(out, "  %-8s", label);
+    for (int i = 0; i < FOODLIST_PROFILE_BUCKETS; ++i) {
+        if (!buckets[i]) {
+            continue;
+        }
+        double bound = i ? (double) (1ULL << i) : 1;
+        if (bound < 1000) {
+            fprintf(out, " <%.0fns:%llu", bound, (unsigned long long) buckets[i]);
+        } else if (bound < 1000000) {
+            fprintf(out, " <%.0fus:%llu", bound / 1000, (unsigned long long) buckets[i]);
+        } else if (bound < 1000000000) {
+            fprintf(out, " <%.0fms:%llu", bound / 1000000, (unsigned long long) buckets[i]);
+        } else {
+            fprintf(out, " <%.0fs:%llu", bound / 1000000000, (unsigned long long) buckets[i]);
+        }
+    }
+    fprintf(out, "\n");
+}
+
+void foodlist_dump_lockprofile(foodlist *fl, FILE *out) {
+    foodlist_lockprofile p;
+    foodlist_get_lockprofile(fl, &p);
+    fprintf(out, "lock profile: readers_high_water=%d overtaking_reads=%llu starved_writes=%llu "
+            "starved_mean_us=%.1f starved_p99_us=%.1f starved_max_us=%.1f\n", p.readers_high_water,
+            (unsigned long long) p.overtaking_reads, (unsigned long long) p.starved_writes,
+            p.starved_writes ? p.starved_ns / 1000.0 / p.starved_writes : 0,
+            foodlist_profile_percentile(p.starved, 99) / 1000.0, p.starved_max_ns / 1000.0);
+    if (p.starved_writes) {
+        foodlist_profile_print(out, "starved", p.starved);
+    }
+    for (int i = 0; i < FOODLIST_SITES; ++i) {
+        foodlist_siteprofile *sp = &p.sites[i];
+        if (!sp->locks) {
+            continue;
+        }
+        fprintf(out, "%s locks=%llu wait_mean_us=%.3f wait_p99_us=%.3f wait_max_us=%.1f hold_mean_us=%.3f "
+                "hold_p99_us=%.3f hold_max_us=%.1f\n", foodlist_site_names[i], (unsigned long long) sp->locks,
+                sp->wait_ns / 1000.0 / sp->locks, foodlist_profile_percentile(sp->wait, 99) / 1000.0,
+                sp->wait_max_ns / 1000.0, sp->hold_ns / 1000.0 / sp->locks,
+                foodlist_profile_percentile(sp->hold, 99) / 1000.0, sp->hold_max_ns / 1000.0);
+        foodlist_profile_print(out, "wait", sp->wait);
+        foodlist_profile_print(out, "hold", sp->hold);
+    }
+}
+
+const char *foodlist_site_name(foodlist_site site) {
+    return foodlist_site_names[site];
+}
+
 bool foodlist_is_empty(foodlist *fl) {
     bool ret;
-    start_read(fl);
+    uint64_t taken = start_read(fl, FOODLIST_SITE_IS_EMPTY);
     ret = (NULL == fl->data);
-    end_read(fl);
+    end_read(fl, FOODLIST_SITE_IS_EMPTY, taken);
     return ret;
 }
 
 void foodlist_append(foodlist *fl, food **f) {
     foodlistnode *newnode = foodlistnode_init();
     foodlistnode_set_item(newnode, f);
-    if (foodlist_is_empty(fl)) {
+    uint64_t taken = start_write(fl, FOODLIST_SITE_APPEND);
+    if (NULL == fl->data) {
         /* this is going to be the first element */
-        start_write(fl);
         fl->data = newnode;
-        end_write(fl);
     } else {
-        /* if elements already existing, search for the tail */
-        start_write(fl);
-        foodlistnode *n = fl->data;
-        while (foodlistnode_has_next(n)) {
-            n = foodlistnode_get_next(n);
+        foodlistnode_set_next(fl->tail, &newnode);
+    }
+    fl->tail = newnode;
+    if (fl->index_len == fl->index_cap) {
+        /* copied instead of reallocated, lock-free readers may still scan the old index */
+        food **index = malloc(fl->index_cap * 2 * sizeof(food *));
+        memcpy(index, fl->index, fl->index_len * sizeof(food *));
+        foodlist_retire(fl, fl->index, NULL, fl->index_cap * sizeof(food *));
+        __atomic_store_n(&fl->index, index, __ATOMIC_RELEASE);
+        fl->index_cap *= 2;
+        for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+            fl->columns[d] = realloc(fl->columns[d], fl->index_cap * sizeof(float));
         }
-        foodlistnode_set_next(n, &newnode);
-        end_write(fl);
     }
+    if (bloom_count(fl->filter) >= bloom_capacity(fl->filter)) {
+        /* the filter is full, keep its false positive rate low */
+        foodlist_filter_rebuild(fl);
+    }
+    fl->index[fl->index_len] = *f;
+    foodlist_columns_add(fl, fl->index_len);
+    foodlist_filter_add(fl->filter, food_get_name(*f));
+    /* published last, a reader seeing the new length finds the food in the index and the filter */
+    __atomic_store_n(&fl->index_len, fl->index_len + 1, __ATOMIC_RELEASE);
+    end_write(fl, FOODLIST_SITE_APPEND, taken);
 }
 
 foodlistnode *foodlist_get_data(foodlist *fl) {
-    start_read(fl);
+    uint64_t taken = start_read(fl, FOODLIST_SITE_GET_DATA);
     foodlistnode *fln = fl->data;
-    end_read(fl);
+    end_read(fl, FOODLIST_SITE_GET_DATA, taken);
     return fln;
 }
 
+bool foodlist_matches(const char *name, const char *str) {
+    /*
+     * To satisfy all search criteria, the string we are searching for has obviously to be shorter than
+     * the string in which we are searching. Furthermore, the first srtlen(str) characters have to match
+     * and either the searchstring has to end with a comma, or the next character in the string we are
+     * searching in has to be a comma. This makes sure, that either "Milk," or "Milk" can match e.g.
+     * "Milk,Whole,3.3% Fat"
+     */
+    size_t len = strlen(str);
+    if (strlen(name) >= len && strncasecmp(str, name, len) == 0) {
+        if (strlen(name) == len
+                || name[len] == ','
+                || (len > 0 && str[len - 1] == ',')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool foodlist_may_match(foodlist *fl, const char *str) {
+    uint64_t taken = start_read(fl, FOODLIST_SITE_MAY_MATCH);
+    bool ret = bloom_may_contain(fl->filter, str, strlen(str));
+    end_read(fl, FOODLIST_SITE_MAY_MATCH, taken);
+    return ret;
+}
+
+bool foodlist_may_match_lockfree(foodlist *fl, const char *str) {
+    return bloom_may_contain(__atomic_load_n(&fl->filter, __ATOMIC_ACQUIRE), str, strlen(str));
+}
+
 food **foodlist_find(foodlist *fl, char *str, size_t *num) {
-    size_t max_items = 25;
-    food **ret = calloc(max_items, sizeof(food *));
+    return foodlist_find_range(fl, str, 0, (size_t) -1, num);
+}
+
+food **foodlist_find_range(foodlist *fl, char *str, size_t from, size_t to, size_t *num) {
+    uint64_t taken = start_read(fl, FOODLIST_SITE_FIND_RANGE);
+    food **ret = foodlist_scan_range(fl, str, from, to, num);
+    end_read(fl, FOODLIST_SITE_FIND_RANGE, taken);
+    return ret;
+}
+
+food **foodlist_find_lockfree(foodlist *fl, char *str, size_t *num) {
+    return foodlist_scan_range(fl, str, 0, (size_t) -1, num);
+}
+
+food **foodlist_get_range(foodlist *fl, size_t from, size_t limit, size_t *num) {
+    uint64_t taken = start_read(fl, FOODLIST_SITE_GET_RANGE);
+    *num = from < fl->index_len ? fl->index_len - from : 0;
+    if (*num > limit) {
+        *num = limit;
+    }
+    food **ret = calloc(*num + 1, sizeof(food *));
+    if (*num > 0) {
+        memcpy(ret, fl->index + from, *num * sizeof(food *));
+    }
+    end_read(fl, FOODLIST_SITE_GET_RANGE, taken);
+    return ret;
+}
+
+food **foodlist_find_page(foodlist *fl, char *str, size_t *pos, size_t skip, size_t limit, size_t *num) {
+    uint64_t taken = start_read(fl, FOODLIST_SITE_FIND_PAGE);
+    food **ret = foodlist_scan_page(fl, str, pos, skip, limit, num);
+    end_read(fl, FOODLIST_SITE_FIND_PAGE, taken);
+    return ret;
+}
+
+food **foodlist_find_page_lockfree(foodlist *fl, char *str, size_t *pos, size_t skip, size_t limit, size_t *num) {
+    return foodlist_scan_page(fl, str, pos, skip, limit, num);
+}
+
+food **foodlist_similar(foodlist *fl, const char *name, size_t k, int less, size_t *num) {
+    food **ret = calloc(k + 1, sizeof(food *));
     *num = 0;
-    foodlistnode *n = foodlist_get_data(fl);
-    while (NULL != n) {
-        if (*num == max_items - 1) {
-            max_items *= 2;
-            ret = realloc(ret, max_items * food_get_size());
+    uint64_t taken = start_read(fl, FOODLIST_SITE_SIMILAR);
+    size_t n = fl->index_len;
+    size_t self = n;
+    for (size_t i = 0; i < n; ++i) {
+        if (!strcasecmp(food_get_name(fl->index[i]), name)) {
+            self = i;
+            break;
         }
-        food *f = foodlistnode_get_item(n);
-        char *name = food_get_name(f);
-
-        /*
-         * To satisfy all search criteria, the string we are searching for has obviously to be shorter than
-         * the string in which we are searching. Furthermore, the first srtlen(str) characters have to match
-         * and either the searchstring has to end with a comma, or the next character in the string we are
-         * searching in has to be a comma. This makes sure, that either "Milk," or "Milk" can match e.g.
-         * "Milk,Whole,3.3% Fat"
-         */
-        if (strlen(name) >= strlen(str) && strncasecmp(str, name, strlen(str)) == 0) {
-            if (strlen(name) == strlen(str)
-                    || name[strlen(str)] == ','
-                    || str[strlen(str) - 1] == ',') {
-                ret[*num] = f;
-                *num += 1;
+    }
+    if (self == n || k == 0 || isnan(fl->columns[0][self])) {
+        end_read(fl, FOODLIST_SITE_SIMILAR, taken);
+        return ret;
+    }
+
+    /* squared distances in units of the standard deviation of every nutrient */
+    float *dist = calloc(n, sizeof(float));
+    for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+        double mean = fl->column_sum[d] / fl->column_len;
+        double var = fl->column_sq[d] / fl->column_len - mean * mean;
+        const float w = var > 1e-9 ? (float) (1.0 / var) : 1.0f;
+        const float q = fl->columns[d][self];
+        const float *c = fl->columns[d];
+        for (size_t i = 0; i < n; ++i) {
+            float x = c[i] - q;
+            dist[i] += w * x * x;
+        }
+    }
+    dist[self] = NAN;
+    if (less >= 0 && less < FOODLIST_NUTRIENTS) {
+        const float q = fl->columns[less][self];
+        for (size_t i = 0; i < n; ++i) {
+            if (!(fl->columns[less][i] < q)) {
+                dist[i] = NAN;
             }
         }
-        n = foodlistnode_get_next(n);
     }
+
+    /* keep the k closest foods sorted */
+    float *best = calloc(k + 1, sizeof(float));
+    for (size_t i = 0; i < n; ++i) {
+        float x = dist[i];
+        if (isnan(x) || (*num == k && x >= best[k - 1])) {
+            continue;
+        }
+        size_t pos = *num < k ? (*num)++ : k - 1;
+        while (pos > 0 && best[pos - 1] > x) {
+            best[pos] = best[pos - 1];
+            ret[pos] = ret[pos - 1];
+            pos--;
+        }
+        best[pos] = x;
+        ret[pos] = fl->index[i];
+    }
+    end_read(fl, FOODLIST_SITE_SIMILAR, taken);
+    free(best);
+    free(dist);
     return ret;
 }
 
@@ -245,6 +847,20 @@ void foodlist_destroy(foodlist *fl) {
     pthread_mutex_destroy(&fl->rw_mutex);
     pthread_mutex_destroy(&fl->r_mutex);
     free(fl->file);
+    free(fl->index);
+    for (int d = 0; d < FOODLIST_NUTRIENTS; ++d) {
+        free(fl->columns[d]);
+    }
+    bloom_destroy(fl->filter);
+    while (fl->retired) {
+        struct foodlist_retired *r = fl->retired;
+        fl->retired = r->next;
+        free(r->index);
+        if (r->filter) {
+            bloom_destroy(r->filter);
+        }
+        free(r);
+    }
     if (fl->data) {
         foodlistnode_destroy(fl->data);
     }
@@ -23,11 +23,106 @@
  *
  * */
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include "food.h"
 #include "foodlistnode.h"
 
 typedef struct foodlist foodlist;
 
+/**
+* @brief Waits for the locks of a foodlist since its creation
+*
+* A read lock counts from the call of the reader until it may read, including the wait for other readers
+* entering or leaving.
+*
+*/
+typedef struct foodlist_lockstats {
+    uint64_t read_locks; /**< Number of read locks taken */
+    uint64_t read_wait_ns; /**< Sum of the waits for read locks in nanoseconds */
+    uint64_t read_wait_max_ns; /**< Longest wait for a read lock in nanoseconds */
+    uint64_t write_locks; /**< Number of write locks taken */
+    uint64_t write_wait_ns; /**< Sum of the waits for write locks in nanoseconds */
+    uint64_t write_wait_max_ns; /**< Longest wait for a write lock in nanoseconds */
+} foodlist_lockstats;
+
+/**
+* @brief Function called after a lock of any foodlist was taken, e.g. for tracing
+*
+* The arguments are whether it is the write lock, and the time the caller started waiting and the time
+* it got the lock, in nanoseconds of CLOCK_MONOTONIC.
+*
+*/
+typedef void (*foodlist_lock_hook)(bool, uint64_t, uint64_t);
+
+/**
+*
+* @brief Nutrients of the per 100 g profile of a food, see foodlist_similar()
+*
+* */
+typedef enum foodlist_nutrient {
+    FOODLIST_KCAL, /**< kcal */
+    FOODLIST_FAT, /**< Fat (g) */
+    FOODLIST_CARBO, /**< Carbo (g) */
+    FOODLIST_PROTEIN, /**< Protein (g) */
+    FOODLIST_NUTRIENTS /**< Number of nutrients */
+} foodlist_nutrient;
+
+#define FOODLIST_PROFILE_BUCKETS 41 /**< Bucket i > 0 counts durations from 2^(i-1) to below 2^i nanoseconds */
+
+/**
+*
+* @brief Methods taking a lock of the foodlist, the call sites of the lock profile
+*
+* */
+typedef enum foodlist_site {
+    FOODLIST_SITE_APPEND, /**< foodlist_append(), write lock */
+    FOODLIST_SITE_REBUILD, /**< Sizing the bloom filter in foodlist_init_csv(), write lock */
+    FOODLIST_SITE_COUNT, /**< foodlist_count(), read lock */
+    FOODLIST_SITE_MEMORY, /**< foodlist_memory(), read lock */
+    FOODLIST_SITE_IS_EMPTY, /**< foodlist_is_empty(), read lock */
+    FOODLIST_SITE_GET_DATA, /**< foodlist_get_data(), read lock */
+    FOODLIST_SITE_MAY_MATCH, /**< foodlist_may_match(), read lock */
+    FOODLIST_SITE_FIND_RANGE, /**< foodlist_find_range() and foodlist_find(), read lock */
+    FOODLIST_SITE_GET_RANGE, /**< foodlist_get_range(), read lock */
+    FOODLIST_SITE_FIND_PAGE, /**< foodlist_find_page(), read lock */
+    FOODLIST_SITE_SIMILAR, /**< foodlist_similar(), read lock */
+    FOODLIST_SITES /**< Number of call sites */
+} foodlist_site;
+
+/**
+* @brief Waits for and holds of the lock at one call site, with log2 histograms in nanoseconds
+*
+*/
+typedef struct foodlist_siteprofile {
+    uint64_t locks; /**< Number of locks taken */
+    uint64_t wait_ns; /**< Sum of the waits for the lock */
+    uint64_t wait_max_ns; /**< Longest wait for the lock */
+    uint64_t hold_ns; /**< Sum of the times the lock was held */
+    uint64_t hold_max_ns; /**< Longest time the lock was held */
+    uint64_t wait[FOODLIST_PROFILE_BUCKETS]; /**< Histogram of the waits */
+    uint64_t hold[FOODLIST_PROFILE_BUCKETS]; /**< Histogram of the holds */
+} foodlist_siteprofile;
+
+/**
+* @brief Lock profile of a foodlist since its creation
+*
+* The readers share the lock and keep it as long as one of them holds it, so readers arriving while a
+* writer waits overtake it. A write is counted as starved, if at least one reader took the lock while it
+* waited, its wait is then a starvation interval.
+*
+*/
+typedef struct foodlist_lockprofile {
+    foodlist_siteprofile sites[FOODLIST_SITES]; /**< Waits and holds per call site */
+    int readers_high_water; /**< Largest number of readers holding the lock at once */
+    uint64_t overtaking_reads; /**< Number of read locks taken while a writer waited */
+    uint64_t starved_writes; /**< Number of write locks which were overtaken by a reader */
+    uint64_t starved_ns; /**< Sum of the waits of the starved writes */
+    uint64_t starved_max_ns; /**< Longest wait of a starved write */
+    uint64_t starved[FOODLIST_PROFILE_BUCKETS]; /**< Histogram of the waits of the starved writes */
+} foodlist_lockprofile;
+
 /**
  * @brief Constructor for foodlist
  * @return A pointer to the foodlist structure, representing the created object
@@ -66,6 +161,128 @@ void foodlist_append(foodlist *, food **);
 * */
 food **foodlist_find(foodlist *, char *, size_t *);
 
+/**
+* @brief Method for finding food within a range of the food list
+* @param foodlist* Pointer to structure to work on
+* @param char* A pointer to the string which should be found
+* @param size_t Position of the first food to check
+* @param size_t Position after the last food to check, clamped to the length of the list
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order, which are satisfying the search criteria.
+*                Must be freed by caller.
+*
+* Splitting the list into ranges allows searching it in parallel.
+*
+* */
+food **foodlist_find_range(foodlist *, char *, size_t, size_t, size_t *);
+
+/**
+* @brief Method for finding one page of food, scanning the food list only as far as needed
+* @param foodlist* Pointer to structure to work on
+* @param char* A pointer to the string which should be found
+* @param size_t* Position of the first food to check. The method updates its value to the position of the
+*                first match after the returned page, or to (size_t) -1 if there is none.
+* @param size_t Number of matches to skip before the page starts
+* @param size_t Maximum number of foods to return
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order, which are satisfying the search criteria.
+*                Must be freed by caller.
+*
+* Foods are only appended, so a position stays valid and the next page can be resumed from it.
+*
+* */
+food **foodlist_find_page(foodlist *, char *, size_t *, size_t, size_t, size_t *);
+
+/**
+* @brief Method for finding food within the food list without taking the lock
+* @param foodlist* Pointer to structure to work on
+* @param char* A pointer to the string which should be found
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order. Must be freed by caller.
+*
+* Lock-free variant of foodlist_find() for readers which must not write to memory shared with other
+* threads, it neither takes the lock nor counts in the lock profile. It may run concurrently with
+* foodlist_append() and finds the foods appended before it read the length of the list.
+*
+* */
+food **foodlist_find_lockfree(foodlist *, char *, size_t *);
+
+/**
+* @brief Method for finding one page of food without taking the lock, see foodlist_find_page()
+* @param foodlist* Pointer to structure to work on
+* @param char* A pointer to the string which should be found
+* @param size_t* Position of the first food to check, updated like by foodlist_find_page()
+* @param size_t Number of matches to skip before the page starts
+* @param size_t Maximum number of foods to return
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order. Must be freed by caller.
+*
+* */
+food **foodlist_find_page_lockfree(foodlist *, char *, size_t *, size_t, size_t, size_t *);
+
+/**
+* @brief Method for getting the foods of a range of the food list, without searching
+* @param foodlist* Pointer to structure to work on
+* @param size_t Position of the first food
+* @param size_t Maximum number of foods to return
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers in list order. Must be freed by caller.
+*
+* Foods are only appended, so the foods from a position on are the ones appended after the list had this
+* length.
+*
+* */
+food **foodlist_get_range(foodlist *, size_t, size_t, size_t *);
+
+/**
+* @brief Method for checking if a food name satisfies the search criteria of foodlist_find()
+* @param char* Name of the food
+* @param char* The string which should be found
+* @return True, if the name matches, false otherwise
+*
+* */
+bool foodlist_matches(const char *, const char *);
+
+/**
+* @brief Method for finding the foods whose nutrients per 100 g are closest to those of a food
+* @param foodlist* Pointer to structure to work on
+* @param char* Name of the food, compared ignoring case, the first food of this name is used
+* @param size_t Maximum number of foods to return
+* @param int A foodlist_nutrient the returned foods must have less of per 100 g than the food, -1 for none
+* @param size_t* Pointer to a size_t instance. The method updates its value to the length of the returned list.
+* @return food** A pointer to an array of food pointers, closest first, without the food itself. Must be freed
+*                by caller.
+*
+* Every nutrient is divided by its standard deviation over the list, so kcal do not outweigh the others.
+* The profiles are kept in one column per nutrient, which is extended as foods are appended, and all foods
+* are compared in a tight loop over the columns. Foods without weight have no profile and are never
+* returned.
+*
+* */
+food **foodlist_similar(foodlist *, const char *, size_t, int, size_t *);
+
+/**
+* @brief Method for checking cheaply if a search may find any food
+* @param foodlist* Pointer to structure to work on
+* @param char* The string which should be found
+* @return False, if no food matches, true if some food probably matches
+*
+* The answer comes from a bloom filter over all matching search terms, no food is scanned.
+*
+* */
+bool foodlist_may_match(foodlist *, const char *);
+
+/**
+* @brief Method for checking cheaply if a search may find any food, without taking the lock
+* @param foodlist* Pointer to structure to work on
+* @param char* The string which should be found
+* @return False, if no food matches, true if some food probably matches
+*
+* Lock-free variant of foodlist_may_match(), see foodlist_find_lockfree().
+*
+* */
+bool foodlist_may_match_lockfree(foodlist *, const char *);
+
 /**
 * @brief Method for saving the food structure to a file
 * @param foodlist* Pointer to structure to work on
@@ -83,6 +300,63 @@ void foodlist_save(foodlist *);
 * */
 int foodlist_count(foodlist *);
 
+/**
+* @brief Method for getting the length of the list without taking the lock
+* @param foodlist* Pointer to structure to work on
+* @return Length of the list, foods appended concurrently may be missing
+*
+* */
+size_t foodlist_count_lockfree(foodlist *);
+
+/**
+* @brief Method for estimating the memory used by the list
+* @param foodlist* Pointer to structure to work on
+* @return Size of the list, its foods, nodes, index and bloom filter in bytes, without allocator overhead
+*
+* */
+size_t foodlist_memory(foodlist *);
+
+/**
+* @brief Method for getting the lock waits of the list
+* @param foodlist* Pointer to structure to work on
+* @param foodlist_lockstats* Pointer to a structure which is filled with the counters
+*
+* */
+void foodlist_get_lockstats(foodlist *, foodlist_lockstats *);
+
+/**
+* @brief Method for getting the lock profile of the list
+* @param foodlist* Pointer to structure to work on
+* @param foodlist_lockprofile* Pointer to a structure which is filled with the counters
+*
+* Profiling is always on, it costs two clock readings and a few atomic additions per lock.
+*
+* */
+void foodlist_get_lockprofile(foodlist *, foodlist_lockprofile *);
+
+/**
+* @brief Method for printing the lock profile of the list, with a line per call site and its histograms
+* @param foodlist* Pointer to structure to work on
+* @param FILE* Stream to print to
+*
+* */
+void foodlist_dump_lockprofile(foodlist *, FILE *);
+
+/**
+* @brief Method for getting the name of a call site
+* @param foodlist_site The call site
+* @return Name of the method taking the lock, e.g. "foodlist_append"
+*
+* */
+const char *foodlist_site_name(foodlist_site);
+
+/**
+* @brief Method for setting the function called after a lock of any foodlist was taken
+* @param foodlist_lock_hook The function, or NULL
+*
+* */
+void foodlist_set_lock_hook(foodlist_lock_hook);
+
 /**
 * @brief Method for getting the data of the list
 * @param foodlist* Pointer to structure to work on
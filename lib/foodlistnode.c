@@ -67,11 +67,13 @@ int foodlistnode_count(foodlistnode *fln) {
 }
 
 void foodlistnode_destroy(foodlistnode *fln) {
-  if(fln->item) {
-    food_destroy(fln->item);
+  /* iterative, a recursion per node overflows the stack on long lists */
+  while(fln) {
+    foodlistnode *next = fln->next;
+    if(fln->item) {
+      food_destroy(fln->item);
+    }
+    free(fln);
+    fln = next;
   }
-  if(fln->next) {
-    foodlistnode_destroy(fln->next);
-  }
-  free(fln);
 }
@@ -84,7 +84,7 @@ int foodlistnode_count(foodlistnode *);
 bool foodlistnode_has_next(foodlistnode *);
 
 /**
- * @brief Destructor for foodlistnode
+ * @brief Destructor for foodlistnode, frees all following nodes as well
  * @param foodlistnode* Pointer to structure to be freed
  *
  * */
@@ -0,0 +1,162 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file histogram.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief File containing the histogram structure and its member methods.
+*
+* The buckets are grouped by the position of the highest set bit of the value. Values below 2^bits have
+* their own bucket, every following power of two is split into 2^(bits-1) buckets of equal width.
+*
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+/**
+* @brief histogram structure for representing the counted values
+*
+*/
+struct histogram {
+    unsigned int bits; /**< Precision, values below 2^bits are counted exactly */
+    size_t num_buckets; /**< Number of buckets */
+    uint64_t *counts; /**< Number of values per bucket */
+    uint64_t count; /**< Number of values */
+    uint64_t max; /**< Largest value */
+    double sum; /**< Sum of all values */
+};
+
+/**
+* @brief Helper function to get the bucket of a value
+* @param histogram* The histogram
+* @param uint64_t The value, at most 2^HISTOGRAM_MAX_BITS
+* @return Index of the bucket
+*
+* */
+static size_t histogram_index(histogram *h, uint64_t v) {
+    uint64_t sub = 1ULL << h->bits;
+    if (v < sub) {
+        return v;
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - (int) h->bits + 1;
+    /* the highest bit is implied by the group, the next bits select the bucket within it */
+    return sub + (size_t) (shift - 1) * (sub / 2) + ((v >> shift) - sub / 2);
+}
+
+/**
+* @brief Helper function to get the largest value of a bucket
+* @param histogram* The histogram
+* @param size_t Index of the bucket
+* @return The largest value counted in the bucket
+*
+* */
+static uint64_t histogram_upper(histogram *h, size_t i) {
+    uint64_t sub = 1ULL << h->bits;
+    if (i < sub) {
+        return i;
+    }
+    size_t group = (i - sub) / (sub / 2);
+    size_t pos = (i - sub) % (sub / 2);
+    return ((sub / 2 + pos + 1) << (group + 1)) - 1;
+}
+
+histogram *histogram_init(unsigned int bits) {
+    histogram *h = (histogram *) malloc(sizeof(histogram));
+    h->bits = bits < 1 ? 1 : bits > 16 ? 16 : bits;
+    h->num_buckets = (1ULL << h->bits) + (HISTOGRAM_MAX_BITS - h->bits + 1) * (1ULL << (h->bits - 1));
+    h->counts = calloc(h->num_buckets, sizeof(uint64_t));
+    h->count = 0;
+    h->max = 0;
+    h->sum = 0;
+    return h;
+}
+
+void histogram_record(histogram *h, uint64_t v) {
+    if (v > (1ULL << HISTOGRAM_MAX_BITS)) {
+        v = 1ULL << HISTOGRAM_MAX_BITS;
+    }
+    h->counts[histogram_index(h, v)]++;
+    h->count++;
+    h->sum += v;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+void histogram_merge(histogram *h, histogram *other) {
+    if (other->bits == h->bits) {
+        for (size_t i = 0; i < h->num_buckets; ++i) {
+            h->counts[i] += other->counts[i];
+        }
+    } else {
+        for (size_t i = 0; i < other->num_buckets; ++i) {
+            if (other->counts[i]) {
+                h->counts[histogram_index(h, histogram_upper(other, i))] += other->counts[i];
+            }
+        }
+    }
+    h->count += other->count;
+    h->sum += other->sum;
+    if (other->max > h->max) {
+        h->max = other->max;
+    }
+}
+
+void histogram_clear(histogram *h) {
+    memset(h->counts, 0, h->num_buckets * sizeof(uint64_t));
+    h->count = 0;
+    h->max = 0;
+    h->sum = 0;
+}
+
+uint64_t histogram_count(histogram *h) {
+    return h->count;
+}
+
+uint64_t histogram_percentile(histogram *h, double p) {
+    if (h->count == 0) {
+        return 0;
+    }
+    /* rank of the value, counted from 1 */
+    uint64_t rank = (uint64_t) (p / 100.0 * h->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < h->num_buckets; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t upper = histogram_upper(h, i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+uint64_t histogram_max(histogram *h) {
+    return h->max;
+}
+
+double histogram_mean(histogram *h) {
+    return h->count ? h->sum / h->count : 0;
+}
+
+void histogram_print(histogram *h, FILE *out, const char *label, double div) {
+    fprintf(out, "%s count=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n", label,
+            (unsigned long long) h->count, histogram_mean(h) / div, histogram_percentile(h, 50) / div,
+            histogram_percentile(h, 90) / div, histogram_percentile(h, 99) / div,
+            histogram_percentile(h, 99.9) / div, histogram_max(h) / div);
+}
+
+void histogram_destroy(histogram *h) {
+    free(h->counts);
+    free(h);
+}
@@ -0,0 +1,121 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file histogram.h
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Header containing the public accessible histogram methods.
+*
+* A histogram counts values, e.g. latencies in nanoseconds, in buckets whose width grows with the value,
+* like an HDR histogram: with a precision of p bits, values below 2^p are counted exactly, larger values
+* with a relative error below 2^(1-p). Recording a value takes constant time and no memory, so every
+* request can be recorded. The histogram is not thread safe, every thread records into its own one and
+* they are merged when they are read.
+*
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTOGRAM_MAX_BITS 40 /**< Larger values are counted as 2^40, about 18 minutes in nanoseconds */
+
+/**
+*
+* @brief Forward declaration for histogram
+*
+* */
+typedef struct histogram histogram;
+
+/**
+* @brief Constructor for histogram
+* @param unsigned int Precision in bits, from 1 to 16. The histogram takes about 4 * (43 - bits) * 2^bits bytes,
+*        e.g. 11 bits for an error below 0.1% take 256 KiB, 7 bits for an error below 2% take 18 KiB.
+* @return A pointer to the histogram structure, representing the created object
+*
+* After using this structure, it must be freed with histogram_destroy(histogram *)
+*
+* */
+histogram *histogram_init(unsigned int);
+
+/**
+* @brief Method for counting a value
+* @param histogram* Pointer to structure to work on
+* @param uint64_t The value, values beyond 2^40 are counted as 2^40
+*
+* */
+void histogram_record(histogram *, uint64_t);
+
+/**
+* @brief Method for adding all values of another histogram
+* @param histogram* Pointer to structure to work on
+* @param histogram* The histogram to add, it is not modified. It may have another precision.
+*
+* */
+void histogram_merge(histogram *, histogram *);
+
+/**
+* @brief Method for removing all values
+* @param histogram* Pointer to structure to work on
+*
+* */
+void histogram_clear(histogram *);
+
+/**
+* @brief Method for getting the number of counted values
+* @param histogram* Pointer to structure to work on
+* @return The number of values
+*
+* */
+uint64_t histogram_count(histogram *);
+
+/**
+* @brief Method for getting a percentile of the counted values
+* @param histogram* Pointer to structure to work on
+* @param double The percentile, e.g. 99.9
+* @return The largest value of the bucket containing the percentile, 0 if there are no values
+*
+* */
+uint64_t histogram_percentile(histogram *, double);
+
+/**
+* @brief Method for getting the largest counted value
+* @param histogram* Pointer to structure to work on
+* @return The exact maximum, 0 if there are no values
+*
+* */
+uint64_t histogram_max(histogram *);
+
+/**
+* @brief Method for getting the mean of the counted values
+* @param histogram* Pointer to structure to work on
+* @return The exact mean, 0 if there are no values
+*
+* */
+double histogram_mean(histogram *);
+
+/**
+* @brief Method for printing the usual percentiles on one line
+* @param histogram* Pointer to structure to work on
+* @param FILE* Stream to print to
+* @param char* Label printed before the percentiles
+* @param double Divisor of the values, e.g. 1000 to print nanoseconds as microseconds
+*
+* */
+void histogram_print(histogram *, FILE *, const char *, double);
+
+/**
+* @brief Destructor for histogram
+* @param histogram* Pointer to structure to be freed
+*
+* */
+void histogram_destroy(histogram *);
+
+#endif /* HISTOGRAM_H */
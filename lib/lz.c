@@ -0,0 +1,197 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file lz.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief File containing a fast LZ77 block compressor for the calory socket protocol.
+*
+* The compressor finds matches with a single entry hash table over four byte sequences and takes the first
+* one it finds, which trades some compression ratio for speed.
+*
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+#define LZ_HASH_BITS 12 /**< Number of bits of the match finder hash */
+#define LZ_MIN_MATCH 4 /**< Shortest match which is encoded */
+#define LZ_MAX_OFFSET 65535 /**< Farthest distance of a match */
+
+/**
+* @brief Helper function reading four bytes
+* @param unsigned char* Pointer to the bytes
+* @return The bytes as integer
+* */
+static uint32_t lz_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+* @brief Helper function writing a length continuation
+* @param unsigned char** Output position, advanced by the written bytes
+* @param unsigned char* End of the output buffer
+* @param size_t Remaining length, after the 15 stored in the token
+* @return 0 on success, -1 if the buffer is too short
+* */
+static int lz_write_length(unsigned char **op, const unsigned char *oend, size_t len) {
+    while (len >= 255) {
+        if (*op >= oend) {
+            return -1;
+        }
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (*op >= oend) {
+        return -1;
+    }
+    *(*op)++ = (unsigned char) len;
+    return 0;
+}
+
+/**
+* @brief Helper function writing one token with its literals and match
+* @param unsigned char** Output position, advanced by the written bytes
+* @param unsigned char* End of the output buffer
+* @param unsigned char* The literals
+* @param size_t Number of literals
+* @param size_t Offset of the match
+* @param size_t Length of the match, 0 for the last token
+* @return 0 on success, -1 if the buffer is too short
+* */
+static int lz_write_sequence(unsigned char **op, const unsigned char *oend, const unsigned char *lit, size_t lit_len,
+                             size_t offset, size_t match_len) {
+    if (*op >= oend) {
+        return -1;
+    }
+    unsigned char *token = (*op)++;
+    size_t ml = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+    *token = (unsigned char) (((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && lz_write_length(op, oend, lit_len - 15) < 0) {
+        return -1;
+    }
+    if ((size_t) (oend - *op) < lit_len) {
+        return -1;
+    }
+    memcpy(*op, lit, lit_len);
+    *op += lit_len;
+    if (match_len == 0) {
+        return 0;
+    }
+    if (oend - *op < 2) {
+        return -1;
+    }
+    *(*op)++ = offset & 0xff;
+    *(*op)++ = (offset >> 8) & 0xff;
+    if (ml >= 15 && lz_write_length(op, oend, ml - 15) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+size_t lz_compress(const char *src, size_t len, char *dst, size_t cap) {
+    const unsigned char *in = (const unsigned char *) src;
+    unsigned char *op = (unsigned char *) dst;
+    const unsigned char *oend = op + cap;
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    size_t ip = 0;
+    size_t anchor = 0;
+    while (ip + LZ_MIN_MATCH <= len) {
+        uint32_t seq = lz_read32(in + ip);
+        uint32_t h = (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+        /* positions are stored plus one, so zero marks an empty slot */
+        size_t ref = table[h];
+        table[h] = (uint32_t) ip + 1;
+        if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || lz_read32(in + ref - 1) != seq) {
+            /* skip faster through data which does not compress */
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+        ref--;
+        size_t match_len = LZ_MIN_MATCH;
+        while (ip + match_len < len && in[ref + match_len] == in[ip + match_len]) {
+            match_len++;
+        }
+        if (lz_write_sequence(&op, oend, in + anchor, ip - anchor, ip - ref, match_len) < 0) {
+            return 0;
+        }
+        ip += match_len;
+        anchor = ip;
+    }
+    if (lz_write_sequence(&op, oend, in + anchor, len - anchor, 0, 0) < 0) {
+        return 0;
+    }
+    return op - (unsigned char *) dst;
+}
+
+/**
+* @brief Helper function reading a length continuation
+* @param unsigned char** Input position, advanced by the read bytes
+* @param unsigned char* End of the input
+* @param size_t* Length to add the continuation to
+* @return 0 on success, -1 if the input ended
+* */
+static int lz_read_length(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+    unsigned char b;
+    do {
+        if (*ip >= iend) {
+            return -1;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+ssize_t lz_decompress(const char *src, size_t len, char *dst, size_t cap) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *iend = ip + len;
+    unsigned char *out = (unsigned char *) dst;
+    size_t op = 0;
+    while (ip < iend) {
+        unsigned char token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && lz_read_length(&ip, iend, &lit_len) < 0) {
+            return -1;
+        }
+        if ((size_t) (iend - ip) < lit_len || cap - op < lit_len) {
+            return -1;
+        }
+        memcpy(out + op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == iend) {
+            /* the last token has no match */
+            break;
+        }
+        if (iend - ip < 2) {
+            return -1;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && lz_read_length(&ip, iend, &match_len) < 0) {
+            return -1;
+        }
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || cap - op < match_len) {
+            return -1;
+        }
+        /* byte by byte, because the match may overlap the bytes it produces */
+        for (size_t i = 0; i < match_len; ++i) {
+            out[op + i] = out[op - offset + i];
+        }
+        op += match_len;
+    }
+    return op;
+}
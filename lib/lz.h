@@ -0,0 +1,47 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file lz.h
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Header containing a fast LZ77 block compressor for the calory socket protocol.
+*
+* A compressed block is a sequence of tokens. Every token byte holds the number of following literal bytes
+* in its upper and the length of the following match minus four in its lower four bits, the value 15 is
+* continued with extra bytes which are added until one is below 255. The literals are followed by a two
+* bytes little endian offset of the match. The last token of a block only carries literals.
+*
+*/
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+* @brief Function to compress a block
+* @param char* The data to compress
+* @param size_t Length of the data
+* @param char* Buffer for the compressed data
+* @param size_t Length of the buffer
+* @return Length of the compressed data, or 0 if it does not fit into the buffer
+* */
+size_t lz_compress(const char *src, size_t len, char *dst, size_t cap);
+
+/**
+* @brief Function to decompress a block
+* @param char* The compressed data
+* @param size_t Length of the compressed data
+* @param char* Buffer for the decompressed data
+* @param size_t Length of the buffer
+* @return Length of the decompressed data, or -1 if the block is malformed or does not fit into the buffer
+* */
+ssize_t lz_decompress(const char *src, size_t len, char *dst, size_t cap);
+
+#endif /* LZ_H */
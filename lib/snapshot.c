@@ -0,0 +1,289 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file snapshot.c
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief File containing the snapshot structure and its member methods.
+*
+* A snapshot file starts with a header, followed by one fixed size record per food, sorted by name
+* case insensitively, and the zero terminated strings. Records refer to their strings by offsets relative
+* to the record itself, so a view needs no pointer to the snapshot it belongs to. Since all foods
+* matching a search term share its prefix, they are adjacent and found by binary search.
+*
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "food.h"
+#include "foodlistnode.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "CALSNAP1" /**< Identifies snapshot files and their format */
+
+/**
+* @brief Header at the start of every snapshot file
+*
+*/
+struct snapshot_header {
+    char magic[8]; /**< SNAPSHOT_MAGIC, without terminating zero */
+    uint64_t version; /**< Version of the snapshot */
+    uint64_t stale; /**< Set to 1 by the server once a newer snapshot is published */
+    uint64_t num_foods; /**< Number of food records */
+    uint64_t size; /**< Size of the file in bytes */
+};
+
+/**
+* @brief snapshot_food structure for representing a food record in a snapshot file
+*
+*/
+struct snapshot_food {
+    uint32_t name; /**< Offset of the name, relative to this record */
+    uint32_t measure; /**< Offset of the measure, relative to this record */
+    int32_t weight; /**< Weight (g) of the food. */
+    int32_t kcal; /**< kCal of the food. */
+    int32_t fat; /**< Fat (g) of the food. */
+    int32_t carbo; /**< Carbo (g) of the food. */
+    int32_t protein; /**< Protein (g) of the food. */
+};
+
+/**
+* @brief snapshot structure for representing a mapped snapshot file
+*
+*/
+struct snapshot {
+    char *path; /**< Path of the snapshot file */
+    struct snapshot_header *hdr; /**< Start of the mapping */
+    const snapshot_food *foods; /**< The food records */
+};
+
+/**
+* @brief Compare function for using qsort() with food objects, by name case insensitively
+* @param void* Pointer to first food object
+* @param void* Pointer to second food object
+* @return An integer less than, equal to, or greater than zero
+*
+* */
+static int snapshot_cmp(const void *a, const void *b) {
+    return strcasecmp(food_get_name(*(food *const *) a), food_get_name(*(food *const *) b));
+}
+
+/**
+* @brief Helper function to map a snapshot file
+* @param char* Path of the snapshot file
+* @param bool True, if the header should be writable
+* @return The mapped header, or NULL if the file is missing or not a valid snapshot
+*
+* */
+static struct snapshot_header *snapshot_map(const char *path, bool writable) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(struct snapshot_header)) {
+        close(fd);
+        return NULL;
+    }
+    void *m = mmap(NULL, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+    struct snapshot_header *hdr = m;
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic)) || hdr->size != (uint64_t) st.st_size
+            || hdr->num_foods > (hdr->size - sizeof(struct snapshot_header)) / sizeof(snapshot_food)) {
+        munmap(m, st.st_size);
+        return NULL;
+    }
+    return hdr;
+}
+
+bool snapshot_publish(foodlist *fl, const char *path) {
+    /* foods appended while we walk the list are part of the next snapshot */
+    size_t num = foodlist_count(fl);
+    food **foods = calloc(num + 1, sizeof(food *));
+    size_t strings = 0;
+    size_t i = 0;
+    for (foodlistnode *n = foodlist_get_data(fl); n && i < num; n = foodlistnode_get_next(n)) {
+        foods[i] = foodlistnode_get_item(n);
+        strings += strlen(food_get_name(foods[i])) + strlen(food_get_measure(foods[i])) + 2;
+        ++i;
+    }
+    num = i;
+    qsort(foods, num, sizeof(food *), snapshot_cmp);
+
+    size_t records = sizeof(struct snapshot_header) + num * sizeof(snapshot_food);
+    size_t size = records + strings;
+    char *buf = calloc(size, 1);
+    struct snapshot_header *hdr = (struct snapshot_header *) buf;
+    memcpy(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic));
+    hdr->num_foods = num;
+    hdr->size = size;
+    snapshot_food *rec = (snapshot_food *) (buf + sizeof(struct snapshot_header));
+    char *str = buf + records;
+    for (i = 0; i < num; ++i) {
+        const char *name = food_get_name(foods[i]);
+        const char *measure = food_get_measure(foods[i]);
+        rec[i].name = str - (char *) &rec[i];
+        str = stpcpy(str, name) + 1;
+        rec[i].measure = str - (char *) &rec[i];
+        str = stpcpy(str, measure) + 1;
+        rec[i].weight = food_get_weight(foods[i]);
+        rec[i].kcal = food_get_kcal(foods[i]);
+        rec[i].fat = food_get_fat(foods[i]);
+        rec[i].carbo = food_get_carbo(foods[i]);
+        rec[i].protein = food_get_protein(foods[i]);
+    }
+    free(foods);
+
+    /* the replaced snapshot is still mapped by readers, tell them about the new one after the rename */
+    struct snapshot_header *old = snapshot_map(path, true);
+    hdr->version = old ? old->version + 1 : 1;
+
+    char *tmp = malloc(strlen(path) + 5);
+    sprintf(tmp, "%s.tmp", path);
+    bool ok = false;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("cannot write file %s\n", tmp);
+    } else {
+        size_t num_w = 0;
+        while (num_w < size) {
+            ssize_t w = write(fd, buf + num_w, size - num_w);
+            if (w <= 0) {
+                break;
+            }
+            num_w += w;
+        }
+        close(fd);
+        ok = num_w == size && rename(tmp, path) == 0;
+        if (!ok) {
+            printf("cannot publish snapshot %s\n", path);
+            unlink(tmp);
+        }
+    }
+    if (old) {
+        if (ok) {
+            __atomic_store_n(&old->stale, 1, __ATOMIC_RELEASE);
+        }
+        munmap(old, old->size);
+    }
+    free(tmp);
+    free(buf);
+    return ok;
+}
+
+snapshot *snapshot_open(const char *path) {
+    struct snapshot_header *hdr = snapshot_map(path, false);
+    if (!hdr) {
+        return NULL;
+    }
+    snapshot *sn = malloc(sizeof(snapshot));
+    sn->path = strdup(path);
+    sn->hdr = hdr;
+    sn->foods = (const snapshot_food *) (hdr + 1);
+    return sn;
+}
+
+bool snapshot_refresh(snapshot *sn) {
+    if (!__atomic_load_n(&sn->hdr->stale, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    struct snapshot_header *hdr = snapshot_map(sn->path, false);
+    if (!hdr) {
+        return false;
+    }
+    munmap(sn->hdr, sn->hdr->size);
+    sn->hdr = hdr;
+    sn->foods = (const snapshot_food *) (hdr + 1);
+    return true;
+}
+
+unsigned long snapshot_version(snapshot *sn) {
+    return sn->hdr->version;
+}
+
+size_t snapshot_count(snapshot *sn) {
+    return sn->hdr->num_foods;
+}
+
+const snapshot_food **snapshot_find(snapshot *sn, const char *str, size_t *num) {
+    size_t max_items = 25;
+    const snapshot_food **ret = calloc(max_items, sizeof(snapshot_food *));
+    size_t len = strlen(str);
+    size_t lo = 0;
+    size_t hi = sn->hdr->num_foods;
+    *num = 0;
+    /* find the first food whose name does not sort before the search term */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strncasecmp(snapshot_food_get_name(&sn->foods[mid]), str, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (size_t i = lo; i < sn->hdr->num_foods; ++i) {
+        const snapshot_food *f = &sn->foods[i];
+        const char *name = snapshot_food_get_name(f);
+        if (strncasecmp(name, str, len)) {
+            break;
+        }
+        if (foodlist_matches(name, str)) {
+            if (*num == max_items) {
+                max_items *= 2;
+                ret = realloc(ret, max_items * sizeof(snapshot_food *));
+            }
+            ret[*num] = f;
+            *num += 1;
+        }
+    }
+    return ret;
+}
+
+const char *snapshot_food_get_name(const snapshot_food *f) {
+    return (const char *) f + f->name;
+}
+
+const char *snapshot_food_get_measure(const snapshot_food *f) {
+    return (const char *) f + f->measure;
+}
+
+int snapshot_food_get_weight(const snapshot_food *f) {
+    return f->weight;
+}
+
+int snapshot_food_get_kcal(const snapshot_food *f) {
+    return f->kcal;
+}
+
+int snapshot_food_get_fat(const snapshot_food *f) {
+    return f->fat;
+}
+
+int snapshot_food_get_carbo(const snapshot_food *f) {
+    return f->carbo;
+}
+
+int snapshot_food_get_protein(const snapshot_food *f) {
+    return f->protein;
+}
+
+void snapshot_close(snapshot *sn) {
+    munmap(sn->hdr, sn->hdr->size);
+    free(sn->path);
+    free(sn);
+}
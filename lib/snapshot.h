@@ -0,0 +1,167 @@
+/****************************************************************************
+* Copyright (C) 2014 by Lukas Elsner                                       *
+*                                                                          *
+* This file is part of calory-counter.                                     *
+*                                                                          *
+****************************************************************************/
+
+/**
+* @file snapshot.h
+* @author Lukas Elsner
+* @date 19-10-2026
+* @brief Header containing the public accessible snapshot methods.
+*
+* A snapshot is a read-only image of a foodlist in a file, which processes on the same machine map into
+* memory and search without talking to the server. The server publishes a new snapshot by writing a new
+* file and renaming it over the old one, so a mapped snapshot never changes under its readers. The old
+* file is marked as superseded, readers notice that with a single memory read in snapshot_refresh() and
+* map the new file. Foods are only added through the server.
+*
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "foodlist.h"
+
+/**
+*
+* @brief Forward declaration for snapshot
+*
+* */
+typedef struct snapshot snapshot;
+
+/**
+*
+* @brief Forward declaration for snapshot_food, a read-only view of a food inside a mapped snapshot
+*
+* */
+typedef struct snapshot_food snapshot_food;
+
+/**
+* @brief Method for writing a snapshot of a foodlist and publishing it atomically
+* @param foodlist* The foodlist to write
+* @param char* Path of the snapshot file
+* @return True, if the snapshot was published, false otherwise
+*
+* The version of the new snapshot is the one of the replaced file plus one.
+*
+* */
+bool snapshot_publish(foodlist *, const char *);
+
+/**
+* @brief Constructor for snapshot, maps a published snapshot file
+* @param char* Path of the snapshot file
+* @return A pointer to the snapshot structure, representing the created object, or NULL if the file is
+*         missing or not a valid snapshot
+*
+* After using this structure, it must be freed with snapshot_close(snapshot *)
+*
+* */
+snapshot *snapshot_open(const char *);
+
+/**
+* @brief Method for switching to the latest published snapshot
+* @param snapshot* Pointer to structure to work on
+* @return True, if a newer snapshot was mapped, false if the mapped one is still current or the new one
+*         could not be mapped
+*
+* This only costs a memory read while the mapped snapshot is current. Mapping a newer snapshot
+* invalidates all views returned by snapshot_find() before.
+*
+* */
+bool snapshot_refresh(snapshot *);
+
+/**
+* @brief Method for getting the version of the mapped snapshot
+* @param snapshot* Pointer to structure to work on
+* @return The version, it grows with every publication
+*
+* */
+unsigned long snapshot_version(snapshot *);
+
+/**
+* @brief Method for getting the number of foods in the mapped snapshot
+* @param snapshot* Pointer to structure to work on
+* @return The number of foods
+*
+* */
+size_t snapshot_count(snapshot *);
+
+/**
+* @brief Method for searching foods in the mapped snapshot, with the matching rules of foodlist_find()
+* @param snapshot* Pointer to structure to work on
+* @param char* The search term
+* @param size_t* Set to the number of found foods
+* @return Array of views sorted by name. The array must be freed by the caller, the views stay valid until
+*         the next snapshot_refresh() which maps a newer snapshot, or snapshot_close()
+*
+* */
+const snapshot_food **snapshot_find(snapshot *, const char *, size_t *);
+
+/**
+* @brief Method for getting the name of a food view
+* @param snapshot_food* The view
+* @return The name, owned by the snapshot
+*
+* */
+const char *snapshot_food_get_name(const snapshot_food *);
+
+/**
+* @brief Method for getting the measure of a food view
+* @param snapshot_food* The view
+* @return The measure, owned by the snapshot
+*
+* */
+const char *snapshot_food_get_measure(const snapshot_food *);
+
+/**
+* @brief Method for getting the weight of a food view
+* @param snapshot_food* The view
+* @return Weight value in g of the food
+*
+* */
+int snapshot_food_get_weight(const snapshot_food *);
+
+/**
+* @brief Method for getting the kCal of a food view
+* @param snapshot_food* The view
+* @return kCal value of the food
+*
+* */
+int snapshot_food_get_kcal(const snapshot_food *);
+
+/**
+* @brief Method for getting the fat of a food view
+* @param snapshot_food* The view
+* @return Fat value in g of the food
+*
+* */
+int snapshot_food_get_fat(const snapshot_food *);
+
+/**
+* @brief Method for getting the carbo of a food view
+* @param snapshot_food* The view
+* @return Carbo value in g of the food
+*
+* */
+int snapshot_food_get_carbo(const snapshot_food *);
+
+/**
+* @brief Method for getting the protein of a food view
+* @param snapshot_food* The view
+* @return Protein value in g of the food
+*
+* */
+int snapshot_food_get_protein(const snapshot_food *);
+
+/**
+* @brief Destructor for snapshot, unmaps the snapshot file
+* @param snapshot* Pointer to structure to be freed
+*
+* */
+void snapshot_close(snapshot *);
+
+#endif /* SNAPSHOT_H */
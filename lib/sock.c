@@ -18,45 +18,91 @@
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "lz.h"
 #include "sock.h"
 
+/**
+* @brief Function called with the phases of acknowledged writes, NULL if they are not timed
+*
+*/
+static sock_hook sock_phase_hook = NULL;
+
+/**
+* @brief Helper function to get the monotonic time in nanoseconds
+* @return Nanoseconds since an arbitrary point in time
+*
+* */
+static uint64_t sock_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void sock_set_hook(sock_hook hook) {
+    sock_phase_hook = hook;
+}
+
 
 bool sock_write(int socket, char *data) {
+    return sock_write_status(socket, data, NULL) == SOCK_OK;
+}
+
+sock_status sock_write_status(int socket, char *data, unsigned int *retry_ms) {
     char buf[BUF_LEN] = {0};
     char re[RE_LEN] = {0};
     snprintf(buf, BUF_LEN, "%s", data);
+    sock_hook hook = sock_phase_hook;
+    uint64_t start = hook ? sock_now() : 0;
     int num_w = write(socket, buf, BUF_LEN);
     if (num_w <= 0) {
         /* if we could not write to socket, something went wrong */
-        return false;
+        return SOCK_ERROR;
     }
     while (num_w != BUF_LEN) {
         /* write as long as all expexted bytes are arrived */
         int w = write(socket, buf + num_w, BUF_LEN - num_w);
         if (w < 0) {
             /* if we could not write to socket, something went wrong */
-            return false;
+            return SOCK_ERROR;
         }
         num_w += w;
     }
+    uint64_t sent = hook ? sock_now() : 0;
+    if (hook) {
+        hook("send", start, sent);
+    }
     /* repeat the above procedure for reading and await an ACK as answer */
     int num_r = read(socket, re, RE_LEN);
-    if (num_r < 0) {
-        return false;
+    if (num_r <= 0) {
+        return SOCK_ERROR;
     }
     while (num_r != RE_LEN) {
         int r = read(socket, re + num_r, RE_LEN - num_r);
-        if (r < 0) {
-            return false;
+        if (r <= 0) {
+            return SOCK_ERROR;
         }
         num_r += r;
     }
+    re[RE_LEN - 1] = 0;
+    if (hook) {
+        hook("ack wait", sent, sock_now());
+    }
     if (!strcmp(re, "ACK")) {
-        return true;
+        return SOCK_OK;
+    } else if (!strncmp(re, "BUSY:", 5)) {
+        /* server is over capacity, it closes the connection after this answer */
+        if (retry_ms) {
+            *retry_ms = atoi(re + 5);
+        }
+        return SOCK_BUSY;
     } else {
         /* this should never happen */
         assert(true);
-        return false;
+        return SOCK_ERROR;
     }
 }
 
@@ -81,6 +127,18 @@ size_t sock_read(int socket, char *data) {
     return num_r;
 }
 
+sock_status sock_send_status(int socket, const char *type, char *data, unsigned int *retry_ms) {
+    char buf[BUF_LEN] = {0};
+    snprintf(buf, BUF_LEN, "%s%s", type, data);
+    return sock_write_status(socket, buf, retry_ms);
+}
+
+bool sock_send_busy(int socket, unsigned int retry_ms) {
+    char re[RE_LEN] = {0};
+    snprintf(re, RE_LEN, "BUSY:%u", retry_ms);
+    return send(socket, re, RE_LEN, MSG_DONTWAIT) == RE_LEN;
+}
+
 bool sock_send_food(int socket, char *data) {
     char buf[BUF_LEN] = {0};
     snprintf(buf, BUF_LEN, "FOOD:%s", data);
@@ -98,3 +156,177 @@ bool sock_send_count(int socket, char *data) {
     snprintf(buf, BUF_LEN, "COUNT:%s", data);
     return sock_write(socket, buf);
 }
+
+void sock_frame_encode(char *hdr, size_t len) {
+    unsigned char *h = (unsigned char *) hdr;
+    h[0] = (len >> 24) & 0x7f;
+    h[1] = (len >> 16) & 0xff;
+    h[2] = (len >> 8) & 0xff;
+    h[3] = len & 0xff;
+}
+
+size_t sock_frame_decode(const char *hdr) {
+    const unsigned char *h = (const unsigned char *) hdr;
+    return ((size_t) (h[0] & 0x7f) << 24) | ((size_t) h[1] << 16) | ((size_t) h[2] << 8) | h[3];
+}
+
+bool sock_frame_is_compressed(const char *hdr) {
+    return ((const unsigned char *) hdr)[0] & 0x80;
+}
+
+size_t sock_frame_pack(char *frame, const char *data, size_t len, bool compress) {
+    if (compress && len >= SOCK_LZ_THRESHOLD) {
+        /* only keep the compressed payload if it is shorter */
+        size_t clen = lz_compress(data, len, frame + SOCK_FRAME_HEADER, len - 1);
+        if (clen > 0) {
+            sock_frame_encode(frame, clen);
+            frame[0] |= 0x80;
+            return SOCK_FRAME_HEADER + clen;
+        }
+    }
+    sock_frame_encode(frame, len);
+    memcpy(frame + SOCK_FRAME_HEADER, data, len);
+    return SOCK_FRAME_HEADER + len;
+}
+
+ssize_t sock_frame_inflate(const char *payload, size_t len, char *data) {
+    ssize_t n = lz_decompress(payload, len, data, SOCK_FRAME_MAX);
+    if (n < 0) {
+        return -1;
+    }
+    data[n] = 0;
+    return n;
+}
+
+/**
+* @brief Helper function writing a buffer completely
+* @param int The socket to communicate with
+* @param char* The data to write
+* @param size_t Length of the data
+* @return True, if all bytes were written, false otherwise
+* */
+static bool sock_write_all(int socket, const char *data, size_t len) {
+    size_t num_w = 0;
+    while (num_w < len) {
+        ssize_t w = write(socket, data + num_w, len - num_w);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return false;
+        }
+        num_w += w;
+    }
+    return true;
+}
+
+/**
+* @brief Helper function reading a buffer completely
+* @param int The socket to communicate with
+* @param char* Buffer for the data
+* @param size_t Number of bytes to read
+* @param bool True, if a receive timeout before the first byte should abort the read
+* @return Number of read bytes, 0 if the connection was closed, -1 on errors or timeout
+* */
+static ssize_t sock_read_all(int socket, char *data, size_t len, bool may_time_out) {
+    size_t num_r = 0;
+    while (num_r < len) {
+        ssize_t r = read(socket, data + num_r, len - num_r);
+        if (r < 0 && (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && (num_r > 0 || !may_time_out)))) {
+            /* never give up in the middle of a frame, the stream would lose its synchronisation */
+            continue;
+        }
+        if (r <= 0) {
+            return r;
+        }
+        num_r += r;
+    }
+    return num_r;
+}
+
+bool sock_write_packed(int socket, const char *frame, size_t len) {
+    return sock_write_all(socket, frame, len);
+}
+
+bool sock_write_frame(int socket, const char *data, size_t len, bool compress) {
+    char buf[SOCK_FRAME_HEADER + SOCK_FRAME_MAX];
+    if (len > SOCK_FRAME_MAX) {
+        return false;
+    }
+    return sock_write_all(socket, buf, sock_frame_pack(buf, data, len, compress));
+}
+
+ssize_t sock_read_frame(int socket, char *data) {
+    char hdr[SOCK_FRAME_HEADER];
+    ssize_t r = sock_read_all(socket, hdr, SOCK_FRAME_HEADER, true);
+    if (r <= 0) {
+        return r;
+    }
+    size_t len = sock_frame_decode(hdr);
+    if (len > SOCK_FRAME_MAX) {
+        return -1;
+    }
+    if (len > 0) {
+        r = sock_read_all(socket, data, len, false);
+        if (r <= 0) {
+            return r == 0 ? 0 : -1;
+        }
+    }
+    data[len] = 0;
+    if (sock_frame_is_compressed(hdr)) {
+        char *payload = malloc(len);
+        memcpy(payload, data, len);
+        ssize_t n = sock_frame_inflate(payload, len, data);
+        free(payload);
+        if (n < 0) {
+            return -1;
+        }
+        len = n;
+    }
+    /* an empty frame is valid, but must not be confused with a closed connection */
+    return len > 0 ? (ssize_t) len : -1;
+}
+
+char *sock_parse_tag(char *msg, unsigned long *id) {
+    if (*msg != '#') {
+        return NULL;
+    }
+    char *end = NULL;
+    *id = strtoul(msg + 1, &end, 10);
+    if (end == msg + 1 || *end != ' ') {
+        return NULL;
+    }
+    return end + 1;
+}
+
+bool sock_has_feature(const char *list, const char *feature) {
+    size_t len = strlen(feature);
+    const char *p = list;
+    while (p && *p) {
+        const char *end = strchr(p, ',');
+        size_t n = end ? (size_t) (end - p) : strlen(p);
+        /* ignore trailing whitespace, e.g. a newline */
+        while (n > 0 && (p[n - 1] == '\n' || p[n - 1] == ' ')) {
+            n--;
+        }
+        if (n == len && !strncmp(p, feature, len)) {
+            return true;
+        }
+        p = end ? end + 1 : NULL;
+    }
+    return false;
+}
+
+void sock_negotiate(const char *offered, char *accepted, size_t len) {
+    char supported[] = SOCK_FEATURES;
+    char *save = NULL;
+    *accepted = 0;
+    for (char *f = strtok_r(supported, ",", &save); f; f = strtok_r(NULL, ",", &save)) {
+        if (sock_has_feature(offered, f)) {
+            if (*accepted) {
+                strncat(accepted, ",", len - strlen(accepted) - 1);
+            }
+            strncat(accepted, f, len - strlen(accepted) - 1);
+        }
+    }
+}
@@ -14,15 +14,60 @@
  * Every write is BUF_LEN bytes long and has to be acknowledged with a RE_LEN bytes long answer
  * containing ACK or NACK.
  *
+ * A client may switch a connection to pipelined mode by sending "HELLO:pipeline". After the server
+ * answered with "HELLO:pipeline", both sides send length prefixed frames without acknowledgement.
+ * A frame carries one or more newline terminated messages, every message is tagged with the id of
+ * the request it belongs to, e.g. "#7 SEARCH:Milk". The server answers with messages tagged with the
+ * same id ("#7 COUNT:2", "#7 FOOD:..."), the answers of different requests may arrive in any order.
+ * A search may ask for one page of the results with "SEARCH?limit=20&offset=0:Milk". If there are more
+ * results, the answer starts with "COUNT:20;next=<cursor>" and the next page is requested with
+ * "SEARCH?limit=20&cursor=<cursor>:Milk". The cursor is opaque to the client.
+ * If both sides accepted the "lz" feature, the highest bit of a frame header marks a payload compressed
+ * with lz_compress(). Frames are only compressed if they are large and actually shrink.
+ *
  */
 
 #ifndef SOCK_H
 #define SOCK_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
 
 #define BUF_LEN 4096
 #define RE_LEN 32
+#define SOCK_FRAME_HEADER 4 /**< Length of the header of a pipelined frame */
+#define SOCK_FRAME_MAX 65536 /**< Maximum payload length of a pipelined frame */
+#define SOCK_PIPELINE "pipeline" /**< Feature name of the pipelined mode in HELLO messages */
+#define SOCK_LZ "lz" /**< Feature name of compressed pipelined frames in HELLO messages */
+#define SOCK_FEATURES SOCK_PIPELINE "," SOCK_LZ /**< Comma separated list of all features this implementation supports */
+#define SOCK_LZ_THRESHOLD 256 /**< Payloads shorter than this are never compressed */
+
+/**
+ * @brief Result of sending a frame
+ *
+ * */
+typedef enum sock_status {
+    SOCK_OK, /**< The frame was acknowledged */
+    SOCK_ERROR, /**< The communication failed */
+    SOCK_BUSY /**< The server is over capacity and rejected the connection */
+} sock_status;
+
+/**
+ * @brief Function called with the phases of acknowledged writes, e.g. for tracing
+ *
+ * The arguments are the name of the phase ("send" or "ack wait") and its start and end in nanoseconds of
+ * CLOCK_MONOTONIC.
+ *
+ * */
+typedef void (*sock_hook)(const char *, uint64_t, uint64_t);
+
+/**
+* @brief Method for setting the function called with the phases of acknowledged writes of all sockets
+* @param sock_hook The function, or NULL to disable timing the phases
+* */
+void sock_set_hook(sock_hook hook);
 
 /**
 * @brief Lower level function to send data to the other endpoint
@@ -32,6 +77,15 @@
 * */
 bool sock_write(int socket, char *data);
 
+/**
+* @brief Lower level function to send data to the other endpoint, reporting why it failed
+* @param int The socket to communicate with
+* @param char* The data to send
+* @param unsigned int* If not NULL and the server answered BUSY, set to the time in ms after which a retry makes sense
+* @return SOCK_OK if the frame was acknowledged, SOCK_BUSY if the server rejected it, SOCK_ERROR otherwise
+* */
+sock_status sock_write_status(int socket, char *data, unsigned int *retry_ms);
+
 /**
 * @brief Function to read data from the other endpoint
 * @param int The socket to communicate with
@@ -56,6 +110,26 @@ bool sock_send_food(int socket, char *data);
 * */
 bool sock_send_search(int socket, char *data);
 
+/**
+* @brief Higher level function to send a request of any type to the other endpoint
+* @param int The socket to communicate with
+* @param char* The message type including the colon, e.g. "SEARCH:"
+* @param char* The payload to send
+* @param unsigned int* If not NULL and the server answered BUSY, set to the time in ms after which a retry makes sense
+* @return SOCK_OK if the frame was acknowledged, SOCK_BUSY if the server rejected it, SOCK_ERROR otherwise
+* */
+sock_status sock_send_status(int socket, const char *type, char *data, unsigned int *retry_ms);
+
+/**
+* @brief Function to reject a freshly accepted connection because the server is over capacity
+* @param int The socket to communicate with
+* @param unsigned int Time in ms after which the client should retry
+* @return True, if the answer could be sent without blocking, false otherwise
+*
+* The client receives the BUSY answer instead of the acknowledgement of its first frame.
+* */
+bool sock_send_busy(int socket, unsigned int retry_ms);
+
 /**
 * @brief Higher level function to send the number of found items to the other endpoint
 * @param int The socket to communicate with
@@ -64,5 +138,96 @@ bool sock_send_search(int socket, char *data);
 * */
 bool sock_send_count(int socket, char *data);
 
+/**
+* @brief Function to send a pipelined frame to the other endpoint
+* @param int The socket to communicate with
+* @param char* The payload to send
+* @param size_t Length of the payload, at most SOCK_FRAME_MAX
+* @param bool True, if the payload may be compressed
+* @return True, if the communication was successful, false otherwise
+* */
+bool sock_write_frame(int socket, const char *data, size_t len, bool compress);
+
+/**
+* @brief Function to send frames built with sock_frame_pack() to the other endpoint
+* @param int The socket to communicate with
+* @param char* The frames
+* @param size_t Length of the frames including their headers
+* @return True, if the communication was successful, false otherwise
+* */
+bool sock_write_packed(int socket, const char *frame, size_t len);
+
+/**
+* @brief Function to read a pipelined frame from the other endpoint
+* @param int The socket to communicate with
+* @param char* A pointer to a buffer for the payload. Must be at least SOCK_FRAME_MAX + 1 bytes long.
+* @return Length of the payload, which is zero terminated and decompressed if necessary. 0 if the connection was closed, -1 on errors or
+*         if a receive timeout expired before the frame started.
+* */
+ssize_t sock_read_frame(int socket, char *data);
+
+/**
+* @brief Function to encode the header of a pipelined frame
+* @param char* Buffer for the header, must be SOCK_FRAME_HEADER bytes long
+* @param size_t Length of the payload
+* */
+void sock_frame_encode(char *hdr, size_t len);
+
+/**
+* @brief Function to decode the header of a pipelined frame
+* @param char* The SOCK_FRAME_HEADER bytes long header
+* @return Length of the payload
+* */
+size_t sock_frame_decode(const char *hdr);
+
+/**
+* @brief Function to check if the header of a pipelined frame marks a compressed payload
+* @param char* The SOCK_FRAME_HEADER bytes long header
+* @return True, if the payload is compressed, false otherwise
+* */
+bool sock_frame_is_compressed(const char *hdr);
+
+/**
+* @brief Function to build a complete pipelined frame, compressing the payload if it pays off
+* @param char* Buffer for the frame, must be at least SOCK_FRAME_HEADER + len bytes long
+* @param char* The payload
+* @param size_t Length of the payload, at most SOCK_FRAME_MAX
+* @param bool True, if the payload may be compressed
+* @return Length of the frame including its header
+* */
+size_t sock_frame_pack(char *frame, const char *data, size_t len, bool compress);
+
+/**
+* @brief Function to decompress the payload of a compressed pipelined frame
+* @param char* The compressed payload
+* @param size_t Length of the compressed payload
+* @param char* Buffer for the payload. Must be at least SOCK_FRAME_MAX + 1 bytes long.
+* @return Length of the payload, which is zero terminated, or -1 if it is malformed
+* */
+ssize_t sock_frame_inflate(const char *payload, size_t len, char *data);
+
+/**
+* @brief Function to split a pipelined message into request id and body
+* @param char* The message, e.g. "#7 SEARCH:Milk"
+* @param unsigned long* Pointer to store the request id
+* @return Pointer to the body of the message, or NULL if the message is not tagged
+* */
+char *sock_parse_tag(char *msg, unsigned long *id);
+
+/**
+* @brief Function to check if a comma separated feature list contains a feature
+* @param char* The feature list, e.g. "pipeline"
+* @param char* The feature to look for
+* @return True, if the feature is contained in the list, false otherwise
+* */
+bool sock_has_feature(const char *list, const char *feature);
+
+/**
+* @brief Function to select the features of a HELLO request which are supported by this implementation
+* @param char* The offered comma separated feature list
+* @param char* Buffer for the accepted comma separated feature list
+* @param size_t Length of the buffer
+* */
+void sock_negotiate(const char *offered, char *accepted, size_t len);
 
-#endif /* TOOLS_H */
+#endif /* SOCK_H */
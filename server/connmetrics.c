@@ -0,0 +1,34 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file connmetrics.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the methods of the connection level metrics.
+ *
+ */
+#include "connmetrics.h"
+
+void connmetrics_read(connmetrics *m, connmetrics *out)
+{
+  out->accepted = __atomic_load_n(&m->accepted, __ATOMIC_RELAXED);
+  out->rejected = __atomic_load_n(&m->rejected, __ATOMIC_RELAXED);
+  out->closed = __atomic_load_n(&m->closed, __ATOMIC_RELAXED);
+  out->timed_out = __atomic_load_n(&m->timed_out, __ATOMIC_RELAXED);
+  out->active = __atomic_load_n(&m->active, __ATOMIC_RELAXED);
+  out->queued = __atomic_load_n(&m->queued, __ATOMIC_RELAXED);
+  out->queue_high_water = __atomic_load_n(&m->queue_high_water, __ATOMIC_RELAXED);
+}
+
+void connmetrics_print(connmetrics *m, FILE *out)
+{
+  connmetrics c;
+  connmetrics_read(m, &c);
+  fprintf(out, "connections: accepted %zu, rejected %zu, closed %zu, timed out %zu, active %zu, queued %zu, "
+          "queue high water %zu\n", c.accepted, c.rejected, c.closed, c.timed_out, c.active, c.queued, c.queue_high_water);
+}
@@ -0,0 +1,54 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file connmetrics.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the connection level metrics of the server.
+ *
+ * The counters are updated by the I/O backends with atomic operations and can be read at any time.
+ *
+ */
+#ifndef CONNMETRICS_H
+#define CONNMETRICS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ *
+ * @brief Connection level counters
+ *
+ * */
+typedef struct connmetrics {
+  size_t accepted; /**< Number of accepted connections */
+  size_t rejected; /**< Number of connections rejected with BUSY */
+  size_t closed; /**< Number of served and closed connections */
+  size_t timed_out; /**< Number of connections closed because they missed a deadline */
+  size_t active; /**< Number of connections currently being served */
+  size_t queued; /**< Number of accepted connections waiting for a connection thread */
+  size_t queue_high_water; /**< Highest number of queued connections seen */
+} connmetrics;
+
+/**
+* @brief Method for taking a consistent enough copy of the counters
+* @param connmetrics* Counters to read
+* @param connmetrics* Structure the values are copied to
+*
+* */
+void connmetrics_read(connmetrics *, connmetrics *);
+
+/**
+* @brief Method for printing the counters in one line
+* @param connmetrics* Counters to print
+* @param FILE* Stream to print to
+*
+* */
+void connmetrics_print(connmetrics *, FILE *);
+
+#endif /* CONNMETRICS_H */
@@ -0,0 +1,447 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file dataset.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the dataset structure and its member methods.
+ *
+ * Requests count the references to the current foodlist under a mutex which is held for a few instructions
+ * only. A reload swaps the current foodlist under this mutex and waits until the references to the replaced
+ * one dropped to zero. Reloads and saves are serialized by their own mutex, additions only wait for the
+ * swap itself, not for loading the file.
+ *
+ * Lock-free readers, like the event loops of the per-core backend, do not count references. Every such
+ * thread publishes the foodlist it works on in a slot of its own, and reads the current foodlist and its
+ * generation under a sequence counter which is odd during a swap. A reload waits until no slot holds the
+ * replaced foodlist anymore.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "logger.h"
+#include "dataset.h"
+
+#define DATASET_READER_POLL_NS 1000000 /**< Interval of checking whether lock-free readers left a replaced foodlist */
+
+/**
+ * @brief The foodlist a thread reading without locks works on
+ *
+ */
+struct dataset_reader {
+  foodlist *foodlist; /**< Foodlist the thread works on, NULL if none, only written by the thread */
+  bool owned; /**< Whether a running thread reads through the slot, taken under reader_mutex */
+  struct dataset_reader *next; /**< Next slot */
+};
+
+/**
+ * @brief dataset structure for representing the foodlist of the server
+ *
+ */
+struct dataset {
+  char *file; /**< Name of the csv file, NULL if the foods come from elsewhere */
+  struct stat loaded; /**< State of the csv file when it was loaded */
+  foodlist *current; /**< Foodlist new requests work on */
+  size_t refs; /**< Number of requests working on current */
+  foodlist *replaced; /**< Foodlist replaced by a running reload, NULL if there is none */
+  size_t replaced_refs; /**< Number of requests still working on replaced */
+  unsigned long generation; /**< Generation of current, it grows with every swap */
+  pthread_mutex_t mutex; /**< Mutex protecting current, replaced and their references */
+  pthread_cond_t released; /**< Condition signalled when replaced was released by all requests */
+  pthread_mutex_t add_mutex; /**< Mutex serializing additions and the swap of current */
+  pthread_mutex_t reload_mutex; /**< Mutex serializing reloads and saves */
+  char **added; /**< Serialized foods added by clients since the file was written */
+  size_t num_added; /**< Number of entries in added */
+  size_t cap_added; /**< Allocated entries of added */
+  querycache *querycache; /**< Cache cleared on reload, NULL if there is none */
+  unsigned long seq; /**< Incremented before and after current and generation change, odd during a swap */
+  pthread_key_t reader; /**< Key for finding the reader slot of the calling thread */
+  pthread_mutex_t reader_mutex; /**< Mutex protecting the list of reader slots */
+  struct dataset_reader *readers; /**< Slots of all threads which ever read without locks */
+};
+
+/**
+ * @brief Helper function to get the state of the csv file
+ * @param dataset* Pointer to structure to work on
+ * @param stat* Set to the state of the file
+ * @return True, if the file exists, false otherwise
+ *
+ * */
+static bool dataset_stat(dataset *ds, struct stat *st)
+{
+  if(!ds->file || stat(ds->file, st) < 0) {
+    memset(st, 0, sizeof(struct stat));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Helper function to check whether the csv file was changed since it was loaded
+ * @param dataset* Pointer to structure to work on
+ * @return True, if the file was changed, false otherwise
+ *
+ * */
+static bool dataset_changed(dataset *ds)
+{
+  struct stat st;
+  if(!dataset_stat(ds, &st)) {
+    return false;
+  }
+  return st.st_ino != ds->loaded.st_ino || st.st_size != ds->loaded.st_size
+         || st.st_mtim.tv_sec != ds->loaded.st_mtim.tv_sec || st.st_mtim.tv_nsec != ds->loaded.st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Helper function to check whether a foodlist contains a food of the given name
+ * @param foodlist* The foodlist
+ * @param char* The name, compared case insensitively
+ * @return True, if there is such a food, false otherwise
+ *
+ * */
+static bool dataset_contains(foodlist *fl, char *name)
+{
+  size_t n = 0;
+  food **foods = foodlist_find(fl, name, &n);
+  bool ret = false;
+  for(size_t i = 0; i < n && !ret; ++i) {
+    ret = !strcasecmp(food_get_name(foods[i]), name);
+  }
+  free(foods);
+  return ret;
+}
+
+/**
+ * @brief Helper function to make a foodlist the current one, the add_mutex and reload_mutex must be held
+ * @param dataset* Pointer to structure to work on
+ * @param foodlist* The new foodlist
+ *
+ * */
+static void dataset_swap(dataset *ds, foodlist *fl)
+{
+  pthread_mutex_lock(&ds->mutex);
+  __atomic_add_fetch(&ds->seq, 1, __ATOMIC_SEQ_CST);
+  ds->replaced = ds->current;
+  ds->replaced_refs = ds->refs;
+  __atomic_store_n(&ds->current, fl, __ATOMIC_SEQ_CST);
+  ds->refs = 0;
+  __atomic_store_n(&ds->generation, ds->generation + 1, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&ds->seq, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&ds->mutex);
+}
+
+/**
+ * @brief Checks whether a lock-free reader still works on a foodlist
+ * @param dataset* Pointer to structure to work on
+ * @param foodlist* The foodlist
+ * @return True, if a reader slot holds the foodlist
+ *
+ * */
+static bool dataset_is_read(dataset *ds, foodlist *fl)
+{
+  bool ret = false;
+  pthread_mutex_lock(&ds->reader_mutex);
+  for(struct dataset_reader *rd = ds->readers; rd && !ret; rd = rd->next) {
+    ret = __atomic_load_n(&rd->foodlist, __ATOMIC_SEQ_CST) == fl;
+  }
+  pthread_mutex_unlock(&ds->reader_mutex);
+  return ret;
+}
+
+/**
+ * @brief Releases the reader slot of an exiting thread, so it is reused by the next new thread
+ * @param void* The slot
+ *
+ * */
+static void dataset_release_reader(void *arg)
+{
+  struct dataset_reader *rd = (struct dataset_reader *)arg;
+  __atomic_store_n(&rd->foodlist, NULL, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&rd->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Finds the reader slot of the calling thread, taking a free one or creating one on its first read
+ * @param dataset* Pointer to structure to work on
+ * @return The slot
+ *
+ * */
+static struct dataset_reader *dataset_reader_of(dataset *ds)
+{
+  struct dataset_reader *rd = pthread_getspecific(ds->reader);
+  if(rd) {
+    return rd;
+  }
+  pthread_mutex_lock(&ds->reader_mutex);
+  for(rd = ds->readers; rd; rd = rd->next) {
+    if(!__atomic_load_n(&rd->owned, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  if(!rd) {
+    rd = (struct dataset_reader *)malloc(sizeof(struct dataset_reader));
+    rd->foodlist = NULL;
+    rd->next = ds->readers;
+    ds->readers = rd;
+  }
+  __atomic_store_n(&rd->owned, true, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&ds->reader_mutex);
+  pthread_setspecific(ds->reader, rd);
+  return rd;
+}
+
+/**
+ * @brief Helper function to free the replaced foodlist, once all requests released it
+ * @param dataset* Pointer to structure to work on
+ *
+ * */
+static void dataset_retire(dataset *ds)
+{
+  /* searches started before have read an older cache version, their replies are not cached */
+  if(ds->querycache) {
+    querycache_clear(ds->querycache);
+  }
+  pthread_mutex_lock(&ds->mutex);
+  while(ds->replaced_refs > 0) {
+    pthread_cond_wait(&ds->released, &ds->mutex);
+  }
+  foodlist *old = ds->replaced;
+  ds->replaced = NULL;
+  pthread_mutex_unlock(&ds->mutex);
+  /* lock-free readers do not signal, they finish their request within a few microseconds */
+  struct timespec poll = { 0, DATASET_READER_POLL_NS };
+  while(dataset_is_read(ds, old)) {
+    nanosleep(&poll, NULL);
+  }
+  foodlist_destroy(old);
+}
+
+dataset *dataset_init(const char *file)
+{
+  dataset *ds = (dataset *)malloc(sizeof(dataset));
+  ds->file = file ? strdup(file) : NULL;
+  /* taken before loading, a change while loading is noticed later on */
+  dataset_stat(ds, &ds->loaded);
+  ds->current = file ? foodlist_init_csv(ds->file) : foodlist_init();
+  ds->refs = 0;
+  ds->replaced = NULL;
+  ds->replaced_refs = 0;
+  /* generations of different runs of the server differ as well */
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ds->generation = (unsigned long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  pthread_mutex_init(&ds->mutex, NULL);
+  pthread_cond_init(&ds->released, NULL);
+  pthread_mutex_init(&ds->add_mutex, NULL);
+  pthread_mutex_init(&ds->reload_mutex, NULL);
+  ds->cap_added = 16;
+  ds->added = calloc(ds->cap_added, sizeof(char *));
+  ds->num_added = 0;
+  ds->querycache = NULL;
+  ds->seq = 0;
+  pthread_key_create(&ds->reader, dataset_release_reader);
+  pthread_mutex_init(&ds->reader_mutex, NULL);
+  ds->readers = NULL;
+  return ds;
+}
+
+void dataset_set_querycache(dataset *ds, querycache *qc)
+{
+  ds->querycache = qc;
+}
+
+foodlist *dataset_acquire(dataset *ds)
+{
+  return dataset_acquire_generation(ds, NULL);
+}
+
+foodlist *dataset_acquire_generation(dataset *ds, unsigned long *generation)
+{
+  pthread_mutex_lock(&ds->mutex);
+  foodlist *fl = ds->current;
+  ds->refs++;
+  if(generation) {
+    *generation = ds->generation;
+  }
+  pthread_mutex_unlock(&ds->mutex);
+  return fl;
+}
+
+foodlist *dataset_acquire_lockfree(dataset *ds, unsigned long *generation)
+{
+  struct dataset_reader *rd = dataset_reader_of(ds);
+  foodlist *fl;
+  unsigned long seq;
+  do {
+    seq = __atomic_load_n(&ds->seq, __ATOMIC_SEQ_CST);
+    fl = __atomic_load_n(&ds->current, __ATOMIC_SEQ_CST);
+    if(generation) {
+      *generation = __atomic_load_n(&ds->generation, __ATOMIC_SEQ_CST);
+    }
+    /* published before checking the sequence again, a swap after the check waits for the slot */
+    __atomic_store_n(&rd->foodlist, fl, __ATOMIC_SEQ_CST);
+  } while((seq & 1) || __atomic_load_n(&ds->seq, __ATOMIC_SEQ_CST) != seq);
+  return fl;
+}
+
+void dataset_release_lockfree(dataset *ds, foodlist *fl)
+{
+  struct dataset_reader *rd = pthread_getspecific(ds->reader);
+  if(rd && rd->foodlist == fl) {
+    __atomic_store_n(&rd->foodlist, NULL, __ATOMIC_RELEASE);
+  }
+}
+
+void dataset_release(dataset *ds, foodlist *fl)
+{
+  pthread_mutex_lock(&ds->mutex);
+  if(fl == ds->current) {
+    ds->refs--;
+  } else if(--ds->replaced_refs == 0) {
+    pthread_cond_signal(&ds->released);
+  }
+  pthread_mutex_unlock(&ds->mutex);
+}
+
+void dataset_add(dataset *ds, food *f)
+{
+  char *s = food_serialize(f);
+  pthread_mutex_lock(&ds->add_mutex);
+  foodlist_append(ds->current, &f);
+  if(ds->num_added == ds->cap_added) {
+    ds->cap_added *= 2;
+    ds->added = realloc(ds->added, ds->cap_added * sizeof(char *));
+  }
+  ds->added[ds->num_added++] = s;
+  pthread_mutex_unlock(&ds->add_mutex);
+}
+
+void dataset_apply(dataset *ds, food **foods, size_t num)
+{
+  pthread_mutex_lock(&ds->add_mutex);
+  for(size_t i = 0; i < num; ++i) {
+    food *f = foods[i];
+    foodlist_append(ds->current, &f);
+    if(ds->querycache) {
+      /* the current foodlist is not freed while add_mutex is held */
+      querycache_invalidate(ds->querycache, food_get_name(f));
+    }
+  }
+  pthread_mutex_unlock(&ds->add_mutex);
+}
+
+void dataset_replace(dataset *ds, foodlist *fl)
+{
+  pthread_mutex_lock(&ds->reload_mutex);
+  pthread_mutex_lock(&ds->add_mutex);
+  dataset_swap(ds, fl);
+  pthread_mutex_unlock(&ds->add_mutex);
+  dataset_retire(ds);
+  pthread_mutex_unlock(&ds->reload_mutex);
+}
+
+bool dataset_reload(dataset *ds)
+{
+  if(!ds->file) {
+    LOGGER_LOG(LOGGER_ERROR, "There is no file to reload the foods from");
+    return false;
+  }
+  pthread_mutex_lock(&ds->reload_mutex);
+  struct stat st;
+  if(!dataset_stat(ds, &st)) {
+    LOGGER_LOG(LOGGER_WARN, "cannot read file %s, keeping %d foods", ds->file, foodlist_count(ds->current));
+    pthread_mutex_unlock(&ds->reload_mutex);
+    return false;
+  }
+  foodlist *fl = foodlist_init_csv(ds->file);
+
+  /* foods added while loading are carried over as well, so additions wait for the swap */
+  pthread_mutex_lock(&ds->add_mutex);
+  size_t kept = 0;
+  for(size_t i = 0; i < ds->num_added; ++i) {
+    char *line = strdup(ds->added[i]);
+    food *f = food_deserialize(line);
+    free(line);
+    if(dataset_contains(fl, food_get_name(f))) {
+      /* the new file has its own version of this food */
+      food_destroy(f);
+      free(ds->added[i]);
+    } else {
+      foodlist_append(fl, &f);
+      ds->added[kept++] = ds->added[i];
+    }
+  }
+  ds->num_added = kept;
+  dataset_swap(ds, fl);
+  pthread_mutex_unlock(&ds->add_mutex);
+  ds->loaded = st;
+  LOGGER_LOG(LOGGER_INFO, "Reloaded %d foods from %s, %zu added foods kept", foodlist_count(fl), ds->file, kept);
+  dataset_retire(ds);
+  pthread_mutex_unlock(&ds->reload_mutex);
+  return true;
+}
+
+unsigned long dataset_generation(dataset *ds)
+{
+  pthread_mutex_lock(&ds->mutex);
+  unsigned long ret = ds->generation;
+  pthread_mutex_unlock(&ds->mutex);
+  return ret;
+}
+
+void dataset_save(dataset *ds)
+{
+  pthread_mutex_lock(&ds->add_mutex);
+  size_t num_added = ds->num_added;
+  pthread_mutex_unlock(&ds->add_mutex);
+  if(num_added == 0) {
+    /* the file holds all foods already, it may have been updated since */
+    return;
+  }
+  if(dataset_changed(ds)) {
+    LOGGER_LOG(LOGGER_INFO, "File %s was changed, loading it before saving", ds->file);
+    dataset_reload(ds);
+  }
+  pthread_mutex_lock(&ds->reload_mutex);
+  pthread_mutex_lock(&ds->add_mutex);
+  foodlist_save(ds->current);
+  for(size_t i = 0; i < ds->num_added; ++i) {
+    free(ds->added[i]);
+  }
+  ds->num_added = 0;
+  dataset_stat(ds, &ds->loaded);
+  pthread_mutex_unlock(&ds->add_mutex);
+  pthread_mutex_unlock(&ds->reload_mutex);
+}
+
+void dataset_destroy(dataset *ds)
+{
+  for(size_t i = 0; i < ds->num_added; ++i) {
+    free(ds->added[i]);
+  }
+  free(ds->added);
+  foodlist_destroy(ds->current);
+  pthread_mutex_destroy(&ds->mutex);
+  pthread_cond_destroy(&ds->released);
+  pthread_mutex_destroy(&ds->add_mutex);
+  pthread_mutex_destroy(&ds->reload_mutex);
+  pthread_key_delete(ds->reader);
+  while(ds->readers) {
+    struct dataset_reader *rd = ds->readers;
+    ds->readers = rd->next;
+    free(rd);
+  }
+  pthread_mutex_destroy(&ds->reader_mutex);
+  free(ds->file);
+  free(ds);
+}
@@ -0,0 +1,165 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file dataset.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible dataset methods.
+ *
+ * A dataset owns the foodlist the server works on and replaces it, when the csv file is reloaded. Every
+ * request works on the foodlist it acquired, until it releases it again, so a reload never changes the
+ * list under a running search. The replaced list is freed as soon as the last request released it. Foods
+ * added by clients are kept over a reload, unless the new file contains a food of the same name.
+ *
+ */
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdbool.h>
+#include "../lib/food.h"
+#include "../lib/foodlist.h"
+#include "querycache.h"
+
+/**
+ *
+ * @brief Forward declaration for dataset
+ *
+ * */
+typedef struct dataset dataset;
+
+/**
+ * @brief Constructor for dataset, loads the foodlist from a csv file
+ * @param char* Name of the csv file, or NULL to start with an empty foodlist which is never saved
+ * @return A pointer to the dataset structure, representing the created object
+ *
+ * After using this structure, it must be freed with dataset_destroy(dataset *)
+ *
+ * */
+dataset *dataset_init(const char *);
+
+/**
+* @brief Method for setting the cache which is cleared when the foodlist is replaced
+* @param dataset* Pointer to structure to work on
+* @param querycache* The cache, NULL if there is none
+*
+* */
+void dataset_set_querycache(dataset *, querycache *);
+
+/**
+* @brief Method for getting the current foodlist for a request
+* @param dataset* Pointer to structure to work on
+* @return The foodlist, it stays valid until it is passed to dataset_release()
+*
+* */
+foodlist *dataset_acquire(dataset *);
+
+/**
+* @brief Method for getting the current foodlist for a request, together with its generation
+* @param dataset* Pointer to structure to work on
+* @param unsigned long* Set to the generation of the returned foodlist, see dataset_generation()
+* @return The foodlist, it stays valid until it is passed to dataset_release()
+*
+* */
+foodlist *dataset_acquire_generation(dataset *, unsigned long *);
+
+/**
+* @brief Method for releasing a foodlist returned by dataset_acquire()
+* @param dataset* Pointer to structure to work on
+* @param foodlist* The foodlist
+*
+* */
+void dataset_release(dataset *, foodlist *);
+
+/**
+* @brief Method for getting the current foodlist and its generation without taking a lock
+* @param dataset* Pointer to structure to work on
+* @param unsigned long* Set to the generation of the returned foodlist, or NULL
+* @return The foodlist, it stays valid until it is passed to dataset_release_lockfree()
+*
+* Nothing shared is written, the foodlist is published in a slot owned by the calling thread, so a thread
+* may hold only one foodlist of this method at a time. Meant for event loops answering requests on their
+* own CPU, together with the lock-free searches of the foodlist.
+*
+* */
+foodlist *dataset_acquire_lockfree(dataset *, unsigned long *);
+
+/**
+* @brief Method for releasing a foodlist returned by dataset_acquire_lockfree()
+* @param dataset* Pointer to structure to work on
+* @param foodlist* The foodlist
+*
+* */
+void dataset_release_lockfree(dataset *, foodlist *);
+
+/**
+* @brief Method for adding a food added by a client to the current foodlist
+* @param dataset* Pointer to structure to work on
+* @param food* The food, it is owned by the foodlist afterwards
+*
+* */
+void dataset_add(dataset *, food *);
+
+/**
+* @brief Method for adding foods received from another server to the current foodlist
+* @param dataset* Pointer to structure to work on
+* @param food** The foods, they are owned by the foodlist afterwards, the array is not
+* @param size_t Number of foods
+*
+* Unlike dataset_add(), the foods are not written to the csv file by dataset_save().
+*
+* */
+void dataset_apply(dataset *, food **, size_t);
+
+/**
+* @brief Method for replacing the current foodlist with a foodlist built elsewhere
+* @param dataset* Pointer to structure to work on
+* @param foodlist* The new foodlist, it is owned by the dataset afterwards
+*
+* Like dataset_reload(), this returns after the replaced foodlist was freed.
+*
+* */
+void dataset_replace(dataset *, foodlist *);
+
+/**
+* @brief Method for loading the csv file again and replacing the current foodlist
+* @param dataset* Pointer to structure to work on
+* @return True, if the foodlist was replaced, false if the file could not be read
+*
+* The new foodlist is built while requests are still served from the current one. The method returns
+* after the replaced foodlist was released by all requests and freed, so it must not be called while
+* holding a foodlist from dataset_acquire().
+*
+* */
+bool dataset_reload(dataset *);
+
+/**
+* @brief Method for getting the generation of the current foodlist
+* @param dataset* Pointer to structure to work on
+* @return The generation, it grows with every reload and differs between runs of the server
+*
+* */
+unsigned long dataset_generation(dataset *);
+
+/**
+* @brief Method for writing foods added by clients back to the csv file
+* @param dataset* Pointer to structure to work on
+*
+* Nothing is written if no foods were added. If the file was changed since it was loaded, it is reloaded
+* first, so the changes are not overwritten.
+*
+* */
+void dataset_save(dataset *);
+
+/**
+ * @brief Destructor for dataset, frees the current foodlist
+ * @param dataset* Pointer to structure to be freed
+ *
+ * */
+void dataset_destroy(dataset *);
+
+#endif /* DATASET_H */
@@ -18,15 +18,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <semaphore.h>
+#include "../lib/snapshot.h"
 #include "sockethandler.h"
+#include "logger.h"
+#include "tracer.h"
+
+#define STATS_INTERVAL 10 /**< Default interval in seconds for appending the stats to a file */
+
+/**
+ * @brief Representation of the food list, which can be reloaded
+ *
+ * */
+dataset *ds;
+
 
 /**
- * @brief Representation of the food list
+ * @brief Representation of the connection to the primary, NULL unless the server is a replica
  *
  * */
-foodlist *fl;
+replica *rp;
 
+/**
+ * @brief Representation of the shards, NULL unless the server is a router
+ *
+ * */
+router *rt;
 
 /**
  * @brief Representation of the socket handler
@@ -34,6 +56,30 @@ foodlist *fl;
  * */
 sockethandler *s;
 
+/**
+ * @brief Representation of the worker pool
+ *
+ * */
+executor *ex;
+
+/**
+ * @brief Representation of the search reply cache
+ *
+ * */
+querycache *qc;
+
+/**
+ * @brief Representation of the request counters
+ *
+ * */
+stats *st;
+
+/**
+ * @brief Representation of the meal planner
+ *
+ * */
+planner *pl;
+
 /**
  * @brief Prints the help for diet-server to the console.
  * @param char* Program name
@@ -41,16 +87,237 @@ sockethandler *s;
  * */
 void usage(char *pname)
 {
-  fprintf(stderr, "usage: %s <port>\n", pname);
+  fprintf(stderr, "usage: %s [-b threads|uring|percore] [-c threads] [-t workers] [-l backlog] [-q queue] [-C megabytes] [-M seconds]\n"
+          "       [-T path] [-v level] [-J] [-X path] [-x every] [-I seconds] [-u path | -U path] [-S path] [-R host:port | -R path] [-r shardmap]\n"
+          "       [<port>]\n",
+          pname);
+  fprintf(stderr, "  -b backend  I/O backend for client connections (default: threads)\n");
+  fprintf(stderr, "  -c threads  number of connection threads of the thread backend (default: 10)\n");
+  fprintf(stderr, "  -t workers  number of worker threads executing requests (default: number of CPUs)\n");
+  fprintf(stderr, "  -l backlog  backlog of the listening socket (default: 128)\n");
+  fprintf(stderr, "  -q queue    number of connections waiting for a connection thread before new ones\n");
+  fprintf(stderr, "              are rejected with BUSY (default: 5)\n");
+  fprintf(stderr, "  -C megabytes memory for caching search replies, 0 to disable (default: 16)\n");
+  fprintf(stderr, "  -M seconds  print connection metrics every given seconds (default: off)\n");
+  fprintf(stderr, "  -T path     append the request stats to a file every -M seconds, or every %d seconds\n"
+          "              without -M (default: off, the stats are still answered to STATS)\n", STATS_INTERVAL);
+  fprintf(stderr, "  -v level    log messages up to the level error, warn, info or debug, which logs every\n"
+          "              request (default: info)\n");
+  fprintf(stderr, "  -J          log one JSON object per line instead of text\n");
+  fprintf(stderr, "  -X path     write the phases of sampled requests as Chrome trace events to a file\n");
+  fprintf(stderr, "  -x every    trace one of every given requests of each thread (default: 100)\n");
+  fprintf(stderr, "  -I seconds  close connections idle for the given seconds, 0 to never (default: 300)\n");
+  fprintf(stderr, "  -u path     additionally listen on a Unix domain socket for local clients\n");
+  fprintf(stderr, "  -U path     listen on a Unix domain socket only, without TCP port\n");
+  fprintf(stderr, "  -S path     publish a snapshot of the food list for local readers\n");
+  fprintf(stderr, "  -R primary  run as a read replica of the server at host:port or at a Unix domain socket,\n"
+          "              added foods are forwarded to it\n");
+  fprintf(stderr, "  -r shardmap run as a router, which spreads the foods over the servers of the shard map\n");
+  fprintf(stderr, "Send SIGHUP to reload calories.csv without dropping connections.\n");
 }
 
 /**
- * @brief Define the function to be called when ctrl-c (SIGINT) signal is sent to process
+ * @brief Interval in seconds for printing the connection metrics, 0 to disable
+ *
+ * */
+unsigned int metrics_interval = 0;
+
+/**
+ * @brief Path of the file the stats are appended to, NULL to disable
+ *
+ * */
+char *stats_path = NULL;
+
+/**
+ * @brief Flag notifying the background threads to stop, protected by stop_mutex
+ *
+ * */
+bool stopping = false;
+
+/**
+ * @brief Mutex protecting stopping
+ *
+ * */
+pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Condition signalled when stopping is set
+ *
+ * */
+pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Waits a second, but returns early when the server stops
+ * @return True, if the server stops, false otherwise
+ *
+ * */
+bool wait_second()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += 1;
+  pthread_mutex_lock(&stop_mutex);
+  while(!stopping && pthread_cond_timedwait(&stop_cond, &stop_mutex, &ts) == 0) {
+  }
+  bool ret = stopping;
+  pthread_mutex_unlock(&stop_mutex);
+  return ret;
+}
+
+/**
+ * @brief Path of the published snapshot for local readers, NULL to disable
+ *
+ * */
+char *snapshot_path = NULL;
+
+/**
+ * @brief Generation of the food list in the published snapshot, see dataset_generation()
+ *
+ * */
+unsigned long published_generation = (unsigned long) -1;
+
+/**
+ * @brief Number of foods in the published snapshot
+ *
+ * */
+int published_count = -1;
+
+/**
+ * @brief Publishes a snapshot of the current food list, if it changed since the last one
+ * @return True, if a snapshot was published, false otherwise
+ *
+ * */
+bool snapshot_update()
+{
+  /* foods are only ever appended to a generation, so the count tells whether the snapshot is outdated */
+  unsigned long generation = 0;
+  foodlist *fl = dataset_acquire_generation(ds, &generation);
+  int count = foodlist_count(fl);
+  bool ret = false;
+  if((generation != published_generation || count != published_count) && snapshot_publish(fl, snapshot_path)) {
+    published_generation = generation;
+    published_count = count;
+    ret = true;
+  }
+  dataset_release(ds, fl);
+  return ret;
+}
+
+/**
+ * @brief Thread function publishing a new snapshot at most once a second, when foods were added or the
+ *        food list was reloaded
+ * @param void* Unused
+ *
+ * */
+void *snapshot_thread_func(void *arg)
+{
+  while(!wait_second()) {
+    snapshot_update();
+  }
+  snapshot_update();
+  return NULL;
+}
+
+/**
+ * @brief Semaphore posted by SIGHUP to reload the food list, and on shutdown
+ *
+ * */
+sem_t reload_sem;
+
+/**
+ * @brief Thread function reloading the food list whenever SIGHUP was caught
+ * @param void* Unused
+ *
+ * */
+void *reload_thread_func(void *arg)
+{
+  while(sem_wait(&reload_sem) == 0 || errno == EINTR) {
+    pthread_mutex_lock(&stop_mutex);
+    bool stop = stopping;
+    pthread_mutex_unlock(&stop_mutex);
+    if(stop) {
+      break;
+    }
+    dataset_reload(ds);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Define the function to be called when SIGHUP is sent to process, to reload calories.csv
+ *
+ * */
+void reload_signal_handler(int signum)
+{
+  /* sem_post is async-signal-safe, the reload itself runs on reload_thread */
+  sem_post(&reload_sem);
+}
+
+/**
+ * @brief Thread function printing the connection metrics periodically
+ * @param void* Unused
+ *
+ * */
+void *metrics_thread_func(void *arg)
+{
+  unsigned int elapsed = 0;
+  while(!wait_second()) {
+    if(++elapsed >= metrics_interval) {
+      connmetrics_print(sockethandler_get_metrics(s), stdout);
+      if(qc) {
+        querycache_print(qc, stdout);
+      }
+      elapsed = 0;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Appends the current stats to the stats file, headed by the time
+ *
+ * */
+void stats_dump()
+{
+  FILE *out = fopen(stats_path, "a");
+  if(!out) {
+    LOGGER_LOG(LOGGER_ERROR, "cannot write stats to %s", stats_path);
+    return;
+  }
+  fprintf(out, "time %ld\n", (long)time(NULL));
+  stats_print(st, out);
+  fclose(out);
+}
+
+/**
+ * @brief Thread function appending the stats to the stats file periodically
+ * @param void* Unused
+ *
+ * */
+void *stats_thread_func(void *arg)
+{
+  unsigned int interval = metrics_interval > 0 ? metrics_interval : STATS_INTERVAL;
+  unsigned int elapsed = 0;
+  while(!wait_second()) {
+    if(++elapsed >= interval) {
+      stats_dump();
+      elapsed = 0;
+    }
+  }
+  stats_dump();
+  return NULL;
+}
+
+/**
+ * @brief Define the function to be called when ctrl-c (SIGINT) or SIGTERM signal is sent to process
  *
  * */
 void signal_callback_handler(int signum)
 {
-  printf("Caught signal %d\n", signum);
+  /* printf is not async-signal-safe */
+  const char msg[] = "Caught signal, shutting down\n";
+  ssize_t w = write(STDOUT_FILENO, msg, sizeof(msg) - 1);
+  (void)w;
   sockethandler_shutdown(s);
 }
 
@@ -63,42 +330,276 @@ void signal_callback_handler(int signum)
  * */
 int main(int argc, char **argv)
 {
-  /* set default port */
+  /* set default values */
   unsigned int port = 12345;
+  sockethandler_backend backend = SOCKETHANDLER_THREADS;
+  size_t threads = 0;
+  size_t workers = 0;
+  size_t queue = 0;
+  int backlog = 0;
+  size_t cache_mb = 16;
+  unsigned int idle_timeout = 300;
+  char *unix_path = NULL;
+  bool tcp = true;
+  char *primary = NULL;
+  unsigned int primary_port = 0;
+  char *shardmap = NULL;
+  logger_level log_level = LOGGER_INFO;
+  logger_format log_format = LOGGER_TEXT;
+  char *trace_path = NULL;
+  unsigned int trace_every = 100;
 
-  /* program started with one argument */
-  if(argc > 1) {
-    /* user wants to see help */
-    if(!strcmp(argv[1], "-h")) {
+  int opt;
+  while((opt = getopt(argc, argv, "hb:c:t:l:q:C:M:T:v:JX:x:I:u:U:S:R:r:")) != -1) {
+    switch(opt) {
+    case 'b':
+      if(!strcmp(optarg, "uring")) {
+        backend = SOCKETHANDLER_URING;
+      } else if(!strcmp(optarg, "percore")) {
+        backend = SOCKETHANDLER_PERCORE;
+      } else if(!strcmp(optarg, "threads")) {
+        backend = SOCKETHANDLER_THREADS;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c':
+      threads = atoi(optarg);
+      break;
+    case 't':
+      workers = atoi(optarg);
+      break;
+    case 'l':
+      backlog = atoi(optarg);
+      break;
+    case 'q':
+      queue = atoi(optarg);
+      break;
+    case 'C':
+      cache_mb = atoi(optarg);
+      break;
+    case 'M':
+      metrics_interval = atoi(optarg);
+      break;
+    case 'T':
+      stats_path = optarg;
+      break;
+    case 'v':
+      if(logger_parse_level(optarg, &log_level) < 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'J':
+      log_format = LOGGER_JSON;
+      break;
+    case 'X':
+      trace_path = optarg;
+      break;
+    case 'x':
+      trace_every = atoi(optarg);
+      break;
+    case 'I':
+      idle_timeout = atoi(optarg);
+      break;
+    case 'u':
+    case 'U':
+      unix_path = optarg;
+      tcp = opt == 'u';
+      break;
+    case 'S':
+      snapshot_path = optarg;
+      break;
+    case 'R':
+      primary = optarg;
+      /* a path of a Unix domain socket has no port */
+      if(!strchr(primary, '/')) {
+        char *colon = strrchr(primary, ':');
+        if(!colon) {
+          usage(argv[0]);
+          return 1;
+        }
+        *colon = 0;
+        primary_port = atoi(colon + 1);
+      }
+      break;
+    case 'r':
+      shardmap = optarg;
+      break;
+    case 'h':
+      /* user wants to see help */
       usage(argv[0]);
       return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  /* program started with a port argument */
+  if(optind < argc) {
+    port = atoi(argv[optind]);
+  }
+
+  /* write the log messages of all threads in the background */
+  logger_start(log_level, log_format, stdout);
+
+  /* trace sampled requests until the server stops */
+  if(trace_path && !tracer_start(trace_path, trace_every)) {
+    logger_stop();
+    return 1;
+  }
+
+  /* connect to the shards, the router keeps no foods itself */
+  rt = NULL;
+  if(shardmap) {
+    rt = router_init(shardmap);
+    if(!rt) {
+      tracer_stop();
+      logger_stop();
+      return 1;
     }
-    port = atoi(argv[1]);
+    /* foods added to the shards directly would not invalidate cached searches */
+    cache_mb = 0;
   }
 
-  /* initialize the foodlist */
-  fl = foodlist_init_csv("calories.csv");
+  /* initialize the foodlist, a replica gets it from its primary */
+  ds = dataset_init(primary || shardmap ? NULL : "calories.csv");
 
-    /* initialize the sockethandler */
-  s = sockethandler_init(fl);
+  /* initialize the worker pool */
+  ex = executor_init(workers);
+
+  /* initialize the search reply cache */
+  qc = cache_mb > 0 ? querycache_init(cache_mb * 1024 * 1024) : NULL;
+  dataset_set_querycache(ds, qc);
+
+  /* initialize the sockethandler */
+  s = sockethandler_init(ds);
   sockethandler_set_port(s, port);
+  sockethandler_set_unix_path(s, unix_path, tcp);
+  sockethandler_set_backend(s, backend);
+  sockethandler_set_threads(s, threads);
+  sockethandler_set_executor(s, ex);
+  sockethandler_set_querycache(s, qc);
+  sockethandler_set_queue_size(s, queue);
+  sockethandler_set_backlog(s, backlog);
+  sockethandler_set_idle_timeout(s, idle_timeout);
+
+  /* count the requests of all backends */
+  st = stats_init(ds, sockethandler_get_metrics(s));
+  sockethandler_set_stats(s, st);
+
+  /* answer PLAN requests on the worker pool */
+  pl = planner_init(ex);
+  sockethandler_set_planner(s, pl);
+
+  /* start following the primary */
+  rp = NULL;
+  if(primary) {
+    rp = replica_init(primary, primary_port, ds);
+    sockethandler_set_replica(s, rp);
+  }
+  sockethandler_set_router(s, rt);
 
   /* Register signal and signal handler */
   signal(SIGINT, signal_callback_handler);
+  signal(SIGTERM, signal_callback_handler);
   /* Register SUGUSR1 as well to be able to test the signal handler when debugging with gdb. */
   signal(SIGUSR1, signal_callback_handler);
 
+  /* reload calories.csv on SIGHUP, without dropping connections */
+  sem_init(&reload_sem, 0, 0);
+  pthread_t reload_thread;
+  pthread_create(&reload_thread, NULL, reload_thread_func, NULL);
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = reload_signal_handler;
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGHUP, &sa, NULL);
+
+  pthread_t metrics_thread;
+  if(metrics_interval > 0) {
+    pthread_create(&metrics_thread, NULL, metrics_thread_func, NULL);
+  }
+  pthread_t stats_thread;
+  if(stats_path) {
+    pthread_create(&stats_thread, NULL, stats_thread_func, NULL);
+  }
+
+  /* publish the snapshot before serving, readers can map it right away */
+  pthread_t snapshot_thread;
+  if(snapshot_path) {
+    if(snapshot_update()) {
+      LOGGER_LOG(LOGGER_INFO, "Snapshot published to %s", snapshot_path);
+    }
+    pthread_create(&snapshot_thread, NULL, snapshot_thread_func, NULL);
+  }
+
   /* Main server functionality */
   sockethandler_server_thread_func(s);
 
+  pthread_mutex_lock(&stop_mutex);
+  stopping = true;
+  pthread_cond_broadcast(&stop_cond);
+  pthread_mutex_unlock(&stop_mutex);
+  signal(SIGHUP, SIG_IGN);
+  sem_post(&reload_sem);
+  pthread_join(reload_thread, NULL);
+  sem_destroy(&reload_sem);
+  if(metrics_interval > 0) {
+    pthread_join(metrics_thread, NULL);
+  }
+  if(stats_path) {
+    pthread_join(stats_thread, NULL);
+  }
+  if(snapshot_path) {
+    pthread_join(snapshot_thread, NULL);
+  }
+  connmetrics_print(sockethandler_get_metrics(s), stdout);
+  if(qc) {
+    querycache_print(qc, stdout);
+  }
+
   /* free the sockethandler object */
   sockethandler_destroy(s);
 
-  /* save the foodlist before exiting */
-  foodlist_save(fl);
+  /* free the request counters */
+  stats_destroy(st);
+
+  /* free the meal planner */
+  planner_destroy(pl);
+
+  /* stop following the primary */
+  if(rp) {
+    replica_destroy(rp);
+  }
+
+  /* close the connections to the shards */
+  if(rt) {
+    router_destroy(rt);
+  }
+
+  /* stop the worker pool */
+  executor_destroy(ex);
+
+  /* save foods added by clients before exiting, a reload while saving still clears the cache */
+  dataset_save(ds);
+
+  /* free the search reply cache */
+  if(qc) {
+    dataset_set_querycache(ds, NULL);
+    querycache_destroy(qc);
+  }
 
   /* free the foodlist object */
-  foodlist_destroy(fl);
+  dataset_destroy(ds);
+
+  /* write the spans of the last requests */
+  tracer_stop();
+
+  /* write the remaining log messages */
+  logger_stop();
 
   return 0;
 }
@@ -0,0 +1,802 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file dispatch.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the dispatch structure and its member methods.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+#include "../lib/food.h"
+#include "../lib/foodlist.h"
+#include "executor.h"
+#include "querycache.h"
+#include "dataset.h"
+#include "replica.h"
+#include "router.h"
+#include "stats.h"
+#include "planner.h"
+#include "logger.h"
+#include "tracer.h"
+#include "dispatch.h"
+
+#define DISPATCH_SPLIT_SIZE 4096 /**< Minimum number of foods a search sub-task scans */
+#define DISPATCH_PAGE_DEFAULT 100 /**< Page size of a paginated search without limit */
+#define DISPATCH_PAGE_MAX 1000 /**< Maximum page size of a paginated search */
+#define DISPATCH_SIMILAR_DEFAULT 10 /**< Number of foods of a similar foods search without k */
+#define DISPATCH_LOG_BATCH 1000 /**< Maximum number of foods of a batch of the replication log */
+
+/**
+ * @brief dispatch structure for representing the command handling of the server
+ *
+ */
+struct dispatch {
+  dataset *dataset; /**< Foods to work with */
+  executor *executor; /**< Worker pool requests are run on, NULL to run them on the calling thread */
+  querycache *querycache; /**< Cache for search replies, NULL to disable caching */
+  replica *replica; /**< Primary FOOD requests are forwarded to, NULL to add foods locally */
+  router *router; /**< Shards SEARCH and FOOD requests are forwarded to, NULL to handle them locally */
+  stats *stats; /**< Counters of the handled requests, NULL to disable counting */
+  planner *planner; /**< Planner for PLAN requests, NULL to answer them without plans */
+  bool local; /**< True, if searches over small lists are answered by the submitting thread without locks */
+};
+
+/**
+ * @brief Part of a search, covering one index range of the foodlist
+ *
+ */
+struct dispatch_chunk {
+  foodlist *foodlist; /**< List of foods to search */
+  char *term; /**< The search term */
+  size_t from; /**< First position to scan */
+  size_t to; /**< Position after the last one to scan */
+  size_t n; /**< Number of found foods */
+  reply *reply; /**< FOOD messages of the found foods */
+  uint64_t trace; /**< Traced request the search belongs to, 0 if it is not traced */
+};
+
+/**
+ * @brief A request handed to the executor
+ *
+ */
+struct dispatch_request {
+  dispatch *dispatch; /**< Dispatcher handling the request */
+  int client; /**< Identifier of the client */
+  char *msg; /**< The received message */
+  reply *reply; /**< Reply for the answer messages */
+  uint64_t trace; /**< Traced request, 0 if it is not traced */
+  uint64_t submitted; /**< Time the request was handed to the executor, from tracer_clock() */
+  stats_command command; /**< Command of the request, for the counters */
+  struct timespec start; /**< Time the request was received, for the counters */
+  size_t before; /**< Number of messages of the reply before the request was handled */
+  dispatch_done_func done; /**< Function called after the reply is complete, NULL if the submitter waits */
+  void *arg; /**< Argument of done */
+};
+
+/**
+ * @brief Searches one index range and serializes the matches
+ * @param void* Pointer to a dispatch_chunk structure
+ *
+ * */
+static void dispatch_search_chunk(void *arg)
+{
+  struct dispatch_chunk *c = (struct dispatch_chunk *)arg;
+  uint64_t prev = tracer_set_current(c->trace);
+  uint64_t start = tracer_clock();
+  food **foods = foodlist_find_range(c->foodlist, c->term, c->from, c->to, &c->n);
+  tracer_span("scan", start);
+  start = tracer_clock();
+  for(size_t i = 0; i < c->n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(c->reply, "FOOD:", s);
+    free(s);
+  }
+  free(foods);
+  tracer_span("serialize", start);
+  tracer_set_current(prev);
+}
+
+/**
+ * @brief Removes surrounding whitespace, e.g. the newline character, from a search term
+ * @param char* The search term, it is modified
+ * @return Start of the trimmed search term
+ *
+ * */
+static char *dispatch_trim(char *term)
+{
+  while(isspace((unsigned char)*term)) {
+    term++;
+  }
+  size_t len = strlen(term);
+  while(len > 0 && isspace((unsigned char)term[len - 1])) {
+    term[--len] = 0;
+  }
+  return term;
+}
+
+/**
+ * @brief Handles a SEARCH request
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The search term
+ * @param reply* Reply to append COUNT and FOOD messages to
+ *
+ * */
+static void dispatch_search(dispatch *d, int client, char *term, reply *r)
+{
+  term = dispatch_trim(term);
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d is searching for some %s", client, term);
+  if(d->router) {
+    size_t n = router_search(d->router, term, r);
+    LOGGER_LOG(LOGGER_DEBUG, "Found %zu food items on the shards for client %d", n, client);
+    return;
+  }
+
+  unsigned long version = 0;
+  if(d->querycache) {
+    uint64_t start = tracer_clock();
+    bool hit = querycache_get(d->querycache, term, r);
+    tracer_span("cache lookup", start);
+    if(hit) {
+      LOGGER_LOG(LOGGER_DEBUG, "Answered search of client %d from cache", client);
+      return;
+    }
+    version = querycache_version(d->querycache);
+  }
+
+  /* acquired after reading the cache version, a reload in between clears the cache and its version */
+  foodlist *fl = dataset_acquire(d->dataset);
+  if(!foodlist_may_match(fl, term)) {
+    /* a miss is answered without scanning, it is not worth a cache entry */
+    dataset_release(d->dataset, fl);
+    reply_add(r, "COUNT:", "0");
+    LOGGER_LOG(LOGGER_DEBUG, "Found 0 food items for client %d", client);
+    return;
+  }
+
+  /* large lists are split into index ranges which are searched in parallel */
+  size_t total = foodlist_count(fl);
+  size_t chunks = 1;
+  if(d->executor && total > 2 * DISPATCH_SPLIT_SIZE) {
+    chunks = total / DISPATCH_SPLIT_SIZE;
+    if(chunks > 4 * executor_size(d->executor)) {
+      chunks = 4 * executor_size(d->executor);
+    }
+  }
+  size_t step = (total + chunks - 1) / chunks;
+  struct dispatch_chunk *c = calloc(chunks, sizeof(struct dispatch_chunk));
+  for(size_t i = 0; i < chunks; ++i) {
+    c[i].foodlist = fl;
+    c[i].term = term;
+    c[i].from = i * step;
+    /* the last chunk also covers foods appended in the meantime */
+    c[i].to = i == chunks - 1 ? (size_t) -1 : (i + 1) * step;
+    c[i].reply = reply_init();
+    c[i].trace = tracer_current();
+  }
+  if(chunks == 1) {
+    dispatch_search_chunk(&c[0]);
+  } else {
+    executor_group *g = executor_group_init();
+    for(size_t i = 0; i < chunks; ++i) {
+      executor_submit(d->executor, g, dispatch_search_chunk, &c[i]);
+    }
+    executor_wait(d->executor, g);
+    executor_group_destroy(g);
+  }
+  dataset_release(d->dataset, fl);
+
+  size_t n = 0;
+  for(size_t i = 0; i < chunks; ++i) {
+    n += c[i].n;
+  }
+  char cbuf[32] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  reply *res = reply_init();
+  reply_add(res, "COUNT:", cbuf);
+  for(size_t i = 0; i < chunks; ++i) {
+    reply_append(res, c[i].reply);
+    reply_destroy(c[i].reply);
+  }
+  free(c);
+  if(d->querycache) {
+    querycache_put(d->querycache, term, res, version);
+  }
+  reply_append(r, res);
+  reply_destroy(res);
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu food items for client %d", n, client);
+}
+
+/**
+ * @brief Handles a paginated SEARCH request, e.g. "SEARCH?limit=20&cursor=5e0f1c2a-1a:Milk"
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The parameters and the search term, e.g. "limit=20&cursor=5e0f1c2a-1a:Milk"
+ * @param reply* Reply to append COUNT and FOOD messages to
+ * @param foodlist* Foodlist of dataset_acquire_lockfree() to scan without locks, NULL to acquire the current one
+ * @param unsigned long Generation of the foodlist scanned without locks, ignored without one
+ *
+ * The page is scanned directly from the index and stops at the first match after the page, so a short
+ * search term does not serialize the whole list. The COUNT message carries the number of foods of this
+ * page and, if there are more, an opaque cursor for the next page: "COUNT:20;next=5e0f1c2a-1a". Like the
+ * cursor of SUBSCRIBE it is the generation of the foodlist and a position in its index, so a cursor of
+ * another generation, e.g. after a reload, starts the search over instead of skipping or repeating foods.
+ *
+ * */
+static void dispatch_search_page(dispatch *d, int client, char *msg, reply *r, foodlist *local, unsigned long local_generation)
+{
+  char *term = strchr(msg, ':');
+  if(!term) {
+    LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected SEARCH?params:term");
+    reply_add(r, "COUNT:", "0");
+    return;
+  }
+  *term++ = 0;
+  term = dispatch_trim(term);
+
+  size_t limit = DISPATCH_PAGE_DEFAULT;
+  size_t offset = 0;
+  size_t pos = 0;
+  char *cursor = NULL;
+  char *save = NULL;
+  for(char *p = strtok_r(msg, "&", &save); p; p = strtok_r(NULL, "&", &save)) {
+    if(!strncmp("limit=", p, 6)) {
+      limit = strtoul(p + 6, NULL, 10);
+    } else if(!strncmp("offset=", p, 7)) {
+      offset = strtoul(p + 7, NULL, 10);
+    } else if(!strncmp("cursor=", p, 7)) {
+      cursor = p + 7;
+    } else {
+      LOGGER_LOG(LOGGER_WARN, "Ignoring unknown search parameter %s", p);
+    }
+  }
+  if(limit == 0 || limit > DISPATCH_PAGE_MAX) {
+    limit = DISPATCH_PAGE_MAX;
+  }
+  if(d->router) {
+    LOGGER_LOG(LOGGER_DEBUG, "Client %d is searching for some %s, %zu items from %s", client, term, limit, cursor ? cursor : "start");
+    size_t n = router_search_page(d->router, term, limit, cursor, r);
+    LOGGER_LOG(LOGGER_DEBUG, "Found %zu food items on the shards for client %d", n, client);
+    return;
+  }
+
+  unsigned long generation = local_generation;
+  foodlist *fl = local ? local : dataset_acquire_generation(d->dataset, &generation);
+  unsigned long from_generation = 0;
+  if(cursor && (sscanf(cursor, "%lx-%zx", &from_generation, &pos) != 2 || from_generation != generation)) {
+    LOGGER_LOG(LOGGER_DEBUG, "Cursor %s of client %d is not one of generation %lx, starting over", cursor, client, generation);
+    pos = 0;
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d is searching for some %s, %zu items from position %zu", client, term, limit, pos);
+
+  size_t n = 0;
+  uint64_t start = tracer_clock();
+  food **foods = local ? foodlist_find_page_lockfree(fl, term, &pos, offset, limit, &n)
+                       : foodlist_find_page(fl, term, &pos, offset, limit, &n);
+  tracer_span("scan", start);
+  start = tracer_clock();
+  char cbuf[64] = { 0 };
+  if(pos != (size_t) -1) {
+    snprintf(cbuf, sizeof(cbuf), "%zu;next=%lx-%zx", n, generation, pos);
+  } else {
+    snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  }
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t i = 0; i < n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(r, "FOOD:", s);
+    free(s);
+  }
+  free(foods);
+  tracer_span("serialize", start);
+  if(!local) {
+    dataset_release(d->dataset, fl);
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu food items for client %d", n, client);
+}
+
+/**
+ * @brief Handles a SEARCH request without locks, from the local cache of the thread or by scanning the foodlist
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The search term
+ * @param reply* Reply to append COUNT and FOOD messages to
+ * @return True, if the request was answered, false if the list is too large to be scanned here
+ *
+ * */
+static bool dispatch_search_local(dispatch *d, int client, char *term, reply *r)
+{
+  term = dispatch_trim(term);
+  querycache *qc = d->querycache ? querycache_local(d->querycache) : NULL;
+  unsigned long version = 0;
+  if(qc) {
+    uint64_t start = tracer_clock();
+    bool hit = querycache_get(qc, term, r);
+    tracer_span("cache lookup", start);
+    if(hit) {
+      LOGGER_LOG(LOGGER_DEBUG, "Answered search of client %d from cache", client);
+      return true;
+    }
+    version = querycache_version(qc);
+  }
+
+  /* acquired after reading the cache version, a reload in between clears the cache and its version */
+  foodlist *fl = dataset_acquire_lockfree(d->dataset, NULL);
+  if(foodlist_count_lockfree(fl) > 2 * DISPATCH_SPLIT_SIZE) {
+    /* the worker pool splits the scan of a large list */
+    dataset_release_lockfree(d->dataset, fl);
+    return false;
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d is searching for some %s", client, term);
+  if(!foodlist_may_match_lockfree(fl, term)) {
+    /* a miss is answered without scanning, it is not worth a cache entry, like in dispatch_search() */
+    dataset_release_lockfree(d->dataset, fl);
+    reply_add(r, "COUNT:", "0");
+    LOGGER_LOG(LOGGER_DEBUG, "Found 0 food items for client %d", client);
+    return true;
+  }
+  size_t n = 0;
+  uint64_t start = tracer_clock();
+  food **foods = foodlist_find_lockfree(fl, term, &n);
+  tracer_span("scan", start);
+  start = tracer_clock();
+  char cbuf[32] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  reply *res = reply_init();
+  reply_add(res, "COUNT:", cbuf);
+  for(size_t i = 0; i < n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(res, "FOOD:", s);
+    free(s);
+  }
+  free(foods);
+  dataset_release_lockfree(d->dataset, fl);
+  tracer_span("serialize", start);
+  if(qc) {
+    /* empty results which got past the filter are cached like in dispatch_search() */
+    querycache_put(qc, term, res, version);
+  }
+  reply_append(r, res);
+  reply_destroy(res);
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu food items for client %d", n, client);
+  return true;
+}
+
+/**
+ * @brief Handles a FOOD request
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The serialized food
+ *
+ * */
+static void dispatch_food(dispatch *d, int client, char *data)
+{
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d wants to add food", client);
+  food *f = food_deserialize(data);
+  if(d->replica) {
+    LOGGER_LOG(LOGGER_DEBUG, "Client %d added some %s, forwarding it to the primary", client, food_get_name(f));
+    replica_forward(d->replica, f);
+    return;
+  }
+  if(d->router) {
+    router_add(d->router, f);
+    return;
+  }
+  /* the food belongs to the foodlist afterwards, which a reload may free */
+  char *name = strdup(food_get_name(f));
+  dataset_add(d->dataset, f);
+  if(d->querycache) {
+    /* cached searches which would find the new food are outdated */
+    querycache_invalidate(d->querycache, name);
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d added some %s", client, name);
+  free(name);
+}
+
+/**
+ * @brief Handles a SUBSCRIBE request of a replica, e.g. "SUBSCRIBE:5e0f1c2a-3c0"
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The cursor returned with the previous batch, empty for the first one
+ * @param reply* Reply to append COUNT and FOOD messages to
+ *
+ * Foods are only appended to a foodlist, so its positions are the replication log. The cursor is the
+ * generation of the foodlist and a position in it: "COUNT:3;next=5e0f1c2a-3c3". A cursor of another
+ * generation, e.g. after a reload, starts over with the first food of the current foodlist.
+ *
+ * */
+static void dispatch_subscribe(dispatch *d, int client, char *cursor, reply *r)
+{
+  cursor = dispatch_trim(cursor);
+  unsigned long generation = 0;
+  foodlist *fl = dataset_acquire_generation(d->dataset, &generation);
+  unsigned long from_generation = 0;
+  size_t pos = 0;
+  if(sscanf(cursor, "%lx-%zx", &from_generation, &pos) != 2 || from_generation != generation) {
+    pos = 0;
+  }
+  size_t n = 0;
+  food **foods = foodlist_get_range(fl, pos, DISPATCH_LOG_BATCH, &n);
+  char cbuf[64] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu;next=%lx-%zx", n, generation, pos + n);
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t i = 0; i < n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(r, "FOOD:", s);
+    free(s);
+  }
+  free(foods);
+  dataset_release(d->dataset, fl);
+  if(n > 0) {
+    LOGGER_LOG(LOGGER_DEBUG, "Sent %zu food items from position %zu to replica %d", n, pos, client);
+  }
+}
+
+/**
+ * @brief Handles a STATS request
+ * @param dispatch* Pointer to structure to work on
+ * @param reply* Reply to append COUNT and STAT messages to
+ *
+ * */
+static void dispatch_stats(dispatch *d, reply *r)
+{
+  reply *res = reply_init();
+  if(d->stats) {
+    stats_report(d->stats, res);
+  }
+  char cbuf[32] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu", reply_count(res));
+  reply_add(r, "COUNT:", cbuf);
+  reply_append(r, res);
+  reply_destroy(res);
+}
+
+/**
+ * @brief Handles a PLAN request, e.g. "PLAN:kcal=2000/100&protein=120&include=Milk|Bread"
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The parameters
+ * @param reply* Reply to append COUNT and PLAN messages to
+ *
+ * */
+static void dispatch_plan(dispatch *d, int client, char *params, reply *r)
+{
+  params = dispatch_trim(params);
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d is planning meals for %s", client, params);
+  if(!d->planner || d->router) {
+    /* the foods of a router are on its shards */
+    reply_add(r, "COUNT:", "0");
+    return;
+  }
+  foodlist *fl = dataset_acquire(d->dataset);
+  size_t n = planner_solve(d->planner, fl, params, r);
+  dataset_release(d->dataset, fl);
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu plans for client %d", n, client);
+}
+
+/**
+ * @brief Handles a SIMILAR request, e.g. "SIMILAR:Milk,Whole,3.3% Fat" or "SIMILAR?k=5&less=fat:Milk,Whole,3.3% Fat"
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The parameters, if any, and the name of the food, e.g. "?k=5&less=fat:Milk,Whole,3.3% Fat"
+ * @param reply* Reply to append COUNT and FOOD messages to
+ *
+ * The FOOD messages are the foods with the closest nutrients per 100 g, closest first.
+ *
+ * */
+static void dispatch_similar(dispatch *d, int client, char *msg, reply *r)
+{
+  char *name = strchr(msg, ':');
+  if(!name) {
+    LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected SIMILAR?params:name");
+    reply_add(r, "COUNT:", "0");
+    return;
+  }
+  *name++ = 0;
+  name = dispatch_trim(name);
+
+  size_t k = DISPATCH_SIMILAR_DEFAULT;
+  int less = -1;
+  char *save = NULL;
+  for(char *p = strtok_r(*msg == '?' ? msg + 1 : msg, "&", &save); p; p = strtok_r(NULL, "&", &save)) {
+    if(!strncmp("k=", p, 2)) {
+      k = strtoul(p + 2, NULL, 10);
+    } else if(!strcmp("less=kcal", p)) {
+      less = FOODLIST_KCAL;
+    } else if(!strcmp("less=fat", p)) {
+      less = FOODLIST_FAT;
+    } else if(!strcmp("less=carbo", p)) {
+      less = FOODLIST_CARBO;
+    } else if(!strcmp("less=protein", p)) {
+      less = FOODLIST_PROTEIN;
+    } else {
+      LOGGER_LOG(LOGGER_WARN, "Ignoring unknown similar parameter %s", p);
+    }
+  }
+  if(k == 0 || k > DISPATCH_PAGE_MAX) {
+    k = DISPATCH_PAGE_MAX;
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Client %d is looking for %zu foods similar to %s", client, k, name);
+  if(d->router) {
+    /* the foods of a router are on its shards */
+    reply_add(r, "COUNT:", "0");
+    return;
+  }
+
+  size_t n = 0;
+  foodlist *fl = dataset_acquire(d->dataset);
+  uint64_t start = tracer_clock();
+  food **foods = foodlist_similar(fl, name, k, less, &n);
+  tracer_span("scan", start);
+  start = tracer_clock();
+  char cbuf[32] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t i = 0; i < n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(r, "FOOD:", s);
+    free(s);
+  }
+  free(foods);
+  tracer_span("serialize", start);
+  dataset_release(d->dataset, fl);
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu similar food items for client %d", n, client);
+}
+
+/**
+ * @brief Handles a request on the calling thread
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The received message
+ * @param reply* Reply for the answer messages
+ *
+ * */
+static void dispatch_run(dispatch *d, int client, char *msg, reply *r)
+{
+  if(!strncmp("SEARCH:", msg, 7)) {
+    /* client is searches for something */
+    dispatch_search(d, client, msg + 7, r);
+  } else if(!strncmp("SEARCH?", msg, 7)) {
+    /* client is searching for one page of results */
+    dispatch_search_page(d, client, msg + 7, r, NULL, 0);
+  } else if(!strncmp("FOOD:", msg, 5)) {
+    /* client adds some food */
+    dispatch_food(d, client, msg + 5);
+  } else if(!strncmp("SUBSCRIBE:", msg, 10)) {
+    /* a replica is following the foodlist */
+    dispatch_subscribe(d, client, msg + 10, r);
+  } else if(!strncmp("STATS:", msg, 6)) {
+    /* an operator is reading the counters */
+    dispatch_stats(d, r);
+  } else if(!strncmp("PLAN:", msg, 5)) {
+    /* client wants meal plans for daily targets */
+    dispatch_plan(d, client, msg + 5, r);
+  } else if(!strncmp("SIMILAR", msg, 7) && (msg[7] == ':' || msg[7] == '?')) {
+    /* client looks for a substitute of a food */
+    dispatch_similar(d, client, msg + 7, r);
+  } else {
+    LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected SEARCH|FOOD|SUBSCRIBE|STATS|PLAN|SIMILAR");
+  }
+}
+
+/**
+ * @brief Answers a search on the calling thread without locks, if it is cheap enough
+ * @param dispatch* Pointer to structure to work on
+ * @param int Identifier of the client
+ * @param char* The received message
+ * @param reply* Reply the answer messages are appended to
+ * @return True, if the request was answered, false if it is left to the worker pool
+ *
+ * Only searches over lists the worker pool would not split are answered here, everything else may take
+ * long or writes shared state. Searches use the local cache of the thread instead of the shared one.
+ *
+ * */
+static bool dispatch_run_local(dispatch *d, int client, char *msg, reply *r)
+{
+  if(d->router) {
+    return false;
+  }
+  if(!strncmp("SEARCH:", msg, 7)) {
+    return dispatch_search_local(d, client, msg + 7, r);
+  }
+  if(strncmp("SEARCH?", msg, 7)) {
+    return false;
+  }
+  unsigned long generation = 0;
+  foodlist *fl = dataset_acquire_lockfree(d->dataset, &generation);
+  if(foodlist_count_lockfree(fl) > 2 * DISPATCH_SPLIT_SIZE) {
+    dataset_release_lockfree(d->dataset, fl);
+    return false;
+  }
+  dispatch_search_page(d, client, msg + 7, r, fl, generation);
+  dataset_release_lockfree(d->dataset, fl);
+  return true;
+}
+
+/**
+ * @brief Starts counting a request, if the dispatcher counts requests
+ * @param dispatch* Pointer to structure to work on
+ * @param struct dispatch_request* The request, its message is not handled yet
+ *
+ * */
+static void dispatch_count_start(dispatch *d, struct dispatch_request *req)
+{
+  /* the command is determined before, the handlers modify the message */
+  req->command = STATS_OTHER;
+  req->before = reply_count(req->reply);
+  if(d->stats) {
+    req->command = stats_command_of(req->msg);
+    clock_gettime(CLOCK_MONOTONIC, &req->start);
+  }
+}
+
+/**
+ * @brief Counts an answered request, if the dispatcher counts requests
+ * @param dispatch* Pointer to structure to work on
+ * @param struct dispatch_request* The answered request
+ *
+ * */
+static void dispatch_count_end(dispatch *d, struct dispatch_request *req)
+{
+  if(d->stats) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t ns = (uint64_t)(end.tv_sec - req->start.tv_sec) * 1000000000ULL + end.tv_nsec - req->start.tv_nsec;
+    /* every message after the COUNT message is a result */
+    size_t n = reply_count(req->reply) - req->before;
+    stats_record(d->stats, req->command, ns, n > 0 ? n - 1 : 0);
+  }
+}
+
+/**
+ * @brief Executor task handling a request
+ * @param void* Pointer to a dispatch_request structure
+ *
+ * Requests of dispatch_submit() are counted and freed here, the submitter is told by their function.
+ *
+ * */
+static void dispatch_request_func(void *arg)
+{
+  struct dispatch_request *req = (struct dispatch_request *)arg;
+  uint64_t prev = tracer_set_current(req->trace);
+  tracer_span("queue", req->submitted);
+  dispatch_run(req->dispatch, req->client, req->msg, req->reply);
+  tracer_set_current(prev);
+  if(req->done) {
+    dispatch_count_end(req->dispatch, req);
+    dispatch_done_func done = req->done;
+    void *done_arg = req->arg;
+    free(req);
+    done(done_arg);
+  }
+}
+
+dispatch *dispatch_init(dataset *ds)
+{
+  dispatch *d = (dispatch *)malloc(sizeof(dispatch));
+  d->dataset = ds;
+  d->executor = NULL;
+  d->querycache = NULL;
+  d->replica = NULL;
+  d->router = NULL;
+  d->stats = NULL;
+  d->planner = NULL;
+  d->local = false;
+  return d;
+}
+
+void dispatch_set_executor(dispatch *d, executor *ex)
+{
+  d->executor = ex;
+}
+
+void dispatch_set_querycache(dispatch *d, querycache *qc)
+{
+  d->querycache = qc;
+}
+
+void dispatch_set_replica(dispatch *d, replica *rp)
+{
+  d->replica = rp;
+}
+
+void dispatch_set_router(dispatch *d, router *rt)
+{
+  d->router = rt;
+}
+
+void dispatch_set_stats(dispatch *d, stats *st)
+{
+  d->stats = st;
+}
+
+void dispatch_set_planner(dispatch *d, planner *pl)
+{
+  d->planner = pl;
+}
+
+void dispatch_set_local(dispatch *d, bool local)
+{
+  d->local = local;
+}
+
+bool dispatch_is_long(const char *msg)
+{
+  /* plans search until their time budget runs out */
+  return !strncmp("PLAN:", msg, 5);
+}
+
+void dispatch_handle(dispatch *d, int client, char *msg, reply *r)
+{
+  struct dispatch_request req = { d, client, msg, r, tracer_current(), tracer_clock() };
+  dispatch_count_start(d, &req);
+  if(!d->executor || executor_is_worker(d->executor)) {
+    dispatch_run(d, client, msg, r);
+  } else {
+    /* run the request as a task, so it is executed by the worker pool instead of the connection thread */
+    executor_group *g = executor_group_init();
+    if(dispatch_is_long(msg)) {
+      executor_submit_long(d->executor, g, dispatch_request_func, &req);
+    } else {
+      executor_submit(d->executor, g, dispatch_request_func, &req);
+    }
+    executor_wait(d->executor, g);
+    executor_group_destroy(g);
+  }
+  dispatch_count_end(d, &req);
+}
+
+bool dispatch_submit(dispatch *d, executor_group *g, int client, char *msg, reply *r, dispatch_done_func done,
+                     void *arg)
+{
+  if(d->local) {
+    struct dispatch_request req = { d, client, msg, r, tracer_current(), tracer_clock() };
+    dispatch_count_start(d, &req);
+    if(dispatch_run_local(d, client, msg, r)) {
+      dispatch_count_end(d, &req);
+      return false;
+    }
+  }
+  if(!d->executor || executor_is_worker(d->executor)) {
+    dispatch_handle(d, client, msg, r);
+    return false;
+  }
+  struct dispatch_request *req = (struct dispatch_request *)malloc(sizeof(struct dispatch_request));
+  req->dispatch = d;
+  req->client = client;
+  req->msg = msg;
+  req->reply = r;
+  req->trace = tracer_current();
+  req->submitted = tracer_clock();
+  req->done = done;
+  req->arg = arg;
+  dispatch_count_start(d, req);
+  if(dispatch_is_long(msg)) {
+    executor_submit_long(d->executor, g, dispatch_request_func, req);
+  } else {
+    executor_submit(d->executor, g, dispatch_request_func, req);
+  }
+  return true;
+}
+
+void dispatch_wait(dispatch *d, executor_group *g)
+{
+  if(d->executor) {
+    executor_wait(d->executor, g);
+  }
+}
+
+void dispatch_destroy(dispatch *d)
+{
+  free(d);
+}
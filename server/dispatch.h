@@ -0,0 +1,170 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file dispatch.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible dispatch methods.
+ *
+ * The dispatcher implements the commands of the calory protocol (SEARCH, FOOD, SUBSCRIBE, STATS) independent of the
+ * I/O backend which received them.
+ *
+ */
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "../lib/foodlist.h"
+#include "reply.h"
+#include "executor.h"
+#include "querycache.h"
+#include "dataset.h"
+#include "replica.h"
+#include "router.h"
+#include "stats.h"
+#include "planner.h"
+
+/**
+ *
+ * @brief Forward declaration for dispatch
+ *
+ * */
+typedef struct dispatch dispatch;
+
+/**
+ *
+ * @brief Function called when a request handed to the worker pool is answered
+ *
+ * */
+typedef void (*dispatch_done_func)(void *);
+
+/**
+ * @brief Constructor for dispatch
+ * @param dataset* The dataset the commands are working on
+ * @return A pointer to the dispatch structure, representing the created object
+ *
+ * After using this structure, it must be freed with dispatch_destroy(dispatch *)
+ *
+ * */
+dispatch *dispatch_init(dataset *);
+
+/**
+* @brief Method for setting the worker pool requests are executed on
+* @param dispatch* Pointer to structure to work on
+* @param executor* The executor, or NULL to handle requests on the calling thread
+*
+* Searches over large lists are split into sub-tasks over index ranges of the foodlist.
+*
+* */
+void dispatch_set_executor(dispatch *, executor *);
+
+/**
+* @brief Method for setting the cache for search replies
+* @param dispatch* Pointer to structure to work on
+* @param querycache* The cache, or NULL to search the foodlist for every request
+*
+* */
+void dispatch_set_querycache(dispatch *, querycache *);
+
+/**
+* @brief Method for making the server a replica, which forwards added foods to its primary
+* @param dispatch* Pointer to structure to work on
+* @param replica* The replica, or NULL to add foods to the own dataset
+*
+* */
+void dispatch_set_replica(dispatch *, replica *);
+
+/**
+* @brief Method for making the server a router, which forwards searches and added foods to its shards
+* @param dispatch* Pointer to structure to work on
+* @param router* The router, or NULL to handle the requests with the own dataset
+*
+* */
+void dispatch_set_router(dispatch *, router *);
+
+/**
+* @brief Method for setting the counters of the handled requests, which are also answered to STATS
+* @param dispatch* Pointer to structure to work on
+* @param stats* The counters, or NULL to disable counting
+*
+* */
+void dispatch_set_stats(dispatch *, stats *);
+
+/**
+* @brief Method for setting the planner answering PLAN requests
+* @param dispatch* Pointer to structure to work on
+* @param planner* The planner, or NULL to answer PLAN requests without plans
+*
+* */
+void dispatch_set_planner(dispatch *, planner *);
+
+/**
+* @brief Method for answering cheap searches on the thread submitting them, without any shared lock
+* @param dispatch* Pointer to structure to work on
+* @param bool True, to answer searches over lists the worker pool would not split in dispatch_submit()
+*
+* Meant for the per-core backend, whose event loops must neither wait for each other nor for a long
+* request. Such searches read the foodlist with dataset_acquire_lockfree() and use the local cache of
+* the thread, see querycache_local(). All other requests go to the worker pool.
+*
+* */
+void dispatch_set_local(dispatch *, bool);
+
+/**
+* @brief Method for handling one request message
+* @param dispatch* Pointer to structure to work on
+* @param int Identifier of the client, used for logging
+* @param char* The received message, e.g. "SEARCH:Milk". The buffer may be modified.
+* @param reply* Reply the answer messages are appended to. Requests without answer leave it empty.
+*
+* */
+void dispatch_handle(dispatch *, int, char *, reply *);
+
+/**
+* @brief Method for checking if a request may occupy a worker for a long time, like a PLAN request
+* @param char* The received message
+* @return True, if the request is to be submitted with executor_submit_long()
+*
+* */
+bool dispatch_is_long(const char *);
+
+/**
+* @brief Method for handing one request message to the worker pool without waiting for the answer
+* @param dispatch* Pointer to structure to work on
+* @param executor_group* Group the request task is added to, for waiting until all requests are answered
+* @param int Identifier of the client, used for logging
+* @param char* The received message, it must stay valid until the request is answered
+* @param reply* Reply the answer messages are appended to, it must not be touched until the request is answered
+* @param dispatch_done_func Function called by the worker after the reply is complete
+* @param void* Argument passed to the function
+* @return True, if the request was handed to the worker pool, false if it was handled before returning
+*
+* Event loops use this to keep serving other connections while a request is worked on. Without an
+* executor, or when called by a worker, the request is handled like by dispatch_handle() and the function
+* is not called. The same holds for the searches answered locally, see dispatch_set_local().
+*
+* */
+bool dispatch_submit(dispatch *, executor_group *, int, char *, reply *, dispatch_done_func, void *);
+
+/**
+* @brief Method for waiting until all requests handed to the worker pool with a group are answered
+* @param dispatch* Pointer to structure to work on
+* @param executor_group* The group
+*
+* */
+void dispatch_wait(dispatch *, executor_group *);
+
+/**
+ * @brief Destructor for dispatch
+ * @param dispatch* Pointer to structure to be freed
+ *
+ * The dataset is not freed.
+ *
+ * */
+void dispatch_destroy(dispatch *);
+
+#endif /* DISPATCH_H */
@@ -0,0 +1,375 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file executor.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the executor structure and its member methods.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "executor.h"
+
+/**
+ * @brief A submitted task
+ *
+ */
+struct executor_task {
+  executor_func func; /**< Function to execute */
+  void *arg; /**< Argument for func */
+  executor_group *group; /**< Group the task belongs to */
+  bool long_running; /**< True, if only idle workers and waiters for its own group may take the task */
+};
+
+/**
+ * @brief Double ended queue of tasks, owned by one worker
+ *
+ * The owner pushes and pops at the bottom, thieves take from the top. The ring grows on demand.
+ *
+ */
+struct executor_deque {
+  pthread_mutex_t mutex; /**< Mutex to mutual exclude owner and thieves */
+  struct executor_task **tasks; /**< Ring of tasks */
+  size_t top; /**< Position thieves steal from */
+  size_t bottom; /**< Position the owner pushes to and pops from */
+  size_t cap; /**< Size of the ring */
+};
+
+/**
+ * @brief A worker thread and its deque
+ *
+ */
+struct executor_worker {
+  executor *executor; /**< Executor the worker belongs to */
+  size_t id; /**< Index of the worker */
+  pthread_t thread; /**< Thread of the worker */
+  struct executor_deque deque; /**< Tasks of the worker */
+};
+
+/**
+ * @brief executor structure for representing a work-stealing thread pool
+ *
+ */
+struct executor {
+  struct executor_worker *workers; /**< Array of workers */
+  size_t size; /**< Number of workers */
+  pthread_key_t current; /**< Key for finding the worker structure of the calling thread */
+  pthread_mutex_t sleep_mutex; /**< Mutex for idle workers */
+  pthread_cond_t sleep_cond; /**< Condition idle workers are sleeping on */
+  size_t pending; /**< Number of queued, not yet started tasks */
+  size_t next; /**< Next worker for round robin distribution of external submits */
+  bool shutdown; /**< Flag notifying all workers to shut down */
+};
+
+/**
+ * @brief executor_group structure for representing a set of tasks which can be waited for
+ *
+ */
+struct executor_group {
+  pthread_mutex_t mutex; /**< Mutex to protect count */
+  pthread_cond_t cond; /**< Condition signaled when count drops to zero */
+  size_t count; /**< Number of unfinished tasks */
+};
+
+/**
+ * @brief Pushes a task to the bottom of a deque
+ * @param executor_deque* The deque to work on
+ * @param executor_task* The task to push
+ *
+ * */
+static void deque_push(struct executor_deque *d, struct executor_task *t)
+{
+  pthread_mutex_lock(&d->mutex);
+  if(d->bottom - d->top == d->cap) {
+    struct executor_task **tasks = calloc(d->cap * 2, sizeof(struct executor_task *));
+    for(size_t i = 0; i < d->cap; ++i) {
+      tasks[i] = d->tasks[(d->top + i) % d->cap];
+    }
+    free(d->tasks);
+    d->tasks = tasks;
+    d->bottom -= d->top;
+    d->top = 0;
+    d->cap *= 2;
+  }
+  d->tasks[d->bottom % d->cap] = t;
+  d->bottom++;
+  pthread_mutex_unlock(&d->mutex);
+}
+
+/**
+ * @brief Checks whether a worker may take a task
+ * @param executor_task* The task
+ * @param executor_group* Group the worker waits for, NULL if it is idle
+ * @return True, if the worker may execute the task
+ *
+ * */
+static bool executor_may_take(struct executor_task *t, executor_group *waiting)
+{
+  return !waiting || !t->long_running || t->group == waiting;
+}
+
+/**
+ * @brief Takes a task from the bottom of a deque
+ * @param executor_deque* The deque to work on
+ * @param executor_group* Group the taking worker waits for, NULL if it is idle
+ * @return The task, or NULL if the deque is empty or the worker may not take its bottom task
+ *
+ * */
+static struct executor_task *deque_pop(struct executor_deque *d, executor_group *waiting)
+{
+  struct executor_task *t = NULL;
+  pthread_mutex_lock(&d->mutex);
+  if(d->bottom != d->top && executor_may_take(d->tasks[(d->bottom - 1) % d->cap], waiting)) {
+    d->bottom--;
+    t = d->tasks[d->bottom % d->cap];
+  }
+  pthread_mutex_unlock(&d->mutex);
+  return t;
+}
+
+/**
+ * @brief Takes a task from the top of a deque
+ * @param executor_deque* The deque to work on
+ * @param executor_group* Group the stealing worker waits for, NULL if it is idle
+ * @return The task, or NULL if the deque is empty or the worker may not take its top task
+ *
+ * */
+static struct executor_task *deque_steal(struct executor_deque *d, executor_group *waiting)
+{
+  struct executor_task *t = NULL;
+  pthread_mutex_lock(&d->mutex);
+  if(d->bottom != d->top && executor_may_take(d->tasks[d->top % d->cap], waiting)) {
+    t = d->tasks[d->top % d->cap];
+    d->top++;
+  }
+  pthread_mutex_unlock(&d->mutex);
+  return t;
+}
+
+/**
+ * @brief Finds the next task for a worker, first in its own deque, then in the deques of the others
+ * @param executor_worker* The worker looking for work
+ * @param executor_group* Group the worker waits for, NULL if it is idle
+ * @return The task, or NULL if there is no queued task the worker may take
+ *
+ * */
+static struct executor_task *executor_take(struct executor_worker *w, executor_group *waiting)
+{
+  executor *ex = w->executor;
+  struct executor_task *t = deque_pop(&w->deque, waiting);
+  for(size_t i = 1; t == NULL && i < ex->size; ++i) {
+    t = deque_steal(&ex->workers[(w->id + i) % ex->size].deque, waiting);
+  }
+  if(t) {
+    __atomic_sub_fetch(&ex->pending, 1, __ATOMIC_RELAXED);
+  }
+  return t;
+}
+
+/**
+ * @brief Executes a task and marks it as finished in its group
+ * @param executor_task* The task to run
+ *
+ * */
+static void executor_run(struct executor_task *t)
+{
+  executor_group *g = t->group;
+  t->func(t->arg);
+  free(t);
+  pthread_mutex_lock(&g->mutex);
+  if(--g->count == 0) {
+    pthread_cond_broadcast(&g->cond);
+  }
+  pthread_mutex_unlock(&g->mutex);
+}
+
+/**
+ * @brief Main loop of a worker thread
+ * @param executor_worker* The worker
+ *
+ * */
+static void *executor_worker_func(void *arg)
+{
+  struct executor_worker *w = (struct executor_worker *)arg;
+  executor *ex = w->executor;
+  pthread_setspecific(ex->current, w);
+  while(true) {
+    struct executor_task *t = executor_take(w, NULL);
+    if(t) {
+      executor_run(t);
+      continue;
+    }
+    pthread_mutex_lock(&ex->sleep_mutex);
+    while(__atomic_load_n(&ex->pending, __ATOMIC_RELAXED) == 0 && !ex->shutdown) {
+      pthread_cond_wait(&ex->sleep_cond, &ex->sleep_mutex);
+    }
+    bool done = ex->shutdown && __atomic_load_n(&ex->pending, __ATOMIC_RELAXED) == 0;
+    pthread_mutex_unlock(&ex->sleep_mutex);
+    if(done) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+executor *executor_init(size_t size)
+{
+  if(size == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size = cpus > 0 ? (size_t)cpus : 1;
+  }
+  executor *ex = (executor *)malloc(sizeof(executor));
+  ex->size = size;
+  ex->pending = 0;
+  ex->next = 0;
+  ex->shutdown = false;
+  pthread_key_create(&ex->current, NULL);
+  pthread_mutex_init(&ex->sleep_mutex, NULL);
+  pthread_cond_init(&ex->sleep_cond, NULL);
+  ex->workers = calloc(size, sizeof(struct executor_worker));
+  for(size_t i = 0; i < size; ++i) {
+    struct executor_worker *w = &ex->workers[i];
+    w->executor = ex;
+    w->id = i;
+    pthread_mutex_init(&w->deque.mutex, NULL);
+    w->deque.cap = 64;
+    w->deque.tasks = calloc(w->deque.cap, sizeof(struct executor_task *));
+    w->deque.top = 0;
+    w->deque.bottom = 0;
+  }
+  for(size_t i = 0; i < size; ++i) {
+    pthread_create(&ex->workers[i].thread, NULL, executor_worker_func, &ex->workers[i]);
+  }
+  return ex;
+}
+
+size_t executor_size(executor *ex)
+{
+  return ex->size;
+}
+
+bool executor_is_worker(executor *ex)
+{
+  return pthread_getspecific(ex->current) != NULL;
+}
+
+/**
+ * @brief Queues a task on the deque of the calling worker, or round robin if called by another thread
+ * @param executor* Pointer to structure to work on
+ * @param executor_group* Group the task belongs to
+ * @param executor_func Function to execute
+ * @param void* Argument passed to the function
+ * @param bool True, if waiters for other groups must not take the task
+ *
+ * */
+static void executor_queue(executor *ex, executor_group *g, executor_func func, void *arg, bool long_running)
+{
+  struct executor_task *t = (struct executor_task *)malloc(sizeof(struct executor_task));
+  t->func = func;
+  t->arg = arg;
+  t->group = g;
+  t->long_running = long_running;
+  pthread_mutex_lock(&g->mutex);
+  g->count++;
+  pthread_mutex_unlock(&g->mutex);
+
+  struct executor_worker *w = pthread_getspecific(ex->current);
+  if(!w) {
+    w = &ex->workers[__atomic_fetch_add(&ex->next, 1, __ATOMIC_RELAXED) % ex->size];
+  }
+  __atomic_add_fetch(&ex->pending, 1, __ATOMIC_RELAXED);
+  deque_push(&w->deque, t);
+
+  /* wake up an idle worker */
+  pthread_mutex_lock(&ex->sleep_mutex);
+  pthread_cond_signal(&ex->sleep_cond);
+  pthread_mutex_unlock(&ex->sleep_mutex);
+}
+
+void executor_submit(executor *ex, executor_group *g, executor_func func, void *arg)
+{
+  executor_queue(ex, g, func, arg, false);
+}
+
+void executor_submit_long(executor *ex, executor_group *g, executor_func func, void *arg)
+{
+  executor_queue(ex, g, func, arg, true);
+}
+
+void executor_wait(executor *ex, executor_group *g)
+{
+  struct executor_worker *w = pthread_getspecific(ex->current);
+  pthread_mutex_lock(&g->mutex);
+  while(g->count > 0) {
+    if(!w) {
+      pthread_cond_wait(&g->cond, &g->mutex);
+      continue;
+    }
+    /* workers help out instead of blocking the pool, but not with long tasks of others */
+    pthread_mutex_unlock(&g->mutex);
+    struct executor_task *t = executor_take(w, g);
+    if(t) {
+      executor_run(t);
+      pthread_mutex_lock(&g->mutex);
+      continue;
+    }
+    pthread_mutex_lock(&g->mutex);
+    if(g->count > 0) {
+      /* the remaining tasks are running elsewhere, recheck for new work every millisecond */
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += 1000000;
+      if(ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&g->cond, &g->mutex, &ts);
+    }
+  }
+  pthread_mutex_unlock(&g->mutex);
+}
+
+executor_group *executor_group_init()
+{
+  executor_group *g = (executor_group *)malloc(sizeof(executor_group));
+  pthread_mutex_init(&g->mutex, NULL);
+  pthread_cond_init(&g->cond, NULL);
+  g->count = 0;
+  return g;
+}
+
+void executor_group_destroy(executor_group *g)
+{
+  pthread_mutex_destroy(&g->mutex);
+  pthread_cond_destroy(&g->cond);
+  free(g);
+}
+
+void executor_destroy(executor *ex)
+{
+  pthread_mutex_lock(&ex->sleep_mutex);
+  ex->shutdown = true;
+  pthread_cond_broadcast(&ex->sleep_cond);
+  pthread_mutex_unlock(&ex->sleep_mutex);
+  for(size_t i = 0; i < ex->size; ++i) {
+    pthread_join(ex->workers[i].thread, NULL);
+  }
+  for(size_t i = 0; i < ex->size; ++i) {
+    pthread_mutex_destroy(&ex->workers[i].deque.mutex);
+    free(ex->workers[i].deque.tasks);
+  }
+  free(ex->workers);
+  pthread_key_delete(ex->current);
+  pthread_mutex_destroy(&ex->sleep_mutex);
+  pthread_cond_destroy(&ex->sleep_cond);
+  free(ex);
+}
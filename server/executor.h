@@ -0,0 +1,133 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file executor.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible executor methods.
+ *
+ * The executor is a work-stealing thread pool. Every worker owns a deque of tasks, it takes work from
+ * the bottom of its own deque and steals from the top of the others when it runs dry. Tasks are
+ * collected in groups, which can be waited for. A worker waiting for a group keeps executing tasks,
+ * so tasks may split themselves into sub-tasks without blocking the pool. Long tasks are only taken by
+ * idle workers and by workers waiting for their own group, so a short wait never gets stuck in one.
+ *
+ */
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ *
+ * @brief Forward declaration for executor
+ *
+ * */
+typedef struct executor executor;
+
+/**
+ *
+ * @brief Forward declaration for executor_group
+ *
+ * */
+typedef struct executor_group executor_group;
+
+/**
+ *
+ * @brief Function executed by a task
+ *
+ * */
+typedef void (*executor_func)(void *);
+
+/**
+ * @brief Constructor for executor
+ * @param size_t Number of worker threads, 0 for one worker per online CPU
+ * @return A pointer to the executor structure, representing the created object
+ *
+ * After using this structure, it must be freed with executor_destroy(executor *)
+ *
+ * */
+executor *executor_init(size_t);
+
+/**
+* @brief Method for getting the number of workers of an executor
+* @param executor* Pointer to structure to work on
+* @return Number of worker threads
+*
+* */
+size_t executor_size(executor *);
+
+/**
+* @brief Method for checking if the calling thread is a worker of the executor
+* @param executor* Pointer to structure to work on
+* @return True, if the calling thread is one of the workers, false otherwise
+*
+* */
+bool executor_is_worker(executor *);
+
+/**
+* @brief Method for submitting a task
+* @param executor* Pointer to structure to work on
+* @param executor_group* Group the task belongs to
+* @param executor_func Function to execute
+* @param void* Argument passed to the function
+*
+* Tasks submitted by a worker are pushed to its own deque, others are distributed round robin.
+*
+* */
+void executor_submit(executor *, executor_group *, executor_func, void *);
+
+/**
+* @brief Method for submitting a task which may run for a long time
+* @param executor* Pointer to structure to work on
+* @param executor_group* Group the task belongs to
+* @param executor_func Function to execute
+* @param void* Argument passed to the function
+*
+* Like executor_submit(), but workers waiting for another group do not execute the task while they wait.
+*
+* */
+void executor_submit_long(executor *, executor_group *, executor_func, void *);
+
+/**
+* @brief Method for waiting until all tasks of a group are finished
+* @param executor* Pointer to structure to work on
+* @param executor_group* Group to wait for
+*
+* If called by a worker, the worker executes pending tasks while waiting, except long tasks of other groups.
+*
+* */
+void executor_wait(executor *, executor_group *);
+
+/**
+ * @brief Constructor for executor_group
+ * @return A pointer to the executor_group structure, representing the created object
+ *
+ * After using this structure, it must be freed with executor_group_destroy(executor_group *)
+ *
+ * */
+executor_group *executor_group_init();
+
+/**
+ * @brief Destructor for executor_group
+ * @param executor_group* Pointer to structure to be freed
+ *
+ * */
+void executor_group_destroy(executor_group *);
+
+/**
+ * @brief Destructor for executor
+ * @param executor* Pointer to structure to be freed
+ *
+ * The workers finish the tasks already submitted before they are joined.
+ *
+ * */
+void executor_destroy(executor *);
+
+#endif /* EXECUTOR_H */
@@ -0,0 +1,298 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file logger.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the logger and its rings.
+ *
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include "logger.h"
+
+#define LOGGER_RING_SLOTS 1024 /**< Number of messages a ring holds until the writer drains it */
+#define LOGGER_MSG_LEN 240 /**< Maximum length of a message, longer ones are truncated */
+#define LOGGER_IDLE_MS 10 /**< Time the writer thread waits after it found all rings empty */
+
+/**
+ * @brief One message in a ring
+ *
+ */
+struct logger_entry {
+  uint64_t ts; /**< Time of the message in nanoseconds since the epoch */
+  int level; /**< Level of the message */
+  char msg[LOGGER_MSG_LEN]; /**< The formatted message */
+};
+
+/**
+ * @brief Ring of the messages of one thread
+ *
+ */
+struct logger_ring {
+  struct logger_entry slots[LOGGER_RING_SLOTS]; /**< The messages */
+  size_t head; /**< Number of messages written, only advanced by the owning thread */
+  size_t tail; /**< Number of messages read, only advanced by the writer thread */
+  bool owned; /**< Whether a running thread writes into the ring, taken under the mutex */
+  unsigned int id; /**< Number of the ring, printed as thread */
+  struct logger_ring *next; /**< Next ring */
+};
+
+int logger_threshold = LOGGER_INFO;
+
+/**
+ * @brief Names of the levels, in the order of logger_level
+ *
+ */
+static const char *logger_names[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+static pthread_mutex_t logger_mutex = PTHREAD_MUTEX_INITIALIZER; /**< Mutex protecting the list of rings */
+static pthread_cond_t logger_cond = PTHREAD_COND_INITIALIZER; /**< Condition signalled on stop */
+static pthread_once_t logger_once = PTHREAD_ONCE_INIT; /**< Creates the key once */
+static pthread_key_t logger_key; /**< Key for finding the ring of the calling thread */
+static struct logger_ring *logger_rings = NULL; /**< Rings of all threads which ever logged */
+static unsigned int logger_num_rings = 0; /**< Number of rings */
+static bool logger_running = false; /**< Whether the writer thread drains the rings */
+static bool logger_stopping = false; /**< Flag notifying the writer thread to stop, protected by the mutex */
+static pthread_t logger_thread; /**< The writer thread */
+static logger_format logger_fmt = LOGGER_TEXT; /**< Output format */
+static FILE *logger_out = NULL; /**< Output stream */
+static size_t logger_num_dropped = 0; /**< Number of messages dropped because a ring was full */
+
+/**
+ * @brief Releases the ring of an exiting thread, so it is reused by the next new thread
+ * @param void* The ring
+ *
+ * */
+static void logger_release_ring(void *arg)
+{
+  struct logger_ring *r = (struct logger_ring *)arg;
+  __atomic_store_n(&r->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Creates the key for the rings
+ *
+ * */
+static void logger_create_key()
+{
+  pthread_key_create(&logger_key, logger_release_ring);
+}
+
+/**
+ * @brief Finds the ring of the calling thread, taking a free one or creating one on its first message
+ * @return The ring
+ *
+ * */
+static struct logger_ring *logger_ring_of()
+{
+  pthread_once(&logger_once, logger_create_key);
+  struct logger_ring *r = pthread_getspecific(logger_key);
+  if(r) {
+    return r;
+  }
+  pthread_mutex_lock(&logger_mutex);
+  for(r = logger_rings; r; r = r->next) {
+    if(!__atomic_load_n(&r->owned, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  if(!r) {
+    r = (struct logger_ring *)malloc(sizeof(struct logger_ring));
+    r->head = 0;
+    r->tail = 0;
+    r->id = logger_num_rings++;
+    r->next = logger_rings;
+    /* the writer thread reads the list without the mutex */
+    __atomic_store_n(&logger_rings, r, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&r->owned, true, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&logger_mutex);
+  pthread_setspecific(logger_key, r);
+  return r;
+}
+
+/**
+ * @brief Writes one message to a stream
+ * @param FILE* The stream
+ * @param uint64_t Time of the message in nanoseconds since the epoch
+ * @param int Level of the message
+ * @param unsigned int Number of the thread
+ * @param char* The message
+ *
+ * */
+static void logger_print(FILE *out, uint64_t ts, int level, unsigned int thread, const char *msg)
+{
+  time_t sec = (time_t)(ts / 1000000000ULL);
+  unsigned long usec = (unsigned long)(ts % 1000000000ULL / 1000);
+  if(logger_fmt == LOGGER_JSON) {
+    fprintf(out, "{\"ts\":%ld.%06lu,\"level\":\"%s\",\"thread\":%u,\"msg\":\"", (long)sec, usec,
+            logger_names[level], thread);
+    for(const char *p = msg; *p; ++p) {
+      if(*p == '"' || *p == '\\') {
+        fputc('\\', out);
+        fputc(*p, out);
+      } else if((unsigned char)*p < 0x20) {
+        fprintf(out, "\\u%04x", (unsigned char)*p);
+      } else {
+        fputc(*p, out);
+      }
+    }
+    fputs("\"}\n", out);
+  } else {
+    struct tm tm;
+    char date[32];
+    localtime_r(&sec, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(out, "%s.%06lu %-5s [%u] %s\n", date, usec, logger_names[level], thread, msg);
+  }
+}
+
+/**
+ * @brief Writes all messages of all rings to the output stream
+ * @return Number of written messages
+ *
+ * */
+static size_t logger_drain()
+{
+  size_t n = 0;
+  for(struct logger_ring *r = __atomic_load_n(&logger_rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+    size_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    size_t tail = r->tail;
+    for(; tail != head; ++tail) {
+      struct logger_entry *e = &r->slots[tail % LOGGER_RING_SLOTS];
+      logger_print(logger_out, e->ts, e->level, r->id, e->msg);
+      n++;
+    }
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+  }
+  if(n > 0) {
+    fflush(logger_out);
+  }
+  return n;
+}
+
+/**
+ * @brief Thread function draining the rings until the logger is stopped
+ * @param void* Unused
+ *
+ * */
+static void *logger_thread_func(void *arg)
+{
+  pthread_mutex_lock(&logger_mutex);
+  while(!logger_stopping) {
+    pthread_mutex_unlock(&logger_mutex);
+    size_t n = logger_drain();
+    pthread_mutex_lock(&logger_mutex);
+    if(n == 0 && !logger_stopping) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += LOGGER_IDLE_MS * 1000000L;
+      if(ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&logger_cond, &logger_mutex, &ts);
+    }
+  }
+  pthread_mutex_unlock(&logger_mutex);
+  logger_drain();
+  return NULL;
+}
+
+void logger_start(logger_level level, logger_format format, FILE *out)
+{
+  logger_threshold = level;
+  logger_fmt = format;
+  logger_out = out;
+  logger_stopping = false;
+  __atomic_store_n(&logger_running, true, __ATOMIC_RELEASE);
+  pthread_create(&logger_thread, NULL, logger_thread_func, NULL);
+}
+
+void logger_write(logger_level level, const char *fmt, ...)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint64_t ts = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  va_list ap;
+  va_start(ap, fmt);
+  if(!__atomic_load_n(&logger_running, __ATOMIC_ACQUIRE)) {
+    /* without writer thread, e.g. while starting, the message is written directly */
+    char msg[LOGGER_MSG_LEN];
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    FILE *out = logger_out ? logger_out : stdout;
+    /* one line at a time from concurrent threads */
+    flockfile(out);
+    logger_print(out, ts, level, 0, msg);
+    fflush(out);
+    funlockfile(out);
+    return;
+  }
+  struct logger_ring *r = logger_ring_of();
+  size_t head = r->head;
+  if(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == LOGGER_RING_SLOTS) {
+    va_end(ap);
+    __atomic_add_fetch(&logger_num_dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  struct logger_entry *e = &r->slots[head % LOGGER_RING_SLOTS];
+  e->ts = ts;
+  e->level = level;
+  vsnprintf(e->msg, sizeof(e->msg), fmt, ap);
+  va_end(ap);
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+  if(head - __atomic_load_n(&r->tail, __ATOMIC_RELAXED) == LOGGER_RING_SLOTS / 2) {
+    /* wake the writer early instead of dropping messages, a missed wakeup only delays it */
+    pthread_cond_signal(&logger_cond);
+  }
+}
+
+int logger_parse_level(const char *name, logger_level *level)
+{
+  for(int i = LOGGER_ERROR; i <= LOGGER_DEBUG; ++i) {
+    if(!strcasecmp(name, logger_names[i])) {
+      *level = i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+size_t logger_dropped()
+{
+  return __atomic_load_n(&logger_num_dropped, __ATOMIC_RELAXED);
+}
+
+void logger_stop()
+{
+  if(!__atomic_load_n(&logger_running, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  /* new messages are written directly, the thread drains the rings a last time */
+  __atomic_store_n(&logger_running, false, __ATOMIC_RELEASE);
+  pthread_mutex_lock(&logger_mutex);
+  logger_stopping = true;
+  pthread_cond_signal(&logger_cond);
+  pthread_mutex_unlock(&logger_mutex);
+  pthread_join(logger_thread, NULL);
+  size_t dropped = logger_dropped();
+  if(dropped > 0) {
+    fprintf(logger_out, "%zu log messages were dropped because the writer thread fell behind\n", dropped);
+  }
+  fflush(logger_out);
+}
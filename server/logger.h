@@ -0,0 +1,106 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file logger.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible logger methods.
+ *
+ * The logger keeps the output of the server off the request path. Every thread formats its messages into
+ * a ring buffer of its own, which only it writes and only the writer thread reads, so logging takes no
+ * lock and makes no system call. The writer thread drains the rings to the output stream. A message of a
+ * disabled level costs one comparison, its arguments are not even evaluated. Messages of a full ring are
+ * dropped and counted instead of blocking the request.
+ *
+ */
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ *
+ * @brief Levels of log messages, a level includes all lower ones
+ *
+ * */
+typedef enum logger_level {
+  LOGGER_ERROR, /**< Failures, e.g. a port which cannot be bound */
+  LOGGER_WARN, /**< Misbehaving clients and shards, e.g. protocol errors */
+  LOGGER_INFO, /**< Connections and changes of the food list */
+  LOGGER_DEBUG /**< Every request */
+} logger_level;
+
+/**
+ *
+ * @brief Output formats of the writer thread
+ *
+ * */
+typedef enum logger_format {
+  LOGGER_TEXT, /**< "2026-10-19 12:00:00.000123 INFO [2] message" */
+  LOGGER_JSON /**< One JSON object per line with ts, level, thread and msg */
+} logger_format;
+
+/**
+ * @brief Highest level which is logged, see logger_start()
+ *
+ * */
+extern int logger_threshold;
+
+/**
+ * @brief Logs a message with a format string, if its level is enabled
+ *
+ * */
+#define LOGGER_LOG(level, ...) do { \
+    if((int)(level) <= logger_threshold) { \
+      logger_write((level), __VA_ARGS__); \
+    } \
+  } while(0)
+
+/**
+* @brief Method for starting the writer thread
+* @param logger_level Highest level which is logged
+* @param logger_format Output format
+* @param FILE* Stream the messages are written to
+*
+* Before the writer thread is started and after it is stopped, messages are written directly.
+*
+* */
+void logger_start(logger_level, logger_format, FILE *);
+
+/**
+* @brief Method for logging a message, use LOGGER_LOG() to skip disabled levels cheaply
+* @param logger_level Level of the message
+* @param char* printf() format string of the message, without newline
+*
+* */
+void logger_write(logger_level, const char *, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+* @brief Method for parsing the name of a level
+* @param char* The name, e.g. "debug"
+* @param logger_level* Pointer to a logger_level instance, which is set to the parsed level
+* @return 0 on success, -1 if the name is unknown
+*
+* */
+int logger_parse_level(const char *, logger_level *);
+
+/**
+* @brief Method for getting the number of messages dropped because a ring was full
+* @return Number of dropped messages since the start
+*
+* */
+size_t logger_dropped();
+
+/**
+* @brief Method for stopping the writer thread, after it wrote all pending messages
+*
+* */
+void logger_stop();
+
+#endif /* LOGGER_H */
@@ -0,0 +1,635 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file planner.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the planner and its branch and bound search.
+ *
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <float.h>
+#include <pthread.h>
+#include <time.h>
+#include "../lib/food.h"
+#include "logger.h"
+#include "tracer.h"
+#include "planner.h"
+
+#define PLANNER_NUTRIENTS 4 /**< Nutrients a plan is built for: kcal, fat, carbo and protein */
+#define PLANNER_MAX_ITEMS 10 /**< Maximum number of foods of a plan */
+#define PLANNER_MAX_PORTIONS 10 /**< Maximum number of portions of a food in a plan */
+#define PLANNER_MAX_PLANS 50 /**< Maximum number of plans of a reply */
+#define PLANNER_MAX_PREFIXES 16 /**< Maximum number of included or excluded name prefixes */
+#define PLANNER_MAX_BUDGET_MS 5000 /**< Maximum time budget of a search */
+#define PLANNER_CHECK_NODES 1024 /**< Number of combinations a task tries between two looks at the clock */
+#define PLANNER_MSG_LEN 4096 /**< Maximum length of a PLAN message, like any message of the protocol */
+
+/**
+ * @brief planner structure for representing the search for meal plans
+ *
+ */
+struct planner {
+  executor *executor; /**< Worker pool the searches are run on */
+  int slots; /**< Number of workers which may still start searching for plans, updated atomically */
+};
+
+/**
+ * @brief Parameters of a PLAN request
+ *
+ */
+struct planner_query {
+  bool set[PLANNER_NUTRIENTS]; /**< Whether a target is given for the nutrient */
+  int target[PLANNER_NUTRIENTS]; /**< Daily targets */
+  int tolerance[PLANNER_NUTRIENTS]; /**< Allowed deviations from the targets */
+  char *include[PLANNER_MAX_PREFIXES]; /**< Name prefixes of the foods to use, all foods if there is none */
+  size_t includes; /**< Number of included prefixes */
+  char *exclude[PLANNER_MAX_PREFIXES]; /**< Name prefixes of the foods not to use */
+  size_t excludes; /**< Number of excluded prefixes */
+  int portions; /**< Maximum number of portions of a food */
+  int items; /**< Maximum number of foods of a plan */
+  size_t plans; /**< Number of plans to return */
+  unsigned int budget_ms; /**< Time budget of the search in milliseconds */
+};
+
+/**
+ * @brief A meal plan
+ *
+ */
+struct planner_plan {
+  double score; /**< Sum of the deviations from the targets, each in units of its tolerance */
+  int total[PLANNER_NUTRIENTS]; /**< Nutrients of the plan */
+  int len; /**< Number of foods */
+  size_t food[PLANNER_MAX_ITEMS]; /**< Positions of the foods among the candidates */
+  int portions[PLANNER_MAX_ITEMS]; /**< Portions of the foods */
+};
+
+/**
+ * @brief A food which may be used in a plan, with its sort key
+ *
+ */
+struct planner_candidate {
+  double key; /**< Contribution of a portion to the targets, the candidates are sorted descending by it */
+  food *food; /**< The food */
+};
+
+/**
+ * @brief State of one PLAN request, shared by its tasks
+ *
+ */
+struct planner_search {
+  struct planner_query *query; /**< Parameters of the request */
+  size_t n; /**< Number of candidates */
+  food **foods; /**< The candidates in search order */
+  int *values[PLANNER_NUTRIENTS]; /**< Nutrients of a portion of every candidate, one column per nutrient */
+  int64_t *suffix_sum[PLANNER_NUTRIENTS]; /**< Nutrients of all portions of the candidates from a position on */
+  int *suffix_max[PLANNER_NUTRIENTS]; /**< Largest portion of a nutrient among the candidates from a position on */
+  uint64_t deadline; /**< End of the time budget, in nanoseconds of CLOCK_MONOTONIC */
+  bool stopped; /**< Whether the time budget ran out, updated atomically */
+  uint64_t nodes; /**< Number of tried combinations, updated atomically */
+  pthread_mutex_t mutex; /**< Mutex protecting the best plans */
+  struct planner_plan *best; /**< Best plans found so far, sorted by score */
+  size_t num_best; /**< Number of best plans */
+  double bound; /**< Score a plan has to beat, the worst best plan once there are enough, read atomically */
+};
+
+/**
+ * @brief One task of a search, covering every stride-th candidate as first food
+ *
+ */
+struct planner_part {
+  struct planner_search *search; /**< The search */
+  size_t first; /**< First candidate of the first level */
+  size_t stride; /**< Distance between the candidates of the first level */
+  uint64_t nodes; /**< Number of tried combinations */
+  uint64_t checked; /**< Number of tried combinations at the last look at the clock */
+  int total[PLANNER_NUTRIENTS]; /**< Nutrients of the current combination */
+  size_t food[PLANNER_MAX_ITEMS]; /**< Candidates of the current combination */
+  int portions[PLANNER_MAX_ITEMS]; /**< Portions of the candidates of the current combination */
+  uint64_t trace; /**< Traced request the search belongs to, 0 if it is not traced */
+};
+
+/**
+ * @brief Names of the nutrients, as parameters and in PLAN messages
+ *
+ */
+static const char *planner_names[PLANNER_NUTRIENTS] = { "kcal", "fat", "carbo", "protein" };
+
+/**
+ * @brief Gets the monotonic time in nanoseconds
+ * @return Nanoseconds since an arbitrary point in time
+ *
+ * */
+static uint64_t planner_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Gets a nutrient of a food
+ * @param food* The food
+ * @param int Index of the nutrient in planner_names
+ * @return The nutrient of a portion, negative if it is unknown
+ *
+ * */
+static int planner_value(food *f, int nutrient)
+{
+  switch(nutrient) {
+  case 0:
+    return food_get_kcal(f);
+  case 1:
+    return food_get_fat(f);
+  case 2:
+    return food_get_carbo(f);
+  default:
+    return food_get_protein(f);
+  }
+}
+
+/**
+ * @brief Splits a list of name prefixes separated by '|'
+ * @param char* The list, it is modified
+ * @param char** Array the prefixes are stored in, with PLANNER_MAX_PREFIXES entries
+ * @return Number of prefixes, further ones are ignored
+ *
+ * */
+static size_t planner_split(char *list, char **prefixes)
+{
+  size_t n = 0;
+  char *save = NULL;
+  for(char *p = strtok_r(list, "|", &save); p && n < PLANNER_MAX_PREFIXES; p = strtok_r(NULL, "|", &save)) {
+    prefixes[n++] = p;
+  }
+  return n;
+}
+
+/**
+ * @brief Parses the parameters of a PLAN request
+ * @param char* The parameters, e.g. "kcal=2000/100&protein=120&portions=2", they are modified
+ * @param planner_query* The query which is filled
+ * @return True, if at least one target is given, false otherwise
+ *
+ * A target is given as "value/tolerance", without tolerance 10% of the value are allowed.
+ *
+ * */
+static bool planner_parse(char *params, struct planner_query *q)
+{
+  memset(q, 0, sizeof(struct planner_query));
+  q->portions = 3;
+  q->items = 5;
+  q->plans = 5;
+  q->budget_ms = 200;
+  bool targets = false;
+  char *save = NULL;
+  for(char *p = strtok_r(params, "&", &save); p; p = strtok_r(NULL, "&", &save)) {
+    char *value = strchr(p, '=');
+    if(!value) {
+      LOGGER_LOG(LOGGER_WARN, "Ignoring plan parameter %s without value", p);
+      continue;
+    }
+    *value++ = 0;
+    int nutrient = -1;
+    for(int i = 0; i < PLANNER_NUTRIENTS; ++i) {
+      if(!strcmp(planner_names[i], p)) {
+        nutrient = i;
+      }
+    }
+    if(nutrient >= 0) {
+      char *tolerance = strchr(value, '/');
+      q->target[nutrient] = atoi(value);
+      q->tolerance[nutrient] = tolerance ? atoi(tolerance + 1) : q->target[nutrient] / 10;
+      if(q->tolerance[nutrient] < 1) {
+        q->tolerance[nutrient] = 1;
+      }
+      q->set[nutrient] = q->target[nutrient] >= 0;
+      targets |= q->set[nutrient];
+    } else if(!strcmp("include", p)) {
+      q->includes = planner_split(value, q->include);
+    } else if(!strcmp("exclude", p)) {
+      q->excludes = planner_split(value, q->exclude);
+    } else if(!strcmp("portions", p)) {
+      q->portions = atoi(value);
+    } else if(!strcmp("items", p)) {
+      q->items = atoi(value);
+    } else if(!strcmp("plans", p)) {
+      q->plans = strtoul(value, NULL, 10);
+    } else if(!strcmp("budget", p)) {
+      q->budget_ms = strtoul(value, NULL, 10);
+    } else {
+      LOGGER_LOG(LOGGER_WARN, "Ignoring unknown plan parameter %s", p);
+    }
+  }
+  if(q->portions < 1 || q->portions > PLANNER_MAX_PORTIONS) {
+    q->portions = q->portions < 1 ? 1 : PLANNER_MAX_PORTIONS;
+  }
+  if(q->items < 1 || q->items > PLANNER_MAX_ITEMS) {
+    q->items = q->items < 1 ? 1 : PLANNER_MAX_ITEMS;
+  }
+  if(q->plans < 1 || q->plans > PLANNER_MAX_PLANS) {
+    q->plans = q->plans < 1 ? 1 : PLANNER_MAX_PLANS;
+  }
+  if(q->budget_ms < 1 || q->budget_ms > PLANNER_MAX_BUDGET_MS) {
+    q->budget_ms = q->budget_ms < 1 ? 1 : PLANNER_MAX_BUDGET_MS;
+  }
+  return targets;
+}
+
+/**
+ * @brief Checks if a name starts with one of some prefixes, ignoring case
+ * @param char* The name
+ * @param char** The prefixes
+ * @param size_t Number of prefixes
+ * @return True, if one prefix matches, false otherwise
+ *
+ * */
+static bool planner_prefixed(const char *name, char **prefixes, size_t n)
+{
+  for(size_t i = 0; i < n; ++i) {
+    if(!strncasecmp(prefixes[i], name, strlen(prefixes[i]))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Compare function for sorting the candidates descending by their key with qsort()
+ * @param void* Pointer to the first candidate
+ * @param void* Pointer to the second candidate
+ * @return An integer less than, equal to, or greater than zero, if the first candidate comes first, equal,
+ *         or later
+ *
+ * */
+static int planner_cmp(const void *a, const void *b)
+{
+  double ka = ((const struct planner_candidate *)a)->key;
+  double kb = ((const struct planner_candidate *)b)->key;
+  return ka > kb ? -1 : ka < kb ? 1 : 0;
+}
+
+/**
+ * @brief Collects the foods which may be used in a plan into columns, with the bounds for pruning
+ * @param planner_search* The search, its query is set
+ * @param foodlist* The foods
+ *
+ * Candidates contributing most to the targets come first, so the remaining candidates of a branch soon
+ * cannot reach the targets anymore. Foods with unknown nutrients or without any targeted one are skipped.
+ *
+ * */
+static void planner_candidates(struct planner_search *s, foodlist *fl)
+{
+  struct planner_query *q = s->query;
+  size_t total = 0;
+  food **foods = foodlist_get_range(fl, 0, (size_t) -1, &total);
+  struct planner_candidate *c = calloc(total + 1, sizeof(struct planner_candidate));
+  size_t n = 0;
+  for(size_t i = 0; i < total; ++i) {
+    const char *name = food_get_name(foods[i]);
+    if((q->includes > 0 && !planner_prefixed(name, q->include, q->includes))
+        || planner_prefixed(name, q->exclude, q->excludes)) {
+      continue;
+    }
+    double key = 0;
+    bool known = true;
+    for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+      int v = planner_value(foods[i], j);
+      if(q->set[j]) {
+        known &= v >= 0;
+        key += q->target[j] > 0 ? (double)v / q->target[j] : v;
+      }
+    }
+    if(known && key > 0) {
+      c[n].key = key;
+      c[n++].food = foods[i];
+    }
+  }
+  free(foods);
+  qsort(c, n, sizeof(struct planner_candidate), planner_cmp);
+
+  s->n = n;
+  s->foods = calloc(n + 1, sizeof(food *));
+  for(size_t i = 0; i < n; ++i) {
+    s->foods[i] = c[i].food;
+  }
+  free(c);
+  for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+    s->values[j] = calloc(n + 1, sizeof(int));
+    s->suffix_sum[j] = calloc(n + 1, sizeof(int64_t));
+    s->suffix_max[j] = calloc(n + 1, sizeof(int));
+    for(size_t i = 0; i < n; ++i) {
+      int v = planner_value(s->foods[i], j);
+      s->values[j][i] = v > 0 ? v : 0;
+    }
+    for(size_t i = n; i-- > 0;) {
+      int v = s->values[j][i];
+      s->suffix_sum[j][i] = s->suffix_sum[j][i + 1] + (int64_t)v * q->portions;
+      s->suffix_max[j][i] = v > s->suffix_max[j][i + 1] ? v : s->suffix_max[j][i + 1];
+    }
+  }
+}
+
+/**
+ * @brief Checks if the time budget of a search ran out, looking at the clock only now and then
+ * @param planner_part* The task
+ * @return True, if the search has to stop
+ *
+ * */
+static bool planner_expired(struct planner_part *p)
+{
+  struct planner_search *s = p->search;
+  if(__atomic_load_n(&s->stopped, __ATOMIC_RELAXED)) {
+    return true;
+  }
+  if(p->nodes - p->checked >= PLANNER_CHECK_NODES) {
+    p->checked = p->nodes;
+    if(planner_now() >= s->deadline) {
+      __atomic_store_n(&s->stopped, true, __ATOMIC_RELAXED);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Checks if adding candidates from a position on may still lead to a plan better than the best ones
+ * @param planner_part* The task with the current combination
+ * @param size_t Position of the next candidate
+ * @param int Number of foods which may still be added
+ * @return False, if no plan can be reached, true otherwise
+ *
+ * The bounds only shrink with the position, so a failed check ends the candidates of a level.
+ *
+ * */
+static bool planner_promising(struct planner_part *p, size_t i, int slots)
+{
+  struct planner_search *s = p->search;
+  struct planner_query *q = s->query;
+  double lower = 0;
+  for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+    if(!q->set[j]) {
+      continue;
+    }
+    /* the most the remaining candidates can add */
+    int64_t reach = s->suffix_sum[j][i];
+    int64_t most = (int64_t)slots * q->portions * s->suffix_max[j][i];
+    if(most < reach) {
+      reach = most;
+    }
+    int64_t cur = p->total[j];
+    if(cur + reach < q->target[j] - q->tolerance[j]) {
+      return false;
+    }
+    /* deviations which cannot be avoided anymore */
+    if(cur > q->target[j]) {
+      lower += (double)(cur - q->target[j]) / q->tolerance[j];
+    } else if(cur + reach < q->target[j]) {
+      lower += (double)(q->target[j] - cur - reach) / q->tolerance[j];
+    }
+  }
+  double bound;
+  __atomic_load(&s->bound, &bound, __ATOMIC_RELAXED);
+  return lower < bound;
+}
+
+/**
+ * @brief Offers the current combination of a task as plan, if it is within the tolerances
+ * @param planner_part* The task
+ * @param int Number of foods of the combination
+ *
+ * */
+static void planner_offer(struct planner_part *p, int len)
+{
+  struct planner_search *s = p->search;
+  struct planner_query *q = s->query;
+  double score = 0;
+  for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+    if(!q->set[j]) {
+      continue;
+    }
+    int dev = abs(p->total[j] - q->target[j]);
+    if(dev > q->tolerance[j]) {
+      return;
+    }
+    score += (double)dev / q->tolerance[j];
+  }
+  double bound;
+  __atomic_load(&s->bound, &bound, __ATOMIC_RELAXED);
+  if(score >= bound) {
+    return;
+  }
+  pthread_mutex_lock(&s->mutex);
+  size_t pos;
+  if(s->num_best < q->plans) {
+    pos = s->num_best++;
+  } else if(score < s->best[q->plans - 1].score) {
+    /* the worst plan is dropped */
+    pos = q->plans - 1;
+  } else {
+    pthread_mutex_unlock(&s->mutex);
+    return;
+  }
+  while(pos > 0 && s->best[pos - 1].score > score) {
+    s->best[pos] = s->best[pos - 1];
+    pos--;
+  }
+  struct planner_plan *plan = &s->best[pos];
+  plan->score = score;
+  memcpy(plan->total, p->total, sizeof(plan->total));
+  plan->len = len;
+  memcpy(plan->food, p->food, len * sizeof(size_t));
+  memcpy(plan->portions, p->portions, len * sizeof(int));
+  if(s->num_best == q->plans) {
+    __atomic_store(&s->bound, &s->best[q->plans - 1].score, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&s->mutex);
+}
+
+/**
+ * @brief Tries all combinations extending the current one of a task with candidates from a position on
+ * @param planner_part* The task
+ * @param size_t Position of the first candidate to add
+ * @param size_t Distance between the candidates to add
+ * @param int Number of foods of the current combination
+ *
+ * */
+static void planner_branch(struct planner_part *p, size_t from, size_t step, int depth)
+{
+  struct planner_search *s = p->search;
+  struct planner_query *q = s->query;
+  int slots = q->items - depth;
+  for(size_t i = from; i < s->n; i += step) {
+    if(planner_expired(p) || !planner_promising(p, i, slots)) {
+      return;
+    }
+    int k = 0;
+    bool over = false;
+    while(k < q->portions && !over) {
+      k++;
+      p->nodes++;
+      for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+        p->total[j] += s->values[j][i];
+        /* nutrients only grow, more portions or foods cannot help anymore */
+        over |= q->set[j] && p->total[j] > q->target[j] + q->tolerance[j];
+      }
+      if(!over) {
+        p->food[depth] = i;
+        p->portions[depth] = k;
+        planner_offer(p, depth + 1);
+        if(slots > 1) {
+          planner_branch(p, i + 1, 1, depth + 1);
+        }
+      }
+    }
+    for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+      p->total[j] -= k * s->values[j][i];
+    }
+  }
+}
+
+/**
+ * @brief Executor task searching the combinations of one part of the first level
+ * @param void* Pointer to a planner_part structure
+ *
+ * */
+static void planner_part_func(void *arg)
+{
+  struct planner_part *p = (struct planner_part *)arg;
+  uint64_t prev = tracer_set_current(p->trace);
+  uint64_t start = tracer_clock();
+  planner_branch(p, p->first, p->stride, 0);
+  __atomic_add_fetch(&p->search->nodes, p->nodes, __ATOMIC_RELAXED);
+  tracer_span("plan", start);
+  tracer_set_current(prev);
+}
+
+/**
+ * @brief Appends a plan to a reply as PLAN message
+ * @param planner_search* The search
+ * @param planner_plan* The plan
+ * @param reply* The reply
+ *
+ * */
+static void planner_reply(struct planner_search *s, struct planner_plan *plan, reply *r)
+{
+  char msg[PLANNER_MSG_LEN];
+  int len = snprintf(msg, sizeof(msg), "score=%.3f", plan->score);
+  for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+    len += snprintf(msg + len, sizeof(msg) - len, ";%s=%d", planner_names[j], plan->total[j]);
+  }
+  len += snprintf(msg + len, sizeof(msg) - len, ";foods=");
+  for(int i = 0; i < plan->len && len < (int)sizeof(msg); ++i) {
+    char *f = food_serialize(s->foods[plan->food[i]]);
+    len += snprintf(msg + len, sizeof(msg) - len, "%s%d*%s", i ? "|" : "", plan->portions[i], f);
+    free(f);
+  }
+  reply_add(r, "PLAN:", msg);
+}
+
+planner *planner_init(executor *ex)
+{
+  planner *pl = (planner *)malloc(sizeof(planner));
+  pl->executor = ex;
+  /* one worker always stays free for searches, a pool of one worker answers every plan as busy */
+  pl->slots = (int)executor_size(ex) - 1;
+  if(pl->slots <= 0) {
+    LOGGER_LOG(LOGGER_WARN, "Answering plans as busy, they need at least 2 workers");
+    pl->slots = 0;
+  }
+  return pl;
+}
+
+size_t planner_solve(planner *pl, foodlist *fl, char *params, reply *r)
+{
+  struct planner_query q;
+  if(!planner_parse(params, &q)) {
+    LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected PLAN:kcal=target/tolerance&...");
+    reply_add(r, "COUNT:", "0");
+    return 0;
+  }
+
+  /* take half of the free workers, so a concurrent plan gets the other half */
+  int slots = __atomic_load_n(&pl->slots, __ATOMIC_RELAXED);
+  int parts = 0;
+  while(slots > 0) {
+    parts = (slots + 1) / 2;
+    if(__atomic_compare_exchange_n(&pl->slots, &slots, slots - parts, false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED)) {
+      break;
+    }
+    parts = 0;
+  }
+  if(parts == 0) {
+    LOGGER_LOG(LOGGER_WARN, "Rejecting plan, the workers for plans are busy");
+    reply_add(r, "COUNT:", "0;busy=1");
+    return 0;
+  }
+
+  struct planner_search s;
+  memset(&s, 0, sizeof(struct planner_search));
+  s.query = &q;
+  s.deadline = planner_now() + q.budget_ms * 1000000ULL;
+  s.bound = DBL_MAX;
+  s.best = calloc(q.plans, sizeof(struct planner_plan));
+  pthread_mutex_init(&s.mutex, NULL);
+  planner_candidates(&s, fl);
+
+  size_t n = parts < (int)s.n ? (size_t)parts : s.n;
+  struct planner_part *p = calloc(n + 1, sizeof(struct planner_part));
+  for(size_t i = 0; i < n; ++i) {
+    p[i].search = &s;
+    p[i].first = i;
+    p[i].stride = n;
+    p[i].trace = tracer_current();
+  }
+  if(n == 1) {
+    planner_part_func(&p[0]);
+  } else if(n > 1) {
+    executor_group *g = executor_group_init();
+    for(size_t i = 0; i < n; ++i) {
+      /* workers waiting for searches must not pick up a part running for the whole budget */
+      executor_submit_long(pl->executor, g, planner_part_func, &p[i]);
+    }
+    executor_wait(pl->executor, g);
+    executor_group_destroy(g);
+  }
+  free(p);
+  __atomic_add_fetch(&pl->slots, parts, __ATOMIC_RELEASE);
+
+  char cbuf[64] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu;nodes=%llu;complete=%d", s.num_best, (unsigned long long)s.nodes, !s.stopped);
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t i = 0; i < s.num_best; ++i) {
+    planner_reply(&s, &s.best[i], r);
+  }
+  LOGGER_LOG(LOGGER_DEBUG, "Found %zu plans among %zu foods after %llu combinations", s.num_best, s.n,
+             (unsigned long long)s.nodes);
+
+  size_t found = s.num_best;
+  pthread_mutex_destroy(&s.mutex);
+  free(s.best);
+  free(s.foods);
+  for(int j = 0; j < PLANNER_NUTRIENTS; ++j) {
+    free(s.values[j]);
+    free(s.suffix_sum[j]);
+    free(s.suffix_max[j]);
+  }
+  return found;
+}
+
+void planner_destroy(planner *pl)
+{
+  free(pl);
+}
@@ -0,0 +1,74 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file planner.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible planner methods.
+ *
+ * The planner answers PLAN requests: it combines portions of foods of the foodlist into meal plans whose
+ * kcal, fat, carbo and protein lie within the tolerances around daily targets, and returns the plans
+ * closest to the targets. The search is a branch and bound over the foods, sorted by how much they
+ * contribute to the targets. A branch is cut, when a nutrient exceeds its target, when the remaining
+ * foods cannot reach a target anymore, or when it cannot beat the worst of the plans found so far.
+ *
+ * The first level of the search is split among tasks on the worker pool, which share the best plans.
+ * Plans may occupy all workers but one together, so searches keep being answered, and every plan stops
+ * after its time budget with the best plans found until then. Pools of a single worker answer no plans.
+ * The parts are long tasks of the executor: workers waiting for the chunks of a search never pick them
+ * up, and the worker answering a PLAN request only runs parts of its own plan, which the slots count.
+ *
+ */
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "../lib/foodlist.h"
+#include "executor.h"
+#include "reply.h"
+
+/**
+ *
+ * @brief Forward declaration for planner
+ *
+ * */
+typedef struct planner planner;
+
+/**
+ * @brief Constructor for planner
+ * @param executor* Worker pool the searches are run on
+ * @return A pointer to the planner structure, representing the created object
+ *
+ * After using this structure, it must be freed with planner_destroy(planner *)
+ *
+ * */
+planner *planner_init(executor *);
+
+/**
+* @brief Method for answering a PLAN request, e.g. "kcal=2000/100&protein=120&include=Milk|Bread"
+* @param planner* Pointer to structure to work on
+* @param foodlist* Foods to build the plans from
+* @param char* The parameters of the request, they are modified
+* @param reply* Reply to append COUNT and PLAN messages to
+* @return Number of returned plans
+*
+* The COUNT message carries the number of plans, the number of searched combinations and whether the
+* search was complete, e.g. "COUNT:5;nodes=183204;complete=0". A PLAN message looks like
+* "PLAN:score=0.42;kcal=2010;fat=68;carbo=255;protein=118;foods=2*Milk,Whole,1 Cup,244,150,8,11,8|1*...",
+* with the number of portions and the serialized food of every food of the plan.
+*
+* */
+size_t planner_solve(planner *, foodlist *, char *, reply *);
+
+/**
+ * @brief Destructor for planner
+ * @param planner* Pointer to structure to be freed
+ *
+ * */
+void planner_destroy(planner *);
+
+#endif /* PLANNER_H */
@@ -0,0 +1,457 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file querycache.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the querycache structure and its member methods.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../lib/foodlist.h"
+#include "querycache.h"
+
+#define QUERYCACHE_SHARDS 16 /**< Number of independently locked shards */
+#define QUERYCACHE_BUCKETS 64 /**< Initial number of hash buckets of a shard */
+
+/**
+ * @brief A cached search
+ *
+ */
+struct querycache_entry {
+  char *key; /**< Case folded search term */
+  uint64_t hash; /**< Hash of the key */
+  reply *reply; /**< Copy of the complete reply */
+  size_t size; /**< Memory accounted for this entry */
+  struct querycache_entry *chain; /**< Next entry in the same hash bucket */
+  struct querycache_entry *prev; /**< More recently used entry */
+  struct querycache_entry *next; /**< Less recently used entry */
+};
+
+/**
+ * @brief One shard of the cache with its own lock, hash table and LRU list
+ *
+ */
+struct querycache_shard {
+  pthread_mutex_t mutex; /**< Mutex protecting the shard */
+  struct querycache_entry **buckets; /**< Hash table */
+  size_t num_buckets; /**< Number of buckets, a power of two */
+  size_t count; /**< Number of entries */
+  size_t size; /**< Memory used by all entries */
+  struct querycache_entry *head; /**< Most recently used entry */
+  struct querycache_entry *tail; /**< Least recently used entry */
+};
+
+/**
+ * @brief querycache structure for representing the search result cache
+ *
+ */
+struct querycache {
+  struct querycache_shard shards[QUERYCACHE_SHARDS]; /**< The shards */
+  size_t shard_capacity; /**< Memory budget of every shard */
+  unsigned long version; /**< Incremented by every invalidation */
+  size_t hits; /**< Number of searches answered from the cache */
+  size_t misses; /**< Number of searches not found in the cache */
+  size_t invalidated; /**< Number of entries removed because a food was added */
+  size_t evicted; /**< Number of entries removed to stay within the budget */
+  size_t capacity; /**< Memory budget of all shards */
+  bool owned; /**< Whether a running thread uses this cache as its local cache, taken under local_mutex */
+  pthread_key_t local; /**< Key for finding the local cache of the calling thread, only of the shared cache */
+  pthread_mutex_t local_mutex; /**< Mutex protecting the list of local caches, only of the shared cache */
+  querycache *shared; /**< Shared cache of a local cache, NULL for the shared cache itself */
+  querycache *locals; /**< Local caches of all threads which ever used one, they receive all invalidations */
+  querycache *next; /**< Next local cache of the same shared cache */
+};
+
+/**
+ * @brief Folds the search term to the key of the cache
+ * @param char* The search term
+ * @return The key, must be freed by the caller
+ *
+ * */
+static char *querycache_key(const char *term)
+{
+  char *key = strdup(term);
+  for(char *p = key; *p; ++p) {
+    *p = tolower((unsigned char)*p);
+  }
+  return key;
+}
+
+/**
+ * @brief FNV-1a hash of a key
+ * @param char* The key
+ * @return The hash value
+ *
+ * */
+static uint64_t querycache_hash(const char *key)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for(const unsigned char *p = (const unsigned char *)key; *p; ++p) {
+    h ^= *p;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/**
+ * @brief Finds the bucket slot pointing to the entry of a key
+ * @param struct querycache_shard* The shard, its mutex must be held
+ * @param char* The key
+ * @param uint64_t Hash of the key
+ * @return Pointer to the slot, which points to NULL if the key is not cached
+ *
+ * */
+static struct querycache_entry **querycache_lookup(struct querycache_shard *sh, const char *key, uint64_t hash)
+{
+  struct querycache_entry **pp = &sh->buckets[(hash / QUERYCACHE_SHARDS) & (sh->num_buckets - 1)];
+  while(*pp && ((*pp)->hash != hash || strcmp((*pp)->key, key))) {
+    pp = &(*pp)->chain;
+  }
+  return pp;
+}
+
+/**
+ * @brief Removes an entry from the LRU list of its shard
+ * @param struct querycache_shard* The shard, its mutex must be held
+ * @param struct querycache_entry* The entry
+ *
+ * */
+static void querycache_unlink_lru(struct querycache_shard *sh, struct querycache_entry *e)
+{
+  if(e->prev) {
+    e->prev->next = e->next;
+  } else {
+    sh->head = e->next;
+  }
+  if(e->next) {
+    e->next->prev = e->prev;
+  } else {
+    sh->tail = e->prev;
+  }
+  e->prev = NULL;
+  e->next = NULL;
+}
+
+/**
+ * @brief Inserts an entry as most recently used one
+ * @param struct querycache_shard* The shard, its mutex must be held
+ * @param struct querycache_entry* The entry
+ *
+ * */
+static void querycache_push_lru(struct querycache_shard *sh, struct querycache_entry *e)
+{
+  e->prev = NULL;
+  e->next = sh->head;
+  if(sh->head) {
+    sh->head->prev = e;
+  } else {
+    sh->tail = e;
+  }
+  sh->head = e;
+}
+
+/**
+ * @brief Removes an entry from its shard and frees it
+ * @param struct querycache_shard* The shard, its mutex must be held
+ * @param struct querycache_entry* The entry
+ *
+ * */
+static void querycache_remove(struct querycache_shard *sh, struct querycache_entry *e)
+{
+  *querycache_lookup(sh, e->key, e->hash) = e->chain;
+  querycache_unlink_lru(sh, e);
+  sh->count--;
+  sh->size -= e->size;
+  reply_destroy(e->reply);
+  free(e->key);
+  free(e);
+}
+
+/**
+ * @brief Doubles the number of hash buckets of a shard
+ * @param struct querycache_shard* The shard, its mutex must be held
+ *
+ * */
+static void querycache_grow(struct querycache_shard *sh)
+{
+  size_t num_buckets = sh->num_buckets * 2;
+  struct querycache_entry **buckets = calloc(num_buckets, sizeof(struct querycache_entry *));
+  for(size_t i = 0; i < sh->num_buckets; ++i) {
+    struct querycache_entry *e = sh->buckets[i];
+    while(e) {
+      struct querycache_entry *next = e->chain;
+      size_t b = (e->hash / QUERYCACHE_SHARDS) & (num_buckets - 1);
+      e->chain = buckets[b];
+      buckets[b] = e;
+      e = next;
+    }
+  }
+  free(sh->buckets);
+  sh->buckets = buckets;
+  sh->num_buckets = num_buckets;
+}
+
+/**
+ * @brief Removes the entry of a search term, if it is cached
+ * @param querycache* Pointer to structure to work on
+ * @param char* The name of a food
+ * @param size_t Length of the prefix of the name which is the search term
+ *
+ * */
+static void querycache_remove_term(querycache *c, const char *name, size_t len)
+{
+  char *term = strndup(name, len);
+  char *key = querycache_key(term);
+  uint64_t hash = querycache_hash(key);
+  struct querycache_shard *sh = &c->shards[hash % QUERYCACHE_SHARDS];
+  pthread_mutex_lock(&sh->mutex);
+  struct querycache_entry *e = *querycache_lookup(sh, key, hash);
+  if(e) {
+    querycache_remove(sh, e);
+    __atomic_add_fetch(&c->invalidated, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&sh->mutex);
+  free(key);
+  free(term);
+}
+
+/**
+ * @brief Releases the local cache of an exiting thread, so it is reused by the next new thread
+ * @param void* The local cache
+ *
+ * */
+static void querycache_release_local(void *arg)
+{
+  querycache *c = (querycache *)arg;
+  /* the entries stay valid, invalidations keep reaching them */
+  __atomic_store_n(&c->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Constructor of the shared cache and of local caches
+ * @param size_t Memory budget in bytes for all cached replies
+ * @param querycache* The shared cache of a local cache, NULL to create a shared cache
+ * @return A pointer to the querycache structure
+ *
+ * */
+static querycache *querycache_create(size_t capacity, querycache *shared)
+{
+  querycache *c = (querycache *)malloc(sizeof(querycache));
+  for(size_t i = 0; i < QUERYCACHE_SHARDS; ++i) {
+    struct querycache_shard *sh = &c->shards[i];
+    pthread_mutex_init(&sh->mutex, NULL);
+    sh->num_buckets = QUERYCACHE_BUCKETS;
+    sh->buckets = calloc(sh->num_buckets, sizeof(struct querycache_entry *));
+    sh->count = 0;
+    sh->size = 0;
+    sh->head = NULL;
+    sh->tail = NULL;
+  }
+  c->shard_capacity = capacity / QUERYCACHE_SHARDS;
+  c->version = 0;
+  c->hits = 0;
+  c->misses = 0;
+  c->invalidated = 0;
+  c->evicted = 0;
+  c->capacity = capacity;
+  c->owned = false;
+  c->shared = shared;
+  if(!shared) {
+    /* local caches are found through the key of their shared cache */
+    pthread_key_create(&c->local, querycache_release_local);
+    pthread_mutex_init(&c->local_mutex, NULL);
+  }
+  c->locals = NULL;
+  c->next = NULL;
+  return c;
+}
+
+querycache *querycache_init(size_t capacity)
+{
+  return querycache_create(capacity, NULL);
+}
+
+querycache *querycache_local(querycache *c)
+{
+  querycache *l = pthread_getspecific(c->local);
+  if(l) {
+    return l;
+  }
+  pthread_mutex_lock(&c->local_mutex);
+  for(l = c->locals; l; l = l->next) {
+    if(!__atomic_load_n(&l->owned, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  if(!l) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    l = querycache_create(c->capacity / (cpus > 0 ? cpus : 1), c);
+    l->next = c->locals;
+    c->locals = l;
+  }
+  __atomic_store_n(&l->owned, true, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&c->local_mutex);
+  pthread_setspecific(c->local, l);
+  return l;
+}
+
+bool querycache_get(querycache *c, const char *term, reply *r)
+{
+  char *key = querycache_key(term);
+  uint64_t hash = querycache_hash(key);
+  struct querycache_shard *sh = &c->shards[hash % QUERYCACHE_SHARDS];
+  pthread_mutex_lock(&sh->mutex);
+  struct querycache_entry *e = *querycache_lookup(sh, key, hash);
+  if(e) {
+    querycache_unlink_lru(sh, e);
+    querycache_push_lru(sh, e);
+    reply_append(r, e->reply);
+  }
+  pthread_mutex_unlock(&sh->mutex);
+  free(key);
+  __atomic_add_fetch(e ? &c->hits : &c->misses, 1, __ATOMIC_RELAXED);
+  return e != NULL;
+}
+
+unsigned long querycache_version(querycache *c)
+{
+  return __atomic_load_n(&c->version, __ATOMIC_ACQUIRE);
+}
+
+void querycache_put(querycache *c, const char *term, reply *r, unsigned long version)
+{
+  char *key = querycache_key(term);
+  size_t size = sizeof(struct querycache_entry) + strlen(key) + 1 + reply_size(r);
+  if(size > c->shard_capacity) {
+    /* would evict the whole shard */
+    free(key);
+    return;
+  }
+  uint64_t hash = querycache_hash(key);
+  struct querycache_shard *sh = &c->shards[hash % QUERYCACHE_SHARDS];
+  pthread_mutex_lock(&sh->mutex);
+  /* compared under the lock, an invalidation sweeping this shard later removes the entry anyway */
+  if(version != querycache_version(c) || *querycache_lookup(sh, key, hash)) {
+    pthread_mutex_unlock(&sh->mutex);
+    free(key);
+    return;
+  }
+  while(sh->size + size > c->shard_capacity && sh->tail) {
+    querycache_remove(sh, sh->tail);
+    __atomic_add_fetch(&c->evicted, 1, __ATOMIC_RELAXED);
+  }
+  if(sh->count >= sh->num_buckets) {
+    querycache_grow(sh);
+  }
+  struct querycache_entry *e = malloc(sizeof(struct querycache_entry));
+  e->key = key;
+  e->hash = hash;
+  e->reply = reply_init();
+  reply_append(e->reply, r);
+  e->size = size;
+  struct querycache_entry **pp = querycache_lookup(sh, key, hash);
+  e->chain = NULL;
+  *pp = e;
+  querycache_push_lru(sh, e);
+  sh->count++;
+  sh->size += size;
+  pthread_mutex_unlock(&sh->mutex);
+}
+
+void querycache_invalidate(querycache *c, const char *name)
+{
+  __atomic_add_fetch(&c->version, 1, __ATOMIC_ACQ_REL);
+  /* only the terms matching the name can be outdated, see foodlist_matches() */
+  size_t len = strlen(name);
+  for(size_t i = 0; i < len; ++i) {
+    if(name[i] == ',') {
+      querycache_remove_term(c, name, i);
+      querycache_remove_term(c, name, i + 1);
+    }
+  }
+  querycache_remove_term(c, name, len);
+  if(!c->shared) {
+    pthread_mutex_lock(&c->local_mutex);
+    for(querycache *l = c->locals; l; l = l->next) {
+      querycache_invalidate(l, name);
+    }
+    pthread_mutex_unlock(&c->local_mutex);
+  }
+}
+
+void querycache_clear(querycache *c)
+{
+  __atomic_add_fetch(&c->version, 1, __ATOMIC_ACQ_REL);
+  for(size_t i = 0; i < QUERYCACHE_SHARDS; ++i) {
+    struct querycache_shard *sh = &c->shards[i];
+    pthread_mutex_lock(&sh->mutex);
+    __atomic_add_fetch(&c->invalidated, sh->count, __ATOMIC_RELAXED);
+    while(sh->head) {
+      querycache_remove(sh, sh->head);
+    }
+    pthread_mutex_unlock(&sh->mutex);
+  }
+  if(!c->shared) {
+    pthread_mutex_lock(&c->local_mutex);
+    for(querycache *l = c->locals; l; l = l->next) {
+      querycache_clear(l);
+    }
+    pthread_mutex_unlock(&c->local_mutex);
+  }
+}
+
+void querycache_print(querycache *c, FILE *out)
+{
+  size_t counters[6] = { 0 };
+  pthread_mutex_lock(&c->local_mutex);
+  /* the shared cache first, then its local caches */
+  for(querycache *l = c; l; l = l == c ? c->locals : l->next) {
+    for(size_t i = 0; i < QUERYCACHE_SHARDS; ++i) {
+      pthread_mutex_lock(&l->shards[i].mutex);
+      counters[4] += l->shards[i].count;
+      counters[5] += l->shards[i].size;
+      pthread_mutex_unlock(&l->shards[i].mutex);
+    }
+    counters[0] += __atomic_load_n(&l->hits, __ATOMIC_RELAXED);
+    counters[1] += __atomic_load_n(&l->misses, __ATOMIC_RELAXED);
+    counters[2] += __atomic_load_n(&l->invalidated, __ATOMIC_RELAXED);
+    counters[3] += __atomic_load_n(&l->evicted, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&c->local_mutex);
+  fprintf(out, "query cache: hits %zu, misses %zu, invalidated %zu, evicted %zu, entries %zu, bytes %zu\n",
+          counters[0], counters[1], counters[2], counters[3], counters[4], counters[5]);
+  fflush(out);
+}
+
+void querycache_destroy(querycache *c)
+{
+  while(c->locals) {
+    querycache *l = c->locals;
+    c->locals = l->next;
+    querycache_destroy(l);
+  }
+  if(!c->shared) {
+    pthread_key_delete(c->local);
+    pthread_mutex_destroy(&c->local_mutex);
+  }
+  for(size_t i = 0; i < QUERYCACHE_SHARDS; ++i) {
+    struct querycache_shard *sh = &c->shards[i];
+    while(sh->head) {
+      querycache_remove(sh, sh->head);
+    }
+    free(sh->buckets);
+    pthread_mutex_destroy(&sh->mutex);
+  }
+  free(c);
+}
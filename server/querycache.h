@@ -0,0 +1,125 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file querycache.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible querycache methods.
+ *
+ * The querycache keeps the complete replies of recent searches, keyed by the case folded search term.
+ * It is split into independently locked shards, every shard evicts its least recently used entries when
+ * it exceeds its share of the memory budget. Adding a food removes exactly the entries whose search term
+ * matches the name of the food: the terms are the prefixes of the name ending at its commas and the whole
+ * name, so they are looked up by key and a write costs the same no matter how many searches are cached.
+ *
+ * Threads which must not share locks with others, like the event loops of the per-core backend, use a
+ * local cache of their own instead. Invalidations and clears of the shared cache are applied to all of
+ * its local caches, which is the only time another thread takes the lock of a local cache.
+ *
+ */
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "reply.h"
+
+/**
+ *
+ * @brief Forward declaration for querycache
+ *
+ * */
+typedef struct querycache querycache;
+
+/**
+ * @brief Constructor for querycache
+ * @param size_t Memory budget in bytes for all cached replies
+ * @return A pointer to the querycache structure, representing the created object
+ *
+ * After using this structure, it must be freed with querycache_destroy(querycache *)
+ *
+ * */
+querycache *querycache_init(size_t);
+
+/**
+* @brief Method for getting the local cache of the calling thread, creating it on the first call
+* @param querycache* Pointer to the shared cache
+* @return The local cache, it is used with the same methods and freed together with the shared cache
+*
+* Every local cache gets the memory budget of the shared cache divided by the number of CPUs. Foods added
+* and reloads have to be reported to the shared cache, which passes them on to the local ones. A local
+* cache has no thread key of its own, only the shared cache takes one.
+*
+* */
+querycache *querycache_local(querycache *);
+
+/**
+* @brief Method for looking up the reply of a search
+* @param querycache* Pointer to structure to work on
+* @param char* The search term
+* @param reply* Reply the cached messages are appended to on a hit
+* @return True, if the search was cached, false otherwise
+*
+* */
+bool querycache_get(querycache *, const char *, reply *);
+
+/**
+* @brief Method for getting the current version of the cache, which changes with every invalidation
+* @param querycache* Pointer to structure to work on
+* @return The version, to be passed to querycache_put()
+*
+* The version has to be read before the foodlist is searched. A reply computed while a food was added
+* is not stored, because it may miss that food.
+*
+* */
+unsigned long querycache_version(querycache *);
+
+/**
+* @brief Method for storing the reply of a search
+* @param querycache* Pointer to structure to work on
+* @param char* The search term
+* @param reply* The complete reply, it is copied
+* @param unsigned long The version returned by querycache_version() before the search
+*
+* */
+void querycache_put(querycache *, const char *, reply *, unsigned long);
+
+/**
+* @brief Method for removing all cached searches which match a food name
+* @param querycache* Pointer to structure to work on
+* @param char* Name of the added or changed food
+*
+* */
+void querycache_invalidate(querycache *, const char *);
+
+/**
+* @brief Method for removing all cached searches, e.g. after the foodlist was replaced
+* @param querycache* Pointer to structure to work on
+*
+* */
+void querycache_clear(querycache *);
+
+/**
+* @brief Method for printing the counters of the cache in one line
+* @param querycache* Pointer to structure to work on
+* @param FILE* Stream to print to
+*
+* The counters of the local caches are included.
+*
+* */
+void querycache_print(querycache *, FILE *);
+
+/**
+ * @brief Destructor for querycache
+ * @param querycache* Pointer to structure to be freed
+ *
+ * */
+void querycache_destroy(querycache *);
+
+#endif /* QUERYCACHE_H */
@@ -0,0 +1,194 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file replica.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the replica structure and its member methods.
+ *
+ * A single thread fetches the replication log batch by batch over a pipelined connection. The cursor of
+ * a batch starts with the generation of the food list of the primary. A batch of another generation than
+ * the cursor it was requested with starts a copy of the whole list, which is built aside and replaces the
+ * foodlist of the dataset once the replica caught up, i.e. once a batch is empty. Until then, searches
+ * are answered from the previous copy.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "../lib/dietclient.h"
+#include "logger.h"
+#include "replica.h"
+
+#define REPLICA_POLL_MS 100 /**< Interval in which an up to date replica asks the primary for new foods */
+#define REPLICA_RETRY_MS 1000 /**< Delay before asking again after a failed request */
+
+/**
+ * @brief replica structure for representing the connection to the primary
+ *
+ */
+struct replica {
+  dietclient *primary; /**< Pipelined connection to the primary */
+  dataset *dataset; /**< Dataset kept in sync */
+  pthread_t thread; /**< Thread fetching the replication log */
+  pthread_mutex_t mutex; /**< Mutex protecting stop */
+  pthread_cond_t cond; /**< Condition signalled when stop is set */
+  bool stop; /**< Set to stop the thread */
+};
+
+/**
+ * @brief Helper function to wait before the next request
+ * @param replica* Pointer to structure to work on
+ * @param unsigned int The delay in ms
+ * @return True, if the replica is stopped, false otherwise
+ *
+ * */
+static bool replica_wait(replica *r, unsigned int ms)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000L;
+  if(ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_lock(&r->mutex);
+  while(!r->stop && pthread_cond_timedwait(&r->cond, &r->mutex, &ts) == 0) {
+  }
+  bool ret = r->stop;
+  pthread_mutex_unlock(&r->mutex);
+  return ret;
+}
+
+/**
+ * @brief Helper function to get the generation of the food list of the primary a cursor belongs to
+ * @param char* The cursor, "<generation>-<position>" in hex
+ * @return The generation
+ *
+ * */
+static unsigned long replica_generation(const char *cursor)
+{
+  return strtoul(cursor, NULL, 16);
+}
+
+/**
+ * @brief Main function of the thread fetching the replication log
+ * @param void* The replica
+ * @return Always NULL
+ *
+ * */
+static void *replica_thread_func(void *arg)
+{
+  replica *r = arg;
+  char *cursor = NULL;
+  foodlist *copy = NULL;
+  for(;;) {
+    /* checked under the mutex, the client is destroyed once stop is set */
+    pthread_mutex_lock(&r->mutex);
+    if(r->stop) {
+      pthread_mutex_unlock(&r->mutex);
+      break;
+    }
+    dietclient_future *fu = dietclient_subscribe_async(r->primary, cursor);
+    pthread_mutex_unlock(&r->mutex);
+
+    food **foods = NULL;
+    size_t n = 0;
+    dietclient_status status = dietclient_future_wait(fu, &foods, &n);
+    const char *next = dietclient_future_cursor(fu);
+    if(status != DIETCLIENT_OK || !next) {
+      if(status == DIETCLIENT_OK) {
+        LOGGER_LOG(LOGGER_WARN, "Error in protocol, replication log without cursor");
+      }
+      for(size_t i = 0; i < n; ++i) {
+        food_destroy(foods[i]);
+      }
+      free(foods);
+      dietclient_future_destroy(fu);
+      if(replica_wait(r, REPLICA_RETRY_MS)) {
+        break;
+      }
+      continue;
+    }
+
+    if(!cursor || replica_generation(next) != replica_generation(cursor)) {
+      /* the primary replaced its food list, copy it from the start */
+      if(copy) {
+        foodlist_destroy(copy);
+      }
+      copy = foodlist_init();
+      LOGGER_LOG(LOGGER_INFO, "Copying the food list of the primary");
+    }
+    if(copy) {
+      for(size_t i = 0; i < n; ++i) {
+        foodlist_append(copy, &foods[i]);
+      }
+    } else if(n > 0) {
+      dataset_apply(r->dataset, foods, n);
+    }
+    free(foods);
+    free(cursor);
+    cursor = strdup(next);
+    dietclient_future_destroy(fu);
+
+    if(n > 0) {
+      /* there may be more, do not wait */
+      continue;
+    }
+    if(copy) {
+      int count = foodlist_count(copy);
+      dataset_replace(r->dataset, copy);
+      copy = NULL;
+      LOGGER_LOG(LOGGER_INFO, "Replica is in sync with the primary, %d foods", count);
+    }
+    if(replica_wait(r, REPLICA_POLL_MS)) {
+      break;
+    }
+  }
+  if(copy) {
+    foodlist_destroy(copy);
+  }
+  free(cursor);
+  return NULL;
+}
+
+replica *replica_init(const char *host, unsigned int port, dataset *ds)
+{
+  replica *r = (replica *)malloc(sizeof(replica));
+  r->primary = dietclient_init(host, port, 1);
+  r->dataset = ds;
+  pthread_mutex_init(&r->mutex, NULL);
+  pthread_cond_init(&r->cond, NULL);
+  r->stop = false;
+  pthread_create(&r->thread, NULL, replica_thread_func, r);
+  return r;
+}
+
+void replica_forward(replica *r, food *f)
+{
+  /* the food comes back with the replication log */
+  dietclient_add(r->primary, f, NULL, NULL);
+  food_destroy(f);
+}
+
+void replica_destroy(replica *r)
+{
+  pthread_mutex_lock(&r->mutex);
+  r->stop = true;
+  pthread_cond_broadcast(&r->cond);
+  pthread_mutex_unlock(&r->mutex);
+  /* completes a request still waiting for the primary */
+  dietclient_destroy(r->primary);
+  pthread_join(r->thread, NULL);
+  pthread_mutex_destroy(&r->mutex);
+  pthread_cond_destroy(&r->cond);
+  free(r);
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file replica.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible replica methods.
+ *
+ * A replica keeps the dataset of a server in sync with another server, the primary. It copies all foods
+ * of the primary first and then fetches the foods added to the primary from its replication log, see the
+ * SUBSCRIBE command. When the primary reloads its food list, the replica copies it again and replaces its
+ * own foodlist at once. Foods added by clients of the replica are forwarded to the primary and reach the
+ * replica through the log, like all other additions.
+ *
+ */
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "../lib/food.h"
+#include "dataset.h"
+
+/**
+ *
+ * @brief Forward declaration for replica
+ *
+ * */
+typedef struct replica replica;
+
+/**
+ * @brief Constructor for replica, starts following the primary in the background
+ * @param char* IPv4 address of the primary, or path of its Unix domain socket if it contains a slash
+ * @param unsigned int Port of the primary, ignored for Unix domain sockets
+ * @param dataset* The dataset kept in sync, it should start empty
+ * @return A pointer to the replica structure, representing the created object
+ *
+ * After using this structure, it must be freed with replica_destroy(replica *)
+ *
+ * */
+replica *replica_init(const char *, unsigned int, dataset *);
+
+/**
+* @brief Method for forwarding a food added by a client to the primary
+* @param replica* Pointer to structure to work on
+* @param food* The food, it is freed
+*
+* */
+void replica_forward(replica *, food *);
+
+/**
+ * @brief Destructor for replica, stops following the primary
+ * @param replica* Pointer to structure to be freed
+ *
+ * The dataset is not freed.
+ *
+ * */
+void replica_destroy(replica *);
+
+#endif /* REPLICA_H */
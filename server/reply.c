@@ -0,0 +1,130 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file reply.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the reply structure and its member methods.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "reply.h"
+
+/**
+ * @brief reply structure for representing the messages of a server answer
+ *
+ */
+struct reply {
+  char *buf; /**< Zero terminated messages, stored back to back */
+  size_t len; /**< Used bytes of buf */
+  size_t cap; /**< Allocated bytes of buf */
+  size_t *offsets; /**< Start of every message in buf */
+  size_t count; /**< Number of messages */
+  size_t offcap; /**< Allocated entries of offsets */
+};
+
+reply *reply_init()
+{
+  reply *r = (reply *)malloc(sizeof(reply));
+  r->cap = 4096;
+  r->buf = malloc(r->cap);
+  r->len = 0;
+  r->offcap = 16;
+  r->offsets = calloc(r->offcap, sizeof(size_t));
+  r->count = 0;
+  return r;
+}
+
+void reply_add(reply *r, const char *type, const char *data)
+{
+  size_t tlen = strlen(type);
+  size_t dlen = strlen(data);
+  while(r->len + tlen + dlen + 1 > r->cap) {
+    r->cap *= 2;
+    r->buf = realloc(r->buf, r->cap);
+  }
+  if(r->count == r->offcap) {
+    r->offcap *= 2;
+    r->offsets = realloc(r->offsets, r->offcap * sizeof(size_t));
+  }
+  r->offsets[r->count++] = r->len;
+  memcpy(r->buf + r->len, type, tlen);
+  memcpy(r->buf + r->len + tlen, data, dlen + 1);
+  r->len += tlen + dlen + 1;
+}
+
+void reply_append(reply *r, reply *src)
+{
+  while(r->len + src->len > r->cap) {
+    r->cap *= 2;
+    r->buf = realloc(r->buf, r->cap);
+  }
+  while(r->count + src->count > r->offcap) {
+    r->offcap *= 2;
+    r->offsets = realloc(r->offsets, r->offcap * sizeof(size_t));
+  }
+  memcpy(r->buf + r->len, src->buf, src->len);
+  for(size_t i = 0; i < src->count; ++i) {
+    r->offsets[r->count++] = r->len + src->offsets[i];
+  }
+  r->len += src->len;
+}
+
+size_t reply_count(reply *r)
+{
+  return r->count;
+}
+
+size_t reply_size(reply *r)
+{
+  return r->len + r->count * sizeof(size_t);
+}
+
+const char *reply_get(reply *r, size_t i)
+{
+  return r->buf + r->offsets[i];
+}
+
+size_t reply_encode_frame(reply *r, unsigned long id, size_t *next, char *buf, size_t cap)
+{
+  char tag[32];
+  int tlen = snprintf(tag, sizeof(tag), "#%lu ", id);
+  size_t len = 0;
+  while(*next < r->count) {
+    const char *msg = r->buf + r->offsets[*next];
+    size_t mlen = strlen(msg);
+    if(len + tlen + mlen + 1 > cap) {
+      if(len > 0) {
+        break;
+      }
+      /* a single message longer than a frame is truncated */
+      mlen = cap - tlen - 1;
+    }
+    memcpy(buf + len, tag, tlen);
+    memcpy(buf + len + tlen, msg, mlen);
+    buf[len + tlen + mlen] = '\n';
+    len += tlen + mlen + 1;
+    (*next)++;
+  }
+  return len;
+}
+
+void reply_clear(reply *r)
+{
+  r->len = 0;
+  r->count = 0;
+}
+
+void reply_destroy(reply *r)
+{
+  free(r->buf);
+  free(r->offsets);
+  free(r);
+}
@@ -0,0 +1,110 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file reply.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible reply methods.
+ *
+ * A reply collects the protocol messages (e.g. "COUNT:3", "FOOD:...") the server answers a request with.
+ * The messages are stored back to back in one buffer, so the I/O backends can send them in whatever
+ * framing they speak.
+ *
+ */
+#ifndef REPLY_H
+#define REPLY_H
+
+#include <stddef.h>
+
+/**
+ *
+ * @brief Forward declaration for reply
+ *
+ * */
+typedef struct reply reply;
+
+/**
+ * @brief Constructor for reply
+ * @return A pointer to the reply structure, representing the created object
+ *
+ * After using this structure, it must be freed with reply_destroy(reply *)
+ *
+ * */
+reply *reply_init();
+
+/**
+* @brief Method for appending a message to a reply
+* @param reply* Pointer to structure to work on
+* @param char* Message type including the colon, e.g. "COUNT:"
+* @param char* Payload of the message
+*
+* */
+void reply_add(reply *, const char *, const char *);
+
+/**
+* @brief Method for appending all messages of another reply to a reply
+* @param reply* Pointer to structure to work on
+* @param reply* Reply whose messages are copied
+*
+* */
+void reply_append(reply *, reply *);
+
+/**
+* @brief Method for getting the number of messages of a reply
+* @param reply* Pointer to structure to work on
+* @return Number of messages
+*
+* */
+size_t reply_count(reply *);
+
+/**
+* @brief Method for getting the memory used by the messages of a reply
+* @param reply* Pointer to structure to work on
+* @return Number of bytes used for the messages and their offsets
+*
+* */
+size_t reply_size(reply *);
+
+/**
+* @brief Method for getting a message of a reply
+* @param reply* Pointer to structure to work on
+* @param size_t Index of the message
+* @return The zero terminated message. Owned by the reply.
+*
+* */
+const char *reply_get(reply *, size_t);
+
+/**
+* @brief Method for encoding messages of a reply as payload of a pipelined frame
+* @param reply* Pointer to structure to work on
+* @param unsigned long Id of the request the reply belongs to, every message is tagged with it
+* @param size_t* Index of the first message to encode, updated to the first message which did not fit
+* @param char* Buffer for the payload
+* @param size_t Length of the buffer
+* @return Length of the payload
+*
+* Call repeatedly until the index reached reply_count(), every call produces the payload of one frame.
+*
+* */
+size_t reply_encode_frame(reply *, unsigned long, size_t *, char *, size_t);
+
+/**
+* @brief Method for removing all messages from a reply, the allocated memory is kept for reuse
+* @param reply* Pointer to structure to work on
+*
+* */
+void reply_clear(reply *);
+
+/**
+ * @brief Destructor for reply
+ * @param reply* Pointer to structure to be freed
+ *
+ * */
+void reply_destroy(reply *);
+
+#endif /* REPLY_H */
@@ -0,0 +1,294 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file router.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the router structure and its member methods.
+ *
+ * Every shard is served by a dietclient, whose pipelined connections let many requests of the router be
+ * in flight at once. A search term only matches names starting with it, so a shard may own matching names
+ * if the term sorts before its end and the start of its first name does not sort after the term.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "../lib/dietclient.h"
+#include "logger.h"
+#include "router.h"
+
+#define ROUTER_CONNS 2 /**< Number of pooled connections per shard */
+#define ROUTER_LINE_LEN 1024 /**< Maximum length of a line of the shard map */
+
+/**
+ * @brief A shard of the router
+ *
+ */
+struct router_shard {
+  char *address; /**< Address of the shard as given in the shard map */
+  char *first; /**< First name owned by the shard, empty for the first shard */
+  dietclient *client; /**< Connections to the shard */
+};
+
+/**
+ * @brief router structure for representing the shards of the server
+ *
+ */
+struct router {
+  struct router_shard *shards; /**< The shards, ordered by first name */
+  size_t num_shards; /**< Number of shards */
+};
+
+/**
+ * @brief Compare function for using qsort() with food objects, in the order of foodlist_save()
+ * @param void* Pointer to first food object
+ * @param void* Pointer to second food object
+ * @return An integer less than, equal to, or greater than zero
+ *
+ * */
+static int router_cmp(const void *a, const void *b)
+{
+  return strcasecmp(food_get_name(*(food *const *)a), food_get_name(*(food *const *)b));
+}
+
+/**
+ * @brief Helper function to check whether a shard may own names matching a search term
+ * @param router* Pointer to structure to work on
+ * @param size_t Index of the shard
+ * @param char* The search term
+ * @return True, if the shard has to be searched, false otherwise
+ *
+ * */
+static bool router_relevant(router *rt, size_t i, const char *term)
+{
+  if(i > 0 && strncasecmp(rt->shards[i].first, term, strlen(term)) > 0) {
+    /* all names starting with the term sort before this shard */
+    return false;
+  }
+  /* the term is the smallest name starting with itself */
+  return i + 1 == rt->num_shards || strcasecmp(term, rt->shards[i + 1].first) < 0;
+}
+
+/**
+ * @brief Helper function to find the shard owning a name
+ * @param router* Pointer to structure to work on
+ * @param char* The name
+ * @return Index of the shard
+ *
+ * */
+static size_t router_owner(router *rt, const char *name)
+{
+  size_t i = rt->num_shards - 1;
+  while(i > 0 && strcasecmp(rt->shards[i].first, name) > 0) {
+    i--;
+  }
+  return i;
+}
+
+/**
+ * @brief Helper function to add a shard of a line of the shard map
+ * @param router* Pointer to structure to work on
+ * @param char* The line, it is modified
+ * @return False, if the line is invalid, true otherwise
+ *
+ * */
+static bool router_parse(router *rt, char *line)
+{
+  line[strcspn(line, "\r\n")] = 0;
+  while(isspace((unsigned char)*line)) {
+    line++;
+  }
+  if(*line == 0 || *line == '#') {
+    return true;
+  }
+  char *first = line + strcspn(line, " \t");
+  if(*first) {
+    *first++ = 0;
+    while(isspace((unsigned char)*first)) {
+      first++;
+    }
+  }
+  size_t len = strlen(first);
+  while(len > 0 && isspace((unsigned char)first[len - 1])) {
+    first[--len] = 0;
+  }
+  if((rt->num_shards == 0) != (len == 0)) {
+    LOGGER_LOG(LOGGER_ERROR, "Only the first shard has no first name: %s", line);
+    return false;
+  }
+  if(rt->num_shards > 1 && strcasecmp(rt->shards[rt->num_shards - 1].first, first) >= 0) {
+    LOGGER_LOG(LOGGER_ERROR, "Shards are not ordered by first name: %s", first);
+    return false;
+  }
+
+  char *host = strdup(line);
+  unsigned int port = 0;
+  /* a path of a Unix domain socket has no port */
+  if(!strchr(host, '/')) {
+    char *colon = strrchr(host, ':');
+    if(!colon) {
+      LOGGER_LOG(LOGGER_ERROR, "Expected host:port, got %s", host);
+      free(host);
+      return false;
+    }
+    *colon = 0;
+    port = atoi(colon + 1);
+  }
+  rt->shards = realloc(rt->shards, (rt->num_shards + 1) * sizeof(struct router_shard));
+  struct router_shard *sh = &rt->shards[rt->num_shards++];
+  sh->address = strdup(line);
+  sh->first = strdup(first);
+  sh->client = dietclient_init(host, port, ROUTER_CONNS);
+  free(host);
+  return true;
+}
+
+router *router_init(const char *file)
+{
+  FILE *fptr = fopen(file, "r");
+  if(!fptr) {
+    LOGGER_LOG(LOGGER_ERROR, "cannot read file %s", file);
+    return NULL;
+  }
+  router *rt = (router *)malloc(sizeof(router));
+  rt->shards = NULL;
+  rt->num_shards = 0;
+  char line[ROUTER_LINE_LEN];
+  bool ok = true;
+  while(ok && fgets(line, sizeof(line), fptr)) {
+    ok = router_parse(rt, line);
+  }
+  fclose(fptr);
+  if(!ok || rt->num_shards == 0) {
+    LOGGER_LOG(LOGGER_ERROR, "Invalid shard map %s", file);
+    router_destroy(rt);
+    return NULL;
+  }
+  for(size_t i = 0; i < rt->num_shards; ++i) {
+    LOGGER_LOG(LOGGER_INFO, "Shard %zu at %s owns names from \"%s\"", i, rt->shards[i].address, rt->shards[i].first);
+  }
+  return rt;
+}
+
+size_t router_search(router *rt, const char *term, reply *r)
+{
+  /* send to all shards first, they search in parallel */
+  dietclient_future **futures = calloc(rt->num_shards, sizeof(dietclient_future *));
+  for(size_t i = 0; i < rt->num_shards; ++i) {
+    if(router_relevant(rt, i, term)) {
+      futures[i] = dietclient_search_async(rt->shards[i].client, term);
+    }
+  }
+  food **foods = NULL;
+  size_t n = 0;
+  for(size_t i = 0; i < rt->num_shards; ++i) {
+    if(!futures[i]) {
+      continue;
+    }
+    food **found = NULL;
+    size_t num = 0;
+    if(dietclient_future_wait(futures[i], &found, &num) != DIETCLIENT_OK) {
+      LOGGER_LOG(LOGGER_WARN, "Shard %s did not answer the search for %s", rt->shards[i].address, term);
+    } else if(num > 0) {
+      foods = realloc(foods, (n + num) * sizeof(food *));
+      memcpy(foods + n, found, num * sizeof(food *));
+      n += num;
+    }
+    free(found);
+    dietclient_future_destroy(futures[i]);
+  }
+  free(futures);
+
+  qsort(foods, n, sizeof(food *), router_cmp);
+  char cbuf[32] = { 0 };
+  snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t i = 0; i < n; ++i) {
+    char *s = food_serialize(foods[i]);
+    reply_add(r, "FOOD:", s);
+    free(s);
+    food_destroy(foods[i]);
+  }
+  free(foods);
+  return n;
+}
+
+size_t router_search_page(router *rt, const char *term, size_t limit, const char *cursor, reply *r)
+{
+  /* the cursor is the index of the shard and the cursor of the shard: "2.1a" */
+  size_t i = 0;
+  const char *shard_cursor = NULL;
+  if(cursor) {
+    char *end = NULL;
+    i = strtoul(cursor, &end, 10);
+    if(*end == '.' && end[1]) {
+      shard_cursor = end + 1;
+    }
+  }
+  while(i < rt->num_shards && !router_relevant(rt, i, term)) {
+    i++;
+    shard_cursor = NULL;
+  }
+  if(i >= rt->num_shards) {
+    reply_add(r, "COUNT:", "0");
+    return 0;
+  }
+
+  dietclient_future *fu = dietclient_search_page_async(rt->shards[i].client, term, limit, shard_cursor);
+  food **foods = NULL;
+  size_t n = 0;
+  if(dietclient_future_wait(fu, &foods, &n) != DIETCLIENT_OK) {
+    LOGGER_LOG(LOGGER_WARN, "Shard %s did not answer the search for %s", rt->shards[i].address, term);
+  }
+  char cbuf[64] = { 0 };
+  const char *next = dietclient_future_cursor(fu);
+  size_t j = i + 1;
+  while(j < rt->num_shards && !router_relevant(rt, j, term)) {
+    j++;
+  }
+  if(next) {
+    snprintf(cbuf, sizeof(cbuf), "%zu;next=%zu.%s", n, i, next);
+  } else if(j < rt->num_shards) {
+    /* continue with the first page of the next shard */
+    snprintf(cbuf, sizeof(cbuf), "%zu;next=%zu.", n, j);
+  } else {
+    snprintf(cbuf, sizeof(cbuf), "%zu", n);
+  }
+  reply_add(r, "COUNT:", cbuf);
+  for(size_t k = 0; k < n; ++k) {
+    char *s = food_serialize(foods[k]);
+    reply_add(r, "FOOD:", s);
+    free(s);
+    food_destroy(foods[k]);
+  }
+  free(foods);
+  dietclient_future_destroy(fu);
+  return n;
+}
+
+void router_add(router *rt, food *f)
+{
+  size_t i = router_owner(rt, food_get_name(f));
+  LOGGER_LOG(LOGGER_DEBUG, "Adding %s to shard %s", food_get_name(f), rt->shards[i].address);
+  dietclient_add(rt->shards[i].client, f, NULL, NULL);
+  food_destroy(f);
+}
+
+void router_destroy(router *rt)
+{
+  for(size_t i = 0; i < rt->num_shards; ++i) {
+    dietclient_destroy(rt->shards[i].client);
+    free(rt->shards[i].address);
+    free(rt->shards[i].first);
+  }
+  free(rt->shards);
+  free(rt);
+}
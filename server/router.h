@@ -0,0 +1,91 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file router.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible router methods.
+ *
+ * A router spreads the foods over several servers, the shards, by name. Every shard owns the names from
+ * its first name on, up to the first name of the next shard, compared case insensitively. A search is sent
+ * to all shards which may own matching names in parallel, a food is added to the shard owning its name.
+ *
+ * The shard map is a text file with one shard per line, ordered by first name: the address of the shard,
+ * i.e. host:port or the path of a Unix domain socket, and the first name. The first shard has no first
+ * name, it owns all names before the second one. Lines starting with '#' are ignored.
+ *
+ *     127.0.0.1:12346
+ *     127.0.0.1:12347 G
+ *     127.0.0.1:12348 Pea
+ *
+ */
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+#include "../lib/food.h"
+#include "reply.h"
+
+/**
+ *
+ * @brief Forward declaration for router
+ *
+ * */
+typedef struct router router;
+
+/**
+ * @brief Constructor for router, connects to the shards of a shard map in the background
+ * @param char* Name of the shard map file
+ * @return A pointer to the router structure, representing the created object, or NULL if the shard map
+ *         could not be read
+ *
+ * After using this structure, it must be freed with router_destroy(router *)
+ *
+ * */
+router *router_init(const char *);
+
+/**
+* @brief Method for searching foods on all shards which may own matching names
+* @param router* Pointer to structure to work on
+* @param char* The search term
+* @param reply* Reply to append the COUNT message and the FOOD messages, sorted by name, to
+* @return Number of found foods
+*
+* */
+size_t router_search(router *, const char *, reply *);
+
+/**
+* @brief Method for searching one page of foods, shard by shard
+* @param router* Pointer to structure to work on
+* @param char* The search term
+* @param size_t Maximum number of foods of the page
+* @param char* Cursor returned with the previous page, or NULL for the first page
+* @param reply* Reply to append the COUNT message, with the cursor of the next page, and the FOOD messages to
+* @return Number of found foods
+*
+* A page holds foods of one shard only, so it may be shorter than the limit even if there are more pages.
+*
+* */
+size_t router_search_page(router *, const char *, size_t, const char *, reply *);
+
+/**
+* @brief Method for adding a food to the shard owning its name
+* @param router* Pointer to structure to work on
+* @param food* The food, it is freed
+*
+* */
+void router_add(router *, food *);
+
+/**
+ * @brief Destructor for router, closes the connections to the shards
+ * @param router* Pointer to structure to be freed
+ *
+ * */
+void router_destroy(router *);
+
+#endif /* ROUTER_H */
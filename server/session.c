@@ -0,0 +1,405 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file session.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the session structure and its member methods.
+ *
+ * The states follow the stop-and-wait scheme of sock_read() and sock_write(): every BUF_LEN bytes long
+ * frame is answered with a RE_LEN bytes long ACK before the next frame is sent. After a successful
+ * HELLO negotiation the session switches to pipelined mode, where receiving and sending are independent
+ * of each other and may happen at the same time.
+ *
+ * Requests are handed to the worker pool of the dispatcher, so the event loop keeps serving other
+ * connections meanwhile. A session has at most one request in flight, which keeps the answers of a
+ * pipelined connection in order; the event loop reports the answer with session_dispatch_done().
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "../lib/sock.h"
+#include "logger.h"
+#include "tracer.h"
+#include "session.h"
+
+#define SESSION_OUT_LIMIT (4 * SOCK_FRAME_MAX) /**< Pending output which stops receiving new requests */
+
+/**
+ * @brief States of the protocol state machine
+ *
+ */
+enum session_state {
+  SESSION_READ_FRAME, /**< Waiting for a request frame */
+  SESSION_WRITE_ACK, /**< Acknowledging the received request frame */
+  SESSION_WRITE_REPLY, /**< Sending a reply frame */
+  SESSION_READ_ACK, /**< Waiting for the acknowledgement of a reply frame */
+  SESSION_DISPATCH, /**< Waiting for the worker pool to answer the received request frame */
+  SESSION_PIPELINE, /**< Pipelined mode, length prefixed frames without acknowledgement */
+  SESSION_CLOSED /**< Connection is finished */
+};
+
+/**
+ * @brief session structure for representing the protocol state of one client connection
+ *
+ */
+struct session {
+  dispatch *dispatch; /**< Dispatcher for received requests */
+  int client; /**< Identifier of the client */
+  enum session_state state; /**< Current protocol state */
+  char frame[BUF_LEN]; /**< Frame currently received or sent */
+  char ack[RE_LEN]; /**< Acknowledgement currently received or sent */
+  size_t pos; /**< Number of bytes of the current frame or ack already transferred */
+  reply *reply; /**< Reply to the last request */
+  size_t next; /**< Index of the reply message currently sent */
+  bool upgrade; /**< True, if the session switches to pipelined mode after the current reply */
+  bool compress; /**< True, if the client accepted compressed frames */
+  char hdr[SOCK_FRAME_HEADER]; /**< Header of the pipelined frame currently received */
+  char *payload; /**< Payload of the pipelined frame currently received */
+  size_t payload_len; /**< Length of the payload, 0 while the header is received */
+  char *scratch; /**< Buffer for decompressing received and compressing sent payloads */
+  char *out; /**< Encoded pipelined frames waiting to be sent */
+  size_t out_len; /**< Number of bytes in out */
+  size_t out_cap; /**< Allocated bytes of out */
+  size_t out_pos; /**< Number of bytes of out already sent */
+  executor_group *group; /**< Group of the requests handed to the worker pool */
+  dispatch_done_func done; /**< Function the worker calls after answering a request */
+  void *done_arg; /**< Argument of done */
+  bool dispatching; /**< True, while a request is handed to the worker pool */
+  char *save; /**< Position of strtok_r() in the payload, NULL before its first request */
+  unsigned long id; /**< Tag of the pipelined request currently handled */
+  uint64_t start; /**< Start of the request currently handled, from tracer_clock() */
+  uint64_t trace; /**< Traced request currently handled, 0 if it is not traced */
+};
+
+/**
+ * @brief Prepares the next reply frame or goes back to waiting for requests
+ * @param session* Pointer to structure to work on
+ *
+ * */
+static void session_next_reply(session *s)
+{
+  s->pos = 0;
+  memset(s->frame, 0, BUF_LEN);
+  if(s->next < reply_count(s->reply)) {
+    snprintf(s->frame, BUF_LEN, "%s", reply_get(s->reply, s->next));
+    s->state = SESSION_WRITE_REPLY;
+  } else if(s->upgrade) {
+    LOGGER_LOG(LOGGER_INFO, "Client %d switched to pipelined mode", s->client);
+    s->payload = malloc(SOCK_FRAME_MAX + 1);
+    s->payload_len = 0;
+    s->scratch = malloc(SOCK_FRAME_MAX + 1);
+    s->out_cap = SOCK_FRAME_HEADER + SOCK_FRAME_MAX;
+    s->out = malloc(s->out_cap);
+    s->out_len = 0;
+    s->out_pos = 0;
+    s->state = SESSION_PIPELINE;
+  } else {
+    s->state = SESSION_READ_FRAME;
+  }
+}
+
+/**
+ * @brief Hands a request to the worker pool, or handles it right away if the dispatcher has none
+ * @param session* Pointer to structure to work on
+ * @param char* The request message, it stays untouched until the request is answered
+ * @return True, if the worker pool answers the request, false if the reply is complete
+ *
+ * */
+static bool session_dispatch(session *s, char *msg)
+{
+  s->trace = tracer_current();
+  s->dispatching = dispatch_submit(s->dispatch, s->group, s->client, msg, s->reply, s->done, s->done_arg);
+  return s->dispatching;
+}
+
+/**
+ * @brief Handles a received legacy frame
+ * @param session* Pointer to structure to work on
+ *
+ * */
+static void session_handle_frame(session *s)
+{
+  reply_clear(s->reply);
+  if(!strncmp("HELLO:", s->frame, 6)) {
+    /* connection level negotiation, not a command */
+    char accepted[BUF_LEN] = { 0 };
+    sock_negotiate(s->frame + 6, accepted, sizeof(accepted));
+    reply_add(s->reply, "HELLO:", accepted);
+    s->upgrade = sock_has_feature(accepted, SOCK_PIPELINE);
+    s->compress = sock_has_feature(accepted, SOCK_LZ);
+  } else {
+    /* the reply is sent by the event loop, the span ends when it is ready */
+    s->start = tracer_clock();
+    tracer_begin();
+    if(session_dispatch(s, s->frame)) {
+      s->state = SESSION_DISPATCH;
+      return;
+    }
+    tracer_end("request", s->start);
+  }
+  s->next = 0;
+  session_next_reply(s);
+}
+
+/**
+ * @brief Queues the answer of the current pipelined request as frames tagged with its id
+ * @param session* Pointer to structure to work on
+ *
+ * */
+static void session_encode_reply(session *s)
+{
+  uint64_t encode = tracer_clock();
+  size_t next = 0;
+  while(next < reply_count(s->reply)) {
+    if(s->out_len + SOCK_FRAME_HEADER + SOCK_FRAME_MAX > s->out_cap) {
+      s->out_cap *= 2;
+      s->out = realloc(s->out, s->out_cap);
+    }
+    if(s->compress) {
+      size_t len = reply_encode_frame(s->reply, s->id, &next, s->scratch, SOCK_FRAME_MAX);
+      s->out_len += sock_frame_pack(s->out + s->out_len, s->scratch, len, true);
+    } else {
+      size_t len = reply_encode_frame(s->reply, s->id, &next, s->out + s->out_len + SOCK_FRAME_HEADER, SOCK_FRAME_MAX);
+      sock_frame_encode(s->out + s->out_len, len);
+      s->out_len += SOCK_FRAME_HEADER + len;
+    }
+  }
+  tracer_span("encode", encode);
+  tracer_end("request", s->start);
+}
+
+/**
+ * @brief Handles the requests of a received pipelined frame and queues the answers
+ * @param session* Pointer to structure to work on
+ *
+ * Stops at a request handed to the worker pool, session_dispatch_done() continues after its answer.
+ * The next frame is received after all requests of the frame are answered.
+ *
+ * */
+static void session_handle_payload(session *s)
+{
+  char *msg;
+  while((msg = strtok_r(s->save ? NULL : s->payload, "\n", &s->save)) != NULL) {
+    char *body = sock_parse_tag(msg, &s->id);
+    if(!body) {
+      LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected tagged message from client %d", s->client);
+      continue;
+    }
+    reply_clear(s->reply);
+    s->start = tracer_clock();
+    tracer_begin();
+    if(session_dispatch(s, body)) {
+      return;
+    }
+    session_encode_reply(s);
+  }
+  s->save = NULL;
+  s->payload_len = 0;
+  s->pos = 0;
+}
+
+session *session_init(dispatch *d, int client, executor_group *group, dispatch_done_func done, void *arg)
+{
+  session *s = (session *)malloc(sizeof(session));
+  s->dispatch = d;
+  s->group = group;
+  s->done = done;
+  s->done_arg = arg;
+  s->dispatching = false;
+  s->save = NULL;
+  s->id = 0;
+  s->start = 0;
+  s->trace = 0;
+  s->client = client;
+  s->state = SESSION_READ_FRAME;
+  memset(s->frame, 0, BUF_LEN);
+  memset(s->ack, 0, RE_LEN);
+  s->pos = 0;
+  s->reply = reply_init();
+  s->next = 0;
+  s->upgrade = false;
+  s->compress = false;
+  s->payload = NULL;
+  s->scratch = NULL;
+  s->payload_len = 0;
+  s->out = NULL;
+  s->out_len = 0;
+  s->out_cap = 0;
+  s->out_pos = 0;
+  return s;
+}
+
+char *session_read_buf(session *s, size_t *len)
+{
+  switch(s->state) {
+  case SESSION_READ_FRAME:
+    *len = BUF_LEN - s->pos;
+    return s->frame + s->pos;
+  case SESSION_READ_ACK:
+    *len = RE_LEN - s->pos;
+    return s->ack + s->pos;
+  case SESSION_PIPELINE:
+    if(s->dispatching) {
+      /* the payload holds the request the worker pool is answering */
+      *len = 0;
+      return NULL;
+    }
+    if(s->out_len - s->out_pos > SESSION_OUT_LIMIT) {
+      /* the client does not read its answers, stop reading requests until it catches up */
+      *len = 0;
+      return NULL;
+    }
+    if(s->payload_len == 0) {
+      *len = SOCK_FRAME_HEADER - s->pos;
+      return s->hdr + s->pos;
+    }
+    *len = s->payload_len - s->pos;
+    return s->payload + s->pos;
+  default:
+    *len = 0;
+    return NULL;
+  }
+}
+
+void session_read_done(session *s, size_t n)
+{
+  if(n == 0) {
+    /* client is disconnected */
+    s->state = SESSION_CLOSED;
+    return;
+  }
+  s->pos += n;
+  if(s->state == SESSION_READ_FRAME && s->pos == BUF_LEN) {
+    s->frame[BUF_LEN - 1] = 0;
+    memset(s->ack, 0, RE_LEN);
+    sprintf(s->ack, "ACK");
+    s->pos = 0;
+    s->state = SESSION_WRITE_ACK;
+  } else if(s->state == SESSION_READ_ACK && s->pos == RE_LEN) {
+    if(strcmp(s->ack, "ACK")) {
+      LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected ACK from client %d", s->client);
+      s->state = SESSION_CLOSED;
+      return;
+    }
+    s->next++;
+    session_next_reply(s);
+  } else if(s->state == SESSION_PIPELINE && s->payload_len == 0 && s->pos == SOCK_FRAME_HEADER) {
+    s->payload_len = sock_frame_decode(s->hdr);
+    s->pos = 0;
+    if(s->payload_len > SOCK_FRAME_MAX) {
+      LOGGER_LOG(LOGGER_WARN, "Error in protocol, frame of client %d too long", s->client);
+      s->state = SESSION_CLOSED;
+    }
+  } else if(s->state == SESSION_PIPELINE && s->payload_len > 0 && s->pos == s->payload_len) {
+    if(sock_frame_is_compressed(s->hdr)) {
+      ssize_t len = sock_frame_inflate(s->payload, s->payload_len, s->scratch);
+      if(len <= 0) {
+        LOGGER_LOG(LOGGER_WARN, "Error in protocol, malformed compressed frame of client %d", s->client);
+        s->state = SESSION_CLOSED;
+        return;
+      }
+      char *inflated = s->scratch;
+      s->scratch = s->payload;
+      s->payload = inflated;
+      s->payload_len = len;
+    }
+    s->payload[s->payload_len] = 0;
+    s->save = NULL;
+    session_handle_payload(s);
+  }
+}
+
+char *session_write_buf(session *s, size_t *len)
+{
+  switch(s->state) {
+  case SESSION_WRITE_ACK:
+    *len = RE_LEN - s->pos;
+    return s->ack + s->pos;
+  case SESSION_WRITE_REPLY:
+    *len = BUF_LEN - s->pos;
+    return s->frame + s->pos;
+  case SESSION_PIPELINE:
+    *len = s->out_len - s->out_pos;
+    return *len > 0 ? s->out + s->out_pos : NULL;
+  default:
+    *len = 0;
+    return NULL;
+  }
+}
+
+void session_write_done(session *s, size_t n)
+{
+  if(s->state == SESSION_PIPELINE) {
+    s->out_pos += n;
+    if(s->out_pos == s->out_len) {
+      s->out_pos = 0;
+      s->out_len = 0;
+    }
+    return;
+  }
+  s->pos += n;
+  if(s->state == SESSION_WRITE_ACK && s->pos == RE_LEN) {
+    /* the request is acknowledged, handle it and start sending the reply */
+    session_handle_frame(s);
+  } else if(s->state == SESSION_WRITE_REPLY && s->pos == BUF_LEN) {
+    memset(s->ack, 0, RE_LEN);
+    s->pos = 0;
+    s->state = SESSION_READ_ACK;
+  }
+}
+
+void session_dispatch_done(session *s)
+{
+  s->dispatching = false;
+  tracer_set_current(s->trace);
+  if(s->state == SESSION_PIPELINE) {
+    session_encode_reply(s);
+    session_handle_payload(s);
+  } else if(s->state == SESSION_DISPATCH) {
+    tracer_end("request", s->start);
+    s->next = 0;
+    session_next_reply(s);
+  } else {
+    /* closed meanwhile, the answer is dropped */
+    tracer_end("request", s->start);
+  }
+}
+
+bool session_is_dispatching(session *s)
+{
+  return s->dispatching;
+}
+
+void session_close(session *s)
+{
+  s->state = SESSION_CLOSED;
+}
+
+bool session_is_closed(session *s)
+{
+  return s->state == SESSION_CLOSED;
+}
+
+bool session_is_idle(session *s)
+{
+  if(s->state == SESSION_PIPELINE) {
+    return s->payload_len == 0 && s->pos == 0 && s->out_len == 0;
+  }
+  return s->state == SESSION_READ_FRAME && s->pos == 0;
+}
+
+void session_destroy(session *s)
+{
+  reply_destroy(s->reply);
+  free(s->payload);
+  free(s->scratch);
+  free(s->out);
+  free(s);
+}
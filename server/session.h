@@ -0,0 +1,133 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file session.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible session methods.
+ *
+ * A session is the server side of the calory socket protocol as a state machine without any I/O.
+ * Event driven backends ask the session which buffer to read into or to write from, perform the
+ * I/O however they like and report the number of transferred bytes back. In pipelined mode a session
+ * may offer a read and a write buffer at the same time, both transfers can be in flight concurrently.
+ * Requests are answered by the worker pool of the dispatcher, while one is in flight the session offers
+ * no buffer to read into; the backend reports the answer with session_dispatch_done().
+ *
+ */
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dispatch.h"
+
+/**
+ *
+ * @brief Forward declaration for session
+ *
+ * */
+typedef struct session session;
+
+/**
+ * @brief Constructor for session
+ * @param dispatch* Dispatcher used for handling the received requests
+ * @param int Identifier of the client, used for logging
+ * @param executor_group* Group the requests handed to the worker pool are added to
+ * @param dispatch_done_func Function a worker calls after answering a request of the session, on the worker thread
+ * @param void* Argument passed to the function
+ * @return A pointer to the session structure, representing the created object
+ *
+ * After using this structure, it must be freed with session_destroy(session *). Without an executor in the
+ * dispatcher, requests are answered right away and the function is never called.
+ *
+ * */
+session *session_init(dispatch *, int, executor_group *, dispatch_done_func, void *);
+
+/**
+* @brief Method for getting the buffer the next received bytes have to be stored in
+* @param session* Pointer to structure to work on
+* @param size_t* Pointer to a size_t instance. The method updates its value to the free length of the buffer.
+* @return Pointer to the buffer, or NULL if the session does not expect data right now
+*
+* */
+char *session_read_buf(session *, size_t *);
+
+/**
+* @brief Method for reporting received bytes to the session
+* @param session* Pointer to structure to work on
+* @param size_t Number of bytes stored into the buffer returned by session_read_buf(). 0 closes the session.
+*
+* */
+void session_read_done(session *, size_t);
+
+/**
+* @brief Method for getting the buffer which has to be sent next
+* @param session* Pointer to structure to work on
+* @param size_t* Pointer to a size_t instance. The method updates its value to the number of bytes to send.
+* @return Pointer to the buffer, or NULL if there is nothing to send right now
+*
+* */
+char *session_write_buf(session *, size_t *);
+
+/**
+* @brief Method for reporting sent bytes to the session
+* @param session* Pointer to structure to work on
+* @param size_t Number of bytes sent from the buffer returned by session_write_buf()
+*
+* */
+void session_write_done(session *, size_t);
+
+/**
+* @brief Method for reporting that the worker pool answered the request of the session
+* @param session* Pointer to structure to work on
+*
+* Must be called on the thread doing the I/O of the session, after the function given to session_init()
+* was called. The answer is queued for sending and the next request of a pipelined frame is handled.
+*
+* */
+void session_dispatch_done(session *);
+
+/**
+* @brief Method for checking if a request of the session is answered by the worker pool right now
+* @param session* Pointer to structure to work on
+* @return True, if a request is in flight, the session must not be destroyed until it is answered
+*
+* */
+bool session_is_dispatching(session *);
+
+/**
+* @brief Method for closing a session, e.g. because sending failed
+* @param session* Pointer to structure to work on
+*
+* */
+void session_close(session *);
+
+/**
+* @brief Method for checking if the session is finished and the connection can be closed
+* @param session* Pointer to structure to work on
+* @return True, if the session is closed, false otherwise
+*
+* */
+bool session_is_closed(session *);
+
+/**
+* @brief Method for checking if the session waits for a new request, without a partial request or unsent output
+* @param session* Pointer to structure to work on
+* @return True, if the session is idle, false otherwise
+*
+* */
+bool session_is_idle(session *);
+
+/**
+ * @brief Destructor for session
+ * @param session* Pointer to structure to be freed
+ *
+ * */
+void session_destroy(session *);
+
+#endif /* SESSION_H */
@@ -12,25 +12,55 @@
  * @brief File containing the sockethandler structure and its member methods.
  *
  */
+#define _GNU_SOURCE
 #include <time.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <fcntl.h>
 #include <sys/select.h>
 #include <semaphore.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include "../lib/sock.h"
 #include "../lib/food.h"
-#include "../lib/foodlist.h"
+#include "dispatch.h"
+#include "reply.h"
+#include "uringhandler.h"
+#include "connmetrics.h"
+#include "timerwheel.h"
+#include "logger.h"
+#include "tracer.h"
 #include "sockethandler.h"
 
-#define MAX_THREADS 10 /**< Size of the Threadpool */
-#define MAX_SOCKETS 5 /**< Maximum number of waiting clients */
+#define DEFAULT_THREADS 10 /**< Default size of the Threadpool */
+#define DEFAULT_QUEUE_SIZE 5 /**< Default maximum number of waiting clients */
+#define DEFAULT_BACKLOG 128 /**< Default backlog of the listening socket */
+#define RETRY_MS 250 /**< Base of the retry time sent with BUSY answers */
+#define MAX_URING_CONNECTIONS 256 /**< Maximum number of connections served by the io_uring backend */
+#define DEFAULT_IDLE_TIMEOUT 300 /**< Default time in seconds a connection may wait for its next request */
+#define IO_TIMEOUT_MS 30000 /**< Time in milliseconds sending a reply may take */
+#define DRAIN_MS 5000 /**< Time in milliseconds requests in flight get to finish after shutdown was requested */
+#define PIPELINE_MAX_IN_FLIGHT 32 /**< Requests of a pipelined connection in the executor before it stops reading */
+
+/**
+ * @brief The connection served by a connection thread of the thread backend
+ *
+ */
+struct sockethandler_conn {
+  sockethandler *sockethandler; /**< The sockethandler */
+  pthread_t thread; /**< The connection thread */
+  int sock; /**< Client socket, -1 while the thread waits for a connection */
+  timerwheel_timer *timer; /**< Deadline of the connection, NULL if there is none */
+};
 
 /**
  * @brief sockethandler structure for representing a sockethandler item
@@ -38,10 +68,26 @@
  */
 struct sockethandler {
   unsigned int listen_port; /**< Listen port for the server socket */
-  pthread_t thread_pool[MAX_THREADS]; /**< Thread pool for handling client connections */
-  int client_sockets[MAX_SOCKETS]; /**< Array of client sockets for consumer/producer principle */
-  bool shutdown; /**< Flag to notifying all threads to shut down */
-  foodlist *foodlist; /**< List of foods to work with */
+  bool listen_tcp; /**< Flag whether the TCP port is served */
+  char *unix_path; /**< Path of the Unix domain socket, NULL if none is served */
+  sockethandler_backend backend; /**< I/O backend serving the client connections */
+  struct sockethandler_conn *thread_pool; /**< Thread pool for handling client connections */
+  size_t num_threads; /**< Size of the thread pool */
+  bool threads_started; /**< Flag whether the thread pool is running */
+  int *client_sockets; /**< Array of client sockets for consumer/producer principle */
+  uint64_t *accept_times; /**< Time every socket of client_sockets was accepted, from tracer_clock() */
+  size_t queue_size; /**< Size of client_sockets, more waiting clients are rejected */
+  int backlog; /**< Backlog of the listening socket */
+  connmetrics metrics; /**< Connection level counters */
+  volatile bool shutdown; /**< Flag to notifying all threads to shut down */
+  int wake_pipe[2]; /**< Pipe written to on shutdown and when the first deadline is set */
+  unsigned int idle_timeout; /**< Time in milliseconds a connection may wait for its next request, 0 for no limit */
+  timerwheel *timers; /**< Deadlines of the connections of the thread backend */
+  pthread_mutex_t timer_mutex; /**< Mutex protecting timers and the sockets of thread_pool */
+  dataset *dataset; /**< Foods to work with */
+  dispatch *dispatch; /**< Command handling for received requests */
+  dispatch *core_dispatch; /**< Command handling of the per-core backend, which answers small searches on the receiving CPU */
+  executor *executor; /**< Worker pool for requests, NULL to handle them on the connection threads */
   pthread_mutex_t mutex;/**< Mutex to mutual exclude the client_socket array. */
   sem_t empty;/**< Semaphore to block on empty socket list. */
   sem_t full;/**< Semaphore to block on full socket list. */
@@ -50,205 +96,815 @@ struct sockethandler {
   size_t count; /**< number of unconsumed items */
 };
 
+/**
+ * @brief Timer callback of a connection which missed its deadline
+ * @param void* Pointer to the sockethandler_conn structure, the timer mutex is held
+ *
+ * */
+static void sockethandler_on_deadline(void *arg)
+{
+  struct sockethandler_conn *c = (struct sockethandler_conn *)arg;
+  LOGGER_LOG(LOGGER_WARN, "Socket %d missed its deadline", c->sock);
+  c->timer = NULL;
+  /* the blocked connection thread wakes up with an error and closes the connection */
+  shutdown(c->sock, SHUT_RDWR);
+  __atomic_add_fetch(&c->sockethandler->metrics.timed_out, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets the deadline of the connection of a connection thread
+ * @param struct sockethandler_conn* The connection
+ * @param unsigned int Milliseconds from now, 0 to remove the deadline
+ *
+ * */
+static void sockethandler_set_deadline(struct sockethandler_conn *c, unsigned int ms)
+{
+  sockethandler *s = c->sockethandler;
+  bool kick = false;
+  pthread_mutex_lock(&s->timer_mutex);
+  if(ms == 0) {
+    if(c->timer) {
+      timerwheel_remove(s->timers, c->timer);
+      c->timer = NULL;
+    }
+  } else if(c->timer) {
+    timerwheel_update(s->timers, c->timer, timerwheel_now() + ms);
+  } else {
+    /* the accept loop only ticks the wheel while there are timers, wake it up for the first one */
+    kick = timerwheel_count(s->timers) == 0;
+    c->timer = timerwheel_add(s->timers, timerwheel_now() + ms, c);
+  }
+  pthread_mutex_unlock(&s->timer_mutex);
+  if(kick) {
+    ssize_t w = write(s->wake_pipe[1], "t", 1);
+    (void)w;
+  }
+}
+
+/**
+ * @brief Hands a client socket to a connection thread
+ * @param struct sockethandler_conn* The connection of the thread
+ * @param int The client socket
+ *
+ * */
+static void sockethandler_claim(struct sockethandler_conn *c, int sock)
+{
+  sockethandler *s = c->sockethandler;
+  pthread_mutex_lock(&s->timer_mutex);
+  c->sock = sock;
+  bool stopping = s->shutdown;
+  pthread_mutex_unlock(&s->timer_mutex);
+  if(stopping) {
+    /* missed the wake up of the busy threads, do not wait for requests */
+    shutdown(sock, SHUT_RD);
+  }
+}
+
+/**
+ * @brief Takes the client socket back from a connection thread, before the socket is closed
+ * @param struct sockethandler_conn* The connection of the thread
+ *
+ * */
+static void sockethandler_release(struct sockethandler_conn *c)
+{
+  sockethandler *s = c->sockethandler;
+  pthread_mutex_lock(&s->timer_mutex);
+  if(c->timer) {
+    timerwheel_remove(s->timers, c->timer);
+    c->timer = NULL;
+  }
+  c->sock = -1;
+  pthread_mutex_unlock(&s->timer_mutex);
+}
+
+/**
+ * @brief A connection in pipelined mode
+ *
+ */
+struct pipeline_conn {
+  sockethandler *sockethandler; /**< The sockethandler serving the connection */
+  int sock; /**< Client socket */
+  pthread_mutex_t write_mutex; /**< Mutex to mutual exclude the tasks writing answers */
+  pthread_mutex_t flight_mutex; /**< Mutex protecting in_flight */
+  pthread_cond_t flight_cond; /**< Signaled when a request in flight was answered */
+  size_t in_flight; /**< Number of requests submitted to the executor and not answered yet */
+  bool broken; /**< Flag set when sending failed, further answers are dropped */
+  bool compress; /**< True, if the client accepted compressed frames */
+};
+
+/**
+ * @brief A request received in pipelined mode
+ *
+ */
+struct pipeline_request {
+  struct pipeline_conn *conn; /**< Connection the request was received on */
+  unsigned long id; /**< Id the client tagged the request with */
+  char *msg; /**< The request message without tag */
+  uint64_t submitted; /**< Time the request was parsed, from tracer_clock() */
+  bool in_flight; /**< True, if the request was submitted to the executor and counts into in_flight */
+};
+
+/**
+ * @brief Task handling one pipelined request and sending its tagged answer
+ * @param void* Pointer to a pipeline_request structure
+ *
+ * */
+static void sockethandler_pipeline_task(void *arg)
+{
+  struct pipeline_request *req = (struct pipeline_request *)arg;
+  struct pipeline_conn *c = req->conn;
+  /* FOOD requests run inline while the frame they came with is traced */
+  uint64_t prev = tracer_current();
+  uint64_t start = tracer_clock();
+  if(tracer_begin()) {
+    tracer_record("queue", req->submitted, start);
+  }
+  reply *r = reply_init();
+  dispatch_handle(c->sockethandler->dispatch, c->sock, req->msg, r);
+
+  char *buf = malloc(SOCK_FRAME_MAX);
+  char *frame = malloc(SOCK_FRAME_HEADER + SOCK_FRAME_MAX);
+  size_t next = 0;
+  while(next < reply_count(r)) {
+    size_t len = reply_encode_frame(r, req->id, &next, buf, SOCK_FRAME_MAX);
+    /* compress before locking, only the sending is serialized */
+    len = sock_frame_pack(frame, buf, len, c->compress);
+    /* lock per frame, so answers of cheap requests can overtake the rest of a large one */
+    uint64_t wait = tracer_clock();
+    pthread_mutex_lock(&c->write_mutex);
+    tracer_span("write lock", wait);
+    uint64_t send = tracer_clock();
+    if(!c->broken && !sock_write_packed(c->sock, frame, len)) {
+      LOGGER_LOG(LOGGER_WARN, "error sending reply to client %d", c->sock);
+      c->broken = true;
+    }
+    tracer_span("send", send);
+    pthread_mutex_unlock(&c->write_mutex);
+  }
+  free(frame);
+  free(buf);
+  reply_destroy(r);
+  tracer_end("request", start);
+  tracer_set_current(prev);
+  if(req->in_flight) {
+    pthread_mutex_lock(&c->flight_mutex);
+    c->in_flight--;
+    pthread_cond_signal(&c->flight_cond);
+    pthread_mutex_unlock(&c->flight_mutex);
+  }
+  free(req->msg);
+  free(req);
+}
+
+/**
+ * @brief Serves a connection in pipelined mode until it closes
+ * @param struct sockethandler_conn* The connection of the calling connection thread
+ * @param bool True, if answers may be sent as compressed frames
+ *
+ * Every received request becomes a task of the executor, so the requests of one connection are
+ * handled concurrently and their answers are sent in order of completion. FOOD requests are handled
+ * inline, so later requests of the same connection see the added food. At most PIPELINE_MAX_IN_FLIGHT
+ * requests of a connection wait in the executor, further ones are not read before one was answered.
+ *
+ * */
+static void sockethandler_pipeline(struct sockethandler_conn *conn, bool compress)
+{
+  sockethandler *s = conn->sockethandler;
+  int sock = conn->sock;
+  struct pipeline_conn c;
+  c.sockethandler = s;
+  c.sock = sock;
+  c.broken = false;
+  c.compress = compress;
+  c.in_flight = 0;
+  pthread_mutex_init(&c.write_mutex, NULL);
+  pthread_mutex_init(&c.flight_mutex, NULL);
+  pthread_cond_init(&c.flight_cond, NULL);
+  executor_group *g = executor_group_init();
+  char *buf = malloc(SOCK_FRAME_MAX + 1);
+  LOGGER_LOG(LOGGER_INFO, "Client %d switched to pipelined mode", sock);
+
+  while(!s->shutdown && !c.broken) {
+    sockethandler_set_deadline(conn, s->idle_timeout);
+    uint64_t start = tracer_clock();
+    ssize_t len = sock_read_frame(sock, buf);
+    if(len <= 0) {
+      /* Client is disconnected, missed its deadline or the server shuts down */
+      break;
+    }
+    /* the frame is traced like a request of its own, its requests are sampled separately */
+    uint64_t received = tracer_clock();
+    if(tracer_begin()) {
+      tracer_record("read frame", start, received);
+    }
+    char *save = NULL;
+    for(char *msg = strtok_r(buf, "\n", &save); msg; msg = strtok_r(NULL, "\n", &save)) {
+      uint64_t parse = tracer_clock();
+      unsigned long id = 0;
+      char *body = sock_parse_tag(msg, &id);
+      if(!body) {
+        LOGGER_LOG(LOGGER_WARN, "Error in protocol, expected tagged message from client %d", sock);
+        continue;
+      }
+      struct pipeline_request *req = malloc(sizeof(struct pipeline_request));
+      req->conn = &c;
+      req->id = id;
+      req->msg = strdup(body);
+      tracer_span("parse", parse);
+      req->submitted = tracer_clock();
+      req->in_flight = false;
+      if(s->executor && strncmp("FOOD:", body, 5)) {
+        pthread_mutex_lock(&c.flight_mutex);
+        while(c.in_flight >= PIPELINE_MAX_IN_FLIGHT) {
+          pthread_cond_wait(&c.flight_cond, &c.flight_mutex);
+        }
+        c.in_flight++;
+        pthread_mutex_unlock(&c.flight_mutex);
+        req->in_flight = true;
+        if(dispatch_is_long(body)) {
+          executor_submit_long(s->executor, g, sockethandler_pipeline_task, req);
+        } else {
+          executor_submit(s->executor, g, sockethandler_pipeline_task, req);
+        }
+      } else {
+        sockethandler_pipeline_task(req);
+      }
+    }
+    tracer_end("frame", received);
+  }
+
+  /* answer all requests in flight before the connection is closed */
+  if(s->executor) {
+    executor_wait(s->executor, g);
+  }
+  executor_group_destroy(g);
+  free(buf);
+  pthread_cond_destroy(&c.flight_cond);
+  pthread_mutex_destroy(&c.flight_mutex);
+  pthread_mutex_destroy(&c.write_mutex);
+}
+
 /**
  * @brief Method for client connection handling
- * @param sockethandler* A pointer to a valid sockethandler structure
+ * @param struct sockethandler_conn* The connection slot of the thread
  *
  * Every Thread is a consumer for the client_sockets[] array. If a socket is available, it is popped out
  * by one of the threads and served in a loop until the connection closes. After that, the thread waits for
  * its next client socket.
  *
  * */
-void sockethandler_client_thread_func(sockethandler *s)
+void *sockethandler_client_thread_func(struct sockethandler_conn *conn)
 {
+  sockethandler *s = conn->sockethandler;
   while(!s->shutdown) {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += 5;
     int sock = -1;
-    if (sem_timedwait(&s->full, &ts) == 0) {
+    if (sem_wait(&s->full) == 0 && !s->shutdown) {
       /* Acquire mutex lock to protect buffer */
       pthread_mutex_lock(&(s->mutex));
 
       sock = s->client_sockets[s->out];
+      uint64_t accept_time = s->accept_times[s->out];
       s->out++;
-      s->out %= MAX_SOCKETS;
+      s->out %= s->queue_size;
       assert(s->count > 0);
       s->count--;
-      assert(s->count == (s->in + MAX_SOCKETS - s->out) % MAX_SOCKETS);
+      assert(s->count == (s->in + s->queue_size - s->out) % s->queue_size);
 
       /* Release mutex lock and full semaphore */
       pthread_mutex_unlock(&(s->mutex));
       sem_post(&s->empty);
-
-      struct timeval timeout;
-      timeout.tv_sec = 5;
-      timeout.tv_usec = 0;
-      setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+      __atomic_sub_fetch(&s->metrics.queued, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&s->metrics.active, 1, __ATOMIC_RELAXED);
+      sockethandler_claim(conn, sock);
+      uint64_t claimed = tracer_clock();
 
       /* Receive a message from client */
+      reply *r = reply_init();
       while( !s->shutdown ) {
         char buf[BUF_LEN] = { 0 };
+        sockethandler_set_deadline(conn, s->idle_timeout);
+        uint64_t start = tracer_clock();
         int r_len = sock_read(sock, buf);
-        /* Client is disconnected */
-        if(r_len == 0) {
+        /* Client is disconnected, missed its deadline or the server shuts down */
+        if(r_len <= 0) {
           break;
         }
-        if(r_len == -1) {
-          /* 5 second timeout to be responsive to shutdown event, just try to read again */
-          continue;
+        sockethandler_set_deadline(conn, IO_TIMEOUT_MS);
+        reply_clear(r);
+        /* the read includes waiting for the client, the request starts when it was received */
+        uint64_t received = tracer_clock();
+        if(tracer_begin()) {
+          /* the first request of a connection also shows how long it waited in client_sockets */
+          if(accept_time) {
+            tracer_record("accept handoff", accept_time, claimed);
+          }
+          tracer_record("read", start, received);
         }
-        if(!strncmp("SEARCH:", buf, 7)) {
-          /* client is searches for something */
-          buf[strlen(buf) - 1] = 0; /* remove newline character */
-          printf("Client %d is searching for some %s\n", sock, buf + 7);
-          size_t n = 0;
-          food **foods = foodlist_find(s->foodlist, buf + 7, &n);
-          char cbuf[BUF_LEN] = { 0 };
-          snprintf(cbuf, BUF_LEN, "%zu", n);
-          if(sock_send_count(sock, cbuf)) {
-            for(int i = 0; i < n; ++i) {
-              food *f = foods[i];
-              char *c = food_serialize(f);
-              if(!sock_send_food(sock, c)) {
-                printf("error sending food\n");
-              }
-              free(c);
-            }
-            free(foods);
+        accept_time = 0;
+        if(!strncmp("HELLO:", buf, 6)) {
+          /* client negotiates features, answer with the supported ones */
+          char accepted[BUF_LEN] = { 0 };
+          sock_negotiate(buf + 6, accepted, sizeof(accepted));
+          if(sock_send_status(sock, "HELLO:", accepted, NULL) != SOCK_OK) {
+            break;
+          }
+          tracer_end("HELLO", received);
+          if(sock_has_feature(accepted, SOCK_PIPELINE)) {
+            sockethandler_pipeline(conn, sock_has_feature(accepted, SOCK_LZ));
+            break;
           }
-          printf("Sent %zu food items to client %d\n", n, sock);
-        } else if(!strncmp("FOOD:", buf, 5)) {
-          /* client adds some food */
-          printf("Client %d wants to add food\n", sock);
-          food *f = food_deserialize(buf + 5);
-          foodlist_append(s->foodlist, &f);
-          printf("Client %d added some %s\n", sock, food_get_name(f));
           continue;
-        } else {
-          printf("Error in protocol, expected SEARCH|FOOD");
         }
+        dispatch_handle(s->dispatch, sock, buf, r);
+        for(size_t i = 0; i < reply_count(r); ++i) {
+          if(!sock_write(sock, (char *)reply_get(r, i))) {
+            LOGGER_LOG(LOGGER_WARN, "error sending reply to client %d", sock);
+            break;
+          }
+        }
+        tracer_end("request", received);
       }
-      printf("Closing socket %d\n", sock);
+      reply_destroy(r);
+      sockethandler_release(conn);
+      LOGGER_LOG(LOGGER_INFO, "Closing socket %d", sock);
       shutdown(sock, 2);
       close(sock);
+      __atomic_sub_fetch(&s->metrics.active, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&s->metrics.closed, 1, __ATOMIC_RELAXED);
     }
   }
+  return NULL;
 }
 
-sockethandler *sockethandler_init(foodlist * fl)
+/**
+ * @brief Starts the thread pool of the thread backend
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ *
+ * */
+static void sockethandler_start_threads(sockethandler *s)
+{
+  /* set of attributes for the thread */
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  s->thread_pool = calloc(s->num_threads, sizeof(struct sockethandler_conn));
+  for(size_t i = 0; i < s->num_threads; ++i) {
+    s->thread_pool[i].sockethandler = s;
+    s->thread_pool[i].sock = -1;
+    s->thread_pool[i].timer = NULL;
+    /* create threads */
+    pthread_create(&s->thread_pool[i].thread, &attr, (void *(*)(void *))sockethandler_client_thread_func,
+                   &s->thread_pool[i]);
+  }
+  s->threads_started = true;
+}
+
+/**
+ * @brief Stops the thread pool of the thread backend, after the requests in flight are answered
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ *
+ * */
+static void sockethandler_stop_threads(sockethandler *s)
+{
+  /* no more requests are read, the busy threads finish their current one */
+  pthread_mutex_lock(&s->timer_mutex);
+  for(size_t i = 0; i < s->num_threads; ++i) {
+    if(s->thread_pool[i].sock >= 0) {
+      shutdown(s->thread_pool[i].sock, SHUT_RD);
+    }
+  }
+  pthread_mutex_unlock(&s->timer_mutex);
+  /* wake the idle threads */
+  for(size_t i = 0; i < s->num_threads; ++i) {
+    sem_post(&s->full);
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += DRAIN_MS / 1000;
+  for(size_t i = 0; i < s->num_threads; ++i) {
+    if(pthread_timedjoin_np(s->thread_pool[i].thread, NULL, &deadline) == 0) {
+      continue;
+    }
+    /* the client does not take its reply, give up on it */
+    pthread_mutex_lock(&s->timer_mutex);
+    if(s->thread_pool[i].sock >= 0) {
+      LOGGER_LOG(LOGGER_WARN, "Closing socket %d with a request in flight", s->thread_pool[i].sock);
+      shutdown(s->thread_pool[i].sock, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&s->timer_mutex);
+    pthread_join(s->thread_pool[i].thread, NULL);
+  }
+
+  /* connections still waiting in the queue are never served */
+  while(s->count > 0) {
+    close(s->client_sockets[s->out]);
+    s->out = (s->out + 1) % s->queue_size;
+    s->count--;
+    __atomic_sub_fetch(&s->metrics.queued, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->metrics.closed, 1, __ATOMIC_RELAXED);
+  }
+  s->threads_started = false;
+}
+
+sockethandler *sockethandler_init(dataset * ds)
 {
   sockethandler *s = (sockethandler *)malloc(sizeof(sockethandler));
 
   s->shutdown = false;
-  s->foodlist = fl;
+  s->dataset = ds;
+  if(pipe(s->wake_pipe) == 0) {
+    fcntl(s->wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(s->wake_pipe[1], F_SETFL, O_NONBLOCK);
+  } else {
+    perror("Could not create wake pipe");
+  }
+  s->idle_timeout = DEFAULT_IDLE_TIMEOUT * 1000;
+  s->timers = timerwheel_init(1000);
+  pthread_mutex_init(&s->timer_mutex, NULL);
   s->in = 0;
   s->out = 0;
   s->count = 0;
 
   /* initialize semaphores and mutex */
-  sem_init(&(s->empty), 0, MAX_SOCKETS);
+  s->queue_size = DEFAULT_QUEUE_SIZE;
+  s->backlog = DEFAULT_BACKLOG;
+  memset(&s->metrics, 0, sizeof(connmetrics));
+  s->client_sockets = calloc(s->queue_size, sizeof(int));
+  s->accept_times = calloc(s->queue_size, sizeof(uint64_t));
+  sem_init(&(s->empty), 0, s->queue_size);
   sem_init(&(s->full), 0, 0);
   pthread_mutex_init(&(s->mutex), NULL);
 
   s->listen_port = 11184;
+  s->listen_tcp = true;
+  s->unix_path = NULL;
+  s->backend = SOCKETHANDLER_THREADS;
+  s->threads_started = false;
+  s->num_threads = DEFAULT_THREADS;
+  s->thread_pool = NULL;
+  s->dispatch = dispatch_init(ds);
+  s->core_dispatch = dispatch_init(ds);
+  /* the event loops answer small searches themselves and hand everything else to the worker pool */
+  dispatch_set_local(s->core_dispatch, true);
+  s->executor = NULL;
 
-  /* set of attributes for the thread */
-  pthread_attr_t attr;
-  pthread_attr_init(&attr);
-  for(int i = 0; i < MAX_THREADS; ++i) {
-    /* create threads */
-    pthread_create(&s->thread_pool[i], &attr, (void *(*)(void *))sockethandler_client_thread_func, (void *)s);
+  return s;
+}
+
+
+/**
+ * @brief Creates the listening TCP socket
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ * @param bool True, if several sockets share the port and the kernel distributes the connections among them
+ * @return The listening socket, or -1 on errors
+ *
+ * */
+static int sockethandler_listen_tcp(sockethandler *s, bool reuseport)
+{
+  struct sockaddr_in server;
+
+  /* create socket */
+  int socket_desc = socket(AF_INET , SOCK_STREAM , 0);
+  if (socket_desc == -1) {
+    perror("Could not create socket");
+    return -1;
   }
 
-  for(int i = 0; i < MAX_SOCKETS; ++i) {
-    s->client_sockets[i] = 0;
+  /* a restarted server must not wait for the connections of its predecessor in TIME_WAIT */
+  int one = 1;
+  setsockopt(socket_desc, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (reuseport && setsockopt(socket_desc, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+    perror("Could not share port");
+    close(socket_desc);
+    return -1;
   }
 
-  return s;
+  /* Prepare the sockaddr_in structure */
+  server.sin_family = AF_INET;
+  server.sin_addr.s_addr = INADDR_ANY;
+  server.sin_port = htons(s->listen_port);
+
+  /* Bind */
+  if( bind(socket_desc, (struct sockaddr *)&server , sizeof(server)) < 0) {
+    LOGGER_LOG(LOGGER_ERROR, "Could not bind to port %u", s->listen_port);
+    close(socket_desc);
+    return -1;
+  }
+
+  /* Listen */
+  listen(socket_desc , s->backlog);
+
+  if (!reuseport) {
+    LOGGER_LOG(LOGGER_INFO, "Server bound to port %u, waiting for incoming connections", s->listen_port);
+  }
+  return socket_desc;
 }
 
+/**
+ * @brief Creates the listening Unix domain socket
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ * @return The listening socket, or -1 on errors
+ *
+ * */
+static int sockethandler_listen_unix(sockethandler *s)
+{
+  struct sockaddr_un server;
+  if (strlen(s->unix_path) >= sizeof(server.sun_path)) {
+    LOGGER_LOG(LOGGER_ERROR, "Socket path %s is too long", s->unix_path);
+    return -1;
+  }
+
+  int socket_desc = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_desc == -1) {
+    perror("Could not create socket");
+    return -1;
+  }
+
+  /* a socket left behind by a previous run would make bind fail, other files are never removed */
+  struct stat st;
+  if (stat(s->unix_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    unlink(s->unix_path);
+  }
+
+  memset(&server, 0, sizeof(server));
+  server.sun_family = AF_UNIX;
+  strcpy(server.sun_path, s->unix_path);
+  if (bind(socket_desc, (struct sockaddr *)&server, sizeof(server)) < 0) {
+    LOGGER_LOG(LOGGER_ERROR, "Could not bind to %s", s->unix_path);
+    close(socket_desc);
+    return -1;
+  }
+  listen(socket_desc, s->backlog);
+
+  LOGGER_LOG(LOGGER_INFO, "Server bound to %s, waiting for incoming connections", s->unix_path);
+  return socket_desc;
+}
+
+/**
+ * @brief Accepts a connection and queues it for the thread pool, or rejects it when the queue is full
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ * @param int The listening socket which is ready
+ *
+ * */
+static void sockethandler_accept(sockethandler *s, int socket_desc)
+{
+  struct sockaddr_storage client;
+  socklen_t len = sizeof(client);
+  int client_sock = accept(socket_desc, (struct sockaddr *)&client, &len);
+  if (client_sock < 0) {
+    perror("accept failed");
+    return;
+  }
+  if (client.ss_family == AF_INET) {
+    LOGGER_LOG(LOGGER_INFO, "New connection from %s on socket %d", inet_ntoa(((struct sockaddr_in *)&client)->sin_addr), client_sock);
+  } else {
+    LOGGER_LOG(LOGGER_INFO, "New local connection on socket %d", client_sock);
+  }
+  __atomic_add_fetch(&s->metrics.accepted, 1, __ATOMIC_RELAXED);
+
+  /* never block the accept loop, a full queue means we are over capacity */
+  if (sem_trywait(&s->empty) == 0) {
+
+    /* Acquire mutex lock to protect buffer */
+    pthread_mutex_lock(&(s->mutex));
+
+    s->client_sockets[s->in] = client_sock;
+    s->accept_times[s->in] = tracer_clock();
+    s->in++;
+    s->in %= s->queue_size;
+    assert(s->count < s->queue_size);
+    s->count++;
+    size_t queued = __atomic_add_fetch(&s->metrics.queued, 1, __ATOMIC_RELAXED);
+    if (queued > s->metrics.queue_high_water) {
+      s->metrics.queue_high_water = queued;
+    }
+
+    /* Release mutex lock and full semaphore */
+    pthread_mutex_unlock(&(s->mutex));
+    sem_post(&s->full);
+  } else {
+    /* shed the connection, the retry time grows with the number of clients waiting per thread */
+    unsigned int retry = RETRY_MS * (1 + s->queue_size / s->num_threads);
+    LOGGER_LOG(LOGGER_WARN, "Server busy, rejecting socket %d, retry after %u ms", client_sock, retry);
+    sock_send_busy(client_sock, retry);
+    shutdown(client_sock, SHUT_WR);
+    close(client_sock);
+    __atomic_add_fetch(&s->metrics.rejected, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * @brief An event loop of the per-core backend
+ *
+ */
+struct sockethandler_core {
+  sockethandler *s; /**< The sockethandler */
+  int cpu; /**< CPU the loop is pinned to */
+  uringhandler *uring; /**< Event loop serving the connections accepted by this core */
+  int listen_fds[2]; /**< Own SO_REUSEPORT listener, the first core serves the Unix domain socket as well */
+  size_t num_fds; /**< Number of listening sockets */
+  pthread_t thread; /**< Thread running the event loop */
+};
+
+/**
+ * @brief Thread function of the per-core backend, pins itself to its CPU and runs its event loop
+ * @param void* Pointer to a sockethandler_core structure
+ *
+ * */
+static void *sockethandler_core_func(void *arg)
+{
+  struct sockethandler_core *c = arg;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(c->cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  uringhandler_run(c->uring, c->listen_fds, c->num_fds, c->s->wake_pipe[0]);
+  return NULL;
+}
+
+/**
+ * @brief Runs one event loop per CPU until shutdown
+ * @param sockethandler* A pointer to a valid sockethandler structure
+ * @return False, if io_uring is not available, true otherwise
+ *
+ * There is no accept thread and no shared connection queue, the kernel distributes new connections over
+ * the SO_REUSEPORT listeners and every connection stays on the CPU which accepted it. Unix domain sockets
+ * cannot share their path, so the first core serves the Unix domain socket.
+ *
+ * */
+static bool sockethandler_run_cores(sockethandler *s)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_cores = cpus > 0 ? cpus : 1;
+  struct sockethandler_core *cores = calloc(num_cores, sizeof(struct sockethandler_core));
+  bool supported = true;
+  bool failed = false;
+  size_t n = 0;
+  for (; n < num_cores && !failed; ++n) {
+    struct sockethandler_core *c = &cores[n];
+    c->s = s;
+    c->cpu = n;
+    c->uring = uringhandler_init(s->core_dispatch, MAX_URING_CONNECTIONS, &s->metrics);
+    if (!c->uring) {
+      supported = false;
+      break;
+    }
+    uringhandler_set_idle_timeout(c->uring, s->idle_timeout);
+    if (s->listen_tcp) {
+      int fd = sockethandler_listen_tcp(s, true);
+      failed |= fd < 0;
+      if (fd >= 0) {
+        c->listen_fds[c->num_fds++] = fd;
+      }
+    }
+    if (n == 0 && s->unix_path) {
+      int fd = sockethandler_listen_unix(s);
+      failed |= fd < 0;
+      if (fd >= 0) {
+        c->listen_fds[c->num_fds++] = fd;
+      }
+    }
+  }
+
+  if (supported && !failed) {
+    if (s->listen_tcp) {
+      LOGGER_LOG(LOGGER_INFO, "Server bound to port %u, waiting for incoming connections", s->listen_port);
+    }
+    LOGGER_LOG(LOGGER_INFO, "Serving connections with %zu io_uring event loops, one per CPU", num_cores);
+    for (size_t i = 0; i < n; ++i) {
+      pthread_create(&cores[i].thread, NULL, sockethandler_core_func, &cores[i]);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      pthread_join(cores[i].thread, NULL);
+    }
+  } else if (supported) {
+    LOGGER_LOG(LOGGER_ERROR, "Could not create all listening sockets, trying again in 5 seconds");
+    sleep(5);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    if (cores[i].uring) {
+      uringhandler_destroy(cores[i].uring);
+    }
+    for (size_t j = 0; j < cores[i].num_fds; ++j) {
+      close(cores[i].listen_fds[j]);
+    }
+  }
+  free(cores);
+  return supported;
+}
 
 void sockethandler_server_thread_func(sockethandler * s)
 {
   while (!s->shutdown) {
-    int socket_desc;
-    int client_sock;
-    struct sockaddr_in server;
-    struct sockaddr_in client;
-
-    /* create socket */
-    socket_desc = socket(AF_INET , SOCK_STREAM , 0);
-    if (socket_desc == -1) {
-      perror("Could not create socket, trying again in 5 seconds");
-      sleep(5);
-      continue;
+    if (s->backend == SOCKETHANDLER_PERCORE) {
+      if (sockethandler_run_cores(s)) {
+        continue;
+      }
+      LOGGER_LOG(LOGGER_WARN, "io_uring is not available, falling back to thread pool");
+      s->backend = SOCKETHANDLER_THREADS;
     }
 
-    /* Prepare the sockaddr_in structure */
-    server.sin_family = AF_INET;
-    server.sin_addr.s_addr = INADDR_ANY;
-    server.sin_port = htons(s->listen_port);
+    int listen_fds[2];
+    size_t num_fds = 0;
+    bool failed = false;
 
-    /* Bind */
-    if( bind(socket_desc, (struct sockaddr *)&server , sizeof(server)) < 0) {
-      printf("Could not bind to port %u, trying again in 5 seconds\n", s->listen_port);
-        close(socket_desc);
+    if (s->listen_tcp) {
+      int fd = sockethandler_listen_tcp(s, false);
+      failed |= fd < 0;
+      if (fd >= 0) {
+        listen_fds[num_fds++] = fd;
+      }
+    }
+    if (s->unix_path) {
+      int fd = sockethandler_listen_unix(s);
+      failed |= fd < 0;
+      if (fd >= 0) {
+        listen_fds[num_fds++] = fd;
+      }
+    }
+    if (failed || num_fds == 0) {
+      LOGGER_LOG(LOGGER_ERROR, "Could not create all listening sockets, trying again in 5 seconds");
+      for (size_t i = 0; i < num_fds; ++i) {
+        close(listen_fds[i]);
+      }
       sleep(5);
       continue;
     }
 
-    /* Listen */
-    listen(socket_desc , 3);
-
-    printf("Server bound to port %u, waiting for incoming connections\n", s->listen_port);
+    if(s->backend == SOCKETHANDLER_URING) {
+      uringhandler *h = uringhandler_init(s->dispatch, MAX_URING_CONNECTIONS, &s->metrics);
+      if(h) {
+        LOGGER_LOG(LOGGER_INFO, "Serving connections with io_uring");
+        uringhandler_set_idle_timeout(h, s->idle_timeout);
+        uringhandler_run(h, listen_fds, num_fds, s->wake_pipe[0]);
+        uringhandler_destroy(h);
+        for (size_t i = 0; i < num_fds; ++i) {
+          close(listen_fds[i]);
+        }
+        continue;
+      }
+      LOGGER_LOG(LOGGER_WARN, "io_uring is not available, falling back to thread pool");
+      s->backend = SOCKETHANDLER_THREADS;
+    }
+    if(!s->threads_started) {
+      sockethandler_start_threads(s);
+    }
 
     while (!s->shutdown) {
       fd_set set;
       FD_ZERO(&set); /* clear the set */
-      FD_SET(socket_desc, &set); /* add our file descriptor to the set */
+      FD_SET(s->wake_pipe[0], &set);
+      int max_fd = s->wake_pipe[0];
+      for (size_t i = 0; i < num_fds; ++i) {
+        FD_SET(listen_fds[i], &set); /* add our file descriptors to the set */
+        if (listen_fds[i] > max_fd) {
+          max_fd = listen_fds[i];
+        }
+      }
+
+      /* sleep until a connection or shutdown arrives, tick the deadlines every second while there are any */
+      pthread_mutex_lock(&s->timer_mutex);
+      bool ticking = timerwheel_count(s->timers) > 0;
+      pthread_mutex_unlock(&s->timer_mutex);
       struct timeval timeout;
-      timeout.tv_sec = 5;
+      timeout.tv_sec = 1;
       timeout.tv_usec = 0;
 
-      int rv = select(socket_desc + 1, &set, NULL, NULL, &timeout);
+      int rv = select(max_fd + 1, &set, NULL, NULL, ticking ? &timeout : NULL);
+
+      pthread_mutex_lock(&s->timer_mutex);
+      timerwheel_advance(s->timers, timerwheel_now(), sockethandler_on_deadline);
+      pthread_mutex_unlock(&s->timer_mutex);
 
       if(rv == -1) {
-        perror("select"); /* an error accured */
+        if (errno != EINTR) {
+          perror("select"); /* an error accured */
+        }
         continue;
       } else if(rv == 0) {
         continue;
-      } else {
-        int len = sizeof(struct sockaddr_in);
-        client_sock = accept(socket_desc, (struct sockaddr *)&client, (socklen_t*)&len);
-        if (client_sock < 0) {
-          perror("accept failed");
-          continue;
-        } else {
-          printf("New connection from %s on socket %d\n", inet_ntoa(client.sin_addr), client_sock);
-
-          struct timespec ts;
-          clock_gettime(CLOCK_REALTIME, &ts);
-          ts.tv_sec += 5;
-
-          if (sem_timedwait(&s->empty, &ts) == 0) {
-
-            /* Acquire mutex lock to protect buffer */
-            pthread_mutex_lock(&(s->mutex));
-
-            s->client_sockets[s->in] = client_sock;
-            s->in++;
-            s->in %= MAX_SOCKETS;
-            assert(s->count < MAX_SOCKETS);
-            s->count++;
-
-            /* Release mutex lock and full semaphore */
-            pthread_mutex_unlock(&(s->mutex));
-            sem_post(&s->full);
-          }
+      }
+      if (FD_ISSET(s->wake_pipe[0], &set)) {
+        char c[16];
+        while (read(s->wake_pipe[0], c, sizeof(c)) > 0) {
+        }
+      }
+      for (size_t i = 0; i < num_fds && !s->shutdown; ++i) {
+        if (FD_ISSET(listen_fds[i], &set)) {
+          sockethandler_accept(s, listen_fds[i]);
         }
       }
     }
+    for (size_t i = 0; i < num_fds; ++i) {
+      close(listen_fds[i]);
+    }
+  }
+  if (s->threads_started) {
+    sockethandler_stop_threads(s);
+  }
+  if (s->unix_path) {
+    unlink(s->unix_path);
   }
 }
 
@@ -257,16 +913,106 @@ void sockethandler_set_port(sockethandler * s, int port)
   s->listen_port = port;
 }
 
+void sockethandler_set_unix_path(sockethandler * s, const char *path, bool tcp)
+{
+  free(s->unix_path);
+  s->unix_path = path ? strdup(path) : NULL;
+  s->listen_tcp = tcp || !path;
+}
+
+void sockethandler_set_backend(sockethandler * s, sockethandler_backend backend)
+{
+  s->backend = backend;
+}
+
+void sockethandler_set_threads(sockethandler * s, size_t threads)
+{
+  s->num_threads = threads > 0 ? threads : DEFAULT_THREADS;
+}
+
+void sockethandler_set_queue_size(sockethandler * s, size_t size)
+{
+  s->queue_size = size > 0 ? size : DEFAULT_QUEUE_SIZE;
+  free(s->client_sockets);
+  free(s->accept_times);
+  s->client_sockets = calloc(s->queue_size, sizeof(int));
+  s->accept_times = calloc(s->queue_size, sizeof(uint64_t));
+  sem_destroy(&s->empty);
+  sem_init(&(s->empty), 0, s->queue_size);
+}
+
+void sockethandler_set_backlog(sockethandler * s, int backlog)
+{
+  s->backlog = backlog > 0 ? backlog : DEFAULT_BACKLOG;
+}
+
+connmetrics *sockethandler_get_metrics(sockethandler * s)
+{
+  return &s->metrics;
+}
+
+void sockethandler_set_executor(sockethandler * s, executor * ex)
+{
+  s->executor = ex;
+  dispatch_set_executor(s->dispatch, ex);
+  dispatch_set_executor(s->core_dispatch, ex);
+}
+
+void sockethandler_set_querycache(sockethandler * s, querycache * qc)
+{
+  dispatch_set_querycache(s->dispatch, qc);
+  dispatch_set_querycache(s->core_dispatch, qc);
+}
+
+void sockethandler_set_replica(sockethandler * s, replica * rp)
+{
+  dispatch_set_replica(s->dispatch, rp);
+  dispatch_set_replica(s->core_dispatch, rp);
+}
+
+void sockethandler_set_router(sockethandler * s, router * rt)
+{
+  dispatch_set_router(s->dispatch, rt);
+  dispatch_set_router(s->core_dispatch, rt);
+}
+
+void sockethandler_set_stats(sockethandler * s, stats * st)
+{
+  dispatch_set_stats(s->dispatch, st);
+  dispatch_set_stats(s->core_dispatch, st);
+}
+
+void sockethandler_set_planner(sockethandler * s, planner * pl)
+{
+  dispatch_set_planner(s->dispatch, pl);
+  dispatch_set_planner(s->core_dispatch, pl);
+}
+
+void sockethandler_set_idle_timeout(sockethandler * s, unsigned int seconds)
+{
+  s->idle_timeout = seconds * 1000;
+}
+
 void sockethandler_shutdown(sockethandler * s)
 {
   s->shutdown = true;
-  for(int i = 0; i < MAX_THREADS; ++i) {
-    pthread_join(s->thread_pool[i], NULL);
-  }
+  /* only async-signal-safe calls, this runs in a signal handler */
+  ssize_t w = write(s->wake_pipe[1], "q", 1);
+  (void)w;
 }
 
 void sockethandler_destroy(sockethandler * s)
 {
+  dispatch_destroy(s->dispatch);
+  dispatch_destroy(s->core_dispatch);
+  free(s->thread_pool);
+  free(s->client_sockets);
+  free(s->accept_times);
+  free(s->unix_path);
+  timerwheel_destroy(s->timers);
+  pthread_mutex_destroy(&s->timer_mutex);
+  close(s->wake_pipe[0]);
+  close(s->wake_pipe[1]);
   pthread_mutex_destroy(&s->mutex);
   sem_destroy(&s->full);
   sem_destroy(&s->empty);
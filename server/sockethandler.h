@@ -16,7 +16,14 @@
 #ifndef SOCKETHANDLER_H
 #define SOCKETHANDLER_H
 
-#include "../lib/foodlist.h"
+#include "dataset.h"
+#include "replica.h"
+#include "router.h"
+#include "executor.h"
+#include "querycache.h"
+#include "connmetrics.h"
+#include "stats.h"
+#include "planner.h"
 
 /**
  *
@@ -25,22 +32,35 @@
  * */
 typedef struct sockethandler sockethandler;
 
+/**
+ *
+ * @brief I/O backends for serving client connections
+ *
+ * */
+typedef enum sockethandler_backend {
+  SOCKETHANDLER_THREADS, /**< Thread pool with one blocking thread per connection */
+  SOCKETHANDLER_URING, /**< Single threaded io_uring event loop, falls back to SOCKETHANDLER_THREADS if unsupported */
+  SOCKETHANDLER_PERCORE /**< One io_uring event loop per CPU with its own SO_REUSEPORT listener, falls back like
+                             SOCKETHANDLER_URING */
+} sockethandler_backend;
+
 /**
  * @brief Constructor for sockethandler
+ * @param dataset* The foods the server works on
  * @return A pointer to the sockethandler structure, representing the created object
  *
  * After using this structure, it must be freed with sockethandler_destroy(food *)
  *
  * */
-sockethandler *sockethandler_init(foodlist *);
+sockethandler *sockethandler_init(dataset *);
 
 /**
 * @brief Main loop function for the sockethandling procedure
 * @param sockethandler* A pointer to a valid initialized sockethandler structure
 *
 * This method starts a listening socket and produces client sockets for the spawned threads which are
-* responsible for client connection handling. The method returns after sockethandler_shutdown() was called
-* and all threads ended gracefully.
+* responsible for client connection handling. The method returns after sockethandler_shutdown() was called,
+* the requests in flight were answered and all threads ended gracefully.
 *
 * */
 void sockethandler_server_thread_func(sockethandler *s);
@@ -49,12 +69,23 @@ void sockethandler_server_thread_func(sockethandler *s);
 * @brief Function to notify main loop thread, that it should shut down.
 * @param sockethandler* A pointer to a valid initialized sockethandler structure
 *
-* This method sets the shutdown flag for the sockethandler structure. After that it joins all
-* running threads before it returns.
+* This method sets the shutdown flag for the sockethandler structure and wakes up the main loop, which
+* stops accepting connections immediately. It is async-signal-safe and returns without waiting.
 *
 * */
 void sockethandler_shutdown(sockethandler *s);
 
+/**
+* @brief Method for limiting the time a connection may wait for its next request
+* @param sockethandler* Pointer to structure to work on
+* @param unsigned int Idle timeout in seconds, 0 for no limit. Must be set before the main loop starts.
+*
+* Idle connections are closed after this time, the default is 300 seconds. Sending a reply always has
+* to complete within 30 seconds.
+*
+* */
+void sockethandler_set_idle_timeout(sockethandler *s, unsigned int seconds);
+
 /**
 * @brief Method for setting the listening port of a sockethandler structure
 * @param sockethandler* Pointer to structure to work on
@@ -63,6 +94,108 @@ void sockethandler_shutdown(sockethandler *s);
 * */
 void sockethandler_set_port(sockethandler *s, int port);
 
+/**
+* @brief Method for letting a sockethandler structure listen on a Unix domain socket
+* @param sockethandler* Pointer to structure to work on
+* @param char* Path of the socket, NULL to disable. A stale socket at this path is replaced.
+* @param bool True, if the TCP port is served as well, false to serve local clients only
+*
+* */
+void sockethandler_set_unix_path(sockethandler *s, const char *path, bool tcp);
+
+/**
+* @brief Method for selecting the I/O backend of a sockethandler structure
+* @param sockethandler* Pointer to structure to work on
+* @param sockethandler_backend Backend to serve client connections with, must be set before the main loop starts
+*
+* */
+void sockethandler_set_backend(sockethandler *s, sockethandler_backend backend);
+
+/**
+* @brief Method for setting the number of connection threads of the thread backend
+* @param sockethandler* Pointer to structure to work on
+* @param size_t Number of threads, 0 for the default of 10. Must be set before the main loop starts.
+*
+* Every connection thread serves one client connection at a time.
+*
+* */
+void sockethandler_set_threads(sockethandler *s, size_t threads);
+
+/**
+* @brief Method for setting the number of accepted connections which may wait for a connection thread
+* @param sockethandler* Pointer to structure to work on
+* @param size_t Queue size, 0 for the default of 5. Must be set before the main loop starts.
+*
+* When the queue is full, new connections are answered with BUSY and a retry time and closed
+* immediately instead of waiting for a free slot.
+*
+* */
+void sockethandler_set_queue_size(sockethandler *s, size_t size);
+
+/**
+* @brief Method for setting the backlog of the listening socket
+* @param sockethandler* Pointer to structure to work on
+* @param int Backlog, 0 for the default of 128. Must be set before the main loop starts.
+*
+* */
+void sockethandler_set_backlog(sockethandler *s, int backlog);
+
+/**
+* @brief Method for getting the connection level metrics of a sockethandler structure
+* @param sockethandler* Pointer to structure to work on
+* @return The counters, owned by the sockethandler. Read them with connmetrics_read().
+*
+* */
+connmetrics *sockethandler_get_metrics(sockethandler *s);
+
+/**
+* @brief Method for setting the worker pool the requests of all connections are executed on
+* @param sockethandler* Pointer to structure to work on
+* @param executor* The executor, or NULL to handle requests on the connection threads
+*
+* */
+void sockethandler_set_executor(sockethandler *s, executor *ex);
+
+/**
+* @brief Method for setting the cache for search replies of all connections
+* @param sockethandler* Pointer to structure to work on
+* @param querycache* The cache, or NULL to disable caching
+*
+* */
+void sockethandler_set_querycache(sockethandler *s, querycache *qc);
+
+/**
+* @brief Method for making the server a replica, which forwards added foods to its primary
+* @param sockethandler* Pointer to structure to work on
+* @param replica* The replica, or NULL to add foods to the own dataset
+*
+* */
+void sockethandler_set_replica(sockethandler *s, replica *rp);
+
+/**
+* @brief Method for making the server a router, which forwards searches and added foods to its shards
+* @param sockethandler* Pointer to structure to work on
+* @param router* The router, or NULL to handle the requests with the own dataset
+*
+* */
+void sockethandler_set_router(sockethandler *s, router *rt);
+
+/**
+* @brief Method for setting the counters of the handled requests, which are also answered to STATS
+* @param sockethandler* Pointer to structure to work on
+* @param stats* The counters, or NULL to disable counting
+*
+* */
+void sockethandler_set_stats(sockethandler *s, stats *st);
+
+/**
+* @brief Method for setting the planner answering PLAN requests
+* @param sockethandler* Pointer to structure to work on
+* @param planner* The planner, or NULL to answer PLAN requests without plans
+*
+* */
+void sockethandler_set_planner(sockethandler *s, planner *pl);
+
 /**
  * @brief Destructor for sockethandler
  * @param sockethandler* Pointer to structure to be freed
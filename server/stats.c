@@ -0,0 +1,247 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file stats.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the stats structure and its member methods.
+ *
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "../lib/foodlist.h"
+#include "stats.h"
+
+#define STATS_LATENCY_BITS 7 /**< Precision of the latency histograms, below 2% error */
+#define STATS_RESULTS_BITS 5 /**< Precision of the result size histograms, below 7% error */
+
+/**
+ * @brief Counters of the requests handled by one thread
+ *
+ */
+struct stats_shard {
+  pthread_mutex_t mutex; /**< Mutex against readers merging the shard, uncontended otherwise */
+  bool owned; /**< Whether a running thread records into the shard, taken under the mutex of stats */
+  histogram *latency[STATS_COMMANDS]; /**< Latencies in nanoseconds per command */
+  histogram *results[STATS_COMMANDS]; /**< Numbers of results per command */
+  struct stats_shard *next; /**< Next shard */
+};
+
+/**
+ * @brief stats structure for representing the request counters of the server
+ *
+ */
+struct stats {
+  dataset *dataset; /**< Dataset whose foodlist is reported, or NULL */
+  connmetrics *metrics; /**< Connection metrics which are reported, or NULL */
+  pthread_key_t current; /**< Key for finding the shard of the calling thread */
+  pthread_mutex_t mutex; /**< Mutex protecting the list of shards */
+  struct stats_shard *shards; /**< Shards of all threads which ever recorded */
+};
+
+/**
+ * @brief Names of the commands, in the order of stats_command
+ *
+ */
+static const char *stats_names[STATS_COMMANDS] = { "SEARCH", "SEARCH?", "FOOD", "SUBSCRIBE", "STATS", "PLAN", "SIMILAR", "OTHER" };
+
+/**
+ * @brief Releases the shard of an exiting thread, so it is reused by the next new thread
+ * @param void* The shard
+ *
+ * */
+static void stats_release_shard(void *arg)
+{
+  struct stats_shard *sh = (struct stats_shard *)arg;
+  /* the counters stay in the shard, the stats keep reporting them */
+  __atomic_store_n(&sh->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Finds the shard of the calling thread, taking a free one or creating one on its first request
+ * @param stats* Pointer to structure to work on
+ * @return The shard
+ *
+ * */
+static struct stats_shard *stats_shard_of(stats *st)
+{
+  struct stats_shard *sh = pthread_getspecific(st->current);
+  if(sh) {
+    return sh;
+  }
+  pthread_mutex_lock(&st->mutex);
+  for(sh = st->shards; sh; sh = sh->next) {
+    if(!__atomic_load_n(&sh->owned, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+  }
+  if(!sh) {
+    sh = (struct stats_shard *)malloc(sizeof(struct stats_shard));
+    pthread_mutex_init(&sh->mutex, NULL);
+    for(int i = 0; i < STATS_COMMANDS; ++i) {
+      sh->latency[i] = histogram_init(STATS_LATENCY_BITS);
+      sh->results[i] = histogram_init(STATS_RESULTS_BITS);
+    }
+    sh->next = st->shards;
+    st->shards = sh;
+  }
+  __atomic_store_n(&sh->owned, true, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&st->mutex);
+  pthread_setspecific(st->current, sh);
+  return sh;
+}
+
+stats *stats_init(dataset *ds, connmetrics *m)
+{
+  stats *st = (stats *)malloc(sizeof(stats));
+  st->dataset = ds;
+  st->metrics = m;
+  pthread_key_create(&st->current, stats_release_shard);
+  pthread_mutex_init(&st->mutex, NULL);
+  st->shards = NULL;
+  return st;
+}
+
+stats_command stats_command_of(const char *msg)
+{
+  if(!strncmp("SEARCH:", msg, 7)) {
+    return STATS_SEARCH;
+  } else if(!strncmp("SEARCH?", msg, 7)) {
+    return STATS_SEARCH_PAGE;
+  } else if(!strncmp("FOOD:", msg, 5)) {
+    return STATS_FOOD;
+  } else if(!strncmp("SUBSCRIBE:", msg, 10)) {
+    return STATS_SUBSCRIBE;
+  } else if(!strncmp("STATS:", msg, 6)) {
+    return STATS_STATS;
+  } else if(!strncmp("PLAN:", msg, 5)) {
+    return STATS_PLAN;
+  } else if(!strncmp("SIMILAR", msg, 7) && (msg[7] == ':' || msg[7] == '?')) {
+    return STATS_SIMILAR;
+  }
+  return STATS_OTHER;
+}
+
+const char *stats_command_name(stats_command cmd)
+{
+  return stats_names[cmd];
+}
+
+void stats_record(stats *st, stats_command cmd, uint64_t ns, size_t results)
+{
+  struct stats_shard *sh = stats_shard_of(st);
+  pthread_mutex_lock(&sh->mutex);
+  histogram_record(sh->latency[cmd], ns);
+  histogram_record(sh->results[cmd], results);
+  pthread_mutex_unlock(&sh->mutex);
+}
+
+void stats_merge(stats *st, stats_command cmd, histogram *latency, histogram *results)
+{
+  pthread_mutex_lock(&st->mutex);
+  for(struct stats_shard *sh = st->shards; sh; sh = sh->next) {
+    pthread_mutex_lock(&sh->mutex);
+    histogram_merge(latency, sh->latency[cmd]);
+    histogram_merge(results, sh->results[cmd]);
+    pthread_mutex_unlock(&sh->mutex);
+  }
+  pthread_mutex_unlock(&st->mutex);
+}
+
+void stats_report(stats *st, reply *r)
+{
+  char buf[512];
+  histogram *latency = histogram_init(STATS_LATENCY_BITS);
+  histogram *results = histogram_init(STATS_RESULTS_BITS);
+  for(int i = 0; i < STATS_COMMANDS; ++i) {
+    histogram_clear(latency);
+    histogram_clear(results);
+    stats_merge(st, i, latency, results);
+    snprintf(buf, sizeof(buf), "%s count=%llu mean_us=%.1f p50_us=%.1f p90_us=%.1f p99_us=%.1f p999_us=%.1f "
+             "max_us=%.1f results_mean=%.1f results_p50=%llu results_p99=%llu results_max=%llu",
+             stats_names[i], (unsigned long long)histogram_count(latency), histogram_mean(latency) / 1000.0,
+             histogram_percentile(latency, 50) / 1000.0, histogram_percentile(latency, 90) / 1000.0,
+             histogram_percentile(latency, 99) / 1000.0, histogram_percentile(latency, 99.9) / 1000.0,
+             histogram_max(latency) / 1000.0, histogram_mean(results),
+             (unsigned long long)histogram_percentile(results, 50),
+             (unsigned long long)histogram_percentile(results, 99), (unsigned long long)histogram_max(results));
+    reply_add(r, "STAT:", buf);
+  }
+  histogram_destroy(latency);
+  histogram_destroy(results);
+
+  if(st->metrics) {
+    connmetrics c;
+    connmetrics_read(st->metrics, &c);
+    snprintf(buf, sizeof(buf), "connections accepted=%zu rejected=%zu closed=%zu timed_out=%zu active=%zu "
+             "queued=%zu queue_high_water=%zu", c.accepted, c.rejected, c.closed, c.timed_out, c.active, c.queued,
+             c.queue_high_water);
+    reply_add(r, "STAT:", buf);
+  }
+
+  if(st->dataset) {
+    foodlist *fl = dataset_acquire(st->dataset);
+    foodlist_lockstats l;
+    foodlist_get_lockstats(fl, &l);
+    snprintf(buf, sizeof(buf), "foodlist foods=%d memory_kb=%zu", foodlist_count(fl), foodlist_memory(fl) / 1024);
+    reply_add(r, "STAT:", buf);
+    snprintf(buf, sizeof(buf), "locks read=%llu read_wait_mean_us=%.3f read_wait_max_us=%.1f write=%llu "
+             "write_wait_mean_us=%.3f write_wait_max_us=%.1f", (unsigned long long)l.read_locks,
+             l.read_locks ? l.read_wait_ns / 1000.0 / l.read_locks : 0, l.read_wait_max_ns / 1000.0,
+             (unsigned long long)l.write_locks, l.write_locks ? l.write_wait_ns / 1000.0 / l.write_locks : 0,
+             l.write_wait_max_ns / 1000.0);
+    reply_add(r, "STAT:", buf);
+    foodlist_lockprofile *p = (foodlist_lockprofile *)malloc(sizeof(foodlist_lockprofile));
+    foodlist_get_lockprofile(fl, p);
+    snprintf(buf, sizeof(buf), "starvation readers_high_water=%d overtaking_reads=%llu starved_writes=%llu "
+             "starved_mean_us=%.1f starved_max_us=%.1f", p->readers_high_water,
+             (unsigned long long)p->overtaking_reads, (unsigned long long)p->starved_writes,
+             p->starved_writes ? p->starved_ns / 1000.0 / p->starved_writes : 0, p->starved_max_ns / 1000.0);
+    reply_add(r, "STAT:", buf);
+    free(p);
+    dataset_release(st->dataset, fl);
+  }
+}
+
+void stats_print(stats *st, FILE *out)
+{
+  reply *r = reply_init();
+  stats_report(st, r);
+  for(size_t i = 0; i < reply_count(r); ++i) {
+    /* without the STAT: prefix of the messages */
+    fprintf(out, "%s\n", reply_get(r, i) + 5);
+  }
+  reply_destroy(r);
+  if(st->dataset) {
+    /* the histograms per call site are too long for a STATS reply */
+    foodlist *fl = dataset_acquire(st->dataset);
+    foodlist_dump_lockprofile(fl, out);
+    dataset_release(st->dataset, fl);
+  }
+}
+
+void stats_destroy(stats *st)
+{
+  pthread_key_delete(st->current);
+  while(st->shards) {
+    struct stats_shard *sh = st->shards;
+    st->shards = sh->next;
+    for(int i = 0; i < STATS_COMMANDS; ++i) {
+      histogram_destroy(sh->latency[i]);
+      histogram_destroy(sh->results[i]);
+    }
+    pthread_mutex_destroy(&sh->mutex);
+    free(sh);
+  }
+  pthread_mutex_destroy(&st->mutex);
+  free(st);
+}
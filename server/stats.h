@@ -0,0 +1,127 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file stats.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible stats methods.
+ *
+ * The stats count every handled request with its latency and number of results. Every thread records into
+ * its own shard, which is only locked by the thread itself and by readers, so recording does not contend.
+ * The shards are merged when the stats are read, together with the connection metrics, the size of the
+ * foodlist and the waits for its locks.
+ *
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "../lib/histogram.h"
+#include "connmetrics.h"
+#include "dataset.h"
+#include "reply.h"
+
+/**
+ *
+ * @brief Commands which are counted separately
+ *
+ * */
+typedef enum stats_command {
+  STATS_SEARCH, /**< SEARCH: */
+  STATS_SEARCH_PAGE, /**< SEARCH? */
+  STATS_FOOD, /**< FOOD: */
+  STATS_SUBSCRIBE, /**< SUBSCRIBE: */
+  STATS_STATS, /**< STATS: */
+  STATS_PLAN, /**< PLAN: */
+  STATS_SIMILAR, /**< SIMILAR: and SIMILAR? */
+  STATS_OTHER, /**< Unknown commands */
+  STATS_COMMANDS /**< Number of counted commands */
+} stats_command;
+
+/**
+ *
+ * @brief Forward declaration for stats
+ *
+ * */
+typedef struct stats stats;
+
+/**
+ * @brief Constructor for stats
+ * @param dataset* The dataset whose foodlist is reported, or NULL
+ * @param connmetrics* The connection metrics which are reported, or NULL
+ * @return A pointer to the stats structure, representing the created object
+ *
+ * After using this structure, it must be freed with stats_destroy(stats *)
+ *
+ * */
+stats *stats_init(dataset *, connmetrics *);
+
+/**
+* @brief Method for getting the command of a request message
+* @param char* The received message, e.g. "SEARCH:Milk"
+* @return The command
+*
+* */
+stats_command stats_command_of(const char *);
+
+/**
+* @brief Method for getting the name of a command
+* @param stats_command The command
+* @return The name, e.g. "SEARCH"
+*
+* */
+const char *stats_command_name(stats_command);
+
+/**
+* @brief Method for counting a handled request in the shard of the calling thread
+* @param stats* Pointer to structure to work on
+* @param stats_command The command of the request
+* @param uint64_t Latency of the request in nanoseconds
+* @param size_t Number of results, e.g. found foods
+*
+* */
+void stats_record(stats *, stats_command, uint64_t, size_t);
+
+/**
+* @brief Method for merging the counters of all threads for one command
+* @param stats* Pointer to structure to work on
+* @param stats_command The command
+* @param histogram* Histogram the latencies in nanoseconds are merged into
+* @param histogram* Histogram the numbers of results are merged into
+*
+* */
+void stats_merge(stats *, stats_command, histogram *, histogram *);
+
+/**
+* @brief Method for reporting all stats as one STAT message per line
+* @param stats* Pointer to structure to work on
+* @param reply* Reply the messages are appended to, e.g. "STAT:SEARCH count=3 mean_us=..."
+*
+* */
+void stats_report(stats *, reply *);
+
+/**
+* @brief Method for printing all stats
+* @param stats* Pointer to structure to work on
+* @param FILE* Stream to print to
+*
+* */
+void stats_print(stats *, FILE *);
+
+/**
+ * @brief Destructor for stats
+ * @param stats* Pointer to structure to be freed
+ *
+ * The dataset and the connection metrics are not freed.
+ *
+ * */
+void stats_destroy(stats *);
+
+#endif /* STATS_H */
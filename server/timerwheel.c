@@ -0,0 +1,201 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file timerwheel.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the timerwheel structure and its member methods.
+ *
+ * The wheel is hierarchical: level 0 has one slot per tick, every slot of level n covers a whole turn of
+ * level n - 1. A timer is put into the lowest level which reaches its deadline. Whenever a lower level
+ * completes a turn, the next slot of the level above is cascaded, i.e. its timers are distributed over
+ * the lower levels again. Every slot is a circular doubly linked list with a sentinel node.
+ *
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "timerwheel.h"
+
+#define TIMERWHEEL_LEVELS 4 /**< Number of levels, together they cover 64^4 ticks */
+#define TIMERWHEEL_BITS 6 /**< Bits of the tick number per level */
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_BITS) /**< Number of slots per level */
+#define TIMERWHEEL_MASK (TIMERWHEEL_SLOTS - 1) /**< Mask of the slot index */
+
+/**
+ * @brief timerwheel_timer structure for representing a timer
+ *
+ */
+struct timerwheel_timer {
+  uint64_t expires; /**< Tick the timer expires at */
+  void *data; /**< Data passed to the callback */
+  struct timerwheel_timer *prev; /**< Previous timer in the same slot */
+  struct timerwheel_timer *next; /**< Next timer in the same slot */
+};
+
+/**
+ * @brief timerwheel structure for representing the timer wheel
+ *
+ */
+struct timerwheel {
+  struct timerwheel_timer slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS]; /**< Sentinels of the slot lists */
+  unsigned int tick_ms; /**< Length of a tick in milliseconds */
+  uint64_t base; /**< Next tick to be processed */
+  size_t count; /**< Number of timers */
+};
+
+/**
+ * @brief Removes a timer from its slot
+ * @param timerwheel_timer* The timer
+ *
+ * */
+static void timerwheel_unlink(timerwheel_timer *t)
+{
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+}
+
+/**
+ * @brief Puts a timer into the slot which reaches its deadline
+ * @param timerwheel* Pointer to structure to work on
+ * @param timerwheel_timer* The timer, it must not be in a slot
+ *
+ * */
+static void timerwheel_place(timerwheel *w, timerwheel_timer *t)
+{
+  if(t->expires < w->base) {
+    /* already due, expires with the next processed tick */
+    t->expires = w->base;
+  }
+  uint64_t delta = t->expires - w->base;
+  size_t level = 0;
+  while(level < TIMERWHEEL_LEVELS - 1 && delta >= (uint64_t)1 << (TIMERWHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  if(delta >= (uint64_t)1 << (TIMERWHEEL_BITS * TIMERWHEEL_LEVELS)) {
+    /* beyond the wheel, expire at its end */
+    t->expires = w->base + ((uint64_t)1 << (TIMERWHEEL_BITS * TIMERWHEEL_LEVELS)) - 1;
+  }
+  timerwheel_timer *head = &w->slots[level][(t->expires >> (TIMERWHEEL_BITS * level)) & TIMERWHEEL_MASK];
+  t->prev = head->prev;
+  t->next = head;
+  head->prev->next = t;
+  head->prev = t;
+}
+
+/**
+ * @brief Distributes the timers of a slot over the lower levels
+ * @param timerwheel* Pointer to structure to work on
+ * @param size_t Level of the slot
+ * @return Index of the cascaded slot, 0 if the level completed a turn as well
+ *
+ * */
+static size_t timerwheel_cascade(timerwheel *w, size_t level)
+{
+  size_t index = (w->base >> (TIMERWHEEL_BITS * level)) & TIMERWHEEL_MASK;
+  timerwheel_timer *head = &w->slots[level][index];
+  while(head->next != head) {
+    timerwheel_timer *t = head->next;
+    timerwheel_unlink(t);
+    timerwheel_place(w, t);
+  }
+  return index;
+}
+
+timerwheel *timerwheel_init(unsigned int tick_ms)
+{
+  timerwheel *w = (timerwheel *)malloc(sizeof(timerwheel));
+  for(size_t l = 0; l < TIMERWHEEL_LEVELS; ++l) {
+    for(size_t i = 0; i < TIMERWHEEL_SLOTS; ++i) {
+      w->slots[l][i].prev = &w->slots[l][i];
+      w->slots[l][i].next = &w->slots[l][i];
+    }
+  }
+  w->tick_ms = tick_ms > 0 ? tick_ms : 1;
+  w->base = timerwheel_now() / w->tick_ms;
+  w->count = 0;
+  return w;
+}
+
+uint64_t timerwheel_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+timerwheel_timer *timerwheel_add(timerwheel *w, uint64_t deadline, void *data)
+{
+  timerwheel_timer *t = (timerwheel_timer *)malloc(sizeof(timerwheel_timer));
+  t->data = data;
+  /* round up, a timer never expires before its deadline */
+  t->expires = (deadline + w->tick_ms - 1) / w->tick_ms;
+  timerwheel_place(w, t);
+  w->count++;
+  return t;
+}
+
+void timerwheel_update(timerwheel *w, timerwheel_timer *t, uint64_t deadline)
+{
+  timerwheel_unlink(t);
+  t->expires = (deadline + w->tick_ms - 1) / w->tick_ms;
+  timerwheel_place(w, t);
+}
+
+void timerwheel_remove(timerwheel *w, timerwheel_timer *t)
+{
+  timerwheel_unlink(t);
+  free(t);
+  w->count--;
+}
+
+size_t timerwheel_advance(timerwheel *w, uint64_t now, timerwheel_cb cb)
+{
+  uint64_t tick = now / w->tick_ms;
+  size_t expired = 0;
+  if(w->count == 0 && tick >= w->base) {
+    /* nothing to expire or to cascade */
+    w->base = tick + 1;
+    return 0;
+  }
+  while(w->base <= tick) {
+    size_t index = w->base & TIMERWHEEL_MASK;
+    for(size_t level = 1; index == 0 && level < TIMERWHEEL_LEVELS; ++level) {
+      if(timerwheel_cascade(w, level) != 0) {
+        break;
+      }
+    }
+    w->base++;
+    timerwheel_timer *head = &w->slots[0][index];
+    while(head->next != head) {
+      timerwheel_timer *t = head->next;
+      void *data = t->data;
+      timerwheel_remove(w, t);
+      cb(data);
+      expired++;
+    }
+  }
+  return expired;
+}
+
+size_t timerwheel_count(timerwheel *w)
+{
+  return w->count;
+}
+
+void timerwheel_destroy(timerwheel *w)
+{
+  for(size_t l = 0; l < TIMERWHEEL_LEVELS; ++l) {
+    for(size_t i = 0; i < TIMERWHEEL_SLOTS; ++i) {
+      timerwheel_timer *head = &w->slots[l][i];
+      while(head->next != head) {
+        timerwheel_remove(w, head->next);
+      }
+    }
+  }
+  free(w);
+}
@@ -0,0 +1,115 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file timerwheel.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible timerwheel methods.
+ *
+ * A timerwheel keeps the deadlines of many connections. Adding, moving and removing a timer take constant
+ * time, no matter how many timers there are, so a deadline can be moved on every request. Timers expire
+ * with the granularity of a tick. The timerwheel is not thread safe.
+ *
+ */
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *
+ * @brief Forward declaration for timerwheel
+ *
+ * */
+typedef struct timerwheel timerwheel;
+
+/**
+ *
+ * @brief Forward declaration for timerwheel_timer
+ *
+ * */
+typedef struct timerwheel_timer timerwheel_timer;
+
+/**
+ *
+ * @brief Function called for an expired timer, with the data the timer was added with
+ *
+ * */
+typedef void (*timerwheel_cb)(void *);
+
+/**
+ * @brief Constructor for timerwheel
+ * @param unsigned int Length of a tick in milliseconds
+ * @return A pointer to the timerwheel structure, representing the created object
+ *
+ * After using this structure, it must be freed with timerwheel_destroy(timerwheel *)
+ *
+ * */
+timerwheel *timerwheel_init(unsigned int);
+
+/**
+* @brief Method for getting the current time of the monotonic clock, which all deadlines refer to
+* @return The time in milliseconds
+*
+* */
+uint64_t timerwheel_now();
+
+/**
+* @brief Method for adding a timer
+* @param timerwheel* Pointer to structure to work on
+* @param uint64_t Deadline in milliseconds, see timerwheel_now()
+* @param void* Data passed to the callback when the timer expires
+* @return The timer, it is freed when it expires or is removed
+*
+* */
+timerwheel_timer *timerwheel_add(timerwheel *, uint64_t, void *);
+
+/**
+* @brief Method for moving the deadline of a timer
+* @param timerwheel* Pointer to structure to work on
+* @param timerwheel_timer* The timer
+* @param uint64_t New deadline in milliseconds
+*
+* */
+void timerwheel_update(timerwheel *, timerwheel_timer *, uint64_t);
+
+/**
+* @brief Method for removing a timer which has not expired yet
+* @param timerwheel* Pointer to structure to work on
+* @param timerwheel_timer* The timer, it is freed
+*
+* */
+void timerwheel_remove(timerwheel *, timerwheel_timer *);
+
+/**
+* @brief Method for expiring all timers whose deadline has passed
+* @param timerwheel* Pointer to structure to work on
+* @param uint64_t The current time in milliseconds
+* @param timerwheel_cb Function called for every expired timer, after the timer was freed
+* @return Number of expired timers
+*
+* */
+size_t timerwheel_advance(timerwheel *, uint64_t, timerwheel_cb);
+
+/**
+* @brief Method for getting the number of timers
+* @param timerwheel* Pointer to structure to work on
+* @return The number of timers which have not expired yet
+*
+* */
+size_t timerwheel_count(timerwheel *);
+
+/**
+ * @brief Destructor for timerwheel, frees all remaining timers
+ * @param timerwheel* Pointer to structure to be freed
+ *
+ * */
+void timerwheel_destroy(timerwheel *);
+
+#endif /* TIMERWHEEL_H */
@@ -0,0 +1,260 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file tracer.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the tracer and its span buffers.
+ *
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include "../lib/foodlist.h"
+#include "../lib/sock.h"
+#include "logger.h"
+#include "tracer.h"
+
+#define TRACER_BUFFER_SPANS 4096 /**< Number of spans a thread collects before it writes them */
+
+/**
+ * @brief One recorded span
+ *
+ */
+struct tracer_span {
+  const char *name; /**< Name of the span */
+  uint64_t start; /**< Start in nanoseconds of CLOCK_MONOTONIC */
+  uint64_t end; /**< End in nanoseconds of CLOCK_MONOTONIC */
+  uint64_t request; /**< Number of the request */
+};
+
+/**
+ * @brief Spans and request state of one thread
+ *
+ */
+struct tracer_buffer {
+  struct tracer_span spans[TRACER_BUFFER_SPANS]; /**< Recorded spans */
+  size_t len; /**< Number of recorded spans */
+  uint64_t current; /**< Request traced on the thread, 0 if there is none */
+  unsigned long requests; /**< Number of requests begun on the thread, for sampling */
+  unsigned int id; /**< Number of the buffer, written as thread id */
+  bool owned; /**< Whether a running thread records into the buffer, taken under the mutex */
+  struct tracer_buffer *next; /**< Next buffer */
+};
+
+static bool tracer_enabled = false; /**< Whether requests are traced */
+static unsigned int tracer_every = 1; /**< Every how many requests of a thread one is traced */
+static uint64_t tracer_requests = 0; /**< Number of traced requests */
+static FILE *tracer_out = NULL; /**< The trace file */
+static bool tracer_first = true; /**< Whether no event was written yet, protected by the mutex */
+static pthread_mutex_t tracer_mutex = PTHREAD_MUTEX_INITIALIZER; /**< Mutex protecting the file and the buffers */
+static pthread_key_t tracer_key; /**< Key for finding the buffer of the calling thread */
+static struct tracer_buffer *tracer_buffers = NULL; /**< Buffers of all threads which ever traced */
+static unsigned int tracer_num_buffers = 0; /**< Number of buffers */
+
+/**
+ * @brief Writes the spans of a buffer to the trace file and empties it, the mutex is held
+ * @param struct tracer_buffer* The buffer
+ *
+ * */
+static void tracer_flush(struct tracer_buffer *b)
+{
+  for(size_t i = 0; i < b->len; ++i) {
+    struct tracer_span *sp = &b->spans[i];
+    fprintf(tracer_out, "%s{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"request\":%llu}}", tracer_first ? "" : ",\n", sp->name, sp->start / 1000.0,
+            (sp->end - sp->start) / 1000.0, b->id, (unsigned long long)sp->request);
+    tracer_first = false;
+  }
+  b->len = 0;
+}
+
+/**
+ * @brief Writes the spans of an exiting thread and releases its buffer for the next new thread
+ * @param void* The buffer
+ *
+ * */
+static void tracer_release_buffer(void *arg)
+{
+  struct tracer_buffer *b = (struct tracer_buffer *)arg;
+  pthread_mutex_lock(&tracer_mutex);
+  if(tracer_out) {
+    tracer_flush(b);
+  }
+  b->current = 0;
+  b->owned = false;
+  pthread_mutex_unlock(&tracer_mutex);
+}
+
+/**
+ * @brief Finds the buffer of the calling thread, taking a free one or creating one on its first request
+ * @return The buffer
+ *
+ * */
+static struct tracer_buffer *tracer_buffer_of()
+{
+  struct tracer_buffer *b = pthread_getspecific(tracer_key);
+  if(b) {
+    return b;
+  }
+  pthread_mutex_lock(&tracer_mutex);
+  for(b = tracer_buffers; b && b->owned; b = b->next) {
+  }
+  if(!b) {
+    b = (struct tracer_buffer *)malloc(sizeof(struct tracer_buffer));
+    b->len = 0;
+    b->current = 0;
+    b->requests = 0;
+    b->id = ++tracer_num_buffers;
+    b->next = tracer_buffers;
+    tracer_buffers = b;
+  }
+  b->owned = true;
+  pthread_mutex_unlock(&tracer_mutex);
+  pthread_setspecific(tracer_key, b);
+  return b;
+}
+
+/**
+ * @brief Lock hook of the foodlist, records the wait for a lock
+ * @param bool True for the write lock
+ * @param uint64_t Start of the wait
+ * @param uint64_t Time the lock was taken
+ *
+ * */
+static void tracer_lock_hook(bool write, uint64_t start, uint64_t end)
+{
+  tracer_record(write ? "write lock" : "read lock", start, end);
+}
+
+/**
+ * @brief Hook of acknowledged writes, records sending and waiting for the ACK
+ * @param char* Name of the phase
+ * @param uint64_t Start of the phase
+ * @param uint64_t End of the phase
+ *
+ * */
+static void tracer_sock_hook(const char *name, uint64_t start, uint64_t end)
+{
+  tracer_record(name, start, end);
+}
+
+bool tracer_start(const char *path, unsigned int every)
+{
+  tracer_out = fopen(path, "w");
+  if(!tracer_out) {
+    LOGGER_LOG(LOGGER_ERROR, "cannot write trace to %s", path);
+    return false;
+  }
+  fputs("[\n", tracer_out);
+  tracer_every = every > 0 ? every : 1;
+  pthread_key_create(&tracer_key, tracer_release_buffer);
+  foodlist_set_lock_hook(tracer_lock_hook);
+  sock_set_hook(tracer_sock_hook);
+  __atomic_store_n(&tracer_enabled, true, __ATOMIC_RELEASE);
+  return true;
+}
+
+uint64_t tracer_clock()
+{
+  if(!__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t tracer_begin()
+{
+  if(!__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  struct tracer_buffer *b = tracer_buffer_of();
+  b->current = b->requests++ % tracer_every == 0 ? __atomic_add_fetch(&tracer_requests, 1, __ATOMIC_RELAXED) : 0;
+  return b->current;
+}
+
+void tracer_end(const char *name, uint64_t start)
+{
+  if(!start) {
+    return;
+  }
+  tracer_span(name, start);
+  tracer_buffer_of()->current = 0;
+}
+
+uint64_t tracer_current()
+{
+  if(!__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  return tracer_buffer_of()->current;
+}
+
+uint64_t tracer_set_current(uint64_t request)
+{
+  if(!__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  struct tracer_buffer *b = tracer_buffer_of();
+  uint64_t prev = b->current;
+  b->current = request;
+  return prev;
+}
+
+void tracer_span(const char *name, uint64_t start)
+{
+  if(!start) {
+    return;
+  }
+  tracer_record(name, start, tracer_clock());
+}
+
+void tracer_record(const char *name, uint64_t start, uint64_t end)
+{
+  if(!start || !__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return;
+  }
+  struct tracer_buffer *b = tracer_buffer_of();
+  if(!b->current) {
+    return;
+  }
+  if(b->len == TRACER_BUFFER_SPANS) {
+    pthread_mutex_lock(&tracer_mutex);
+    tracer_flush(b);
+    pthread_mutex_unlock(&tracer_mutex);
+  }
+  struct tracer_span *sp = &b->spans[b->len++];
+  sp->name = name;
+  sp->start = start;
+  sp->end = end;
+  sp->request = b->current;
+}
+
+void tracer_stop()
+{
+  if(!__atomic_load_n(&tracer_enabled, __ATOMIC_RELAXED)) {
+    return;
+  }
+  __atomic_store_n(&tracer_enabled, false, __ATOMIC_RELEASE);
+  foodlist_set_lock_hook(NULL);
+  sock_set_hook(NULL);
+  pthread_mutex_lock(&tracer_mutex);
+  for(struct tracer_buffer *b = tracer_buffers; b; b = b->next) {
+    tracer_flush(b);
+  }
+  fputs("\n]\n", tracer_out);
+  fclose(tracer_out);
+  tracer_out = NULL;
+  LOGGER_LOG(LOGGER_INFO, "Traced %llu requests", (unsigned long long)tracer_requests);
+  pthread_mutex_unlock(&tracer_mutex);
+}
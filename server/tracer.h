@@ -0,0 +1,101 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file tracer.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible tracer methods.
+ *
+ * The tracer records the phases of sampled requests as spans, e.g. reading, waiting for the foodlist lock,
+ * scanning and sending, and writes them as Chrome trace events, which chrome://tracing and Perfetto open.
+ * Every thread collects its spans in a buffer of its own and only takes the file lock to write a full
+ * buffer. A request is identified by a number, which is passed along when a request moves to another
+ * thread, so all its spans carry the same request argument.
+ *
+ * Spans are recorded after the fact from a start time taken with tracer_clock(), which is 0 while tracing
+ * is disabled, so an untraced server only pays a comparison per span.
+ *
+ */
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+* @brief Method for starting to trace requests
+* @param char* Path of the trace file, it is overwritten
+* @param unsigned int Every how many requests of a thread one is traced, 1 traces every request
+* @return True, if the trace file could be created, false otherwise
+*
+* */
+bool tracer_start(const char *, unsigned int);
+
+/**
+* @brief Method for getting the current time for the start of a span
+* @return Nanoseconds of CLOCK_MONOTONIC, 0 if tracing is disabled
+*
+* */
+uint64_t tracer_clock();
+
+/**
+* @brief Method for starting a request on the calling thread, which is traced if it is sampled
+* @return Number of the request if it is traced, 0 otherwise
+*
+* */
+uint64_t tracer_begin();
+
+/**
+* @brief Method for ending the request of the calling thread with a span covering all of it
+* @param char* Name of the span, e.g. "request"
+* @param uint64_t Start of the request from tracer_clock()
+*
+* */
+void tracer_end(const char *, uint64_t);
+
+/**
+* @brief Method for getting the request traced on the calling thread
+* @return Number of the request, 0 if there is none
+*
+* */
+uint64_t tracer_current();
+
+/**
+* @brief Method for continuing a request on the calling thread, e.g. in an executor task
+* @param uint64_t Number of the request from tracer_current(), 0 for none
+* @return The request traced on the calling thread before, to be restored afterwards
+*
+* */
+uint64_t tracer_set_current(uint64_t);
+
+/**
+* @brief Method for recording a span of the current request, which ends now
+* @param char* Name of the span, a string literal
+* @param uint64_t Start of the span from tracer_clock()
+*
+* */
+void tracer_span(const char *, uint64_t);
+
+/**
+* @brief Method for recording a span of the current request with an explicit end
+* @param char* Name of the span, a string literal
+* @param uint64_t Start of the span from tracer_clock()
+* @param uint64_t End of the span from tracer_clock()
+*
+* */
+void tracer_record(const char *, uint64_t, uint64_t);
+
+/**
+* @brief Method for writing all buffered spans and closing the trace file
+*
+* Threads must not record spans anymore.
+*
+* */
+void tracer_stop();
+
+#endif /* TRACER_H */
@@ -0,0 +1,653 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file uringhandler.c
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief File containing the uringhandler structure and its member methods.
+ *
+ * The ring is driven with the raw io_uring system calls, so there is no dependency on liburing.
+ * Every connection owns a slot with two registered buffers (receive and send) and has at most one
+ * receive and one send in flight, the protocol itself is done by the session state machine.
+ * Every connection has one timer, which is moved to the idle, read or write deadline after each
+ * operation. The timeout operation ticking the timer wheel is only queued while there are timers.
+ * Requests are answered by the worker pool, so a slow request does not hold up the loop. The worker
+ * queues the slot of its connection and signals an eventfd, whose read completes on the ring; a slot
+ * with a request in flight is only released after the answer arrived.
+ *
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include "../lib/sock.h"
+#include "session.h"
+#include "timerwheel.h"
+#include "logger.h"
+#include "uringhandler.h"
+
+#define URING_ENTRIES 256 /**< Number of submission queue entries */
+#define URING_RETRY_MS 250 /**< Retry time sent with BUSY answers */
+#define URING_IO_TIMEOUT_MS 30000 /**< Time a started request or a send may take */
+#define URING_DRAIN_MS 5000 /**< Time requests in flight get to finish after shutdown was requested */
+
+#define URING_OP_ACCEPT 1 /**< user_data of the accept operation */
+#define URING_OP_TIMEOUT 2 /**< user_data of the timeout operation, which ticks the timer wheel every second */
+#define URING_OP_READ 3 /**< Operation code of receives, the slot is stored in the upper bits of user_data */
+#define URING_OP_WRITE 4 /**< Operation code of sends, the slot is stored in the upper bits of user_data */
+#define URING_OP_WAKE 5 /**< user_data of the poll operation on the wake descriptor */
+#define URING_OP_DONE 6 /**< user_data of the read of the eventfd signaling answered requests */
+
+/**
+ * @brief Connection slot of the uringhandler
+ *
+ */
+struct uring_conn {
+  uringhandler *handler; /**< Handler owning the slot */
+  int fd; /**< Client socket, -1 if the slot is unused */
+  session *session; /**< Protocol state of the connection */
+  char *rbuf; /**< Registered receive buffer */
+  char *wbuf; /**< Registered send buffer */
+  bool reading; /**< True, while a receive is in flight */
+  bool writing; /**< True, while a send is in flight */
+  timerwheel_timer *timer; /**< Deadline of the connection, NULL if there is none */
+};
+
+/**
+ * @brief uringhandler structure for representing an io_uring instance and its connections
+ *
+ */
+struct uringhandler {
+  dispatch *dispatch; /**< Dispatcher for received requests */
+  connmetrics *metrics; /**< Connection level counters */
+  int ring_fd; /**< File descriptor of the ring */
+  void *sq_ring; /**< Mapping of the submission queue ring */
+  size_t sq_ring_len; /**< Length of the submission queue ring mapping */
+  void *cq_ring; /**< Mapping of the completion queue ring, may be the same as sq_ring */
+  size_t cq_ring_len; /**< Length of the completion queue ring mapping */
+  struct io_uring_sqe *sqes; /**< Mapping of the submission queue entries */
+  size_t sqes_len; /**< Length of the submission queue entries mapping */
+  unsigned *sq_head; /**< Submission queue head, written by the kernel */
+  unsigned *sq_tail; /**< Submission queue tail, written by us */
+  unsigned *sq_mask; /**< Submission queue index mask */
+  unsigned *sq_array; /**< Submission queue index array */
+  unsigned sq_entries; /**< Number of submission queue entries */
+  unsigned sq_local_tail; /**< Tail including the not yet published entries */
+  unsigned to_submit; /**< Number of prepared but not yet submitted entries */
+  unsigned *cq_head; /**< Completion queue head, written by us */
+  unsigned *cq_tail; /**< Completion queue tail, written by the kernel */
+  unsigned *cq_mask; /**< Completion queue index mask */
+  struct io_uring_cqe *cqes; /**< Completion queue entries */
+  struct uring_conn *conns; /**< Connection slots */
+  size_t max_conns; /**< Number of connection slots */
+  size_t *free_slots; /**< Stack of unused connection slots */
+  size_t num_free; /**< Number of unused connection slots */
+  char *buffers; /**< Memory of all receive and send buffers */
+  bool fixed; /**< True, if the buffers could be registered with the kernel */
+  bool multishot; /**< True, as long as the kernel accepts multishot accept requests */
+  struct __kernel_timespec tick; /**< Interval of the timeout operation */
+  timerwheel *timers; /**< Deadlines of the connections */
+  uint64_t now; /**< Time of the last completions, in milliseconds of timerwheel_now() */
+  bool ticking; /**< True, while the timeout operation is queued */
+  unsigned int idle_timeout; /**< Time a connection may wait for its next request, 0 for no limit */
+  bool draining; /**< True, after shutdown was requested */
+  uint64_t drain_deadline; /**< Time the loop returns even if requests are still in flight */
+  executor_group *group; /**< Group of the requests handed to the worker pool */
+  int done_fd; /**< eventfd the workers signal after answering a request */
+  uint64_t done_count; /**< Buffer of the read of done_fd */
+  pthread_mutex_t done_mutex; /**< Mutex protecting done_slots */
+  size_t *done_slots; /**< Slots whose requests were answered since the last read of done_fd */
+  size_t num_done; /**< Number of entries of done_slots */
+  size_t *ready_slots; /**< Slots the loop is finishing, swapped with done_slots */
+};
+
+/**
+ * @brief Submits the prepared entries and optionally waits for completions
+ * @param uringhandler* Pointer to structure to work on
+ * @param unsigned Minimum number of completions to wait for
+ * @return Result of io_uring_enter()
+ *
+ * */
+static int uring_enter(uringhandler *h, unsigned wait)
+{
+  __atomic_store_n(h->sq_tail, h->sq_local_tail, __ATOMIC_RELEASE);
+  int ret = syscall(__NR_io_uring_enter, h->ring_fd, h->to_submit, wait,
+                    wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  if(ret > 0) {
+    h->to_submit -= ret;
+  }
+  return ret;
+}
+
+/**
+ * @brief Gets an empty submission queue entry, submits the queue first if it is full
+ * @param uringhandler* Pointer to structure to work on
+ * @return Zeroed submission queue entry
+ *
+ * */
+static struct io_uring_sqe *uring_get_sqe(uringhandler *h)
+{
+  while(h->sq_local_tail - __atomic_load_n(h->sq_head, __ATOMIC_ACQUIRE) >= h->sq_entries) {
+    uring_enter(h, 0);
+  }
+  unsigned idx = h->sq_local_tail & *h->sq_mask;
+  struct io_uring_sqe *sqe = &h->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  h->sq_array[idx] = idx;
+  h->sq_local_tail++;
+  h->to_submit++;
+  return sqe;
+}
+
+/**
+ * @brief Queues an accept operation on a listening socket
+ * @param uringhandler* Pointer to structure to work on
+ * @param int Listening socket
+ * @param size_t Index of the listening socket, stored in the user_data like a connection slot
+ *
+ * */
+static void uring_arm_accept(uringhandler *h, int listen_fd, size_t index)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe(h);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listen_fd;
+  if(h->multishot) {
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  }
+  sqe->user_data = ((uint64_t)index << 8) | URING_OP_ACCEPT;
+}
+
+/**
+ * @brief Queues the timeout operation which ticks the timer wheel
+ * @param uringhandler* Pointer to structure to work on
+ *
+ * */
+static void uring_arm_timeout(uringhandler *h)
+{
+  h->ticking = true;
+  struct io_uring_sqe *sqe = uring_get_sqe(h);
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->addr = (uint64_t)(uintptr_t)&h->tick;
+  sqe->len = 1;
+  sqe->user_data = URING_OP_TIMEOUT;
+}
+
+/**
+ * @brief Queues a poll on the wake descriptor, which becomes readable when shutdown is requested
+ * @param uringhandler* Pointer to structure to work on
+ * @param int The wake descriptor
+ *
+ * */
+static void uring_arm_wake(uringhandler *h, int wake_fd)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe(h);
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = wake_fd;
+  sqe->poll32_events = POLLIN;
+  sqe->user_data = URING_OP_WAKE;
+}
+
+/**
+ * @brief Queues a read of the eventfd, which completes when the workers answered requests
+ * @param uringhandler* Pointer to structure to work on
+ *
+ * */
+static void uring_arm_done(uringhandler *h)
+{
+  struct io_uring_sqe *sqe = uring_get_sqe(h);
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = h->done_fd;
+  sqe->addr = (uint64_t)(uintptr_t)&h->done_count;
+  sqe->len = sizeof(h->done_count);
+  sqe->user_data = URING_OP_DONE;
+}
+
+/**
+ * @brief Called by a worker after answering a request, queues the slot for the loop
+ * @param void* Pointer to the uring_conn structure of the request
+ *
+ * */
+static void uring_on_dispatched(void *arg)
+{
+  struct uring_conn *c = (struct uring_conn *)arg;
+  uringhandler *h = c->handler;
+  pthread_mutex_lock(&h->done_mutex);
+  h->done_slots[h->num_done++] = c - h->conns;
+  pthread_mutex_unlock(&h->done_mutex);
+  uint64_t one = 1;
+  if(write(h->done_fd, &one, sizeof(one)) < 0) {
+    perror("write eventfd");
+  }
+}
+
+/**
+ * @brief Timer callback of a connection which missed its deadline, closes the connection
+ * @param void* Pointer to the uring_conn structure
+ *
+ * */
+static void uring_on_deadline(void *arg)
+{
+  struct uring_conn *c = (struct uring_conn *)arg;
+  LOGGER_LOG(LOGGER_WARN, "Socket %d missed its deadline", c->fd);
+  c->timer = NULL;
+  session_close(c->session);
+  /* the operations in flight complete with an error and release the slot */
+  shutdown(c->fd, SHUT_RDWR);
+  __atomic_add_fetch(&c->handler->metrics->timed_out, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Moves the timer of a connection to the deadline of what it waits for
+ * @param uringhandler* Pointer to structure to work on
+ * @param struct uring_conn* The connection
+ *
+ * */
+static void uring_set_deadline(uringhandler *h, struct uring_conn *c)
+{
+  unsigned int ms = c->writing || !session_is_idle(c->session) ? URING_IO_TIMEOUT_MS : h->idle_timeout;
+  if(ms == 0) {
+    if(c->timer) {
+      timerwheel_remove(h->timers, c->timer);
+      c->timer = NULL;
+    }
+    return;
+  }
+  if(c->timer) {
+    timerwheel_update(h->timers, c->timer, h->now + ms);
+  } else {
+    c->timer = timerwheel_add(h->timers, h->now + ms, c);
+  }
+  if(!h->ticking) {
+    uring_arm_timeout(h);
+  }
+}
+
+/**
+ * @brief Closes a connection and releases its slot
+ * @param uringhandler* Pointer to structure to work on
+ * @param size_t Slot of the connection
+ *
+ * */
+static void uring_close(uringhandler *h, size_t slot)
+{
+  struct uring_conn *c = &h->conns[slot];
+  LOGGER_LOG(LOGGER_INFO, "Closing socket %d", c->fd);
+  shutdown(c->fd, 2);
+  close(c->fd);
+  session_destroy(c->session);
+  if(c->timer) {
+    timerwheel_remove(h->timers, c->timer);
+    c->timer = NULL;
+  }
+  c->fd = -1;
+  c->session = NULL;
+  h->free_slots[h->num_free++] = slot;
+  __atomic_sub_fetch(&h->metrics->active, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&h->metrics->closed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Queues the next receive or send a connection's session asks for
+ * @param uringhandler* Pointer to structure to work on
+ * @param size_t Slot of the connection
+ *
+ * */
+static void uring_arm_conn(uringhandler *h, size_t slot)
+{
+  struct uring_conn *c = &h->conns[slot];
+  size_t len = 0;
+  char *p = NULL;
+  if(h->draining && !c->writing && session_is_idle(c->session)) {
+    /* shutting down, the last request of the connection is answered */
+    session_close(c->session);
+  }
+  bool dispatching = session_is_dispatching(c->session);
+  if(session_is_closed(c->session)) {
+    if(c->reading || c->writing || dispatching) {
+      /* let the operations in flight complete before the slot is released */
+      shutdown(c->fd, SHUT_RDWR);
+    } else {
+      uring_close(h, slot);
+    }
+    return;
+  }
+  if(!c->writing && (p = session_write_buf(c->session, &len)) != NULL) {
+    len = len < BUF_LEN ? len : BUF_LEN;
+    memcpy(c->wbuf, p, len);
+    struct io_uring_sqe *sqe = uring_get_sqe(h);
+    sqe->opcode = h->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)c->wbuf;
+    sqe->len = len;
+    sqe->buf_index = 2 * slot + 1;
+    sqe->user_data = (slot << 8) | URING_OP_WRITE;
+    c->writing = true;
+  }
+  if(!c->reading && (p = session_read_buf(c->session, &len)) != NULL) {
+    len = len < BUF_LEN ? len : BUF_LEN;
+    struct io_uring_sqe *sqe = uring_get_sqe(h);
+    sqe->opcode = h->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)c->rbuf;
+    sqe->len = len;
+    sqe->buf_index = 2 * slot;
+    sqe->user_data = (slot << 8) | URING_OP_READ;
+    c->reading = true;
+  }
+  if(!c->reading && !c->writing && !dispatching) {
+    uring_close(h, slot);
+    return;
+  }
+  uring_set_deadline(h, c);
+}
+
+/**
+ * @brief Handles an accepted connection
+ * @param uringhandler* Pointer to structure to work on
+ * @param int Client socket
+ *
+ * */
+static void uring_on_accept(uringhandler *h, int fd)
+{
+  __atomic_add_fetch(&h->metrics->accepted, 1, __ATOMIC_RELAXED);
+  if(h->num_free == 0 || h->draining) {
+    LOGGER_LOG(LOGGER_WARN, "Server busy, rejecting socket %d, retry after %u ms", fd, URING_RETRY_MS);
+    sock_send_busy(fd, URING_RETRY_MS);
+    shutdown(fd, SHUT_WR);
+    close(fd);
+    __atomic_add_fetch(&h->metrics->rejected, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  struct sockaddr_storage client;
+  socklen_t len = sizeof(client);
+  memset(&client, 0, sizeof(client));
+  getpeername(fd, (struct sockaddr *)&client, &len);
+  if(client.ss_family == AF_INET) {
+    LOGGER_LOG(LOGGER_INFO, "New connection from %s on socket %d", inet_ntoa(((struct sockaddr_in *)&client)->sin_addr), fd);
+  } else {
+    LOGGER_LOG(LOGGER_INFO, "New local connection on socket %d", fd);
+  }
+
+  size_t slot = h->free_slots[--h->num_free];
+  h->conns[slot].fd = fd;
+  h->conns[slot].session = session_init(h->dispatch, fd, h->group, uring_on_dispatched, &h->conns[slot]);
+  h->conns[slot].reading = false;
+  h->conns[slot].writing = false;
+  __atomic_add_fetch(&h->metrics->active, 1, __ATOMIC_RELAXED);
+  uring_arm_conn(h, slot);
+}
+
+/**
+ * @brief Handles one completion queue entry
+ * @param uringhandler* Pointer to structure to work on
+ * @param int* Listening sockets, indexed by the user_data of accept operations
+ * @param uint64_t user_data of the completed operation
+ * @param int Result of the completed operation
+ * @param unsigned Flags of the completion
+ *
+ * */
+static void uring_complete(uringhandler *h, const int *listen_fds, uint64_t data, int res, unsigned flags)
+{
+  if((data & 0xff) == URING_OP_ACCEPT) {
+    if(res >= 0) {
+      uring_on_accept(h, res);
+    } else if(res == -EINVAL && h->multishot) {
+      /* kernel is too old for multishot accept, continue with one accept per connection */
+      h->multishot = false;
+    } else {
+      LOGGER_LOG(LOGGER_ERROR, "accept failed: %s", strerror(-res));
+    }
+    if(!(flags & IORING_CQE_F_MORE) && !h->draining) {
+      uring_arm_accept(h, listen_fds[data >> 8], data >> 8);
+    }
+    return;
+  }
+  if(data == URING_OP_TIMEOUT) {
+    h->ticking = false;
+    timerwheel_advance(h->timers, h->now, uring_on_deadline);
+    if(timerwheel_count(h->timers) > 0 || h->draining) {
+      uring_arm_timeout(h);
+    }
+    return;
+  }
+  if(data == URING_OP_DONE) {
+    /* take all answered requests at once, the workers keep queuing into the other array meanwhile */
+    pthread_mutex_lock(&h->done_mutex);
+    size_t *ready = h->done_slots;
+    size_t num_ready = h->num_done;
+    h->done_slots = h->ready_slots;
+    h->ready_slots = ready;
+    h->num_done = 0;
+    pthread_mutex_unlock(&h->done_mutex);
+    uring_arm_done(h);
+    for(size_t i = 0; i < num_ready; ++i) {
+      session_dispatch_done(h->conns[ready[i]].session);
+      uring_arm_conn(h, ready[i]);
+    }
+    return;
+  }
+  if(data == URING_OP_WAKE) {
+    /* stop accepting, close the idle connections and let the others finish their request */
+    LOGGER_LOG(LOGGER_INFO, "Draining %zu connections", h->max_conns - h->num_free);
+    h->draining = true;
+    h->drain_deadline = h->now + URING_DRAIN_MS;
+    for(size_t i = 0; i < h->max_conns; ++i) {
+      if(h->conns[i].fd != -1) {
+        uring_arm_conn(h, i);
+      }
+    }
+    if(!h->ticking) {
+      uring_arm_timeout(h);
+    }
+    return;
+  }
+
+  size_t slot = data >> 8;
+  struct uring_conn *c = &h->conns[slot];
+  if((data & 0xff) == URING_OP_READ) {
+    c->reading = false;
+    if(res <= 0) {
+      /* client is disconnected or the operation failed */
+      session_close(c->session);
+    } else {
+      size_t len = 0;
+      char *p = session_read_buf(c->session, &len);
+      if(p && (size_t)res <= len) {
+        memcpy(p, c->rbuf, res);
+        session_read_done(c->session, res);
+      } else {
+        /* the session was closed by a deadline or the drain while the receive was in flight */
+        LOGGER_LOG(LOGGER_DEBUG, "Dropping %d bytes received on closed socket %d", res, c->fd);
+      }
+    }
+  } else {
+    c->writing = false;
+    if(res <= 0) {
+      session_close(c->session);
+    } else {
+      session_write_done(c->session, res);
+    }
+  }
+  uring_arm_conn(h, slot);
+}
+
+uringhandler *uringhandler_init(dispatch *d, size_t max_conns, connmetrics *metrics)
+{
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+  if(fd < 0) {
+    return NULL;
+  }
+
+  uringhandler *h = (uringhandler *)malloc(sizeof(uringhandler));
+  h->dispatch = d;
+  h->metrics = metrics;
+  h->ring_fd = fd;
+  h->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  h->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    if(h->cq_ring_len > h->sq_ring_len)
+      h->sq_ring_len = h->cq_ring_len;
+    h->cq_ring_len = h->sq_ring_len;
+  }
+  h->sq_ring = mmap(NULL, h->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQ_RING);
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    h->cq_ring = h->sq_ring;
+  } else {
+    h->cq_ring = mmap(NULL, h->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_CQ_RING);
+  }
+  h->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  h->sqes = mmap(NULL, h->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                 IORING_OFF_SQES);
+  if(h->sq_ring == MAP_FAILED || h->cq_ring == MAP_FAILED || h->sqes == MAP_FAILED) {
+    perror("mmap io_uring");
+    close(fd);
+    free(h);
+    return NULL;
+  }
+
+  char *sq = (char *)h->sq_ring;
+  char *cq = (char *)h->cq_ring;
+  h->sq_head = (unsigned *)(sq + p.sq_off.head);
+  h->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+  h->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+  h->sq_array = (unsigned *)(sq + p.sq_off.array);
+  h->sq_entries = p.sq_entries;
+  h->sq_local_tail = *h->sq_tail;
+  h->to_submit = 0;
+  h->cq_head = (unsigned *)(cq + p.cq_off.head);
+  h->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+  h->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+  h->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  /* every connection gets a receive and a send buffer */
+  h->max_conns = max_conns;
+  h->conns = calloc(max_conns, sizeof(struct uring_conn));
+  h->free_slots = calloc(max_conns, sizeof(size_t));
+  if(posix_memalign((void **)&h->buffers, 4096, max_conns * 2 * BUF_LEN)) {
+    h->buffers = malloc(max_conns * 2 * BUF_LEN);
+  }
+  struct iovec *iov = calloc(max_conns * 2, sizeof(struct iovec));
+  h->num_free = 0;
+  for(size_t i = 0; i < max_conns; ++i) {
+    h->conns[i].handler = h;
+    h->conns[i].fd = -1;
+    h->conns[i].session = NULL;
+    h->conns[i].timer = NULL;
+    h->conns[i].rbuf = h->buffers + 2 * i * BUF_LEN;
+    h->conns[i].wbuf = h->buffers + (2 * i + 1) * BUF_LEN;
+    iov[2 * i].iov_base = h->conns[i].rbuf;
+    iov[2 * i].iov_len = BUF_LEN;
+    iov[2 * i + 1].iov_base = h->conns[i].wbuf;
+    iov[2 * i + 1].iov_len = BUF_LEN;
+    /* hand out low slots first */
+    h->free_slots[h->num_free++] = max_conns - 1 - i;
+  }
+  h->fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, max_conns * 2) == 0;
+  if(!h->fixed) {
+    perror("Could not register io_uring buffers, using unregistered buffers");
+  }
+  free(iov);
+
+  h->multishot = true;
+  h->tick.tv_sec = 1;
+  h->tick.tv_nsec = 0;
+  h->timers = timerwheel_init(1000);
+  h->now = timerwheel_now();
+  h->ticking = false;
+  h->idle_timeout = 0;
+  h->draining = false;
+  h->drain_deadline = 0;
+  h->group = executor_group_init();
+  h->done_fd = eventfd(0, EFD_CLOEXEC);
+  pthread_mutex_init(&h->done_mutex, NULL);
+  h->done_slots = calloc(max_conns, sizeof(size_t));
+  h->ready_slots = calloc(max_conns, sizeof(size_t));
+  h->num_done = 0;
+  return h;
+}
+
+void uringhandler_set_idle_timeout(uringhandler *h, unsigned int ms)
+{
+  h->idle_timeout = ms;
+}
+
+void uringhandler_run(uringhandler *h, const int *listen_fds, size_t num_fds, int wake_fd)
+{
+  for(size_t i = 0; i < num_fds; ++i) {
+    uring_arm_accept(h, listen_fds[i], i);
+  }
+  uring_arm_wake(h, wake_fd);
+  uring_arm_done(h);
+
+  while(!h->draining || h->num_free < h->max_conns) {
+    if(h->draining && h->now >= h->drain_deadline) {
+      LOGGER_LOG(LOGGER_WARN, "Closing %zu connections with requests in flight", h->max_conns - h->num_free);
+      break;
+    }
+    if(uring_enter(h, 1) < 0 && errno != EINTR) {
+      perror("io_uring_enter");
+      break;
+    }
+    h->now = timerwheel_now();
+    unsigned head = *h->cq_head;
+    unsigned tail = __atomic_load_n(h->cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+      struct io_uring_cqe *cqe = &h->cqes[head & *h->cq_mask];
+      uint64_t data = cqe->user_data;
+      int res = cqe->res;
+      unsigned flags = cqe->flags;
+      head++;
+      uring_complete(h, listen_fds, data, res, flags);
+    }
+    __atomic_store_n(h->cq_head, head, __ATOMIC_RELEASE);
+  }
+}
+
+void uringhandler_destroy(uringhandler *h)
+{
+  /* the workers still answering requests use the slots */
+  dispatch_wait(h->dispatch, h->group);
+  for(size_t i = 0; i < h->max_conns; ++i) {
+    if(h->conns[i].fd != -1) {
+      uring_close(h, i);
+    }
+  }
+  /* closing the ring cancels all operations still in flight */
+  munmap(h->sqes, h->sqes_len);
+  if(h->cq_ring != h->sq_ring) {
+    munmap(h->cq_ring, h->cq_ring_len);
+  }
+  munmap(h->sq_ring, h->sq_ring_len);
+  close(h->ring_fd);
+  timerwheel_destroy(h->timers);
+  executor_group_destroy(h->group);
+  close(h->done_fd);
+  pthread_mutex_destroy(&h->done_mutex);
+  free(h->done_slots);
+  free(h->ready_slots);
+  free(h->buffers);
+  free(h->free_slots);
+  free(h->conns);
+  free(h);
+}
@@ -0,0 +1,79 @@
+/****************************************************************************
+ * Copyright (C) 2014 by Lukas Elsner                                       *
+ *                                                                          *
+ * This file is part of calory-counter.                                     *
+ *                                                                          *
+ ****************************************************************************/
+
+/**
+ * @file uringhandler.h
+ * @author Lukas Elsner
+ * @date 19-10-2026
+ * @brief Header containing the public accessible uringhandler methods.
+ *
+ * The uringhandler serves all client connections from one thread with Linux io_uring. It is used by the
+ * sockethandler as an alternative to its thread pool.
+ *
+ */
+#ifndef URINGHANDLER_H
+#define URINGHANDLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dispatch.h"
+#include "connmetrics.h"
+
+/**
+ *
+ * @brief Forward declaration for uringhandler
+ *
+ * */
+typedef struct uringhandler uringhandler;
+
+/**
+ * @brief Constructor for uringhandler
+ * @param dispatch* Dispatcher used for handling the received requests
+ * @param size_t Maximum number of concurrently served connections, further connections are rejected with BUSY
+ * @param connmetrics* Counters updated for every connection
+ * @return A pointer to the uringhandler structure, or NULL if the kernel does not support io_uring
+ *
+ * After using this structure, it must be freed with uringhandler_destroy(uringhandler *)
+ *
+ * */
+uringhandler *uringhandler_init(dispatch *, size_t, connmetrics *);
+
+/**
+* @brief Method for limiting the time a connection may wait for its next request
+* @param uringhandler* Pointer to structure to work on
+* @param unsigned int Idle timeout in milliseconds, 0 for no limit
+*
+* Started requests and sends always have to complete within 30 seconds.
+*
+* */
+void uringhandler_set_idle_timeout(uringhandler *, unsigned int);
+
+/**
+* @brief Main loop function of the io_uring backend
+* @param uringhandler* Pointer to structure to work on
+* @param int* Listening sockets to accept connections from, e.g. a TCP and a Unix domain socket
+* @param size_t Number of listening sockets
+* @param int Descriptor which becomes readable when the loop has to shut down, it is not read
+*
+* Accepting, receiving and sending of all connections is submitted to the ring in batches, so one
+* io_uring_enter() call covers the I/O of many connections. When the wake descriptor becomes readable,
+* new connections are rejected with BUSY and idle connections are closed. The method returns as soon as
+* the requests in flight are answered, or after 5 seconds.
+*
+* */
+void uringhandler_run(uringhandler *, const int *, size_t, int);
+
+/**
+ * @brief Destructor for uringhandler
+ * @param uringhandler* Pointer to structure to be freed
+ *
+ * Waits for the requests the worker pool is still answering, then open client connections are closed.
+ *
+ * */
+void uringhandler_destroy(uringhandler *);
+
+#endif /* URINGHANDLER_H */